@@ -0,0 +1,62 @@
+#include "batch.hpp"
+#include "database.hpp"
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+// Runs the same generated script (item inserts followed by stock moves) with
+// one commit per command and with grouped commits, and reports commands per
+// second for each.
+//
+// Usage: batch_bench.out [commands] [commit every] [database file]
+
+static string makeScript(long commands){
+    ostringstream script;
+    script << "add category name=Bench description=\"\"\n"
+           << "add suppliers name=Supplier address=\"\"\n"
+           << "add user username=bench password=x role=admin contact_info=\"\"\n";
+
+    const long items = max(1L, commands / 4);
+    for (long i = 0; i < items; ++i){
+        script << "add item name=\"Item " << i << "\" description=\"\" category_id=1 quantity=100 unit_measurement=pcs "
+               << "unit_price=2.5 supplier_id=1\n";
+    }
+    for (long i = items; i < commands; ++i){
+        script << "move-stock " << (i % items) + 1 << (i % 3 == 0 ? " -1" : " +2") << " remarks=\"bench\"\n";
+    }
+    return script.str();
+}
+
+static double run(const string &path, const string &script, size_t commitEvery, BatchStats &stats){
+    std::remove(path.c_str());
+    Database database(path);
+    database.init();
+
+    BatchOptions options;
+    options.commitEvery = commitEvery;
+    BatchRunner runner(database, options);
+
+    istringstream input(script);
+    auto start = chrono::steady_clock::now();
+    runner.run(input);
+    stats = runner.stats();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv){
+    long commands = argc > 1 ? atol(argv[1]) : 20000;
+    size_t commitEvery = argc > 2 ? static_cast<size_t>(atol(argv[2])) : 1000;
+    string path = argc > 3 ? argv[3] : "batch_bench.db";
+
+    const string script = makeScript(commands);
+    for (size_t group : {static_cast<size_t>(1), commitEvery}){
+        BatchStats stats;
+        double ms = run(path, script, group, stats);
+        printf("commit every %6zu  %10.1f ms  %10.0f commands/s  (%zu commands, %zu failed, %zu transactions)\n", group, ms,
+               static_cast<double>(stats.commands) * 1000.0 / ms, stats.commands, stats.failed, stats.transactions);
+    }
+    return 0;
+}
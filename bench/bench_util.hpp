@@ -0,0 +1,27 @@
+#ifndef BENCH_UTIL_HPP
+#define BENCH_UTIL_HPP
+
+#include "logger.hpp"
+#include <sqlite3.h>
+#include <chrono>
+#include <string>
+
+/**
+ * @brief Returns the milliseconds elapsed since start.
+ */
+inline double elapsedMs(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Runs one or more SQL statements, logging a failure.
+ */
+inline void exec(sqlite3 *db, const std::string &sql){
+    char *errMsg = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK){
+        LOG_ERROR("Error executing \"%s\": %s", sql.c_str(), errMsg);
+        sqlite3_free(errMsg);
+    }
+}
+
+#endif
@@ -0,0 +1,191 @@
+#include "bench_util.hpp"
+#include "category_tree.hpp"
+#include "database.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Builds a five-level category tree (departments down to sub-sub-categories)
+// with items on the leaves, then compares subtree aggregates answered by the
+// closure table with the recursive CTE they replace, checks that both agree,
+// and times subtree moves and the cascading removal of a department.
+//
+// Usage: category_tree_bench.out [categories] [items] [database file]
+
+// Category ids of every level, root level first.
+static vector<vector<int>> populate(sqlite3 *db, long categories, long items){
+    // 0.02%, 0.18%, 1.8%, 18% and 80% of the categories per level: 10, 90,
+    // 900, 9000 and 40000 for 50k.
+    const double shares[] = {0.0002, 0.0018, 0.018, 0.18, 0.8};
+    vector<vector<int>> levels;
+
+    exec(db, "BEGIN;");
+    exec(db, "INSERT INTO suppliers(name, address) VALUES ('Supplier', '');");
+
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO category(name, description, parent_id) VALUES (?, '', NULLIF(?, 0));", -1, &stmt, nullptr);
+    long created = 0;
+    for (double share : shares){
+        const long size = max(1L, static_cast<long>(static_cast<double>(categories) * share));
+        vector<int> level;
+        for (long i = 0; i < size; ++i){
+            const int parent = levels.empty() ? 0 : levels.back()[static_cast<size_t>(i) % levels.back().size()];
+            string name = "Category " + to_string(++created);
+            sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(stmt, 2, parent);
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+            level.push_back(static_cast<int>(sqlite3_last_insert_rowid(db)));
+        }
+        levels.push_back(move(level));
+    }
+    sqlite3_finalize(stmt);
+
+    sqlite3_prepare_v2(db, "INSERT INTO item(name, description, category_id, quantity, unit_measurement, unit_price, supplier_id) "
+                           "VALUES (?, '', ?, ?, 'pcs', ?, 1);", -1, &stmt, nullptr);
+    mt19937 random(42);
+    const vector<int> &leaves = levels.back();
+    uniform_int_distribution<size_t> leafDist(0, leaves.size() - 1);
+    uniform_int_distribution<int> quantityDist(0, 500);
+    uniform_int_distribution<int> centsDist(50, 100000);
+    for (long i = 0; i < items; ++i){
+        string name = "Item " + to_string(i);
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, leaves[leafDist(random)]);
+        sqlite3_bind_int(stmt, 3, quantityDist(random));
+        sqlite3_bind_int(stmt, 4, centsDist(random));
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    exec(db, "COMMIT;");
+    return levels;
+}
+
+// The query the closure table replaces: walk the subtree, then scan its items.
+static bool recursiveTotals(sqlite3 *db, sqlite3_stmt *stmt, int categoryId, SubtreeTotals &totals){
+    sqlite3_bind_int(stmt, 1, categoryId);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    if (found){
+        totals.items = sqlite3_column_int64(stmt, 0);
+        totals.quantity = sqlite3_column_int64(stmt, 1);
+        totals.valuation = Money::fromUnits(sqlite3_column_int64(stmt, 2));
+    }else{
+        LOG_ERROR("Error running recursive totals: %s", sqlite3_errmsg(db));
+    }
+    sqlite3_reset(stmt);
+    return found;
+}
+
+int main(int argc, char **argv){
+    long categories = argc > 1 ? atol(argv[1]) : 50000;
+    long items = argc > 2 ? atol(argv[2]) : 200000;
+    string path = argc > 3 ? argv[3] : "category_tree_bench.db";
+
+    std::remove(path.c_str());
+    Database database(path);
+    database.init();
+    sqlite3 *db = database.getDBConnection();
+    exec(db, "PRAGMA synchronous = OFF;");
+
+    auto start = chrono::steady_clock::now();
+    vector<vector<int>> levels = populate(db, categories, items);
+    printf("populate              %10.1f ms  (%ld categories, %ld items)\n", elapsedMs(start), categories, items);
+
+    CategoryTree tree(database);
+    sqlite3_stmt *recursive;
+    sqlite3_prepare_v2(db, "WITH RECURSIVE sub(id) AS (SELECT ?1 UNION ALL SELECT c.id FROM category AS c JOIN sub ON c.parent_id = sub.id) "
+                           "SELECT COUNT(*), COALESCE(SUM(quantity), 0), COALESCE(SUM(price), 0) FROM item "
+                           "WHERE deleted_at IS NULL AND category_id IN sub;", -1, &recursive, nullptr);
+
+    mt19937 random(7);
+    size_t mismatches = 0;
+    for (size_t depth = 0; depth < levels.size(); ++depth){
+        const vector<int> &level = levels[depth];
+        uniform_int_distribution<size_t> pick(0, level.size() - 1);
+        const int samples = static_cast<int>(min<size_t>(200, level.size()));
+        vector<int> ids;
+        for (int i = 0; i < samples; ++i){
+            ids.push_back(level[pick(random)]);
+        }
+
+        vector<SubtreeTotals> closure(ids.size());
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < ids.size(); ++i){
+            tree.totals(ids[i], closure[i]);
+        }
+        double closureMs = elapsedMs(start);
+
+        vector<SubtreeTotals> walked(ids.size());
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < ids.size(); ++i){
+            recursiveTotals(db, recursive, ids[i], walked[i]);
+        }
+        double recursiveMs = elapsedMs(start);
+
+        for (size_t i = 0; i < ids.size(); ++i){
+            if (closure[i].items != walked[i].items || closure[i].quantity != walked[i].quantity || closure[i].valuation != walked[i].valuation){
+                ++mismatches;
+            }
+        }
+        printf("level %zu subtree totals  closure %9.1f us  recursive %11.1f us  per query  (%d queries)\n", depth + 1,
+               closureMs * 1000.0 / samples, recursiveMs * 1000.0 / samples, samples);
+    }
+    sqlite3_finalize(recursive);
+
+    map<int, SubtreeTotals> children;
+    start = chrono::steady_clock::now();
+    tree.childTotals(0, children);
+    printf("department totals     %10.3f ms  (%zu departments)\n", elapsedMs(start), children.size());
+
+    // Moves aisles, with everything below them, to another department.
+    const vector<int> &aisles = levels.size() > 1 ? levels[1] : levels[0];
+    const vector<int> &departments = levels[0];
+    const int moves = static_cast<int>(min<size_t>(100, aisles.size()));
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < moves; ++i){
+        database.transaction([&]{
+            return tree.move(aisles[static_cast<size_t>(i)], departments[static_cast<size_t>(i + 1) % departments.size()]);
+        });
+    }
+    printf("subtree move          %10.3f ms  per move  (%zu categories per subtree)\n", elapsedMs(start) / moves,
+           static_cast<size_t>(categories) / max<size_t>(1, aisles.size()));
+
+    // Moving a department under its own deepest descendant must fail.
+    vector<int> descendants;
+    tree.subtree(departments[0], descendants);
+    bool cycleRejected = descendants.size() > 1 && !tree.move(departments[0], descendants.back());
+    printf("cycle rejected        %10s\n", cycleRejected ? "yes" : "no");
+
+    // Removing a department with cascade takes every level below it, and the items there.
+    vector<int> doomed;
+    tree.subtree(departments.back(), doomed);
+    size_t removed = 0;
+    start = chrono::steady_clock::now();
+    bool cascaded = database.removeMany("category", {departments.back()}, true, &removed) && removed == doomed.size();
+    printf("cascade remove        %10.1f ms  (%zu categories)\n", elapsedMs(start), removed);
+    vector<Row> left;
+    cascaded = cascaded && database.query("SELECT COUNT(*) AS n FROM category_tree WHERE ancestor_id = ?;", {departments.back()}, left) &&
+               std::get<sqlite3_int64>(left.front().at("n")) == 0;
+    printf("subtree removed       %10s\n", cascaded ? "yes" : "no");
+
+    // Without cascade, a category alone is refused while its child remains,
+    // but the two go together.
+    exec(db, "INSERT INTO category(name, description) VALUES ('Empty parent', '');");
+    const int emptyParent = static_cast<int>(sqlite3_last_insert_rowid(db));
+    exec(db, "INSERT INTO category(name, description, parent_id) VALUES ('Empty child', '', " + to_string(emptyParent) + ");");
+    const int emptyChild = static_cast<int>(sqlite3_last_insert_rowid(db));
+    bool pairRemoved = !database.removeMany("category", {emptyParent}) &&
+                       database.removeMany("category", {emptyParent, emptyChild}, false, &removed) && removed == 2;
+    printf("parent and child      %10s\n", pairRemoved ? "yes" : "no");
+    printf("mismatches            %10zu\n", mismatches);
+
+    Logger::instance().flush();
+    return mismatches == 0 && cycleRejected && cascaded && pairRemoved ? 0 : 1;
+}
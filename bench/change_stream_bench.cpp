@@ -0,0 +1,209 @@
+#include "bench_util.hpp"
+#include "database.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Publishes row changes through the change stream and checks when they reach
+// subscribers: a subscriber woken by a commit re-reads the row on another
+// connection and must see the committed value, a rolled-back transaction
+// publishes nothing, and neither does a COMMIT that fails to write the WAL.
+//
+// Usage: change_stream_bench.out [commits] [database file]
+
+// Runs SQL that may fail on purpose and returns its result code.
+static int tryExec(sqlite3 *db, const char *sql){
+    char *errMsg = nullptr;
+    int result = sqlite3_exec(db, sql, nullptr, nullptr, &errMsg);
+    sqlite3_free(errMsg);
+    return result;
+}
+
+// Default VFS whose writes to a WAL file fail while failWalWrites is set.
+struct FailingVfs {
+    struct File {
+        sqlite3_file base;
+        sqlite3_file *real;
+        bool wal;
+    };
+
+    static inline atomic<bool> failWalWrites{false};
+
+    static sqlite3_vfs *real(){
+        static sqlite3_vfs *vfs = sqlite3_vfs_find(nullptr);
+        return vfs;
+    }
+
+    static sqlite3_file *inner(sqlite3_file *file){
+        return reinterpret_cast<File*>(file)->real;
+    }
+
+    static int close(sqlite3_file *file){
+        int result = inner(file)->pMethods ? inner(file)->pMethods->xClose(inner(file)) : SQLITE_OK;
+        return result;
+    }
+    static int read(sqlite3_file *file, void *buffer, int amount, sqlite3_int64 offset){
+        return inner(file)->pMethods->xRead(inner(file), buffer, amount, offset);
+    }
+    static int write(sqlite3_file *file, const void *buffer, int amount, sqlite3_int64 offset){
+        if (failWalWrites && reinterpret_cast<File*>(file)->wal){
+            return SQLITE_IOERR_WRITE;
+        }
+        return inner(file)->pMethods->xWrite(inner(file), buffer, amount, offset);
+    }
+    static int truncate(sqlite3_file *file, sqlite3_int64 size){ return inner(file)->pMethods->xTruncate(inner(file), size); }
+    static int sync(sqlite3_file *file, int flags){ return inner(file)->pMethods->xSync(inner(file), flags); }
+    static int fileSize(sqlite3_file *file, sqlite3_int64 *size){ return inner(file)->pMethods->xFileSize(inner(file), size); }
+    static int lock(sqlite3_file *file, int level){ return inner(file)->pMethods->xLock(inner(file), level); }
+    static int unlock(sqlite3_file *file, int level){ return inner(file)->pMethods->xUnlock(inner(file), level); }
+    static int checkReservedLock(sqlite3_file *file, int *out){ return inner(file)->pMethods->xCheckReservedLock(inner(file), out); }
+    static int fileControl(sqlite3_file *file, int op, void *arg){ return inner(file)->pMethods->xFileControl(inner(file), op, arg); }
+    static int sectorSize(sqlite3_file *file){ return inner(file)->pMethods->xSectorSize(inner(file)); }
+    static int deviceCharacteristics(sqlite3_file *file){ return inner(file)->pMethods->xDeviceCharacteristics(inner(file)); }
+    static int shmMap(sqlite3_file *file, int region, int size, int extend, void volatile **out){
+        return inner(file)->pMethods->xShmMap(inner(file), region, size, extend, out);
+    }
+    static int shmLock(sqlite3_file *file, int offset, int count, int flags){ return inner(file)->pMethods->xShmLock(inner(file), offset, count, flags); }
+    static void shmBarrier(sqlite3_file *file){ inner(file)->pMethods->xShmBarrier(inner(file)); }
+    static int shmUnmap(sqlite3_file *file, int deleteFlag){ return inner(file)->pMethods->xShmUnmap(inner(file), deleteFlag); }
+
+    static int open(sqlite3_vfs *, sqlite3_filename name, sqlite3_file *file, int flags, int *outFlags){
+        static const sqlite3_io_methods methods = {
+            2, close, read, write, truncate, sync, fileSize, lock, unlock, checkReservedLock, fileControl, sectorSize,
+            deviceCharacteristics, shmMap, shmLock, shmBarrier, shmUnmap, nullptr, nullptr
+        };
+        File *shim = reinterpret_cast<File*>(file);
+        shim->real = reinterpret_cast<sqlite3_file*>(shim + 1);
+        shim->wal = (flags & SQLITE_OPEN_WAL) != 0;
+        int result = real()->xOpen(real(), name, shim->real, flags, outFlags);
+        shim->base.pMethods = result == SQLITE_OK ? &methods : nullptr;
+        return result;
+    }
+
+    static sqlite3_vfs &instance(){
+        static sqlite3_vfs vfs = []{
+            sqlite3_vfs copy = *real();
+            copy.zName = "failing";
+            copy.szOsFile = static_cast<int>(sizeof(File)) + real()->szOsFile;
+            copy.xOpen = open;
+            return copy;
+        }();
+        return vfs;
+    }
+};
+
+static void removeDatabase(const string &path){
+    std::remove(path.c_str());
+    std::remove((path + "-wal").c_str());
+    std::remove((path + "-shm").c_str());
+    std::remove((path + "-journal").c_str());
+}
+
+int main(int argc, char **argv){
+    int commits = argc > 1 ? atoi(argv[1]) : 20000;
+    string path = argc > 2 ? argv[2] : "change_stream_bench.db";
+
+    // Visibility: every event is followed by a read on a second connection.
+    removeDatabase(path);
+    Database database(path);
+    database.init();
+    sqlite3 *db = database.getDBConnection();
+    tryExec(db, "CREATE TABLE counter(id INTEGER PRIMARY KEY, value INTEGER NOT NULL);"
+             "INSERT INTO counter(id, value) VALUES (1, 0);");
+
+    auto subscription = database.changes().subscribe(1 << 16);
+    atomic<bool> writing{true};
+    atomic<long> received{0};
+    long staleReads = 0;
+    thread reader([&]{
+        sqlite3 *other;
+        sqlite3_open(path.c_str(), &other);
+        sqlite3_stmt *stmt;
+        sqlite3_prepare_v2(other, "SELECT value FROM counter WHERE id = 1;", -1, &stmt, nullptr);
+        vector<ChangeEvent> events;
+        while (writing || !events.empty()){
+            events.clear();
+            if (subscription->poll(events) == 0){
+                subscription->wait(chrono::milliseconds(10));
+                continue;
+            }
+            // Commit n sets the value to n, so the row is at least as new as the events seen.
+            received += static_cast<long>(events.size());
+            if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) < received){
+                ++staleReads;
+            }
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+        sqlite3_close(other);
+    });
+
+    sqlite3_stmt *update;
+    sqlite3_prepare_v2(db, "UPDATE counter SET value = ? WHERE id = 1;", -1, &update, nullptr);
+    auto start = chrono::steady_clock::now();
+    for (int commit = 1; commit <= commits; ++commit){
+        sqlite3_bind_int(update, 1, commit);
+        sqlite3_step(update);
+        sqlite3_reset(update);
+    }
+    const double ms = elapsedMs(start);
+    sqlite3_finalize(update);
+    while (database.changes().published() > static_cast<uint64_t>(received) && elapsedMs(start) < 10000.0){
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    writing = false;
+    reader.join();
+    printf("visibility        %10.1f ms  %8.2f us/commit  (%ld events, %ld stale reads)\n", ms, ms * 1e3 / commits, received.load(), staleReads);
+    const bool visible = received == commits && staleReads == 0;
+
+    // Rollback: nothing is published.
+    const uint64_t publishedBefore = database.changes().published();
+    tryExec(db, "BEGIN; UPDATE counter SET value = -1 WHERE id = 1; ROLLBACK;");
+    vector<ChangeEvent> events;
+    subscription->poll(events);
+    const bool rollbackHidden = events.empty() && database.changes().published() == publishedBefore;
+    printf("rollback          %10zu events\n", events.size());
+
+    // Failed commit: writing the WAL fails with an I/O error after the commit
+    // hook ran, and SQLite rolls the transaction back.
+    const string failingPath = path + ".failing";
+    removeDatabase(failingPath);
+    sqlite3_vfs_register(&FailingVfs::instance(), 1);
+    Database failing(failingPath);
+    sqlite3 *fdb = failing.getDBConnection();
+    tryExec(fdb, "PRAGMA journal_mode = WAL;"
+              "CREATE TABLE counter(id INTEGER PRIMARY KEY, value INTEGER NOT NULL);"
+              "INSERT INTO counter(id, value) VALUES (1, 0);");
+    auto failingSubscription = failing.changes().subscribe();
+    auto increment = [&]{ return tryExec(fdb, "UPDATE counter SET value = value + 1 WHERE id = 1;") == SQLITE_OK; };
+
+    FailingVfs::failWalWrites = true;
+    const bool failedCommitted = failing.transaction(increment);
+    const int failedError = failing.lastTransactionError();
+    FailingVfs::failWalWrites = false;
+    events.clear();
+    failingSubscription->poll(events);
+    const size_t afterFailure = events.size();
+
+    // The same transaction commits once the log can be written again, and is published.
+    const bool committed = failing.transaction(increment);
+    events.clear();
+    failingSubscription->poll(events);
+    const size_t afterSuccess = events.size();
+    sqlite3_vfs_unregister(&FailingVfs::instance());
+
+    printf("failed commit     %10zu events  (%s), %zu after a successful commit\n", afterFailure, sqlite3_errstr(failedError), afterSuccess);
+    const bool failedHidden = !failedCommitted && (failedError & 0xff) == SQLITE_IOERR && afterFailure == 0 && committed && afterSuccess == 1;
+
+    printf("visible on wake   %10s\n", visible ? "yes" : "no");
+    printf("rollback hidden   %10s\n", rollbackHidden ? "yes" : "no");
+    printf("failed hidden     %10s\n", failedHidden ? "yes" : "no");
+
+    Logger::instance().flush();
+    return visible && rollbackHidden && failedHidden ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+#include "bench_util.hpp"
+#include "database.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Stress test for concurrent access: writer threads move stock (an item
+// update plus a ledger row in one transaction) while reader threads look up
+// items and, every 50th read, run the category valuation aggregate. Every
+// (connection mode, journal mode, writers, readers) combination runs for a
+// fixed time and prints one JSON line with throughput, latency percentiles in
+// microseconds and the SQLITE_BUSY counters.
+//
+// Connection modes:
+//   shared      one Database for every thread, serialized by a mutex; this is
+//               how the application shares its connection today
+//   per-thread  one Database per thread, contending on the file locks
+//
+// Usage: contention_bench.out [seconds per run] [items] [database file]
+
+struct Mix {
+    int writers;
+    int readers;
+};
+
+enum Kind { Write, Lookup, Report, Kinds };
+
+static const char *kindNames[Kinds] = {"write", "lookup", "report"};
+
+struct Series {
+    vector<double> micros;
+    uint64_t failed = 0;
+    uint64_t busyFailures = 0;
+};
+
+static void populate(const string &path, const string &journalMode, long items){
+    for (const char *suffix : {"", "-wal", "-shm", "-journal"}){
+        std::remove((path + suffix).c_str());
+    }
+    Database database(path);
+    database.init();
+    sqlite3 *db = database.getDBConnection();
+    exec(db, "PRAGMA journal_mode = " + journalMode + ";");
+    exec(db, "BEGIN;");
+    exec(db, "INSERT INTO user(username, password, role, contact_info) VALUES ('bench', '', 'admin', '');");
+    exec(db, "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 50) "
+             "INSERT INTO category(name, description) SELECT 'Category ' || i, '' FROM n;");
+    exec(db, "INSERT INTO suppliers(name, address) VALUES ('Supplier', '');");
+    exec(db, "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < " + to_string(items) + ") "
+             "INSERT INTO item(name, description, category_id, quantity, unit_measurement, unit_price, supplier_id) "
+             "SELECT 'Item ' || i, '', 1 + i % 50, 1000000, 'pcs', 250, 1 FROM n;");
+    exec(db, "COMMIT;");
+}
+
+// Writes run in transaction(), whose rollback resets the connection's error
+// code, so their failure is read from lastTransactionError().
+static bool busy(Database &database, bool write){
+    int code = (write ? database.lastTransactionError() : sqlite3_extended_errcode(database.getDBConnection())) & 0xFF;
+    return code == SQLITE_BUSY || code == SQLITE_LOCKED;
+}
+
+static bool moveStock(Database &database, int itemId, int quantity){
+    return database.transaction([&]{
+        vector<Row> rows;
+        return database.query("UPDATE item SET quantity = quantity + ?1 WHERE id = ?2;",
+                              {quantity, itemId}, rows) &&
+               database.query("INSERT INTO transaction_records(item_id, transaction_type, quantity, transaction_date, user_id) "
+                              "VALUES (?, ?, ?, datetime('now'), 1);", {itemId, string(quantity < 0 ? "out" : "in"), abs(quantity)}, rows);
+    });
+}
+
+static bool read(Database &database, int itemId, bool report){
+    vector<Row> rows;
+    if (report){
+        return database.query("SELECT category_id, valuation FROM category_totals;", {}, rows);
+    }
+    return database.query("SELECT * FROM item WHERE id = ?;", {itemId}, rows);
+}
+
+static void run(const string &path, const string &mode, const string &journalMode, const Mix &mix, double seconds, long items){
+    populate(path, journalMode, items);
+
+    const int threads = mix.writers + mix.readers;
+    vector<unique_ptr<Database>> connections;
+    for (int i = 0; i < (mode == "shared" ? 1 : threads); ++i){
+        // Only WAL is stored in the file; DELETE and TRUNCATE apply to the
+        // connection that sets them, so every connection sets its own.
+        connections.push_back(make_unique<Database>(path));
+        exec(connections.back()->getDBConnection(), "PRAGMA journal_mode = " + journalMode + "; PRAGMA synchronous = NORMAL;");
+    }
+    mutex sharedMutex;
+
+    vector<array<Series, Kinds>> results(static_cast<size_t>(threads));
+    atomic<bool> stop{false};
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t){
+        workers.emplace_back([&, t]{
+            Database &database = *connections[mode == "shared" ? 0 : static_cast<size_t>(t)];
+            array<Series, Kinds> &series = results[static_cast<size_t>(t)];
+            const bool writer = t < mix.writers;
+            mt19937 random(static_cast<unsigned>(t + 1));
+            uniform_int_distribution<int> itemDist(1, static_cast<int>(items));
+
+            for (long operation = 0; !stop.load(memory_order_relaxed); ++operation){
+                const int itemId = itemDist(random);
+                const Kind kind = writer ? Write : operation % 50 == 49 ? Report : Lookup;
+                auto start = chrono::steady_clock::now();
+                bool ok;
+                bool busyFailure;
+                {
+                    unique_lock<mutex> lock(sharedMutex, defer_lock);
+                    if (mode == "shared"){
+                        lock.lock();
+                    }
+                    ok = kind == Write ? moveStock(database, itemId, operation % 3 == 0 ? -1 : 1) : read(database, itemId, kind == Report);
+                    busyFailure = !ok && busy(database, kind == Write);
+                }
+
+                Series &measured = series[kind];
+                measured.micros.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+                measured.failed += ok ? 0 : 1;
+                measured.busyFailures += busyFailure ? 1 : 0;
+            }
+        });
+    }
+
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    stop = true;
+    for (thread &worker : workers){
+        worker.join();
+    }
+
+    array<Series, Kinds> total;
+    for (array<Series, Kinds> &series : results){
+        for (int kind = 0; kind < Kinds; ++kind){
+            total[kind].micros.insert(total[kind].micros.end(), series[kind].micros.begin(), series[kind].micros.end());
+            total[kind].failed += series[kind].failed;
+            total[kind].busyFailures += series[kind].busyFailures;
+        }
+    }
+    BusyStats busyStats;
+    for (const unique_ptr<Database> &connection : connections){
+        BusyStats stats = connection->busyStats();
+        busyStats.handlerCalls += stats.handlerCalls;
+        busyStats.retries += stats.retries;
+        busyStats.timeouts += stats.timeouts;
+        busyStats.waitMicros += stats.waitMicros;
+    }
+
+    size_t operations = 0;
+    uint64_t busyFailures = 0;
+    printf("{\"mode\":\"%s\",\"journal\":\"%s\",\"writers\":%d,\"readers\":%d,\"seconds\":%.2f", mode.c_str(), journalMode.c_str(),
+           mix.writers, mix.readers, seconds);
+    for (int kind = 0; kind < Kinds; ++kind){
+        Series &measured = total[kind];
+        const char *name = kindNames[kind];
+        operations += measured.micros.size();
+        busyFailures += measured.busyFailures;
+        printf(",\"%ss\":%zu,\"%ss_per_s\":%.0f,\"%s_p50_us\":%.1f,\"%s_p99_us\":%.1f,\"%s_max_us\":%.1f,\"%s_failed\":%llu", name,
+               measured.micros.size(), name, static_cast<double>(measured.micros.size()) / seconds, name, percentile(measured.micros, 0.5), name,
+               percentile(measured.micros, 0.99), name, percentile(measured.micros, 1.0), name, static_cast<unsigned long long>(measured.failed));
+    }
+    printf(",\"busy_failures\":%llu,\"busy_handler_calls\":%llu,\"busy_retries\":%llu,\"busy_timeouts\":%llu,\"busy_wait_us\":%llu,"
+           "\"busy_calls_per_op\":%.4f}\n",
+           static_cast<unsigned long long>(busyFailures), static_cast<unsigned long long>(busyStats.handlerCalls),
+           static_cast<unsigned long long>(busyStats.retries), static_cast<unsigned long long>(busyStats.timeouts),
+           static_cast<unsigned long long>(busyStats.waitMicros),
+           operations > 0 ? static_cast<double>(busyStats.handlerCalls) / static_cast<double>(operations) : 0.0);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv){
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    long items = argc > 2 ? atol(argv[2]) : 10000;
+    string path = argc > 3 ? argv[3] : "contention_bench.db";
+
+    const Mix mixes[] = {{1, 0}, {0, 4}, {1, 4}, {4, 0}, {4, 4}, {2, 8}};
+    for (const char *journalMode : {"wal", "delete", "truncate"}){
+        for (const char *mode : {"shared", "per-thread"}){
+            for (const Mix &mix : mixes){
+                run(path, mode, journalMode, mix, seconds, items);
+            }
+        }
+    }
+    Logger::instance().flush();
+    return 0;
+}
@@ -0,0 +1,235 @@
+#include "bench_util.hpp"
+#include "db_executor.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Drives a DbExecutor from coroutines and checks its three ways of finishing
+// an operation: completion (many concurrent inserts and queries resumed on a
+// caller-side event loop), cancellation (a long query interrupted through
+// sqlite3_interrupt() and a queued one skipped), and shutdown (coroutines
+// resumed as Cancelled by the destructor that await again must still finish).
+//
+// Usage: db_executor_bench.out [coroutines] [database file]
+
+// Fire-and-forget coroutine; the frame frees itself when the body returns.
+struct Task {
+    struct promise_type {
+        Task get_return_object(){ return {}; }
+        suspend_never initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void(){}
+        void unhandled_exception(){ terminate(); }
+    };
+};
+
+// Single-threaded event loop the executor posts resumed coroutines to.
+class EventLoop {
+    private :
+        deque<coroutine_handle<>> ready;
+        mutex readyMutex;
+        condition_variable readyCondition;
+
+    public :
+        void post(coroutine_handle<> handle){
+            {
+                lock_guard<mutex> lock(readyMutex);
+                ready.push_back(handle);
+            }
+            readyCondition.notify_one();
+        }
+
+        // Resumes posted coroutines until done() holds.
+        template <typename Done>
+        void runUntil(Done done){
+            while (!done()){
+                coroutine_handle<> handle;
+                {
+                    unique_lock<mutex> lock(readyMutex);
+                    if (!readyCondition.wait_for(lock, chrono::milliseconds(100), [this]{ return !ready.empty(); })){
+                        continue;
+                    }
+                    handle = ready.front();
+                    ready.pop_front();
+                }
+                handle.resume();
+            }
+        }
+};
+
+struct Counters {
+    atomic<long> finished{0};
+    atomic<long> ok{0};
+    atomic<long> cancelled{0};
+    atomic<long> failed{0};
+
+    void count(const DbResult &result){
+        if (result.status == DbStatus::Ok){
+            ++ok;
+        }else if (result.status == DbStatus::Cancelled){
+            ++cancelled;
+        }else{
+            ++failed;
+        }
+    }
+};
+
+struct Movement {
+    int itemId;
+    int quantity;
+    string remarks;
+};
+
+static const FieldMapping<Movement> movementMapping = {
+    {"item_id", [](const Movement &movement){ return movement.itemId; }},
+    {"quantity", [](const Movement &movement){ return movement.quantity; }},
+    {"remarks", [](const Movement &movement){ return movement.remarks; }},
+};
+
+// Inserts a row, then reads it back.
+static Task insertAndRead(DbExecutor &executor, int number, Counters &counters){
+    Movement movement{1, number, "bench " + to_string(number)};
+    DbResult inserted = co_await executor.insert("bench_movement", movement, movementMapping);
+    counters.count(inserted);
+
+    string sql = "SELECT quantity FROM bench_movement WHERE remarks = ?;";
+    vector<FieldValue> parameters{movement.remarks};
+    DbResult read = co_await executor.query(sql, parameters);
+    if (read.ok() && (read.rows.size() != 1 || get<sqlite3_int64>(read.rows[0].at("quantity")) != number)){
+        read.status = DbStatus::Failed;
+    }
+    counters.count(read);
+    ++counters.finished;
+}
+
+// Awaits an operation with a token and records how it ended.
+static Task awaitOperation(DbExecutor &executor, function<bool(Database&)> work, CancellationToken token, Counters &counters){
+    DbResult result = co_await executor.execute(move(work), token);
+    counters.count(result);
+    ++counters.finished;
+}
+
+// Retries its query on Cancelled, as a request handler might; during
+// shutdown every attempt must come back Cancelled rather than hang.
+static Task retryingQuery(DbExecutor &executor, int attempts, Counters &counters){
+    string sql = "SELECT COUNT(*) AS n FROM bench_movement;";
+    for (int attempt = 0; attempt < attempts; ++attempt){
+        DbResult result = co_await executor.query(sql);
+        counters.count(result);
+        if (result.status != DbStatus::Cancelled){
+            break;
+        }
+    }
+    ++counters.finished;
+}
+
+// Query that runs for a long time without returning a row.
+static bool longQuery(Database &database){
+    vector<Row> rows;
+    return database.query("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 2000000000) "
+                          "SELECT COUNT(*) AS n FROM n;", {}, rows);
+}
+
+int main(int argc, char **argv){
+    int coroutines = argc > 1 ? atoi(argv[1]) : 20000;
+    string path = argc > 2 ? argv[2] : "db_executor_bench.db";
+
+    std::remove(path.c_str());
+    std::remove((path + "-wal").c_str());
+    std::remove((path + "-shm").c_str());
+    {
+        Database setup(path);
+        setup.init();
+        sqlite3_exec(setup.getDBConnection(), "CREATE TABLE bench_movement(id INTEGER PRIMARY KEY, item_id INTEGER, quantity INTEGER, remarks TEXT);"
+                                              "CREATE INDEX idx_bench_movement_remarks ON bench_movement(remarks);", nullptr, nullptr, nullptr);
+    }
+
+    // Completion: every coroutine gets both of its results on the loop thread.
+    EventLoop loop;
+    Counters completion;
+    {
+        DbExecutor executor(path, [&loop](coroutine_handle<> handle){ loop.post(handle); });
+        auto start = chrono::steady_clock::now();
+        for (int number = 0; number < coroutines; ++number){
+            insertAndRead(executor, number, completion);
+        }
+        loop.runUntil([&]{ return completion.finished == coroutines; });
+        const double ms = elapsedMs(start);
+        printf("completion        %10.1f ms  %8.1f us/operation  (%ld ok, %ld failed)\n", ms, ms * 1e3 / (2.0 * coroutines),
+               completion.ok.load(), completion.failed.load());
+    }
+    const bool completed = completion.ok == 2L * coroutines && completion.failed == 0;
+
+    // Cancellation: the running query is interrupted, the queued one never starts.
+    Counters cancellation;
+    double interruptMs = 0.0;
+    atomic<bool> started{false};
+    atomic<bool> queuedRan{false};
+    {
+        DbExecutor executor(path, [&loop](coroutine_handle<> handle){ loop.post(handle); });
+        CancellationToken running = CancellationToken::create();
+        CancellationToken queued = CancellationToken::create();
+        awaitOperation(executor, [&started](Database &database){
+            started = true;
+            return longQuery(database);
+        }, running, cancellation);
+        awaitOperation(executor, [&queuedRan](Database&){
+            queuedRan = true;
+            return true;
+        }, queued, cancellation);
+
+        while (!started){
+            this_thread::yield();
+        }
+        this_thread::sleep_for(chrono::milliseconds(50));
+        auto start = chrono::steady_clock::now();
+        executor.cancel(queued);
+        executor.cancel(running);
+        loop.runUntil([&]{ return cancellation.finished == 2; });
+        interruptMs = elapsedMs(start);
+    }
+    printf("cancellation      %10.3f ms  (%ld cancelled, queued operation ran: %s)\n", interruptMs, cancellation.cancelled.load(),
+           queuedRan ? "yes" : "no");
+    const bool interrupted = cancellation.cancelled == 2 && !queuedRan;
+
+    // Shutdown: coroutines resumed inline by the destructor retry at once.
+    Counters shutdown;
+    const int retrying = 100;
+    const int attempts = 3;
+    auto start = chrono::steady_clock::now();
+    {
+        DbExecutor executor(path);
+        atomic<bool> blocking{false};
+        awaitOperation(executor, [&blocking](Database&){
+            blocking = true;
+            this_thread::sleep_for(chrono::milliseconds(100));
+            return true;
+        }, CancellationToken(), shutdown);
+        while (!blocking){
+            this_thread::yield();
+        }
+        for (int number = 0; number < retrying; ++number){
+            retryingQuery(executor, attempts, shutdown);
+        }
+    }
+    const double shutdownMs = elapsedMs(start);
+    printf("shutdown          %10.1f ms  (%ld of %d coroutines finished, %ld cancelled)\n", shutdownMs, shutdown.finished.load(),
+           retrying + 1, shutdown.cancelled.load());
+    const bool drained = shutdown.finished == retrying + 1 && shutdown.ok == 1 && shutdown.cancelled == static_cast<long>(retrying) * attempts;
+
+    printf("completed         %10s\n", completed ? "yes" : "no");
+    printf("interrupted       %10s\n", interrupted ? "yes" : "no");
+    printf("drained           %10s\n", drained ? "yes" : "no");
+
+    Logger::instance().flush();
+    return completed && interrupted && drained ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+#include "bench_util.hpp"
+#include "database.hpp"
+#include "item_snapshot.hpp"
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+
+using namespace std;
+
+// Compares the dashboard aggregates computed by ItemSnapshot with the
+// equivalent SQL queries.
+//
+// Usage: item_snapshot_bench.out [rows] [database file]
+
+static Money sqlAmount(sqlite3 *db, const char *sql){
+    sqlite3_stmt *stmt;
+    Money value;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW){
+        value = Money::fromUnits(sqlite3_column_int64(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+static size_t sqlRowCount(sqlite3 *db, const char *sql){
+    sqlite3_stmt *stmt;
+    size_t rows = 0;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK){
+        while (sqlite3_step(stmt) == SQLITE_ROW){
+            ++rows;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return rows;
+}
+
+static void populate(sqlite3 *db, long rows){
+    const int categories = 200;
+    const int suppliers = 100;
+
+    exec(db, "BEGIN;");
+    for (int i = 1; i <= categories; ++i){
+        string sql = "INSERT INTO category(name, description) VALUES ('Category " + to_string(i) + "', '');";
+        exec(db, sql);
+    }
+    for (int i = 1; i <= suppliers; ++i){
+        string sql = "INSERT INTO suppliers(name, address) VALUES ('Supplier " + to_string(i) + "', '');";
+        exec(db, sql);
+    }
+
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO item(name, description, category_id, quantity, unit_measurement, unit_price, supplier_id) "
+                           "VALUES (?, '', ?, ?, 'pcs', ?, ?);", -1, &stmt, nullptr);
+
+    mt19937 random(42);
+    uniform_int_distribution<int> categoryDist(1, categories);
+    uniform_int_distribution<int> supplierDist(1, suppliers);
+    uniform_int_distribution<int> quantityDist(0, 500);
+    uniform_int_distribution<int> centsDist(50, 100000);
+
+    for (long i = 0; i < rows; ++i){
+        int quantity = quantityDist(random);
+        int64_t unitPrice = centsDist(random);
+        string name = "Item " + to_string(i);
+
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, categoryDist(random));
+        sqlite3_bind_int(stmt, 3, quantity);
+        sqlite3_bind_int64(stmt, 4, unitPrice);
+        sqlite3_bind_int(stmt, 5, supplierDist(random));
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+
+    sqlite3_finalize(stmt);
+    exec(db, "COMMIT;");
+}
+
+int main(int argc, char **argv){
+    long rows = argc > 1 ? atol(argv[1]) : 10000000;
+    string path = argc > 2 ? argv[2] : "item_snapshot_bench.db";
+
+    std::remove(path.c_str());
+    Database database(path);
+    database.init();
+    sqlite3 *db = database.getDBConnection();
+    exec(db, "PRAGMA journal_mode = WAL;");
+    exec(db, "PRAGMA synchronous = OFF;");
+
+    auto start = chrono::steady_clock::now();
+    populate(db, rows);
+    printf("populate            %10.1f ms  (%ld rows)\n", elapsedMs(start), rows);
+
+    ItemSnapshot snapshot(database);
+    start = chrono::steady_clock::now();
+    snapshot.load();
+    printf("snapshot load       %10.1f ms\n", elapsedMs(start));
+    printf("avx2 kernels        %10s\n", kernels::avx2Enabled() ? "yes" : "no");
+
+    start = chrono::steady_clock::now();
+    Money sqlValuation = sqlAmount(db, "SELECT SUM(quantity * unit_price) FROM item;");
+    printf("valuation   sql     %10.3f ms  = %s\n", elapsedMs(start), sqlValuation.toString().c_str());
+
+    start = chrono::steady_clock::now();
+    Money snapshotValuation;
+    snapshot.totalValuation(snapshotValuation);
+    printf("valuation   simd    %10.3f ms  = %s%s\n", elapsedMs(start), snapshotValuation.toString().c_str(),
+           snapshotValuation == sqlValuation ? "" : "  (differs from sql)");
+
+    const auto &quantities = snapshot.itemQuantities();
+    const auto &unitPrices = snapshot.itemUnitPrices();
+    start = chrono::steady_clock::now();
+    int64_t scalarValuation = 0;
+    kernels::sumProductsScalar(quantities.data(), unitPrices.data(), quantities.size(), scalarValuation);
+    printf("valuation   scalar  %10.3f ms  = %s\n", elapsedMs(start), Money::fromUnits(scalarValuation).toString().c_str());
+
+    start = chrono::steady_clock::now();
+    size_t sqlGroups = sqlRowCount(db, "SELECT category_id, SUM(quantity * unit_price) FROM item GROUP BY category_id;");
+    printf("by category sql     %10.3f ms  (%zu groups)\n", elapsedMs(start), sqlGroups);
+
+    start = chrono::steady_clock::now();
+    map<int, Money> valuations;
+    snapshot.valuationByCategory(valuations);
+    size_t snapshotGroups = valuations.size();
+    printf("by category simd    %10.3f ms  (%zu groups)\n", elapsedMs(start), snapshotGroups);
+
+    start = chrono::steady_clock::now();
+    size_t sqlLow = sqlRowCount(db, "SELECT id FROM item WHERE quantity < 10;");
+    printf("low stock   sql     %10.3f ms  (%zu items)\n", elapsedMs(start), sqlLow);
+
+    start = chrono::steady_clock::now();
+    size_t snapshotLow = snapshot.lowStock(10).size();
+    printf("low stock   simd    %10.3f ms  (%zu items)\n", elapsedMs(start), snapshotLow);
+
+    start = chrono::steady_clock::now();
+    exec(db, "UPDATE item SET quantity = quantity + 1 WHERE id % 1000 = 0;");
+    size_t applied = snapshot.refresh();
+    printf("incremental refresh %10.3f ms  (%zu rows)\n", elapsedMs(start), applied);
+
+    return 0;
+}
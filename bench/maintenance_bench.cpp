@@ -0,0 +1,174 @@
+#include "bench_util.hpp"
+#include "compactor.hpp"
+#include "database.hpp"
+#include "maintenance.hpp"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+// Runs the MaintenanceScheduler and the Compactor against a live database.
+//
+// The scheduler sees a burst of heavy writes, a trickle of small commits and
+// then an idle period. The burst must trigger passive checkpoints that keep the
+// WAL bounded, the trickle must not (the WAL file keeps its size after a
+// checkpoint, only the frame count says whether one is due), and the idle
+// period must truncate the WAL and run ANALYZE. Throughout, the WAL may not
+// grow much beyond commitCheckpointFrames. The compactor then purges
+// expired tombstones and hands the free pages back to the file system.
+//
+// Usage: maintenance_bench.out [burst seconds] [items] [database file]
+
+static int queryInt(sqlite3 *db, const char *sql){
+    sqlite3_stmt *stmt;
+    int value = -1;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW){
+        value = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+static uintmax_t fileSize(const string &path){
+    error_code error;
+    uintmax_t size = filesystem::file_size(path, error);
+    return error ? 0 : size;
+}
+
+// One transaction of count items with a few hundred bytes each.
+static void insertItems(sqlite3 *db, sqlite3_stmt *stmt, long first, long count){
+    exec(db, "BEGIN;");
+    const string description(300, 'd');
+    for (long i = first; i < first + count; ++i){
+        string name = "Item " + to_string(i);
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, description.c_str(), -1, SQLITE_STATIC);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    exec(db, "COMMIT;");
+}
+
+// Polls until done() holds or the timeout passes.
+template <typename Done>
+static bool waitFor(Done done, chrono::milliseconds timeout){
+    auto deadline = chrono::steady_clock::now() + timeout;
+    while (!done()){
+        if (chrono::steady_clock::now() >= deadline){
+            return false;
+        }
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    return true;
+}
+
+int main(int argc, char **argv){
+    double burstSeconds = argc > 1 ? atof(argv[1]) : 2.0;
+    long items = argc > 2 ? atol(argv[2]) : 20000;
+    string path = argc > 3 ? argv[3] : "maintenance_bench.db";
+    const string walPath = path + "-wal";
+
+    std::remove(path.c_str());
+    std::remove(walPath.c_str());
+    std::remove((path + "-shm").c_str());
+    Database database(path);
+    database.init();
+    sqlite3 *db = database.getDBConnection();
+    exec(db, "INSERT INTO category(name, description) VALUES ('Category', '');"
+             "INSERT INTO suppliers(name, address) VALUES ('Supplier', '');");
+
+    sqlite3_stmt *insert;
+    sqlite3_prepare_v2(db, "INSERT INTO item(name, description, category_id, quantity, unit_measurement, unit_price, supplier_id) "
+                           "VALUES (?, ?, 1, 1, 'pcs', 100, 1);", -1, &insert, nullptr);
+
+    MaintenanceOptions options;
+    options.tick = chrono::milliseconds(10);
+    options.idleThreshold = chrono::milliseconds(500);
+    options.checkpointInterval = chrono::milliseconds(50);
+    options.passiveCheckpointFrames = 200;
+    options.analyzeInterval = chrono::milliseconds(200);
+    options.analyzeWriteThreshold = 1000;
+    options.optimizeInterval = chrono::milliseconds(1000);
+    MaintenanceScheduler scheduler(database, options);
+    scheduler.start();
+
+    // Burst: large commits back to back.
+    long inserted = 0;
+    uintmax_t maxWal = 0;
+    auto start = chrono::steady_clock::now();
+    while (elapsedMs(start) < burstSeconds * 1000.0){
+        insertItems(db, insert, inserted, 200);
+        inserted += 200;
+        maxWal = max(maxWal, fileSize(walPath));
+    }
+    const MaintenanceMetrics afterBurst = scheduler.metrics();
+    printf("burst             %10.1f ms  (%ld items, %llu passive and %llu commit checkpoints, WAL at most %llu KiB)\n", elapsedMs(start), inserted,
+           static_cast<unsigned long long>(afterBurst.passiveCheckpoints), static_cast<unsigned long long>(afterBurst.commitCheckpoints),
+           static_cast<unsigned long long>(maxWal / 1024));
+
+    // Trickle: one small commit every 40 ms, never idle long enough to truncate.
+    start = chrono::steady_clock::now();
+    const uintmax_t walBeforeTrickle = fileSize(walPath);
+    for (int commit = 0; commit < 25; ++commit){
+        exec(db, "UPDATE item SET quantity = quantity + 1 WHERE id = 1;");
+        this_thread::sleep_for(chrono::milliseconds(40));
+    }
+    const MaintenanceMetrics afterTrickle = scheduler.metrics();
+    const uint64_t tricklePassive = afterTrickle.passiveCheckpoints - afterBurst.passiveCheckpoints;
+    printf("trickle           %10.1f ms  (25 commits, %llu passive checkpoints, WAL file %llu KiB before)\n", elapsedMs(start),
+           static_cast<unsigned long long>(tricklePassive), static_cast<unsigned long long>(walBeforeTrickle / 1024));
+
+    // Idle: the WAL is truncated and the statistics refreshed.
+    start = chrono::steady_clock::now();
+    const bool truncated = waitFor([&]{ return scheduler.metrics().truncateCheckpoints > 0 && fileSize(walPath) == 0; }, chrono::seconds(10));
+    const bool analyzed = waitFor([&]{ return scheduler.metrics().analyzeRuns > 0 && scheduler.metrics().optimizeRuns > 0; }, chrono::seconds(10));
+    scheduler.stop();
+    const MaintenanceMetrics idleMetrics = scheduler.metrics();
+    printf("idle              %10.1f ms  (%llu truncate checkpoints, %llu ANALYZE, %llu optimize, %llu busy skips)\n", elapsedMs(start),
+           static_cast<unsigned long long>(idleMetrics.truncateCheckpoints), static_cast<unsigned long long>(idleMetrics.analyzeRuns),
+           static_cast<unsigned long long>(idleMetrics.optimizeRuns), static_cast<unsigned long long>(idleMetrics.busySkips));
+
+    // Compaction: tombstones past their retention are purged, the file shrinks.
+    const long doomed = min(items, inserted);
+    const string softDelete = "UPDATE item SET deleted_at = datetime('now', '-2 days') WHERE id <= " + to_string(doomed) + ";";
+    exec(db, softDelete);
+    exec(db, "PRAGMA wal_checkpoint(TRUNCATE);");
+    const uintmax_t sizeBefore = fileSize(path);
+
+    CompactorOptions compaction;
+    compaction.retention = chrono::hours(24);
+    compaction.interval = chrono::milliseconds(50);
+    compaction.idleThreshold = chrono::milliseconds(200);
+    compaction.freelistThreshold = 64;
+    compaction.vacuumPages = 512;
+    Compactor compactor(database, compaction);
+    start = chrono::steady_clock::now();
+    compactor.start();
+    const bool purgedAll = waitFor([&]{ return compactor.purgedRows() == static_cast<uint64_t>(doomed); }, chrono::seconds(30));
+    const bool vacuumed = waitFor([&]{ return queryInt(db, "PRAGMA freelist_count;") < compaction.freelistThreshold; }, chrono::seconds(30));
+    compactor.stop();
+    exec(db, "PRAGMA wal_checkpoint(TRUNCATE);");
+    const uintmax_t sizeAfter = fileSize(path);
+    const int remaining = queryInt(db, "SELECT COUNT(*) FROM item WHERE deleted_at IS NOT NULL;");
+    printf("compaction        %10.1f ms  (%llu purged, %llu pages released, file %llu -> %llu KiB, %d tombstones left)\n", elapsedMs(start),
+           static_cast<unsigned long long>(compactor.purgedRows()), static_cast<unsigned long long>(compactor.vacuumedPages()),
+           static_cast<unsigned long long>(sizeBefore / 1024), static_cast<unsigned long long>(sizeAfter / 1024), remaining);
+    sqlite3_finalize(insert);
+
+    // The log may overshoot the limit by the commit that crossed it.
+    const uintmax_t walLimit = static_cast<uintmax_t>(options.commitCheckpointFrames + 400) * static_cast<uintmax_t>(queryInt(db, "PRAGMA page_size;") + 24);
+    const bool burstCheckpointed = afterBurst.passiveCheckpoints > 0 && maxWal <= walLimit;
+    const bool trickleLeftAlone = tricklePassive <= 1;
+    const bool compacted = purgedAll && vacuumed && remaining == 0 && compactor.vacuumedPages() > 0 && sizeAfter < sizeBefore;
+    printf("burst checkpointed %9s\n", burstCheckpointed ? "yes" : "no");
+    printf("trickle left alone %9s\n", trickleLeftAlone ? "yes" : "no");
+    printf("idle truncated     %9s\n", truncated ? "yes" : "no");
+    printf("idle analyzed      %9s\n", analyzed ? "yes" : "no");
+    printf("compacted          %9s\n", compacted ? "yes" : "no");
+
+    Logger::instance().flush();
+    return burstCheckpointed && trickleLeftAlone && truncated && analyzed && compacted ? 0 : 1;
+}
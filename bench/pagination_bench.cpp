@@ -0,0 +1,117 @@
+#include "bench_util.hpp"
+#include "database.hpp"
+#include "paginator.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+// Fetches pages at increasing depths of the item listing (ordered by name)
+// with LIMIT/OFFSET and with the keyset Paginator, and checks that paging
+// backward returns the same rows as paging forward.
+//
+// Usage: pagination_bench.out [items] [page size] [repetitions] [database file]
+
+static void populate(sqlite3 *db, long items){
+    exec(db, "BEGIN;");
+    exec(db, "INSERT INTO category(name, description) VALUES ('Category', '');");
+    exec(db, "INSERT INTO suppliers(name, address) VALUES ('Supplier', '');");
+
+    // Names in scrambled order, so the listing is not simply the id order.
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO item(name, description, category_id, quantity, unit_measurement, unit_price, supplier_id) "
+                           "VALUES (?, '', 1, 1, 'pcs', 100, 1);", -1, &stmt, nullptr);
+    for (long i = 0; i < items; ++i){
+        string name = "Item " + to_string((i * 7919) % items) + "-" + to_string(i);
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    exec(db, "UPDATE item SET deleted_at = datetime('now') WHERE id % 50 = 0;");
+    exec(db, "COMMIT;");
+}
+
+int main(int argc, char **argv){
+    long items = argc > 1 ? atol(argv[1]) : 500000;
+    long pageSize = argc > 2 ? atol(argv[2]) : 50;
+    long repetitions = argc > 3 ? atol(argv[3]) : 20;
+    string path = argc > 4 ? argv[4] : "pagination_bench.db";
+
+    std::remove(path.c_str());
+    Database database(path);
+    database.init();
+    sqlite3 *db = database.getDBConnection();
+    exec(db, "PRAGMA synchronous = OFF;");
+
+    auto start = chrono::steady_clock::now();
+    populate(db, items);
+    printf("populate    %10.1f ms  (%ld items)\n", elapsedMs(start), items);
+
+    Paginator paginator(database, "item", "name", false, static_cast<size_t>(pageSize));
+
+    // Walk the whole listing once, keeping the token of every page.
+    start = chrono::steady_clock::now();
+    vector<string> tokens = {""};
+    vector<int> forwardIds;
+    Page page;
+    paginator.first(page);
+    while (true){
+        for (const Row &row : page.rows){
+            forwardIds.push_back(std::get<sqlite3_int64>(row.at("id")));
+        }
+        if (page.nextToken.empty()){
+            break;
+        }
+        tokens.push_back(page.nextToken);
+        paginator.fetch(page.nextToken, page);
+    }
+    printf("full walk   %10.1f ms  (%zu pages, %zu live rows)\n", elapsedMs(start), tokens.size(), forwardIds.size());
+
+    // Both sides decode rows through Database::query, so only the access path differs.
+    const string offsetSql = "SELECT * FROM item WHERE deleted_at IS NULL ORDER BY name, id LIMIT ? OFFSET ?;";
+    vector<Row> rows;
+
+    printf("%10s %16s %16s\n", "page", "offset ms/page", "keyset ms/page");
+    for (size_t depth = 1; depth < tokens.size(); depth *= 10){
+        start = chrono::steady_clock::now();
+        long checksum = 0;
+        for (long r = 0; r < repetitions; ++r){
+            database.query(offsetSql, {static_cast<int>(pageSize), static_cast<int>(depth * static_cast<size_t>(pageSize))}, rows);
+            for (const Row &row : rows){
+                checksum += std::get<sqlite3_int64>(row.at("id"));
+            }
+        }
+        double offsetMs = elapsedMs(start) / static_cast<double>(repetitions);
+
+        start = chrono::steady_clock::now();
+        long keysetChecksum = 0;
+        for (long r = 0; r < repetitions; ++r){
+            paginator.fetch(tokens[depth], page);
+            for (const Row &row : page.rows){
+                keysetChecksum += std::get<sqlite3_int64>(row.at("id"));
+            }
+        }
+        double keysetMs = elapsedMs(start) / static_cast<double>(repetitions);
+        printf("%10zu %16.3f %16.3f%s\n", depth, offsetMs, keysetMs, checksum == keysetChecksum ? "" : "  (rows differ)");
+    }
+
+    // Walking backward from the last page must list the same rows in the same order.
+    start = chrono::steady_clock::now();
+    vector<int> backwardIds;
+    paginator.last(page);
+    while (true){
+        for (auto row = page.rows.rbegin(); row != page.rows.rend(); ++row){
+            backwardIds.push_back(std::get<sqlite3_int64>(row->at("id")));
+        }
+        if (page.previousToken.empty()){
+            break;
+        }
+        paginator.fetch(page.previousToken, page);
+    }
+    reverse(backwardIds.begin(), backwardIds.end());
+    printf("backward walk %8.1f ms  (%s)\n", elapsedMs(start), backwardIds == forwardIds ? "same rows as forward" : "rows differ");
+    return 0;
+}
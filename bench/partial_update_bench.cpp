@@ -0,0 +1,94 @@
+#include "bench_util.hpp"
+#include "database.hpp"
+#include "tracked.hpp"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+using namespace std;
+
+// Measures WAL bytes written per update when every mapped column is written
+// versus only the dirty ones.
+//
+// Usage: partial_update_bench.out [items] [updates] [database file]
+
+struct Item {
+    string name;
+    string description;
+    int categoryId;
+    int quantity;
+    string unitMeasurement;
+    Money unitPrice;
+    int supplierId;
+};
+
+static const FieldMapping<Item> itemMapping = {
+    {"name", [](const Item &item){ return item.name; }},
+    {"description", [](const Item &item){ return item.description; }},
+    {"category_id", [](const Item &item){ return item.categoryId; }},
+    {"quantity", [](const Item &item){ return item.quantity; }},
+    {"unit_measurement", [](const Item &item){ return item.unitMeasurement; }},
+    {"unit_price", [](const Item &item){ return item.unitPrice; }},
+    {"supplier_id", [](const Item &item){ return item.supplierId; }},
+};
+
+static uintmax_t walSize(const string &path){
+    error_code error;
+    uintmax_t size = filesystem::file_size(path + "-wal", error);
+    return error ? 0 : size;
+}
+
+static Item makeItem(int i){
+    return Item{"Item " + to_string(i), "Description of item " + to_string(i), 1, 100, "pcs", Money::fromUnits(250), 1};
+}
+
+int main(int argc, char **argv){
+    int items = argc > 1 ? atoi(argv[1]) : 100000;
+    int updates = argc > 2 ? atoi(argv[2]) : 10000;
+    string path = argc > 3 ? argv[3] : "partial_update_bench.db";
+
+    std::remove(path.c_str());
+    Database database(path);
+    sqlite3 *db = database.getDBConnection();
+    exec(db, "PRAGMA journal_mode = WAL;");
+    // No automatic checkpoint: the runs below truncate the log themselves.
+    database.setWalObserver([](sqlite3*, const char*, int){});
+    database.init();
+
+    exec(db, "INSERT INTO category(name, description) VALUES ('General', '');");
+    exec(db, "INSERT INTO suppliers(name, address) VALUES ('Supplier', '');");
+    database.transaction([&]{
+        for (int i = 0; i < items; ++i){
+            database.insert("item", makeItem(i), itemMapping);
+        }
+        return true;
+    });
+
+    // Full-row updates: every mapped column is rewritten.
+    exec(db, "PRAGMA wal_checkpoint(TRUNCATE);");
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < updates; ++i){
+        Item item = makeItem(i % items);
+        item.quantity = 100 + i;
+        database.update("item", i % items + 1, item, itemMapping);
+    }
+    double fullMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    uintmax_t fullBytes = walSize(path);
+
+    // Dirty-field updates: only quantity is written.
+    exec(db, "PRAGMA wal_checkpoint(TRUNCATE);");
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < updates; ++i){
+        Tracked<Item> item(makeItem(i % items));
+        item.edit().quantity = 200 + i;
+        database.update("item", i % items + 1, item, itemMapping);
+    }
+    double partialMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    uintmax_t partialBytes = walSize(path);
+
+    printf("updates                 %d (autocommit, %d items)\n", updates, items);
+    printf("full row    WAL bytes/update %10.1f   %8.1f ms\n", static_cast<double>(fullBytes) / updates, fullMs);
+    printf("dirty only  WAL bytes/update %10.1f   %8.1f ms\n", static_cast<double>(partialBytes) / updates, partialMs);
+    return 0;
+}
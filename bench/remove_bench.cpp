@@ -0,0 +1,170 @@
+#include "bench_util.hpp"
+#include "database.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Times cascading removals of suppliers, which reach supplier_prices through
+// two parents (the supplier and the item it supplies), and checks that the
+// foreign keys still hold afterwards. Then removes from a small diamond of
+// tables whose two-parent table has a child of its own, where the removal
+// only succeeds in topological order, and checks that tables referencing each
+// other in a cycle are refused.
+//
+// Usage: remove_bench.out [suppliers] [items] [database file]
+
+static long count(sqlite3 *db, const string &sql){
+    sqlite3_stmt *stmt;
+    long rows = -1;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW){
+        rows = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return rows;
+}
+
+// Each item gets a default supplier, three offers from other suppliers and two
+// transactions.
+static void populate(sqlite3 *db, int suppliers, long items){
+    exec(db, "BEGIN;");
+    exec(db, "INSERT INTO category(name, description) VALUES ('Category', '');");
+    exec(db, "INSERT INTO user(username, password, role, contact_info) VALUES ('bench', '', 'admin', '');");
+
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO suppliers(name, address) VALUES (?, '');", -1, &stmt, nullptr);
+    for (int i = 0; i < suppliers; ++i){
+        string name = "Supplier " + to_string(i + 1);
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    sqlite3_stmt *item, *offer, *record;
+    sqlite3_prepare_v2(db, "INSERT INTO item(name, description, category_id, quantity, unit_measurement, unit_price, supplier_id) "
+                           "VALUES (?, '', 1, 10, 'pcs', 100, ?);", -1, &item, nullptr);
+    sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO supplier_prices(supplier_id, item_id, unit_price) VALUES (?, ?, 90);", -1, &offer, nullptr);
+    sqlite3_prepare_v2(db, "INSERT INTO transaction_records(item_id, transaction_type, quantity, transaction_date, user_id) "
+                           "VALUES (?, 'purchase', 5, '2026-01-01', 1);", -1, &record, nullptr);
+    mt19937 random(42);
+    uniform_int_distribution<int> supplierDist(1, suppliers);
+    for (long i = 0; i < items; ++i){
+        string name = "Item " + to_string(i);
+        sqlite3_bind_text(item, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(item, 2, supplierDist(random));
+        sqlite3_step(item);
+        sqlite3_reset(item);
+        const sqlite3_int64 itemId = sqlite3_last_insert_rowid(db);
+
+        for (int j = 0; j < 3; ++j){
+            sqlite3_bind_int(offer, 1, supplierDist(random));
+            sqlite3_bind_int64(offer, 2, itemId);
+            sqlite3_step(offer);
+            sqlite3_reset(offer);
+        }
+        for (int j = 0; j < 2; ++j){
+            sqlite3_bind_int64(record, 1, itemId);
+            sqlite3_step(record);
+            sqlite3_reset(record);
+        }
+    }
+    sqlite3_finalize(item);
+    sqlite3_finalize(offer);
+    sqlite3_finalize(record);
+    exec(db, "COMMIT;");
+}
+
+// crate references both region and depot, and is created before depot so the
+// schema lists it first; label hangs off crate. Removing a region must collect
+// the crates of its depots before following crate to label, and delete crate
+// before depot.
+static void populateDiamond(sqlite3 *db){
+    exec(db, "CREATE TABLE region (id INTEGER PRIMARY KEY); "
+             "CREATE TABLE crate (id INTEGER PRIMARY KEY, region_id INTEGER REFERENCES region(id), depot_id INTEGER REFERENCES depot(id)); "
+             "CREATE TABLE depot (id INTEGER PRIMARY KEY, region_id INTEGER REFERENCES region(id)); "
+             "CREATE TABLE label (id INTEGER PRIMARY KEY, crate_id INTEGER REFERENCES crate(id)); "
+             "CREATE INDEX idx_crate_region ON crate(region_id); "
+             "CREATE INDEX idx_crate_depot ON crate(depot_id); "
+             "CREATE INDEX idx_depot_region ON depot(region_id); "
+             "CREATE INDEX idx_label_crate ON label(crate_id);");
+
+    exec(db, "BEGIN;");
+    exec(db, "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 1000) "
+             "INSERT INTO region (id) SELECT i FROM n WHERE i <= 10;");
+    exec(db, "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 1000) "
+             "INSERT INTO depot (id, region_id) SELECT i, i % 10 + 1 FROM n WHERE i <= 100;");
+    // A crate sits in one region and a depot of the next region.
+    exec(db, "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 1000) "
+             "INSERT INTO crate (id, region_id, depot_id) SELECT i, i % 10 + 1, (i + 1) % 10 + 10 * (i / 10 % 9) + 10 FROM n;");
+    exec(db, "INSERT INTO label (crate_id) SELECT id FROM crate; "
+             "INSERT INTO label (crate_id) SELECT id FROM crate;");
+    exec(db, "COMMIT;");
+
+    exec(db, "CREATE TABLE ping (id INTEGER PRIMARY KEY, pong_id INTEGER REFERENCES pong(id)); "
+             "CREATE TABLE pong (id INTEGER PRIMARY KEY, ping_id INTEGER REFERENCES ping(id)); "
+             "INSERT INTO ping (id) VALUES (1); "
+             "INSERT INTO pong (id, ping_id) VALUES (1, 1);");
+}
+
+int main(int argc, char **argv){
+    int suppliers = argc > 1 ? atoi(argv[1]) : 1000;
+    long items = argc > 2 ? atol(argv[2]) : 100000;
+    string path = argc > 3 ? argv[3] : "remove_bench.db";
+
+    std::remove(path.c_str());
+    Database database(path);
+    database.init();
+    sqlite3 *db = database.getDBConnection();
+    exec(db, "PRAGMA synchronous = OFF;");
+
+    auto start = chrono::steady_clock::now();
+    populate(db, suppliers, items);
+    printf("populate              %10.1f ms  (%d suppliers, %ld items)\n", elapsedMs(start), suppliers, items);
+
+    // A supplier with offers cannot go without cascade.
+    bool refused = !database.removeMany("suppliers", {1});
+    printf("dependents refused    %10s\n", refused ? "yes" : "no");
+
+    // Removes a tenth of the suppliers, in batches of ten.
+    vector<int> ids;
+    for (int id = 1; id <= suppliers; id += 10){
+        ids.push_back(id);
+    }
+    const long itemsBefore = count(db, "SELECT COUNT(*) FROM item;");
+    const long offersBefore = count(db, "SELECT COUNT(*) FROM supplier_prices;");
+    size_t removed = 0;
+    bool cascaded = true;
+    start = chrono::steady_clock::now();
+    for (size_t first = 0; first < ids.size(); first += 10){
+        vector<int> batch(ids.begin() + static_cast<long>(first), ids.begin() + static_cast<long>(min(first + 10, ids.size())));
+        size_t batchRemoved = 0;
+        cascaded = database.removeMany("suppliers", batch, true, &batchRemoved) && cascaded;
+        removed += batchRemoved;
+    }
+    const double cascadeMs = elapsedMs(start);
+    printf("cascade remove        %10.3f ms  per batch  (%zu suppliers, %ld items, %ld offers)\n",
+           cascadeMs / static_cast<double>((ids.size() + 9) / 10), removed,
+           itemsBefore - count(db, "SELECT COUNT(*) FROM item;"), offersBefore - count(db, "SELECT COUNT(*) FROM supplier_prices;"));
+    cascaded = cascaded && removed == ids.size() && count(db, "SELECT COUNT(*) FROM pragma_foreign_key_check;") == 0;
+    printf("suppliers removed     %10s\n", cascaded ? "yes" : "no");
+
+    populateDiamond(db);
+    const long cratesBefore = count(db, "SELECT COUNT(*) FROM crate;");
+    const long doomedCrates = count(db, "SELECT COUNT(*) FROM crate WHERE region_id = 1 OR depot_id IN (SELECT id FROM depot WHERE region_id = 1);");
+    bool diamond = database.removeMany("region", {1}, true, &removed) && removed == 1 &&
+                   cratesBefore - count(db, "SELECT COUNT(*) FROM crate;") == doomedCrates &&
+                   count(db, "SELECT COUNT(*) FROM label WHERE crate_id NOT IN (SELECT id FROM crate);") == 0 &&
+                   count(db, "SELECT COUNT(*) FROM pragma_foreign_key_check;") == 0;
+    printf("two parents removed   %10s  (%ld crates)\n", diamond ? "yes" : "no", doomedCrates);
+
+    bool cycleRefused = !database.removeMany("ping", {1}, true) && count(db, "SELECT COUNT(*) FROM ping;") == 1;
+    printf("cycle refused         %10s\n", cycleRefused ? "yes" : "no");
+
+    Logger::instance().flush();
+    return refused && cascaded && diamond && cycleRefused ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+#include "bench_util.hpp"
+#include "database.hpp"
+#include "replication.hpp"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// Replicates catalog writes from a primary to a follower through shipped
+// changesets, round by round, and checks that the follower ends up with the
+// same items, prices and per-category totals as the primary. Also checks the
+// reported lag, and that a follower missing a parent row holds back the
+// changeset that needs it until the row is restored.
+//
+// Usage: replication_bench.out [items] [rounds] [directory]
+
+// Every row of a query, columns joined with tabs.
+static vector<string> rowsOf(sqlite3 *db, const char *sql){
+    vector<string> rows;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error preparing \"%s\": %s", sql, sqlite3_errmsg(db));
+        return rows;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW){
+        string row;
+        for (int column = 0; column < sqlite3_column_count(stmt); ++column){
+            const unsigned char *text = sqlite3_column_text(stmt, column);
+            row += text ? reinterpret_cast<const char*>(text) : "NULL";
+            row += '\t';
+        }
+        rows.push_back(move(row));
+    }
+    sqlite3_finalize(stmt);
+    return rows;
+}
+
+// Inserts items, moves stock and reprices on the primary.
+static void writeRound(sqlite3 *db, mt19937 &random, long firstItem, long items){
+    exec(db, "BEGIN;");
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO item(name, description, category_id, quantity, unit_measurement, unit_price, supplier_id) "
+                           "VALUES (?, '', ?, ?, 'pcs', ?, 1);", -1, &stmt, nullptr);
+    uniform_int_distribution<int> categoryDist(1, 8);
+    uniform_int_distribution<int> quantityDist(0, 500);
+    uniform_int_distribution<int> centsDist(50, 100000);
+    for (long i = 0; i < items; ++i){
+        string name = "Item " + to_string(firstItem + i);
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, categoryDist(random));
+        sqlite3_bind_int(stmt, 3, quantityDist(random));
+        sqlite3_bind_int(stmt, 4, centsDist(random));
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    const long total = firstItem + items;
+    uniform_int_distribution<long> itemDist(1, total);
+    sqlite3_prepare_v2(db, "UPDATE item SET quantity = quantity + ? WHERE id = ?;", -1, &stmt, nullptr);
+    for (long i = 0; i < items / 2; ++i){
+        sqlite3_bind_int(stmt, 1, quantityDist(random) / 10);
+        sqlite3_bind_int64(stmt, 2, itemDist(random));
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    sqlite3_prepare_v2(db, "UPDATE item SET unit_price = ?, category_id = ? WHERE id = ?;", -1, &stmt, nullptr);
+    for (long i = 0; i < items / 10; ++i){
+        sqlite3_bind_int(stmt, 1, centsDist(random));
+        sqlite3_bind_int(stmt, 2, categoryDist(random));
+        sqlite3_bind_int64(stmt, 3, itemDist(random));
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    exec(db, "COMMIT;");
+}
+
+int main(int argc, char **argv){
+    long items = argc > 1 ? atol(argv[1]) : 50000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 10;
+    string directory = argc > 3 ? argv[3] : "replication_bench";
+
+    fs::remove_all(directory);
+    fs::create_directories(directory);
+    const string changesets = (fs::path(directory) / "changesets").string();
+
+    Database primary((fs::path(directory) / "primary.db").string());
+    primary.init();
+    Database follower((fs::path(directory) / "follower.db").string());
+    follower.init();
+    sqlite3 *db = primary.getDBConnection();
+    exec(db, "PRAGMA synchronous = OFF;");
+    exec(follower.getDBConnection(), "PRAGMA synchronous = OFF;");
+
+    ReplicationPrimary shipper(primary, changesets);
+    ReplicationFollower applier(follower, changesets);
+
+    exec(db, "INSERT INTO suppliers(name, address) VALUES ('Supplier', '');");
+    for (int category = 1; category <= 8; ++category){
+        exec(db, "INSERT INTO category(name, description) VALUES ('Category " + to_string(category) + "', '');");
+    }
+
+    mt19937 random(42);
+    size_t failures = 0;
+    double writeMs = 0.0;
+    double shipMs = 0.0;
+    double applyMs = 0.0;
+    const long perRound = max(1L, items / rounds);
+    for (int round = 0; round < rounds; ++round){
+        auto start = chrono::steady_clock::now();
+        writeRound(db, random, round * perRound, perRound);
+        writeMs += elapsedMs(start);
+
+        start = chrono::steady_clock::now();
+        if (!shipper.ship()){
+            ++failures;
+        }
+        shipMs += elapsedMs(start);
+
+        start = chrono::steady_clock::now();
+        applier.catchUp();
+        applyMs += elapsedMs(start);
+    }
+
+    printf("write                 %10.1f ms  (%ld items, %d rounds)\n", writeMs, perRound * rounds, rounds);
+    printf("ship                  %10.1f ms  (%llu changesets, %llu bytes raw, %llu compressed)\n", shipMs,
+           static_cast<unsigned long long>(shipper.lastShipped()), static_cast<unsigned long long>(shipper.shippedRawBytes()),
+           static_cast<unsigned long long>(shipper.shippedCompressedBytes()));
+    printf("apply                 %10.1f ms  (%llu applied)\n", applyMs, static_cast<unsigned long long>(applier.appliedSequence()));
+
+    // Lag: one changeset shipped and not yet applied, then none.
+    exec(db, "UPDATE item SET quantity = quantity + 1 WHERE id = 1;");
+    if (!shipper.ship()){
+        ++failures;
+    }
+    const ReplicationLag behind = applier.lag();
+    applier.catchUp();
+    const ReplicationLag current = applier.lag();
+    const bool lagReported = behind.changesetsBehind == 1 && behind.secondsBehind >= 0.0 &&
+                             current.changesetsBehind == 0 && current.secondsBehind == 0.0;
+
+    // A follower missing a parent row refuses the changeset that needs it
+    // instead of committing an orphan, and resumes once the row is back.
+    sqlite3 *followerDb = follower.getDBConnection();
+    exec(db, "INSERT INTO category(id, name, description) VALUES (100, 'Spare', '');");
+    shipper.ship();
+    applier.catchUp();
+    exec(followerDb, "DELETE FROM category WHERE id = 100;");
+    exec(db, "INSERT INTO item(name, description, category_id, quantity, unit_measurement, unit_price, supplier_id) "
+             "VALUES ('Spare part', '', 100, 4, 'pcs', 125, 1);");
+    shipper.ship();
+    const size_t appliedOrphan = applier.catchUp();
+    const uint64_t heldBack = applier.lag().changesetsBehind;
+    exec(followerDb, "INSERT INTO category(id, name, description) VALUES (100, 'Spare', '');");
+    const size_t appliedRepaired = applier.catchUp();
+    const bool orphanRefused = appliedOrphan == 0 && heldBack == 1 && appliedRepaired == 1;
+
+    const char *itemsQuery = "SELECT id, name, category_id, quantity, unit_price, price, deleted_at FROM item ORDER BY id;";
+    const char *totalsQuery = "SELECT category_id, valuation, quantity, items FROM category_totals WHERE items > 0 ORDER BY category_id;";
+    const char *stalePricesQuery = "SELECT id FROM item WHERE price IS NOT quantity * unit_price;";
+    vector<string> primaryItems = rowsOf(db, itemsQuery);
+    const bool itemsMatch = !primaryItems.empty() && primaryItems == rowsOf(follower.getDBConnection(), itemsQuery);
+    const bool totalsMatch = rowsOf(db, totalsQuery) == rowsOf(follower.getDBConnection(), totalsQuery);
+    const bool pricesCurrent = rowsOf(db, stalePricesQuery).empty() && rowsOf(follower.getDBConnection(), stalePricesQuery).empty();
+    const bool caughtUp = applier.appliedSequence() == shipper.lastShipped() && shipper.lastShipped() == static_cast<uint64_t>(rounds) + 3;
+
+    printf("failed ships          %10zu\n", failures);
+    printf("items match           %10s  (%zu rows)\n", itemsMatch ? "yes" : "no", primaryItems.size());
+    printf("totals match          %10s\n", totalsMatch ? "yes" : "no");
+    printf("prices current        %10s\n", pricesCurrent ? "yes" : "no");
+    printf("lag reported          %10s  (%.3f s behind before catching up)\n", lagReported ? "yes" : "no", behind.secondsBehind);
+    printf("orphan refused        %10s\n", orphanRefused ? "yes" : "no");
+    printf("caught up             %10s\n", caughtUp ? "yes" : "no");
+
+    Logger::instance().flush();
+    return failures == 0 && itemsMatch && totalsMatch && pricesCurrent && lagReported && orphanRefused && caughtUp ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+#include "bench_util.hpp"
+#include "database.hpp"
+#include "report.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+// Runs the inventory reports sequentially on one connection and in parallel
+// on the work-stealing pool, and checks that both produce the same totals.
+// A stage whose query fails must fail the run, along with its dependents.
+//
+// Usage: report_bench.out [items] [transactions] [threads] [database file]
+
+static void populate(sqlite3 *db, long items, long transactions){
+    const int categories = 200;
+    const int suppliers = 100;
+    const char *types[] = {"in", "out", "adjust"};
+
+    exec(db, "BEGIN;");
+    exec(db, "INSERT INTO user(username, password, role, contact_info) VALUES ('bench', '', 'admin', '');");
+    for (int i = 1; i <= categories; ++i){
+        string sql = "INSERT INTO category(name, description) VALUES ('Category " + to_string(i) + "', '');";
+        exec(db, sql);
+    }
+    for (int i = 1; i <= suppliers; ++i){
+        string sql = "INSERT INTO suppliers(name, address) VALUES ('Supplier " + to_string(i) + "', '');";
+        exec(db, sql);
+    }
+
+    mt19937 random(42);
+    uniform_int_distribution<int> categoryDist(1, categories);
+    uniform_int_distribution<int> supplierDist(1, suppliers);
+    uniform_int_distribution<int> quantityDist(0, 500);
+    uniform_int_distribution<int> centsDist(50, 100000);
+
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO item(name, description, category_id, quantity, unit_measurement, unit_price, supplier_id) "
+                           "VALUES (?, '', ?, ?, 'pcs', ?, ?);", -1, &stmt, nullptr);
+    for (long i = 0; i < items; ++i){
+        int quantity = quantityDist(random);
+        int64_t unitPrice = centsDist(random);
+        string name = "Item " + to_string(i);
+
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, categoryDist(random));
+        sqlite3_bind_int(stmt, 3, quantity);
+        sqlite3_bind_int64(stmt, 4, unitPrice);
+        sqlite3_bind_int(stmt, 5, supplierDist(random));
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    uniform_int_distribution<long> itemDist(1, items);
+    uniform_int_distribution<int> typeDist(0, 2);
+    uniform_int_distribution<int> dayDist(0, 729);
+    sqlite3_prepare_v2(db, "INSERT INTO transaction_records(item_id, transaction_type, quantity, transaction_date, user_id) "
+                           "VALUES (?, ?, ?, date('2024-01-01', '+' || ? || ' days'), 1);", -1, &stmt, nullptr);
+    for (long i = 0; i < transactions; ++i){
+        sqlite3_bind_int64(stmt, 1, itemDist(random));
+        sqlite3_bind_text(stmt, 2, types[typeDist(random)], -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 3, quantityDist(random));
+        sqlite3_bind_int(stmt, 4, dayDist(random));
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    exec(db, "COMMIT;");
+}
+
+static void printSummary(const char *label, double ms, const ReportResults &results){
+    const vector<double> &stock = results.at("inventory_summary").at("stock");
+    const vector<double> &purchases = results.at("inventory_summary").at("purchases");
+    printf("%-22s %10.1f ms  stock %s  purchases %s  months %zu\n", label, ms, Money::fromUnits(llround(stock[0])).toString().c_str(),
+           Money::fromUnits(llround(purchases[0])).toString().c_str(),
+           results.at("movement_history").size());
+}
+
+int main(int argc, char **argv){
+    long items = argc > 1 ? atol(argv[1]) : 1000000;
+    long transactions = argc > 2 ? atol(argv[2]) : 5000000;
+    size_t threads = argc > 3 ? static_cast<size_t>(atol(argv[3])) : thread::hardware_concurrency();
+    string path = argc > 4 ? argv[4] : "report_bench.db";
+
+    std::remove(path.c_str());
+    Database database(path);
+    database.init();
+    sqlite3 *db = database.getDBConnection();
+    exec(db, "PRAGMA synchronous = OFF;");
+
+    auto start = chrono::steady_clock::now();
+    populate(db, items, transactions);
+    exec(db, "PRAGMA wal_checkpoint(TRUNCATE);");
+    printf("populate               %10.1f ms  (%ld items, %ld transactions)\n", elapsedMs(start), items, transactions);
+
+    ReportDag sequential = inventoryReports(1);
+    ReportResults results;
+    start = chrono::steady_clock::now();
+    if (!sequential.runSequential(db, results)){
+        return 1;
+    }
+    printSummary("sequential", elapsedMs(start), results);
+
+    TaskPool pool(path, threads);
+    ReportDag parallel = inventoryReports(0);
+    map<string, double> timings;
+
+    // The first run warms the page cache of every read connection.
+    parallel.run(pool, results);
+    start = chrono::steady_clock::now();
+    if (!parallel.run(pool, results, &timings)){
+        return 1;
+    }
+    char label[32];
+    snprintf(label, sizeof(label), "parallel x%zu", pool.size());
+    printSummary(label, elapsedMs(start), results);
+
+    for (const auto &[stage, ms] : timings){
+        printf("  %-20s %10.1f ms\n", stage.c_str(), ms);
+    }
+    printf("stolen tasks           %10llu\n", static_cast<unsigned long long>(pool.stolenTasks()));
+
+    // A query on a missing table, and a stage that reads its result.
+    ReportDag failing = inventoryReports(0);
+    failing.addStage({"missing", {}, 0, [](sqlite3 *connection, int, int, const ReportResults&, ReportTable&){
+        return sqlite3_exec(connection, "SELECT * FROM missing_table;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    }, {}});
+    failing.addStage({"after_missing", {"missing"}, 1, [](sqlite3*, int, int, const ReportResults &inputs, ReportTable&){
+        return inputs.count("missing") > 0;
+    }, {}});
+    const bool parallelFailed = !failing.run(pool, results) && !results.count("missing") && !results.count("after_missing") &&
+                                results.count("inventory_summary");
+    const bool sequentialFailed = !failing.runSequential(db, results) && !results.count("missing") && !results.count("after_missing") &&
+                                  results.count("inventory_summary");
+    printf("failures reported      %10s\n", parallelFailed && sequentialFailed ? "yes" : "no");
+
+    Logger::instance().flush();
+    return parallelFailed && sequentialFailed ? 0 : 1;
+}
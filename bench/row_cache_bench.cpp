@@ -0,0 +1,179 @@
+#include "bench_util.hpp"
+#include "database.hpp"
+#include "row_cache.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Scrolls through the item list a page at a time and resolves the category
+// and supplier of every visible row, the way the terminal UI draws them:
+// through a RowCache, and with a SQL query per page. Prints the cache hit
+// rate, then checks that a small memory budget is enforced and that renames
+// made on this and on another connection are seen.
+//
+// Usage: row_cache_bench.out [items] [page rows] [database file]
+
+static const int categories = 500;
+static const int suppliers = 200;
+
+static void populate(sqlite3 *db, long items){
+    exec(db, "BEGIN;");
+    for (int category = 1; category <= categories; ++category){
+        exec(db, "INSERT INTO category(name, description) VALUES ('Category " + to_string(category) + "', '');");
+    }
+    for (int supplier = 1; supplier <= suppliers; ++supplier){
+        exec(db, "INSERT INTO suppliers(name, address) VALUES ('Supplier " + to_string(supplier) + "', '');");
+    }
+
+    mt19937 random(11);
+    uniform_int_distribution<int> categoryDist(1, categories);
+    uniform_int_distribution<int> supplierDist(1, suppliers);
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO item(name, description, category_id, quantity, unit_measurement, unit_price, supplier_id) "
+                           "VALUES (?, '', ?, 1, 'pcs', 100, ?);", -1, &stmt, nullptr);
+    for (long i = 0; i < items; ++i){
+        string name = "Item " + to_string(i);
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, categoryDist(random));
+        sqlite3_bind_int(stmt, 3, supplierDist(random));
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    exec(db, "COMMIT;");
+}
+
+// Name of a cached row, or "" for a missing one.
+static string nameOf(const shared_ptr<const Row> &row){
+    if (!row){
+        return "";
+    }
+    auto name = row->find("name");
+    return name != row->end() && holds_alternative<string>(name->second) ? get<string>(name->second) : "";
+}
+
+int main(int argc, char **argv){
+    long items = argc > 1 ? atol(argv[1]) : 200000;
+    int pageRows = argc > 2 ? atoi(argv[2]) : 50;
+    string path = argc > 3 ? argv[3] : "row_cache_bench.db";
+
+    std::remove(path.c_str());
+    std::remove((path + "-wal").c_str());
+    std::remove((path + "-shm").c_str());
+    Database database(path);
+    database.init();
+    sqlite3 *db = database.getDBConnection();
+    exec(db, "PRAGMA synchronous = OFF;");
+
+    auto start = chrono::steady_clock::now();
+    populate(db, items);
+    printf("populate          %10.1f ms  (%ld items, %d categories, %d suppliers)\n", elapsedMs(start), items, categories, suppliers);
+
+    // Every page of the listing, as the ids of its category and supplier columns.
+    vector<vector<sqlite3_int64>> pageCategories;
+    vector<vector<sqlite3_int64>> pageSuppliers;
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "SELECT category_id, supplier_id FROM item ORDER BY id;", -1, &stmt, nullptr);
+    while (sqlite3_step(stmt) == SQLITE_ROW){
+        if (pageCategories.empty() || pageCategories.back().size() == static_cast<size_t>(pageRows)){
+            pageCategories.emplace_back();
+            pageSuppliers.emplace_back();
+        }
+        pageCategories.back().push_back(sqlite3_column_int64(stmt, 0));
+        pageSuppliers.back().push_back(sqlite3_column_int64(stmt, 1));
+    }
+    sqlite3_finalize(stmt);
+
+    RowCache cache(database);
+    start = chrono::steady_clock::now();
+    size_t resolved = 0;
+    for (size_t page = 0; page < pageCategories.size(); ++page){
+        cache.sync();
+        for (const auto &row : cache.getMany("category", pageCategories[page])){
+            resolved += row ? 1 : 0;
+        }
+        for (const auto &row : cache.getMany("suppliers", pageSuppliers[page])){
+            resolved += row ? 1 : 0;
+        }
+    }
+    double ms = elapsedMs(start);
+    RowCacheMetrics metrics = cache.metrics();
+    printf("row cache         %10.1f ms  %8.1f us/page  (hit rate %.4f, %zu entries, %zu bytes)\n", ms, ms * 1e3 / static_cast<double>(pageCategories.size()),
+           metrics.hitRate(), metrics.entries, metrics.bytes);
+
+    // The same names with a query per column and page.
+    sqlite3_prepare_v2(db, "SELECT id, name FROM category WHERE id IN (SELECT value FROM json_each(?));", -1, &stmt, nullptr);
+    sqlite3_stmt *supplierStmt;
+    sqlite3_prepare_v2(db, "SELECT id, name FROM suppliers WHERE id IN (SELECT value FROM json_each(?));", -1, &supplierStmt, nullptr);
+    start = chrono::steady_clock::now();
+    size_t queried = 0;
+    for (size_t page = 0; page < pageCategories.size(); ++page){
+        for (auto [query, ids] : {make_pair(stmt, &pageCategories[page]), make_pair(supplierStmt, &pageSuppliers[page])}){
+            string list = "[";
+            for (sqlite3_int64 id : *ids){
+                list += (list.size() > 1 ? "," : "") + to_string(id);
+            }
+            list += "]";
+            sqlite3_bind_text(query, 1, list.c_str(), -1, SQLITE_TRANSIENT);
+            while (sqlite3_step(query) == SQLITE_ROW){
+                ++queried;
+            }
+            sqlite3_reset(query);
+        }
+    }
+    ms = elapsedMs(start);
+    sqlite3_finalize(stmt);
+    sqlite3_finalize(supplierStmt);
+    printf("sql per page      %10.1f ms  %8.1f us/page  (%zu distinct rows read)\n", ms, ms * 1e3 / static_cast<double>(pageCategories.size()), queried);
+
+    // A budget far below the item table: the cache must stay within it.
+    RowCacheOptions small;
+    small.memoryBudget = 256 * 1024;
+    small.shards = 4;
+    RowCache bounded(database, small);
+    size_t maxBytes = 0;
+    long wrongRows = 0;
+    vector<sqlite3_int64> ids;
+    for (long id = 1; id <= items; ++id){
+        ids.push_back(id);
+        if (ids.size() < 500 && id < items){
+            continue;
+        }
+        vector<shared_ptr<const Row>> rows = bounded.getMany("item", ids);
+        for (size_t position = 0; position < ids.size(); ++position){
+            if (!rows[position] || get<sqlite3_int64>(rows[position]->at("id")) != ids[position]){
+                ++wrongRows;
+            }
+        }
+        maxBytes = max(maxBytes, bounded.metrics().bytes);
+        ids.clear();
+    }
+    RowCacheMetrics boundedMetrics = bounded.metrics();
+    const bool withinBudget = maxBytes <= small.memoryBudget && boundedMetrics.evictions > 0 && wrongRows == 0;
+    printf("bounded           %10zu bytes at most  (budget %zu, %llu evictions, %zu entries, %ld wrong rows)\n", maxBytes, small.memoryBudget,
+           static_cast<unsigned long long>(boundedMetrics.evictions), boundedMetrics.entries, wrongRows);
+
+    // Renames on this connection invalidate the key; those on another clear the cache at sync().
+    exec(db, "UPDATE category SET name = 'Renamed here' WHERE id = 1;");
+    const bool localRename = nameOf(cache.get("category", 1)) == "Renamed here";
+    {
+        Database other(path);
+        exec(other.getDBConnection(), "UPDATE suppliers SET name = 'Renamed elsewhere' WHERE id = 1;");
+    }
+    cache.sync();
+    const bool foreignRename = nameOf(cache.get("suppliers", 1)) == "Renamed elsewhere";
+
+    const bool resolvedAll = resolved == 2 * static_cast<size_t>(items);
+    const bool hitRateHigh = metrics.hitRate() > 0.99;
+    printf("names resolved    %10s\n", resolvedAll ? "yes" : "no");
+    printf("hit rate > 0.99   %10s\n", hitRateHigh ? "yes" : "no");
+    printf("within budget     %10s\n", withinBudget ? "yes" : "no");
+    printf("renames seen      %10s\n", localRename && foreignRename ? "yes" : "no");
+
+    Logger::instance().flush();
+    return resolvedAll && hitRateHigh && withinBudget && localRename && foreignRename ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+#include "bench_util.hpp"
+#include "database.hpp"
+#include "search.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+
+// Types search terms one character at a time against the SearchEngine and
+// reports the delay between each keystroke and its first hits, then replays
+// the same terms with no pause between keys to exercise cancellation.
+//
+// Usage: search_bench.out [items] [terms] [ms between keys] [database file]
+
+static const vector<string> adjectives = {"Steel", "Stainless", "Copper", "Plastic", "Rubber", "Heavy", "Light", "Small", "Large", "Red",
+                                          "Blue", "Green", "Premium", "Basic", "Industrial", "Compact", "Flexible", "Round", "Square", "Long"};
+static const vector<string> nouns = {"Bolt", "Screw", "Washer", "Hinge", "Bracket", "Pipe", "Valve", "Cable", "Hose", "Clamp",
+                                     "Nut", "Spring", "Gasket", "Bearing", "Fitting", "Hook", "Chain", "Rivet", "Anchor", "Tape"};
+
+static void populate(sqlite3 *db, long items){
+    exec(db, "BEGIN;");
+    exec(db, "INSERT INTO category(name, description) VALUES ('Category', '');");
+    exec(db, "INSERT INTO suppliers(name, address) VALUES ('Supplier', '');");
+
+    mt19937 random(3);
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO item(name, description, category_id, quantity, unit_measurement, unit_price, supplier_id, sku) "
+                           "VALUES (?, '', 1, 1, 'pcs', 100, 1, ?);", -1, &stmt, nullptr);
+    for (long i = 0; i < items; ++i){
+        string name = adjectives[random() % adjectives.size()] + " " + nouns[random() % nouns.size()] + " " + to_string(random() % 100000) + "-" +
+                      to_string(i);
+        char sku[24];
+        snprintf(sku, sizeof(sku), "%013ld", 8990000000000L + i * 13);
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, sku, -1, SQLITE_TRANSIENT);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    exec(db, "COMMIT;");
+}
+
+int main(int argc, char **argv){
+    long items = argc > 1 ? atol(argv[1]) : 1000000;
+    long termCount = argc > 2 ? atol(argv[2]) : 60;
+    long keyInterval = argc > 3 ? atol(argv[3]) : 25;
+    string path = argc > 4 ? argv[4] : "search_bench.db";
+
+    std::remove(path.c_str());
+    {
+        Database database(path);
+        database.init();
+        exec(database.getDBConnection(), "PRAGMA synchronous = OFF;");
+        auto start = chrono::steady_clock::now();
+        populate(database.getDBConnection(), items);
+        printf("populate       %10.1f ms  (%ld items)\n", elapsedMs(start), items);
+    }
+
+    // Mixed-case name terms and SKU prefixes, as a user would type them.
+    mt19937 random(5);
+    vector<string> terms;
+    for (long i = 0; i < termCount; ++i){
+        if (i % 4 == 3){
+            terms.push_back(to_string(8990000000000L + static_cast<long>(random() % static_cast<unsigned long>(items)) * 13).substr(0, 9));
+        }else{
+            string term = adjectives[random() % adjectives.size()] + " " + nouns[random() % nouns.size()] + " " + to_string(random() % 100);
+            if (i % 2 == 0){
+                transform(term.begin(), term.end(), term.begin(), [](char c){ return static_cast<char>(tolower(c)); });
+            }
+            terms.push_back(term);
+        }
+    }
+
+    mutex timesMutex;
+    unordered_map<uint64_t, chrono::steady_clock::time_point> submitted;
+    unordered_map<uint64_t, double> firstHits;
+    unordered_map<uint64_t, double> completed;
+    SearchEngine engine(path, SearchOptions(), [&](const SearchResults &results){
+        lock_guard<mutex> lock(timesMutex);
+        auto sent = submitted.find(results.generation);
+        if (sent == submitted.end()){
+            return;
+        }
+        double ms = elapsedMs(sent->second);
+        firstHits.emplace(results.generation, ms);
+        if (results.complete){
+            completed.emplace(results.generation, ms);
+        }
+    });
+
+    for (long interval : {keyInterval, 0L}){
+        {
+            lock_guard<mutex> lock(timesMutex);
+            submitted.clear();
+            firstHits.clear();
+            completed.clear();
+        }
+        const uint64_t cancelledBefore = engine.cancelledQueries();
+        const uint64_t reusedBefore = engine.reusedQueries();
+        long keystrokes = 0;
+
+        for (const string &term : terms){
+            for (size_t length = 1; length <= term.size(); ++length){
+                {
+                    lock_guard<mutex> lock(timesMutex);
+                    auto now = chrono::steady_clock::now();
+                    submitted[engine.submit(term.substr(0, length))] = now;
+                }
+                ++keystrokes;
+                this_thread::sleep_for(chrono::milliseconds(interval));
+            }
+            // The field is cleared between two terms.
+            this_thread::sleep_for(chrono::milliseconds(50));
+            lock_guard<mutex> lock(timesMutex);
+            submitted[engine.submit("")] = chrono::steady_clock::now();
+        }
+        this_thread::sleep_for(chrono::milliseconds(200));
+
+        vector<double> first;
+        vector<double> complete;
+        {
+            lock_guard<mutex> lock(timesMutex);
+            for (const auto &[generation, ms] : firstHits){
+                first.push_back(ms);
+            }
+            for (const auto &[generation, ms] : completed){
+                complete.push_back(ms);
+            }
+        }
+        printf("%ld ms between keys: %ld keystrokes, %zu answered, %llu cancelled, %llu reused previous hits\n", interval, keystrokes,
+               complete.size(), static_cast<unsigned long long>(engine.cancelledQueries() - cancelledBefore),
+               static_cast<unsigned long long>(engine.reusedQueries() - reusedBefore));
+        printf("  first hits   p50 %6.2f ms  p99 %6.2f ms  max %6.2f ms\n", percentile(first, 0.5), percentile(first, 0.99),
+               percentile(first, 1.0));
+        printf("  all hits     p50 %6.2f ms  p99 %6.2f ms  max %6.2f ms\n", percentile(complete, 0.5), percentile(complete, 0.99),
+               percentile(complete, 1.0));
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "bench_util.hpp"
+#include "database.hpp"
+#include "protocol.hpp"
+#include "server.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Load generator for the socket server: every client keeps a fixed number of
+// requests in flight (Get of a random item, or a one-unit move-stock for the
+// write share) and the run reports requests per second, latency percentiles
+// and how many writes shared each commit. It runs once with one commit per
+// request and once with the default group size.
+//
+// Usage: server_bench.out [clients] [pipeline depth] [seconds] [write percent] [items] [database file]
+
+static void populate(sqlite3 *db, int items){
+    exec(db, "BEGIN;");
+    exec(db, "INSERT INTO category(name, description) VALUES ('Category', '');");
+    exec(db, "INSERT INTO suppliers(name, address) VALUES ('Supplier', '');");
+    exec(db, "INSERT INTO user(username, password, role, contact_info) VALUES ('bench', '', 'clerk', '');");
+
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO item(name, description, category_id, quantity, unit_measurement, unit_price, supplier_id) "
+                           "VALUES (?, '', 1, 1000000, 'pcs', 100, 1);", -1, &stmt, nullptr);
+    for (int i = 0; i < items; ++i){
+        string name = "Item " + to_string(i);
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    exec(db, "COMMIT;");
+}
+
+int main(int argc, char **argv){
+    int clients = argc > 1 ? atoi(argv[1]) : 8;
+    int depth = argc > 2 ? atoi(argv[2]) : 16;
+    double seconds = argc > 3 ? atof(argv[3]) : 3.0;
+    int writePercent = argc > 4 ? atoi(argv[4]) : 20;
+    int items = argc > 5 ? atoi(argv[5]) : 10000;
+    string path = argc > 6 ? argv[6] : "server_bench.db";
+    const string socketPath = path + ".sock";
+
+    for (size_t maxGroup : {static_cast<size_t>(1), ServerOptions().maxGroup}){
+        std::remove(path.c_str());
+        Database database(path);
+        database.init();
+        populate(database.getDBConnection(), items);
+
+        ServerOptions options;
+        options.maxGroup = maxGroup;
+        Server server(database, socketPath, options);
+        if (!server.listen()){
+            return 1;
+        }
+        thread serving(&Server::run, &server);
+
+        atomic<bool> failed{false};
+        vector<vector<double>> latencies(static_cast<size_t>(clients));
+        vector<thread> workers;
+        const auto deadline = chrono::steady_clock::now() + chrono::duration<double>(seconds);
+        for (int client = 0; client < clients; ++client){
+            workers.emplace_back([&, client]{
+                ServerClient connection;
+                if (!connection.connect(socketPath)){
+                    failed = true;
+                    return;
+                }
+
+                mt19937 random(static_cast<unsigned>(client) + 1);
+                unordered_map<uint32_t, chrono::steady_clock::time_point> sent;
+                uint32_t nextId = 0;
+                auto queueOne = [&]{
+                    protocol::Request request;
+                    request.id = ++nextId;
+                    request.command.ids.push_back(static_cast<int>(random() % static_cast<unsigned>(items)) + 1);
+                    if (static_cast<int>(random() % 100) < writePercent){
+                        request.op = protocol::Opcode::MoveStock;
+                        request.command.quantity = random() % 2 ? 1 : -1;
+                    }else{
+                        request.op = protocol::Opcode::Get;
+                        request.command.table = "item";
+                    }
+                    sent[request.id] = chrono::steady_clock::now();
+                    connection.queue(request);
+                };
+
+                for (int i = 0; i < depth; ++i){
+                    queueOne();
+                }
+                connection.flush();
+
+                vector<double> &measured = latencies[static_cast<size_t>(client)];
+                protocol::Response response;
+                while (!sent.empty()){
+                    if (!connection.receive(response) || response.status != protocol::Status::Ok){
+                        failed = true;
+                        return;
+                    }
+                    auto found = sent.find(response.id);
+                    measured.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - found->second).count());
+                    sent.erase(found);
+                    if (chrono::steady_clock::now() < deadline){
+                        queueOne();
+                        connection.flush();
+                    }
+                }
+            });
+        }
+
+        auto start = chrono::steady_clock::now();
+        for (thread &worker : workers){
+            worker.join();
+        }
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        server.stop();
+        serving.join();
+
+        vector<double> all;
+        for (const vector<double> &measured : latencies){
+            all.insert(all.end(), measured.begin(), measured.end());
+        }
+
+        const ServerStats &stats = server.stats();
+        const uint64_t commits = stats.commits.load();
+        printf("group %4zu: %d clients x %d in flight, %d%% writes: %10.0f requests/s  p50 %7.1f us  p99 %7.1f us  %6.1f writes/commit%s\n",
+               maxGroup, clients, depth, writePercent, static_cast<double>(all.size()) / elapsed, percentile(all, 0.5), percentile(all, 0.99),
+               commits ? static_cast<double>(stats.writes.load()) / static_cast<double>(commits) : 0.0, failed ? "  (errors)" : "");
+    }
+    return 0;
+}
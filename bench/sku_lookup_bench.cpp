@@ -0,0 +1,176 @@
+#include "bench_util.hpp"
+#include "database.hpp"
+#include "sku_index.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+using namespace std;
+
+// Resolves scanned SKUs through the perfect-hash SkuIndex and through the
+// unique SQL index on item(sku), then checks that stock movements stay out of
+// the delta and times rebuild() against a full reload.
+//
+// Usage: sku_lookup_bench.out [items] [lookups] [database file]
+
+// 13-digit EAN-style code for an item number.
+static string skuFor(long number){
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "%013ld", 4006381000000L + number * 7);
+    return buffer;
+}
+
+static void populate(sqlite3 *db, long items){
+    exec(db, "BEGIN;");
+    exec(db, "INSERT INTO category(name, description) VALUES ('Category', '');");
+    exec(db, "INSERT INTO suppliers(name, address) VALUES ('Supplier', '');");
+
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO item(name, description, category_id, quantity, unit_measurement, unit_price, supplier_id, sku) "
+                           "VALUES (?, '', 1, 1, 'pcs', 100, 1, ?);", -1, &stmt, nullptr);
+    for (long i = 0; i < items; ++i){
+        string name = "Item " + to_string(i);
+        string sku = skuFor(i);
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, sku.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    exec(db, "COMMIT;");
+}
+
+int main(int argc, char **argv){
+    long items = argc > 1 ? atol(argv[1]) : 1000000;
+    long lookups = argc > 2 ? atol(argv[2]) : 1000000;
+    string path = argc > 3 ? argv[3] : "sku_lookup_bench.db";
+
+    std::remove(path.c_str());
+    Database database(path);
+    database.init();
+    sqlite3 *db = database.getDBConnection();
+    exec(db, "PRAGMA synchronous = OFF;");
+
+    auto start = chrono::steady_clock::now();
+    populate(db, items);
+    printf("populate          %10.1f ms  (%ld items)\n", elapsedMs(start), items);
+
+    SkuIndex index(database);
+    start = chrono::steady_clock::now();
+    index.load();
+    printf("perfect hash load %10.1f ms  (%zu keys)\n", elapsedMs(start), index.hashedKeys());
+
+    // Nine scans in ten are known codes, the rest are unknown.
+    mt19937 random(7);
+    uniform_int_distribution<long> itemDist(0, items * 10 / 9);
+    vector<string> scans;
+    scans.reserve(static_cast<size_t>(lookups));
+    for (long i = 0; i < lookups; ++i){
+        scans.push_back(skuFor(itemDist(random)));
+    }
+
+    start = chrono::steady_clock::now();
+    long found = 0;
+    sqlite3_int64 checksum = 0;
+    for (const string &scan : scans){
+        sqlite3_int64 id;
+        if (index.find(scan, id)){
+            ++found;
+            checksum += id;
+        }
+    }
+    double ms = elapsedMs(start);
+    printf("perfect hash find %10.1f ms  %8.1f ns/lookup  (%ld found, checksum %lld)\n", ms, ms * 1e6 / lookups, found,
+           static_cast<long long>(checksum));
+
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "SELECT id FROM item WHERE sku = ?;", -1, &stmt, nullptr);
+    start = chrono::steady_clock::now();
+    found = 0;
+    checksum = 0;
+    for (const string &scan : scans){
+        sqlite3_bind_text(stmt, 1, scan.c_str(), static_cast<int>(scan.size()), SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW){
+            ++found;
+            checksum += sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_reset(stmt);
+    }
+    ms = elapsedMs(start);
+    sqlite3_finalize(stmt);
+    printf("sql index find    %10.1f ms  %8.1f ns/lookup  (%ld found, checksum %lld)\n", ms, ms * 1e6 / lookups, found,
+           static_cast<long long>(checksum));
+
+    // New items land in the delta until the next rebuild.
+    start = chrono::steady_clock::now();
+    exec(db, "BEGIN;");
+    for (long i = items; i < items + 1000; ++i){
+        string sql = "INSERT INTO item(name, description, category_id, quantity, unit_measurement, unit_price, supplier_id, sku) "
+                     "VALUES ('Item " + to_string(i) + "', '', 1, 1, 'pcs', 100, 1, '" + skuFor(i) + "');";
+        exec(db, sql);
+    }
+    exec(db, "COMMIT;");
+    index.refresh();
+    sqlite3_int64 id = 0;
+    bool newFound = index.find(skuFor(items + 10), id);
+    printf("delta refresh     %10.1f ms  (%zu delta keys, new item found: %s)\n", elapsedMs(start), index.deltaKeys(),
+           newFound ? "yes" : "no");
+
+    // Stock movements rewrite item rows but leave their SKU alone.
+    const size_t deltaBefore = index.deltaKeys();
+    exec(db, "UPDATE item SET quantity = quantity + 1 WHERE id % 100 = 0;");
+    start = chrono::steady_clock::now();
+    const size_t reread = index.refresh();
+    const bool stockIgnored = reread > 0 && index.deltaKeys() == deltaBefore;
+    printf("stock refresh     %10.1f ms  (%zu items re-read, %zu delta keys)\n", elapsedMs(start), reread, index.deltaKeys());
+
+    // Relabel enough items that a rebuild falls due, then run it off the scan path.
+    // Batches are refreshed as they commit, so their events fit the index's
+    // change ring; a larger transaction overflows it and forces a full reload.
+    const long relabelled = items / 8 + 2048;
+    const long relabelBatch = 16384;
+    double refreshMs = 0.0;
+    sqlite3_prepare_v2(db, "UPDATE item SET sku = ? WHERE id = ?;", -1, &stmt, nullptr);
+    for (long first = 0; first < relabelled && first < items; first += relabelBatch){
+        exec(db, "BEGIN;");
+        for (long i = first; i < first + relabelBatch && i < relabelled && i < items; ++i){
+            string sku = "R" + skuFor(i);
+            sqlite3_bind_text(stmt, 1, sku.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 2, i + 1);
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+        exec(db, "COMMIT;");
+        start = chrono::steady_clock::now();
+        index.refresh();
+        refreshMs += elapsedMs(start);
+    }
+    sqlite3_finalize(stmt);
+    const bool due = index.rebuildDue();
+    printf("relabel refresh   %10.1f ms  (%zu delta keys, rebuild due: %s)\n", refreshMs, index.deltaKeys(), due ? "yes" : "no");
+
+    start = chrono::steady_clock::now();
+    const bool rebuilt = index.rebuild();
+    printf("rebuild           %10.1f ms  (%zu keys, %zu delta keys)\n", elapsedMs(start), index.hashedKeys(), index.deltaKeys());
+
+    long mismatches = 0;
+    for (long i = 0; i < items + 1000; ++i){
+        const bool relabel = i < relabelled && i < items;
+        id = 0;
+        if (!index.find(relabel ? "R" + skuFor(i) : skuFor(i), id) || id != i + 1){
+            ++mismatches;
+        }
+        if (relabel && index.find(skuFor(i), id)){
+            ++mismatches;
+        }
+    }
+    printf("after rebuild     %10ld mismatches\n", mismatches);
+
+    start = chrono::steady_clock::now();
+    index.load();
+    printf("full reload       %10.1f ms  (%zu keys)\n", elapsedMs(start), index.hashedKeys());
+
+    Logger::instance().flush();
+    return newFound && stockIgnored && due && rebuilt && index.deltaKeys() == 0 && mismatches == 0 ? 0 : 1;
+}
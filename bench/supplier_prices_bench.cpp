@@ -0,0 +1,239 @@
+#include "bench_util.hpp"
+#include "database.hpp"
+#include "supplier_prices.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Fills price lists for every item from a pool of suppliers, then sources
+// purchase orders of growing size through the in-memory SupplierPriceIndex,
+// through one SQL query per order line and through a single batched SQL query
+// (json_each plus a window function), checking that all three pick the same
+// offers. Finally reprices some offers, soft-deletes a supplier and checks the
+// index again after refresh().
+//
+// Usage: supplier_prices_bench.out [items] [suppliers] [offers per item] [database file]
+
+static void populate(sqlite3 *db, long items, int suppliers, int offersPerItem){
+    exec(db, "BEGIN;");
+    exec(db, "INSERT INTO category(name, description) VALUES ('Category', '');");
+
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO suppliers(name, address) VALUES (?, '');", -1, &stmt, nullptr);
+    for (int i = 0; i < suppliers; ++i){
+        string name = "Supplier " + to_string(i + 1);
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    mt19937 random(42);
+    uniform_int_distribution<int> listPriceDist(100, 50000);
+    uniform_int_distribution<int> markupDist(80, 130);
+    uniform_int_distribution<int> leadTimeDist(1, 30);
+    const int minimumOrders[] = {1, 1, 1, 5, 10, 25, 50, 100};
+    uniform_int_distribution<size_t> minimumOrderDist(0, sizeof(minimumOrders) / sizeof(minimumOrders[0]) - 1);
+
+    sqlite3_stmt *item;
+    sqlite3_prepare_v2(db, "INSERT INTO item(name, description, category_id, quantity, unit_measurement, unit_price, supplier_id) "
+                           "VALUES (?, '', 1, 0, 'pcs', ?, 1);", -1, &item, nullptr);
+    sqlite3_prepare_v2(db, "INSERT INTO supplier_prices(supplier_id, item_id, unit_price, lead_time_days, minimum_order) "
+                           "VALUES (?, ?, ?, ?, ?);", -1, &stmt, nullptr);
+    vector<int> pool(static_cast<size_t>(suppliers));
+    for (int i = 0; i < suppliers; ++i){
+        pool[static_cast<size_t>(i)] = i + 1;
+    }
+    const int perItem = min(offersPerItem, suppliers);
+    for (long i = 0; i < items; ++i){
+        const int listPrice = listPriceDist(random);
+        string name = "Item " + to_string(i);
+        sqlite3_bind_text(item, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(item, 2, listPrice);
+        sqlite3_step(item);
+        sqlite3_reset(item);
+        const sqlite3_int64 itemId = sqlite3_last_insert_rowid(db);
+
+        // A partial shuffle picks distinct suppliers for the item.
+        for (int k = 0; k < perItem; ++k){
+            uniform_int_distribution<int> swapDist(k, suppliers - 1);
+            swap(pool[static_cast<size_t>(k)], pool[static_cast<size_t>(swapDist(random))]);
+            sqlite3_bind_int(stmt, 1, pool[static_cast<size_t>(k)]);
+            sqlite3_bind_int64(stmt, 2, itemId);
+            sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(listPrice) * markupDist(random) / 100);
+            sqlite3_bind_int(stmt, 4, leadTimeDist(random));
+            sqlite3_bind_int(stmt, 5, minimumOrders[minimumOrderDist(random)]);
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+    }
+    sqlite3_finalize(item);
+    sqlite3_finalize(stmt);
+    exec(db, "COMMIT;");
+}
+
+static vector<PurchaseNeed> purchaseOrder(mt19937 &random, long items, size_t lines){
+    uniform_int_distribution<int> itemDist(1, static_cast<int>(items));
+    uniform_int_distribution<int> quantityDist(1, 60);
+    vector<PurchaseNeed> needs(lines);
+    for (PurchaseNeed &need : needs){
+        need.itemId = itemDist(random);
+        need.quantity = quantityDist(random);
+    }
+    return needs;
+}
+
+static const char *lineQuery = "SELECT p.supplier_id, p.unit_price, p.lead_time_days, p.minimum_order "
+                               "FROM supplier_prices AS p JOIN suppliers AS s ON s.id = p.supplier_id AND s.deleted_at IS NULL "
+                               "WHERE p.item_id = ?1 AND p.minimum_order <= ?2 AND p.lead_time_days <= ?3 "
+                               "ORDER BY p.unit_price, p.lead_time_days, p.supplier_id LIMIT 1;";
+
+static void sqlPerLine(sqlite3_stmt *stmt, const vector<PurchaseNeed> &needs, int maxLeadTime, vector<SupplierOffer> &chosen){
+    chosen.assign(needs.size(), SupplierOffer());
+    for (size_t line = 0; line < needs.size(); ++line){
+        sqlite3_bind_int(stmt, 1, needs[line].itemId);
+        sqlite3_bind_int(stmt, 2, needs[line].quantity);
+        sqlite3_bind_int(stmt, 3, maxLeadTime);
+        if (sqlite3_step(stmt) == SQLITE_ROW){
+            chosen[line].supplierId = sqlite3_column_int(stmt, 0);
+            chosen[line].unitPrice = Money::fromUnits(sqlite3_column_int64(stmt, 1));
+            chosen[line].leadTimeDays = sqlite3_column_int(stmt, 2);
+            chosen[line].minimumOrder = sqlite3_column_int(stmt, 3);
+        }
+        sqlite3_reset(stmt);
+    }
+}
+
+// The whole order in one statement: the lines arrive as a JSON array of
+// [item, quantity] pairs and the cheapest offer per line is ranked first.
+static const char *batchQuery = "WITH need(line, item_id, quantity) AS (SELECT key, value ->> 0, value ->> 1 FROM json_each(?1)) "
+                                "SELECT line, supplier_id, unit_price, lead_time_days, minimum_order FROM ("
+                                "SELECT n.line, p.supplier_id, p.unit_price, p.lead_time_days, p.minimum_order, "
+                                "ROW_NUMBER() OVER (PARTITION BY n.line ORDER BY p.unit_price, p.lead_time_days, p.supplier_id) AS rank "
+                                "FROM need AS n JOIN supplier_prices AS p ON p.item_id = n.item_id "
+                                "JOIN suppliers AS s ON s.id = p.supplier_id AND s.deleted_at IS NULL "
+                                "WHERE p.minimum_order <= n.quantity AND p.lead_time_days <= ?2) "
+                                "WHERE rank = 1;";
+
+static void sqlBatch(sqlite3_stmt *stmt, const vector<PurchaseNeed> &needs, int maxLeadTime, vector<SupplierOffer> &chosen){
+    string lines = "[";
+    for (const PurchaseNeed &need : needs){
+        lines += (lines.size() > 1 ? ",[" : "[") + to_string(need.itemId) + "," + to_string(need.quantity) + "]";
+    }
+    lines += "]";
+
+    chosen.assign(needs.size(), SupplierOffer());
+    sqlite3_bind_text(stmt, 1, lines.c_str(), static_cast<int>(lines.size()), SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, maxLeadTime);
+    while (sqlite3_step(stmt) == SQLITE_ROW){
+        SupplierOffer &offer = chosen[static_cast<size_t>(sqlite3_column_int64(stmt, 0))];
+        offer.supplierId = sqlite3_column_int(stmt, 1);
+        offer.unitPrice = Money::fromUnits(sqlite3_column_int64(stmt, 2));
+        offer.leadTimeDays = sqlite3_column_int(stmt, 3);
+        offer.minimumOrder = sqlite3_column_int(stmt, 4);
+    }
+    sqlite3_reset(stmt);
+}
+
+static size_t differences(const vector<SupplierOffer> &left, const vector<SupplierOffer> &right){
+    size_t count = 0;
+    for (size_t line = 0; line < left.size(); ++line){
+        if (left[line].supplierId != right[line].supplierId || left[line].unitPrice != right[line].unitPrice){
+            ++count;
+        }
+    }
+    return count;
+}
+
+int main(int argc, char **argv){
+    long items = argc > 1 ? atol(argv[1]) : 100000;
+    int suppliers = argc > 2 ? atoi(argv[2]) : 200;
+    int offersPerItem = argc > 3 ? atoi(argv[3]) : 8;
+    string path = argc > 4 ? argv[4] : "supplier_prices_bench.db";
+
+    std::remove(path.c_str());
+    Database database(path);
+    database.init();
+    sqlite3 *db = database.getDBConnection();
+    exec(db, "PRAGMA synchronous = OFF;");
+
+    auto start = chrono::steady_clock::now();
+    populate(db, items, suppliers, offersPerItem);
+    printf("populate              %10.1f ms  (%ld items, %d suppliers, %d offers per item)\n", elapsedMs(start), items, suppliers, offersPerItem);
+
+    SupplierPriceIndex index(database);
+    start = chrono::steady_clock::now();
+    index.load();
+    printf("index load            %10.1f ms  (%zu offers)\n", elapsedMs(start), index.size());
+
+    sqlite3_stmt *perLine;
+    sqlite3_stmt *batch;
+    sqlite3_prepare_v2(db, lineQuery, -1, &perLine, nullptr);
+    if (sqlite3_prepare_v2(db, batchQuery, -1, &batch, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error preparing batch query: %s", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    const int maxLeadTime = 21;
+    mt19937 random(7);
+    size_t mismatches = 0;
+    for (size_t lines : {100UL, 1000UL, 10000UL, static_cast<size_t>(items)}){
+        vector<PurchaseNeed> needs = purchaseOrder(random, items, lines);
+
+        vector<SupplierOffer> fromIndex;
+        start = chrono::steady_clock::now();
+        size_t filled = index.cheapest(needs, maxLeadTime, fromIndex);
+        double indexMs = elapsedMs(start);
+
+        vector<SupplierOffer> fromBatch;
+        start = chrono::steady_clock::now();
+        sqlBatch(batch, needs, maxLeadTime, fromBatch);
+        double batchMs = elapsedMs(start);
+
+        vector<SupplierOffer> fromLines;
+        start = chrono::steady_clock::now();
+        sqlPerLine(perLine, needs, maxLeadTime, fromLines);
+        double linesMs = elapsedMs(start);
+
+        mismatches += differences(fromIndex, fromBatch) + differences(fromIndex, fromLines);
+        printf("order of %6zu lines  index %9.3f ms  sql batch %9.3f ms  sql per line %9.3f ms  (%zu filled)\n",
+               lines, indexMs, batchMs, linesMs, filled);
+    }
+
+    // Reprice a slice of the offers and drop a supplier, then source again.
+    start = chrono::steady_clock::now();
+    exec(db, "BEGIN;");
+    exec(db, "UPDATE supplier_prices SET unit_price = unit_price / 2 WHERE id % 97 = 0;");
+    exec(db, "UPDATE suppliers SET deleted_at = datetime('now') WHERE id = 1;");
+    exec(db, "COMMIT;");
+    double updateMs = elapsedMs(start);
+    start = chrono::steady_clock::now();
+    size_t changed = index.refresh();
+    printf("reprice and refresh   %10.1f ms  update %10.1f ms  (%zu rows, %zu items in delta)\n",
+           elapsedMs(start), updateMs, changed, index.deltaItems());
+
+    vector<PurchaseNeed> needs = purchaseOrder(random, items, 10000);
+    vector<SupplierOffer> fromIndex;
+    vector<SupplierOffer> fromBatch;
+    index.cheapest(needs, maxLeadTime, fromIndex);
+    sqlBatch(batch, needs, maxLeadTime, fromBatch);
+    size_t refreshMismatches = differences(fromIndex, fromBatch);
+    for (const SupplierOffer &offer : fromIndex){
+        if (offer.supplierId == 1){
+            ++refreshMismatches;
+        }
+    }
+    mismatches += refreshMismatches;
+
+    sqlite3_finalize(perLine);
+    sqlite3_finalize(batch);
+    printf("mismatches            %10zu\n", mismatches);
+
+    Logger::instance().flush();
+    return mismatches == 0 ? 0 : 1;
+}
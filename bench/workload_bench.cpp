@@ -0,0 +1,107 @@
+#include "batch.hpp"
+#include "database.hpp"
+#include "workload.hpp"
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+
+using namespace std;
+
+// Runs one generated batch script (item inserts, stock moves and lookups)
+// without and with workload capture to measure the capture overhead and the
+// trace size, then replays the trace against a copy of the starting database
+// back to back and prints the replay latency table.
+//
+// Usage: workload_bench.out [commands] [database file]
+
+static string makeScript(long commands){
+    ostringstream script;
+    const long items = max(1L, commands / 4);
+    for (long i = 0; i < items; ++i){
+        script << "add item name=\"Item " << i << "\" description=\"\" category_id=1 quantity=100 unit_measurement=pcs "
+               << "unit_price=2.5 supplier_id=1\n";
+    }
+    for (long i = items; i < commands; ++i){
+        if (i % 4 == 0){
+            script << "update item " << (i % items) + 1 << " description=\"revised " << i << "\"\n";
+        }else{
+            script << "move-stock " << (i % items) + 1 << (i % 3 == 0 ? " -1" : " +2") << " remarks=\"bench\"\n";
+        }
+    }
+    return script.str();
+}
+
+static void seed(const string &path){
+    std::remove(path.c_str());
+    Database database(path);
+    database.init();
+    vector<Row> rows;
+    database.query("INSERT INTO category (name, description) VALUES ('Bench', '');", {}, rows);
+    database.query("INSERT INTO suppliers (name, address) VALUES ('Supplier', '');", {}, rows);
+    database.query("INSERT INTO user (username, password, role, contact_info) VALUES ('bench', 'x', 'admin', '');", {}, rows);
+}
+
+static double run(const string &path, const string &script, WorkloadCapture *capture){
+    Database database(path);
+    database.init();
+    database.setCapture(capture);
+
+    BatchRunner runner(database, BatchOptions());
+    istringstream input(script);
+    auto start = chrono::steady_clock::now();
+    runner.run(input);
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv){
+    long commands = argc > 1 ? atol(argv[1]) : 20000;
+    string path = argc > 2 ? argv[2] : "workload_bench.db";
+    const string seedPath = path + ".seed";
+    const string tracePath = path + ".trace";
+
+    const string script = makeScript(commands);
+    seed(seedPath);
+
+    // Each run starts from a copy of the seeded database.
+    auto fresh = [&]{
+        Database source(seedPath);
+        WorkloadReplayer::copyDatabase(source, path);
+    };
+
+    fresh();
+    double plain = run(path, script, nullptr);
+
+    fresh();
+    uint64_t records;
+    double captured;
+    {
+        WorkloadCapture capture(tracePath);
+        captured = run(path, script, &capture);
+        capture.flush();
+        records = capture.records();
+    }
+
+    struct stat traceStat;
+    stat(tracePath.c_str(), &traceStat);
+    printf("without capture  %10.1f ms  %10.0f commands/s\n", plain, static_cast<double>(commands) * 1000.0 / plain);
+    printf("with capture     %10.1f ms  %10.0f commands/s  (%+.1f%%)\n", captured, static_cast<double>(commands) * 1000.0 / captured,
+           (captured - plain) * 100.0 / plain);
+    printf("trace            %10llu records  %10lld bytes  %.1f bytes/record\n", static_cast<unsigned long long>(records),
+           static_cast<long long>(traceStat.st_size), static_cast<double>(traceStat.st_size) / static_cast<double>(records));
+
+    vector<TraceRecord> trace;
+    if (!readTrace(tracePath, trace)){
+        return 1;
+    }
+    fresh();
+    Database copy(path);
+    copy.init();
+    ReplayOptions options;
+    options.speed = 0;
+    WorkloadReplayer replayer(copy, options);
+    replayer.run(trace);
+    replayer.printSummary(stdout);
+    return 0;
+}
@@ -0,0 +1,196 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include "database.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Tuning knobs of a BatchRunner.
+ */
+struct BatchOptions {
+    /**
+     * @brief Commands grouped into one transaction.
+     */
+    size_t commitEvery = 1000;
+
+    /**
+     * @brief Parsed commands the parser may run ahead of execution.
+     */
+    size_t queueCapacity = 8192;
+
+    /**
+     * @brief How long a partial group waits for more input before it is committed anyway.
+     */
+    std::chrono::milliseconds linger{100};
+
+    /**
+     * @brief Stop at the first failed command, rolling back its group.
+     */
+    bool stopOnError = false;
+
+    /**
+     * @brief Ledger user of move-stock commands that name none.
+     */
+    int userId = 1;
+};
+
+/**
+ * @brief Counters of one BatchRunner::run() call.
+ */
+struct BatchStats {
+    size_t lines = 0;
+    size_t commands = 0;
+    size_t failed = 0;
+    size_t transactions = 0;
+};
+
+/**
+ * @brief One parsed line of a batch script.
+ */
+struct BatchCommand {
+    enum class Kind {
+        Add,
+        Update,
+        Remove,
+        MoveStock,
+        Report,
+        Commit
+    };
+
+    Kind kind = Kind::Commit;
+    size_t line = 0;
+    std::string table;
+    std::vector<int> ids;
+
+    /**
+     * @brief Column values of add and update, or user and remarks of move-stock.
+     */
+    Row values;
+
+    /**
+     * @brief Units moved by move-stock, or the item count of report top_items.
+     */
+    int quantity = 0;
+};
+
+/**
+ * @brief Runs a line-oriented command script against a Database.
+ *
+ * The script language, one command per line:
+ *
+ *     add <table> <column>=<value> ...          insert a row
+ *     update <table> <id> <column>=<value> ...  change columns of a row
+ *     remove <table> <id> [<id> ...]            delete rows (removeMany, no cascade)
+ *     move-stock <item id> <+n|-n> [user=<id>] [remarks=<text>]
+ *     report [<name>]                           print a standard report, or all of them
+ *     report top_items [<n>]                    print the n most valuable items (default 10)
+ *     commit                                    commit the commands read so far
+ *
+ * Values may be double-quoted, with backslash escapes; quoted values are
+ * always text, unquoted ones are integers or reals when they parse as such.
+ * Blank lines and lines starting with `#` are ignored.
+ *
+ * One thread parses while the calling thread executes: parsed commands go
+ * through a bounded queue and are applied in groups of commitEvery, each group
+ * in one transaction, so a script costs one commit per group instead of one
+ * per line. A group is also closed when input pauses for longer than the
+ * linger time, or by report and commit, which see every earlier command
+ * committed. Each command runs in its own savepoint: a failing command is
+ * reported with its line number and skipped without losing the rest of its
+ * group, unless stopOnError is set.
+ */
+class BatchRunner {
+    private :
+        Database &database;
+        BatchOptions options;
+        std::ostream &output;
+        BatchStats counters;
+
+        /**
+         * @brief Malformed lines, counted by the parser thread.
+         */
+        size_t parseFailures = 0;
+
+        std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        std::deque<BatchCommand> queue;
+        bool inputDone = false;
+        bool aborted = false;
+
+        /**
+         * @brief Body of the parser thread.
+         */
+        void parseInput(std::istream &input);
+
+        /**
+         * @brief Takes the next group from the queue; false once the input is exhausted.
+         */
+        bool nextGroup(std::vector<BatchCommand> &group);
+
+        /**
+         * @brief Applies a group of data commands in one transaction; false to stop the script.
+         */
+        bool executeGroup(const std::vector<BatchCommand> &group);
+
+        static bool moveStock(Database &database, const BatchCommand &command, int userId);
+        bool report(const BatchCommand &command);
+
+    public :
+        /**
+         * @param output Receives report output.
+         */
+        BatchRunner(Database &database, const BatchOptions &options = BatchOptions(), std::ostream &output = std::cout);
+
+        /**
+         * @brief Runs a whole script.
+         *
+         * @return true if every command succeeded.
+         */
+        bool run(std::istream &input);
+
+        /**
+         * @brief Returns the counters of the last run().
+         */
+        const BatchStats &stats() const { return counters; }
+
+        /**
+         * @brief Applies one add, update, remove or move-stock command; other kinds do nothing.
+         *
+         * Values of MONEY columns that are not Money yet are converted with
+         * the meaning Database::insert() gives them: numbers are minor units,
+         * so 1250 and 1250.0 become 12.50 and 12.5 is rejected; text must be
+         * an exact decimal amount such as "12.50".
+         *
+         * @param userId Ledger user of a move-stock command that names none.
+         */
+        static bool apply(Database &database, const BatchCommand &command, int userId);
+
+        /**
+         * @brief Returns true for the tables commands may name.
+         */
+        static bool knownTable(const std::string &tableName);
+
+        /**
+         * @brief Returns true for names that may be used as a column; they are pasted into SQL.
+         */
+        static bool validColumn(const std::string &columnName);
+
+        /**
+         * @brief Parses one script line.
+         *
+         * @param command Receives the command; untouched for blank and comment lines.
+         * @param error Receives the reason when the line is malformed.
+         *
+         * @return false if the line holds no command; error is empty for blank lines.
+         */
+        static bool parse(const std::string &line, BatchCommand &command, std::string &error);
+};
+
+#endif
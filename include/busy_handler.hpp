@@ -0,0 +1,134 @@
+#ifndef BUSY_HANDLER_HPP
+#define BUSY_HANDLER_HPP
+
+#include <sqlite3.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief How long and how aggressively to wait for a locked database.
+ */
+struct BusyPolicy {
+    /**
+     * @brief First backoff delay; each further attempt doubles it.
+     */
+    std::chrono::microseconds initialDelay{200};
+
+    /**
+     * @brief Upper bound of a single backoff delay.
+     */
+    std::chrono::microseconds maxDelay{std::chrono::milliseconds(50)};
+
+    /**
+     * @brief Total time to wait for one lock before giving up with SQLITE_BUSY.
+     */
+    std::chrono::milliseconds timeout{5000};
+
+    /**
+     * @brief Fraction of each delay that is randomized (0 = none, 1 = full jitter).
+     */
+    double jitter = 0.5;
+
+    /**
+     * @brief How many times an operation that still failed with SQLITE_BUSY or
+     *        SQLITE_LOCKED is re-executed from the start.
+     */
+    int maxRetries = 3;
+};
+
+/**
+ * @brief Snapshot of the contention counters.
+ */
+struct BusyStats {
+    /**
+     * @brief Times SQLite called the busy handler.
+     */
+    uint64_t handlerCalls = 0;
+
+    /**
+     * @brief Times a whole statement or transaction was re-executed.
+     */
+    uint64_t retries = 0;
+
+    /**
+     * @brief Lock waits that exceeded the timeout.
+     */
+    uint64_t timeouts = 0;
+
+    /**
+     * @brief Total time spent sleeping in backoff, in microseconds.
+     */
+    uint64_t waitMicros = 0;
+};
+
+/**
+ * @brief sqlite3_busy_handler implementation with jittered exponential backoff.
+ *
+ * Installed on a connection, the handler sleeps between lock attempts with a
+ * delay that doubles from initialDelay up to maxDelay, randomized by the jitter
+ * fraction so that competing processes do not retry in lockstep, and gives up
+ * once the policy timeout has elapsed. The same backoff is used by callers that
+ * re-execute operations which still failed with SQLITE_BUSY or SQLITE_LOCKED,
+ * for example when SQLite reports a deadlock without calling the handler.
+ *
+ * Counters are atomic, so stats() may be read from any thread.
+ */
+class BusyHandler {
+    private :
+        BusyPolicy policy;
+
+        std::atomic<uint64_t> handlerCalls{0};
+        std::atomic<uint64_t> retries{0};
+        std::atomic<uint64_t> timeouts{0};
+        std::atomic<uint64_t> waitMicros{0};
+
+        /**
+         * @brief Trampoline registered with sqlite3_busy_handler.
+         */
+        static int callback(void *context, int attempts);
+
+    public :
+        explicit BusyHandler(const BusyPolicy &policy = BusyPolicy());
+
+        /**
+         * @brief Registers the handler on a connection.
+         */
+        void install(sqlite3 *connection);
+
+        /**
+         * @brief Replaces the policy; must not race with lock waits on other threads.
+         */
+        void setPolicy(const BusyPolicy &policy);
+
+        /**
+         * @brief Returns the current policy.
+         */
+        const BusyPolicy &currentPolicy() const;
+
+        /**
+         * @brief Returns the jittered delay for the given zero-based attempt.
+         */
+        std::chrono::microseconds backoff(int attempt) const;
+
+        /**
+         * @brief Sleeps before re-executing an operation and counts the retry.
+         *
+         * @param attempt Zero-based number of the retry.
+         *
+         * @return true if the caller may retry; false once maxRetries is reached.
+         */
+        bool waitBeforeRetry(int attempt);
+
+        /**
+         * @brief Returns whether a result code is worth retrying.
+         */
+        static bool retryable(int resultCode);
+
+        /**
+         * @brief Returns a snapshot of the counters.
+         */
+        BusyStats stats() const;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef CATEGORY_TREE_HPP
+#define CATEGORY_TREE_HPP
+
+#include "database.hpp"
+#include <map>
+#include <vector>
+
+/**
+ * @brief Aggregates of every item in a category and the categories below it.
+ */
+struct SubtreeTotals {
+    /**
+     * @brief Categories in the subtree, the root included.
+     */
+    long long categories = 0;
+    long long items = 0;
+    long long quantity = 0;
+    Money valuation;
+};
+
+/**
+ * @brief Queries and moves over the category hierarchy.
+ *
+ * Categories form a forest through `category.parent_id` (NULL for a root).
+ * Database::init() keeps the `category_tree` closure table in step with it
+ * through triggers: one row per ancestor/descendant pair, the category itself
+ * included at depth 0. A subtree is then one range of the closure table's
+ * primary key, and subtree aggregates join that range with the per-category
+ * `category_totals`, so no query walks the tree recursively.
+ *
+ * Statements are prepared once and run on the Database's connection; like the
+ * Database itself, a CategoryTree must not be shared between threads.
+ */
+class CategoryTree {
+    private :
+        Database &database;
+
+        sqlite3_stmt *totalsStmt = nullptr;
+        sqlite3_stmt *childTotalsStmt = nullptr;
+        sqlite3_stmt *subtreeStmt = nullptr;
+        sqlite3_stmt *pathStmt = nullptr;
+
+        /**
+         * @brief Prepares stmt on first use and resets it on later ones; null on error.
+         */
+        sqlite3_stmt *prepare(sqlite3_stmt *&stmt, const char *sql);
+
+        /**
+         * @brief Collects the first column of every row of a bound statement.
+         */
+        bool collectIds(sqlite3_stmt *stmt, std::vector<int> &ids);
+
+    public :
+        /**
+         * @param database The database holding the categories. It must outlive the tree.
+         */
+        explicit CategoryTree(Database &database);
+        ~CategoryTree();
+
+        CategoryTree(const CategoryTree&) = delete;
+        CategoryTree &operator=(const CategoryTree&) = delete;
+
+        /**
+         * @brief Moves a category, with everything below it, under a new parent.
+         *
+         * @param categoryId The root of the subtree to move.
+         * @param parentId The new parent, or 0 to make the category a root.
+         *
+         * @return false if a category does not exist or the new parent lies
+         *         inside the moved subtree; nothing changes then.
+         */
+        bool move(int categoryId, int parentId);
+
+        /**
+         * @brief Lists a category and all its descendants, nearest first.
+         */
+        bool subtree(int categoryId, std::vector<int> &ids);
+
+        /**
+         * @brief Lists the ancestors of a category from its root down to the category itself.
+         */
+        bool path(int categoryId, std::vector<int> &ids);
+
+        /**
+         * @brief Sums the live items of a category and all its descendants.
+         */
+        bool totals(int categoryId, SubtreeTotals &totals);
+
+        /**
+         * @brief Computes totals() for every child of a category in one query.
+         *
+         * @param parentId The parent whose children are listed, or 0 for the roots.
+         * @param totals Receives the totals keyed by child id.
+         */
+        bool childTotals(int parentId, std::map<int, SubtreeTotals> &totals);
+};
+
+#endif
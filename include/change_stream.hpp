@@ -0,0 +1,267 @@
+#ifndef CHANGE_STREAM_HPP
+#define CHANGE_STREAM_HPP
+
+#include <sqlite3.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A committed row change reported by the change stream.
+ */
+struct ChangeEvent {
+    /**
+     * @brief Name of the changed table.
+     *
+     * The string is interned by the ChangeStream and stays valid for as long
+     * as the stream exists, which keeps events trivially copyable.
+     */
+    const char *table;
+
+    /**
+     * @brief SQLITE_INSERT, SQLITE_UPDATE or SQLITE_DELETE.
+     */
+    int operation;
+
+    /**
+     * @brief Rowid of the changed row.
+     */
+    sqlite3_int64 rowId;
+
+    /**
+     * @brief Sequence number of the transaction that committed the change.
+     */
+    uint64_t transaction;
+};
+
+/**
+ * @brief Bounded single-producer/single-consumer ring of change events.
+ *
+ * The producer is the thread committing on the database connection and the
+ * consumer is the subscriber; neither side takes a lock. When the ring is full
+ * new events are dropped and the ring is flagged as overflowed so that the
+ * consumer knows it has to resynchronize from the database.
+ */
+class ChangeRing {
+    private :
+        std::vector<ChangeEvent> slots;
+        size_t mask;
+
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+        alignas(64) std::atomic<uint64_t> droppedEvents{0};
+        std::atomic<bool> overflowFlag{false};
+
+    public :
+        /**
+         * @brief Creates a ring able to hold at least capacity events.
+         *
+         * @param capacity Requested capacity, rounded up to a power of two.
+         */
+        explicit ChangeRing(size_t capacity);
+
+        /**
+         * @brief Appends an event; called by the producer only.
+         *
+         * @return true if the event was queued; false if the ring was full.
+         */
+        bool push(const ChangeEvent &event);
+
+        /**
+         * @brief Moves up to maxEvents queued events into out; called by the consumer only.
+         *
+         * @return The number of events appended to out.
+         */
+        size_t pop(std::vector<ChangeEvent> &out, size_t maxEvents);
+
+        /**
+         * @brief Returns the number of events dropped because the ring was full.
+         */
+        uint64_t dropped() const;
+
+        /**
+         * @brief Returns and clears the overflow flag.
+         */
+        bool takeOverflow();
+};
+
+class ChangeStream;
+
+/**
+ * @brief A consumer's handle on the change stream.
+ *
+ * Each subscription owns its own ring, so a slow subscriber only loses its
+ * own events. Destroying the subscription detaches it from the stream.
+ */
+class ChangeSubscription {
+    private :
+        ChangeStream &stream;
+        std::shared_ptr<ChangeRing> ring;
+        uint64_t lastSequence = 0;
+
+    public :
+        ChangeSubscription(ChangeStream &stream, std::shared_ptr<ChangeRing> ring);
+        ~ChangeSubscription();
+
+        ChangeSubscription(const ChangeSubscription&) = delete;
+        ChangeSubscription &operator=(const ChangeSubscription&) = delete;
+
+        /**
+         * @brief Appends up to maxEvents committed events to out without blocking.
+         *
+         * @return The number of events appended.
+         */
+        size_t poll(std::vector<ChangeEvent> &out, size_t maxEvents = SIZE_MAX);
+
+        /**
+         * @brief Blocks until a transaction commits after the last wait or the timeout expires.
+         *
+         * @return true if new events may be available; false on timeout.
+         */
+        bool wait(std::chrono::milliseconds timeout);
+
+        /**
+         * @brief Returns true once if events were lost since the last call.
+         *
+         * A subscriber that sees this must treat its derived state as stale and
+         * rebuild it from the database.
+         */
+        bool overflowed();
+
+        /**
+         * @brief Returns the total number of events this subscriber lost.
+         */
+        uint64_t dropped() const;
+};
+
+/**
+ * @brief Change-data-capture stream fed by the SQLite update, commit and rollback hooks.
+ *
+ * Row changes reported by sqlite3_update_hook are buffered per transaction.
+ * The commit hook runs before the commit is durable or visible to other
+ * connections, so it only stages them; they are published to every subscriber
+ * ring once COMMIT has succeeded, and discarded when the transaction (or a
+ * failed COMMIT) rolls back. Subscribers therefore only ever see changes that
+ * are durable, and a reader on another connection that re-reads a changed row
+ * gets the new version. Changes undone with ROLLBACK TO a savepoint are still
+ * published, because SQLite reports no hook for them; subscribers should treat
+ * events as hints to re-read the row rather than as row images.
+ *
+ * The hook methods are called by SQLite while it holds the connection mutex,
+ * which serializes the producer side even when several threads share the
+ * connection.
+ */
+class ChangeStream {
+    private :
+        /**
+         * @brief Table names referenced by events; std::set keeps the strings at stable addresses.
+         */
+        std::set<std::string> tableNames;
+
+        /**
+         * @brief Changes of the transaction currently open on the connection.
+         */
+        std::vector<ChangeEvent> pending;
+
+        /**
+         * @brief Changes of a transaction whose COMMIT is under way, published once it succeeded.
+         */
+        std::vector<ChangeEvent> committing;
+
+        /**
+         * @brief Copy-on-write list of subscriber rings, read by the publisher without locking.
+         */
+        std::shared_ptr<const std::vector<std::shared_ptr<ChangeRing>>> rings;
+
+        /**
+         * @brief Serializes subscribe/unsubscribe updates of rings.
+         */
+        std::mutex subscribersMutex;
+
+        /**
+         * @brief Number of committed transactions that carried at least one change.
+         */
+        std::atomic<uint64_t> sequence{0};
+
+        /**
+         * @brief Number of events published and discarded, for diagnostics.
+         */
+        std::atomic<uint64_t> publishedEvents{0};
+        std::atomic<uint64_t> discardedEvents{0};
+
+        /**
+         * @brief Wakes subscribers blocked in ChangeSubscription::wait().
+         */
+        std::mutex waitMutex;
+        std::condition_variable waitCondition;
+        std::atomic<int> waiters{0};
+
+        friend class ChangeSubscription;
+
+        /**
+         * @brief Removes a ring from the subscriber list.
+         */
+        void unsubscribe(const std::shared_ptr<ChangeRing> &ring);
+
+        /**
+         * @brief Blocks until the sequence moves past lastSequence or the timeout expires.
+         */
+        bool waitForCommit(uint64_t &lastSequence, std::chrono::milliseconds timeout);
+
+    public :
+        ChangeStream();
+
+        /**
+         * @brief Records a row change of the open transaction (update hook).
+         */
+        void recordChange(int operation, const char *tableName, sqlite3_int64 rowId);
+
+        /**
+         * @brief Stages the buffered changes of a transaction about to commit (commit hook).
+         */
+        void stage();
+
+        /**
+         * @brief Publishes the staged changes to all subscribers; called once COMMIT has succeeded.
+         */
+        void publish();
+
+        /**
+         * @brief Discards the buffered and staged changes (rollback hook).
+         */
+        void rollback();
+
+        /**
+         * @brief Attaches a new subscriber.
+         *
+         * @param capacity Number of events the subscriber may fall behind by before
+         *                 events are dropped.
+         *
+         * @return The subscription; events committed from now on are delivered to it.
+         */
+        std::unique_ptr<ChangeSubscription> subscribe(size_t capacity = 8192);
+
+        /**
+         * @brief Returns the sequence number of the last committed transaction.
+         */
+        uint64_t lastSequence() const;
+
+        /**
+         * @brief Returns the number of events delivered to the subscriber rings.
+         */
+        uint64_t published() const;
+
+        /**
+         * @brief Returns the number of uncommitted events dropped on rollback.
+         */
+        uint64_t discarded() const;
+};
+
+#endif
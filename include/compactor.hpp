@@ -0,0 +1,170 @@
+#ifndef COMPACTOR_HPP
+#define COMPACTOR_HPP
+
+#include "database.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Tuning knobs of the background Compactor.
+ */
+struct CompactorOptions {
+    /**
+     * @brief Tables whose tombstones are purged, in purge order (children first).
+     */
+    std::vector<std::string> tables = {"item", "category", "suppliers"};
+
+    /**
+     * @brief How long a soft-deleted row is kept before it may be purged.
+     */
+    std::chrono::seconds retention{std::chrono::hours(24)};
+
+    /**
+     * @brief Maximum number of rows deleted per transaction.
+     */
+    int batchSize = 200;
+
+    /**
+     * @brief Delay between two checks for idle time.
+     */
+    std::chrono::milliseconds interval{1000};
+
+    /**
+     * @brief The database counts as idle when no other connection committed for this long.
+     */
+    std::chrono::milliseconds idleThreshold{2000};
+
+    /**
+     * @brief Free pages that trigger an incremental vacuum step.
+     */
+    int freelistThreshold = 256;
+
+    /**
+     * @brief Pages returned to the file system per incremental vacuum step.
+     */
+    int vacuumPages = 128;
+};
+
+/**
+ * @brief Background thread that purges soft-deleted rows and shrinks the file.
+ *
+ * The compactor owns its own connection to the database file. It watches
+ * `PRAGMA data_version` to detect commits from other connections and only works
+ * once the database has been idle for a while. Tombstones older than the
+ * retention period are deleted in small autocommit batches so that writers are
+ * never blocked for long; rows still referenced through a foreign key (for
+ * example items with ledger entries) are left in place. Afterwards, if enough
+ * pages are free, `PRAGMA incremental_vacuum(N)` returns them to the file
+ * system without a blocking full VACUUM.
+ */
+class Compactor {
+    private :
+        /**
+         * @brief The compactor's private connection.
+         */
+        sqlite3 *db = nullptr;
+
+        /**
+         * @brief Options fixed at construction.
+         */
+        CompactorOptions options;
+
+        /**
+         * @brief Purge statement for each table in options.tables.
+         */
+        std::vector<std::string> purgeQueries;
+
+        /**
+         * @brief Worker thread and its stop signal.
+         */
+        std::thread worker;
+        std::mutex stateMutex;
+        std::condition_variable stateCondition;
+        bool stopping = false;
+
+        /**
+         * @brief Last observed data_version and when it changed.
+         */
+        int lastDataVersion = -1;
+        std::chrono::steady_clock::time_point lastActivity;
+
+        /**
+         * @brief Counters exposed through the accessors.
+         */
+        std::atomic<uint64_t> purged{0};
+        std::atomic<uint64_t> vacuumed{0};
+        std::atomic<uint64_t> passes{0};
+
+        /**
+         * @brief Returns true when no other connection committed within the idle threshold.
+         */
+        bool idle();
+
+        /**
+         * @brief Reads a single integer from a pragma or query.
+         */
+        int queryInt(const char *sql);
+
+        /**
+         * @brief Body of the worker thread.
+         */
+        void run();
+
+    public :
+        /**
+         * @brief Opens a private connection to the database file.
+         *
+         * @param database The database to compact. Only its file path is used; the
+         *                 compactor never touches the Database's own connection.
+         * @param options Tuning knobs.
+         */
+        Compactor(const Database &database, const CompactorOptions &options = CompactorOptions());
+
+        /**
+         * @brief Stops the worker thread and closes the connection.
+         */
+        ~Compactor();
+
+        Compactor(const Compactor&) = delete;
+        Compactor &operator=(const Compactor&) = delete;
+
+        /**
+         * @brief Starts the background thread.
+         */
+        void start();
+
+        /**
+         * @brief Stops the background thread, waiting for the current batch to finish.
+         */
+        void stop();
+
+        /**
+         * @brief Runs one full purge and vacuum pass on the calling thread, ignoring idleness.
+         *
+         * @return The number of rows purged.
+         */
+        size_t runOnce();
+
+        /**
+         * @brief Returns the number of tombstones purged so far.
+         */
+        uint64_t purgedRows() const;
+
+        /**
+         * @brief Returns the number of pages released by incremental vacuum so far.
+         */
+        uint64_t vacuumedPages() const;
+
+        /**
+         * @brief Returns the number of completed passes.
+         */
+        uint64_t completedPasses() const;
+};
+
+#endif
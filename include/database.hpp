@@ -3,10 +3,59 @@
 
 #include <string>
 #include <sqlite3.h>
+#include "busy_handler.hpp"
+#include "change_stream.hpp"
 #include <functional>
 #include <map>
-#include <iostream>
+#include <unordered_map>
+#include "logger.hpp"
+#include "money.hpp"
+#include "workload.hpp"
 #include <variant>
+#include <vector>
+
+/**
+ * @brief A value read from or bound to a table column.
+ *
+ * Money is bound as its minor units and read back from columns declared MONEY.
+ * query() reads every other integer as sqlite3_int64, so ids, counts and sums
+ * past 2^31 are not truncated; int remains for values written by the caller.
+ */
+using FieldValue = std::variant<std::string, int, double, Money, sqlite3_int64>;
+
+/**
+ * @brief Reads an integer FieldValue, whichever of int and sqlite3_int64 it holds.
+ *
+ * Rows returned by query() hold sqlite3_int64, rows built by callers often
+ * int; code reading ids from either should go through this.
+ *
+ * @return false if value holds no integer.
+ */
+inline bool integerValue(const FieldValue &value, sqlite3_int64 &integer){
+    if (const sqlite3_int64 *wide = std::get_if<sqlite3_int64>(&value)){
+        integer = *wide;
+        return true;
+    }
+    if (const int *narrow = std::get_if<int>(&value)){
+        integer = *narrow;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Associates column names with getters that read the column value from a T.
+ */
+template <typename T>
+using FieldMapping = std::map<std::string, std::function<FieldValue(const T&)>>;
+
+/**
+ * @brief A result row, keyed by column name. NULL columns are left out.
+ */
+using Row = std::map<std::string, FieldValue>;
+
+template <typename T>
+class Tracked;
 
 /**
  * @brief Represents a database connection.
@@ -22,6 +71,238 @@ class Database {
          */
         sqlite3 *db;
 
+        /**
+         * @brief Change-data-capture stream fed by the connection hooks.
+         * 
+         * Row changes are buffered while a transaction is open and published to
+         * subscribers once its commit has succeeded; see changes().
+         */
+        ChangeStream changeStream;
+
+        /**
+         * @brief Trampolines registered with sqlite3_update_hook, sqlite3_commit_hook
+         * and sqlite3_rollback_hook, forwarding to changeStream. Rows of
+         * attached and temporary databases are not forwarded.
+         */
+        static void updateHook(void *context, int operation, const char *databaseName, const char *tableName, sqlite3_int64 rowId);
+        static int commitHook(void *context);
+        static void rollbackHook(void *context);
+
+        /**
+         * @brief WAL hook, called after a commit has taken place: publishes the
+         * staged changes, then checkpoints or forwards to walObserver.
+         */
+        static int walHook(void *context, sqlite3 *db, const char *databaseName, int frames);
+
+        /**
+         * @brief Receives the WAL hook in place of the automatic checkpoint; see setWalObserver().
+         */
+        std::function<void(sqlite3*, const char*, int)> walObserver;
+
+        /**
+         * @brief Publishes changes staged by a commit once the connection is back in autocommit mode.
+         *
+         * Covers connections not in WAL mode, where walHook() is never called.
+         */
+        void publishCommitted();
+
+        /**
+         * @brief Busy handler installed on the connection; also paces operation retries.
+         */
+        BusyHandler busyHandler;
+
+        /**
+         * @brief Result code that made the last transaction() fail; see lastTransactionError().
+         */
+        int transactionError = SQLITE_OK;
+
+        /**
+         * @brief Steps a statement, re-executing it while it fails with SQLITE_BUSY or SQLITE_LOCKED.
+         * 
+         * Retries only happen outside an explicit transaction, where the statement is
+         * its own transaction and a failed attempt has changed nothing. Inside a
+         * transaction the error is returned so the whole transaction can be retried.
+         * 
+         * @return The result of the last sqlite3_step() call.
+         */
+        int step(sqlite3_stmt *stmt);
+
+        /**
+         * @brief Prepared statements keyed by their SQL text.
+         * 
+         * Statements generated by insert(), upsert() and the other write helpers
+         * are prepared once and reused; they are finalized in the destructor.
+         */
+        std::unordered_map<std::string, sqlite3_stmt*> statementCache;
+
+        /**
+         * @brief Returns a cached prepared statement for the SQL text, preparing it on first use.
+         * 
+         * The statement is returned reset and with its bindings cleared.
+         * 
+         * @param sql The SQL text of the statement.
+         * 
+         * @return The prepared statement, or nullptr if preparation failed.
+         */
+        sqlite3_stmt *prepareCached(const std::string &sql);
+
+        /**
+         * @brief Resets a cached statement after use so it can be reused.
+         */
+        static void releaseCached(sqlite3_stmt *stmt);
+
+        /**
+         * @brief Binds a field value to the placeholder at the given index.
+         */
+        static void bindValue(sqlite3_stmt *stmt, int index, const FieldValue &value);
+
+        /**
+         * @brief Adds a column to an existing table unless it is already present.
+         * 
+         * Used by init() to upgrade databases created by older versions.
+         */
+        void addColumnIfMissing(const std::string &tableName, const std::string &columnName, const std::string &definition);
+
+        /**
+         * @brief Returns the declared type of a column, or an empty string if it does not exist.
+         */
+        std::string columnType(const std::string &tableName, const std::string &columnName);
+
+        /**
+         * @brief Returns true if the column exists and is a generated column.
+         */
+        bool columnIsGenerated(const std::string &tableName, const std::string &columnName);
+
+        /**
+         * @brief Recreates a table with a new definition, copying its rows.
+         * 
+         * Used by init() for changes ALTER TABLE cannot make. Runs with foreign
+         * key enforcement off, as SQLite recommends, and keeps the AUTOINCREMENT
+         * counter. Indexes of the table are dropped with it; init() recreates them.
+         * 
+         * @param definition The column definitions, without the table name.
+         * @param columns The columns to fill, comma-separated.
+         * @param select The expressions filling them, evaluated over the old table.
+         */
+        bool rebuildTable(const std::string &tableName, const std::string &definition, const std::string &columns, const std::string &select);
+
+        /**
+         * @brief Workload capture receiving every operation; see setCapture().
+         */
+        WorkloadCapture *capture = nullptr;
+
+        /**
+         * @brief Whether commits skip the fsync; see setFastCommit().
+         */
+        bool fastCommit = false;
+
+        /**
+         * @brief Records of the traced transaction in progress, written when it ends.
+         * 
+         * Buffering keeps the records of a transaction contiguous in the trace and
+         * lets a retried attempt replace the records of the failed one.
+         */
+        std::vector<TraceRecord> transactionTrace;
+
+        /**
+         * @brief Depth of captured operations in progress; operations made by another
+         * captured operation, such as the statements of removeMany(), are not recorded.
+         */
+        int captureDepth = 0;
+
+        /**
+         * @brief Records one operation into the capture when it goes out of scope.
+         * 
+         * Inactive, and nearly free, when no capture is set or when it runs inside
+         * another captured operation. The operation fills record while it runs and
+         * calls succeeded() on success.
+         */
+        class CapturedOperation {
+            private :
+                Database &database;
+                bool active;
+
+            public :
+                TraceRecord record;
+
+                CapturedOperation(Database &database, TraceOp op, const std::string &tableName);
+                ~CapturedOperation();
+
+                CapturedOperation(const CapturedOperation&) = delete;
+                CapturedOperation &operator=(const CapturedOperation&) = delete;
+
+                explicit operator bool() const { return active; }
+
+                void succeeded() { record.ok = true; }
+
+                /**
+                 * @brief Records a bound column value, when active.
+                 */
+                void column(const std::string &columnName, const FieldValue &value){
+                    if (active){
+                        record.columns.push_back(columnName);
+                        record.values.push_back(value);
+                    }
+                }
+        };
+
+        /**
+         * @brief Body of transaction(), without capture.
+         */
+        bool runTransaction(const std::function<bool()> &work);
+
+        /**
+         * @brief Shared implementation of update(): writes the listed columns of one row.
+         * 
+         * @param columns The mapped columns to write, in the order they are bound.
+         */
+        template <typename T>
+        bool updateColumns(const std::string &tableName, const int &id, const T &data, const FieldMapping<T> &fieldMapping, const std::vector<std::string> &columns){
+            std::string sql = "UPDATE "+ tableName +" SET ";
+            for (const std::string &columnName : columns){
+                sql += columnName + " = ?, ";
+            }
+
+            sql.pop_back();
+            sql.pop_back();
+            sql += " WHERE id = ?;";
+
+            CapturedOperation captured(*this, TraceOp::Update, tableName);
+            sqlite3_stmt *stmt = prepareCached(sql);
+            if (!stmt){
+                LOG_ERROR("Error preparing UPDATE statement: %s", sqlite3_errmsg(db));
+                return false;
+            }
+
+            int index = 1;
+
+            for (const std::string &columnName : columns){
+                FieldValue value = fieldMapping.at(columnName)(data);
+                bindValue(stmt, index++, value);
+                captured.column(columnName, value);
+            }
+
+            sqlite3_bind_int(stmt, index++, id);
+            if (captured){
+                captured.record.values.emplace_back(std::in_place_type<int>, id);
+            }
+
+            if (step(stmt) != SQLITE_DONE){
+                LOG_ERROR("Error executing update statement: %s", sqlite3_errmsg(db));
+                releaseCached(stmt);
+                return false;
+            }
+
+            int changes = sqlite3_changes(db);
+            if (changes == 0) {
+                LOG_WARNING("No rows were updated. Check if the ID exists.");
+            }
+
+            releaseCached(stmt);
+            captured.succeeded();
+            return true;
+        }
+
     public :
         /**
          * @brief Constructs a Database object with the specified database name.
@@ -65,6 +346,126 @@ class Database {
          */
         sqlite3* getDBConnection() const;
 
+        /**
+         * @brief Returns true for the columns init() declares MONEY.
+         * 
+         * MONEY columns hold whole minor units (see Money), so values written to
+         * them must be Money or int, and an int is a number of minor units (250
+         * is 2.50). BatchRunner::apply() and the server protocol read numbers
+         * the same way; only text is parsed as a decimal amount. query()
+         * returns these columns as Money.
+         */
+        static bool isMoneyColumn(const std::string &tableName, const std::string &columnName);
+
+        /**
+         * @brief Returns true for the columns init() derives from other columns.
+         * 
+         * Triggers compute them (item.price is quantity * unit_price) and reject
+         * conflicting writes, so insert(), upsert() and update() skip them when
+         * they appear in a field mapping.
+         */
+        static bool isDerivedColumn(const std::string &tableName, const std::string &columnName);
+
+        /**
+         * @brief Returns true for the tables with a `deleted_at` column (see softRemove()).
+         * 
+         * Their natural-key unique indexes only cover live rows, so a tombstone
+         * never blocks a new row with the same key, and upsert() names the same
+         * predicate in its conflict target.
+         */
+        static bool isSoftDeleteTable(const std::string &tableName);
+
+        /**
+         * @brief Returns the absolute path of the database file.
+         * 
+         * Background components use it to open their own connections to the same
+         * file. In-memory and temporary databases have no path.
+         * 
+         * @return The file path, or an empty string if the database has no file.
+         */
+        std::string getDBPath() const;
+
+        /**
+         * @brief Replaces the policy used when the database file is locked by another connection.
+         * 
+         * Must be called before other threads start using this Database.
+         * 
+         * @param policy Backoff delays, lock wait timeout and operation retry limit.
+         */
+        void setBusyPolicy(const BusyPolicy &policy);
+
+        /**
+         * @brief Converts an existing database file to incremental auto-vacuum.
+         * 
+         * init() only enables the mode on a new file. Converting a file that
+         * already holds tables rewrites it with a full VACUUM, which locks out
+         * every other connection for as long as it runs, so it is left to this
+         * explicit, one-time migration (`--vacuum-incremental`).
+         * 
+         * @return true if the file was converted.
+         */
+        bool enableIncrementalVacuum();
+
+        /**
+         * @brief Chooses between durable and fast commits for this connection.
+         * 
+         * init() switches to WAL and keeps `PRAGMA synchronous = FULL`, so a
+         * commit is on disk when it returns. Fast commits use NORMAL instead:
+         * the WAL is only synced at checkpoints, which removes an fsync per
+         * commit. The database stays consistent, and an application crash
+         * loses nothing, but the last commits before a power failure or OS
+         * crash may be rolled back. May be called before or after init().
+         * 
+         * @param enabled true for NORMAL, false for FULL.
+         */
+        bool setFastCommit(bool enabled);
+
+        /**
+         * @brief Returns the contention counters: handler calls, retries, timeouts and wait time.
+         */
+        BusyStats busyStats() const;
+
+        /**
+         * @brief Returns the change-data-capture stream of this connection.
+         * 
+         * Subscribers receive a (table, operation, rowid) event for every row changed
+         * by a committed transaction on this connection, in commit order. Changes made
+         * through other connections to the same file are not reported.
+         * 
+         * @return The change stream owned by this Database.
+         */
+        ChangeStream &changes();
+
+        /**
+         * @brief Routes the WAL hook of this connection to observer.
+         * 
+         * The connection keeps a WAL hook of its own to publish committed
+         * changes, so `PRAGMA wal_autocheckpoint` and sqlite3_wal_hook() must
+         * not be used on it. Without an observer it checkpoints like SQLite's
+         * automatic checkpoint, once the log holds 1000 frames; with one, the
+         * observer is called after every commit with the frames in the log and
+         * is responsible for checkpointing.
+         * 
+         * @param observer Called with the connection, the schema name and the
+         *                 frame count; an empty function restores the
+         *                 automatic checkpoint.
+         */
+        void setWalObserver(std::function<void(sqlite3 *db, const char *databaseName, int frames)> observer);
+
+        /**
+         * @brief Records every operation of this connection into a workload trace.
+         * 
+         * insert(), upsert(), update(), remove(), softRemove(), restore(), query()
+         * and removeMany() are recorded with their table, columns, parameters,
+         * start time and duration, and transaction() calls are recorded as
+         * brackets around their operations. The records of a transaction are
+         * written when it ends. With no capture set, the only cost is a pointer
+         * test per operation. Must not be changed while a transaction is open.
+         * 
+         * @param capture The trace to append to, or nullptr to stop recording.
+         *                It must outlive the recording.
+         */
+        void setCapture(WorkloadCapture *capture);
 
         /**
          * @brief Inserts a new record into the specified table.
@@ -82,60 +483,247 @@ class Database {
          * 
          * @param fieldMapping A map that associates column names in the table with
          *                     functions that retrieve the corresponding values from the
-         *                     data object. The functions should return a variant type
-         *                     containing either a string, int, or double.
+         *                     data object. The functions return a FieldValue: a
+         *                     string, int, sqlite3_int64, double or Money.
          * 
          * @return true if the insert operation was successful; false otherwise. 
          * 
          * This method prepares the SQL statement, binds the values to the placeholders,
          * and executes the INSERT operation. If any errors occur during preparation or
-         * execution, an error message is printed to standard error.
+         * execution, an error message is written to the Logger.
          */
         template <typename T>
-        bool insert(const std::string &tableName, const T &data, const std::map<std::string, std::function<std::variant<std::string, int, double>(const T&)>> &fieldMapping){
+        bool insert(const std::string &tableName, const T &data, const FieldMapping<T> &fieldMapping){
             std::string sql = "INSERT INTO "+ tableName + "( ";
             std::string placeholders = " VALUES (";
             for (auto &[columnName, getter] : fieldMapping){
+                if (isDerivedColumn(tableName, columnName)){
+                    continue;
+                }
                 sql += columnName + ",";
-                placeholders += "?, ";
+                placeholders += "?,";
             }
 
             sql.pop_back();
             placeholders.pop_back();
 
-            sql += placeholders;
+            sql += ")" + placeholders + ");";
 
-            sqlite3_stmt *stmt;
-            if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK){
-                std::cerr << "Error preparing insert statement: " << sqlite3_errmsg(db) << std::endl;
+            CapturedOperation captured(*this, TraceOp::Insert, tableName);
+            sqlite3_stmt *stmt = prepareCached(sql);
+            if (!stmt){
+                LOG_ERROR("Error preparing insert statement: %s", sqlite3_errmsg(db));
                 return false;
             }
 
             int index = 1;
 
             for (auto &[columnName, getter] : fieldMapping){
-                std::variant<std::string, int, double> value = getter(data);
-
-                if(std::holds_alternative<int>(value)){
-                    sqlite3_bind_int(stmt, index++, std::get<int>(value));
-                }else if(std::holds_alternative<double>(value)){
-                    sqlite3_bind_double(stmt, index++, std::get<double>(value));
-                }else if(std::holds_alternative<std::string>(value)){
-                    const std::string &strValue = std::get<std::string>(value);
-                    sqlite3_bind_text(stmt, index++, strValue.c_str(), -1, SQLITE_TRANSIENT);
+                if (isDerivedColumn(tableName, columnName)){
+                    continue;
+                }
+                FieldValue value = getter(data);
+                bindValue(stmt, index++, value);
+                captured.column(columnName, value);
+            }
+
+            if (step(stmt) != SQLITE_DONE){
+                LOG_ERROR("Error executing INSERT statement: %s", sqlite3_errmsg(db));
+                releaseCached(stmt);
+                return false;
+            }
+
+            releaseCached(stmt);
+            captured.succeeded();
+            return true;
+        }
+
+        /**
+         * @brief Inserts a record, or updates the existing one that has the same natural key.
+         * 
+         * This method generates an `INSERT ... ON CONFLICT (...) DO UPDATE` statement so
+         * that a sync job can write a row in a single round trip instead of checking for
+         * its existence first. Columns listed in conflictColumns identify the row; every
+         * other mapped column is overwritten with the new value. The statement is cached,
+         * so repeated upserts into the same table only bind and step.
+         * 
+         * @tparam T The type of the data object being written.
+         * 
+         * @param tableName The name of the table to write to.
+         * 
+         * @param conflictColumns The columns of a UNIQUE index (or the primary key) that
+         *                        identify an existing row, e.g. {"name", "supplier_id"}
+         *                        for `item`. They must also appear in fieldMapping.
+         *                        Soft-deleted rows never match a natural key.
+         * 
+         * @param data The data object containing the values to be written.
+         * 
+         * @param fieldMapping A map that associates column names in the table with
+         *                     functions that retrieve the corresponding values from the
+         *                     data object.
+         * 
+         * @param returnedId When not null, receives the id of the inserted or updated
+         *                   row (via `RETURNING id`).
+         * 
+         * @return true if the row was inserted or updated; false otherwise.
+         */
+        template <typename T>
+        bool upsert(const std::string &tableName, const std::vector<std::string> &conflictColumns, const T &data, const FieldMapping<T> &fieldMapping, sqlite3_int64 *returnedId = nullptr){
+            std::string sql = "INSERT INTO " + tableName + " (";
+            std::string placeholders = " VALUES (";
+            std::string assignments;
+
+            for (auto &[columnName, getter] : fieldMapping){
+                if (isDerivedColumn(tableName, columnName)){
+                    continue;
+                }
+                sql += columnName + ",";
+                placeholders += "?,";
+
+                bool isConflictColumn = false;
+                for (const std::string &conflictColumn : conflictColumns){
+                    isConflictColumn = isConflictColumn || conflictColumn == columnName;
+                }
+                if (!isConflictColumn){
+                    assignments += columnName + " = excluded." + columnName + ",";
+                }
+            }
+
+            if (fieldMapping.empty() || conflictColumns.empty()){
+                LOG_ERROR("Error preparing UPSERT statement: no columns to write");
+                return false;
+            }
+
+            // With only key columns mapped there is nothing to overwrite; a no-op
+            // assignment still lets RETURNING report the existing row.
+            if (assignments.empty()){
+                assignments = conflictColumns.front() + " = excluded." + conflictColumns.front() + ",";
+            }
+
+            sql.pop_back();
+            placeholders.pop_back();
+            assignments.pop_back();
+
+            sql += ")" + placeholders + ") ON CONFLICT (";
+            for (const std::string &conflictColumn : conflictColumns){
+                sql += conflictColumn + ",";
+            }
+            sql.pop_back();
+            sql += ")";
+            // Matches the partial natural-key indexes, so a tombstone with the
+            // same key is left alone and a live row is inserted next to it.
+            if (isSoftDeleteTable(tableName)){
+                sql += " WHERE deleted_at IS NULL";
+            }
+            sql += " DO UPDATE SET " + assignments;
+            if (returnedId){
+                sql += " RETURNING id";
+            }
+            sql += ";";
+
+            CapturedOperation captured(*this, TraceOp::Upsert, tableName);
+            if (captured){
+                captured.record.keys = conflictColumns;
+            }
+            sqlite3_stmt *stmt = prepareCached(sql);
+            if (!stmt){
+                LOG_ERROR("Error preparing UPSERT statement: %s", sqlite3_errmsg(db));
+                return false;
+            }
+
+            int index = 1;
+            for (auto &[columnName, getter] : fieldMapping){
+                if (isDerivedColumn(tableName, columnName)){
+                    continue;
                 }
+                FieldValue value = getter(data);
+                bindValue(stmt, index++, value);
+                captured.column(columnName, value);
+            }
+
+            int result = step(stmt);
+            if (returnedId && result == SQLITE_ROW){
+                *returnedId = sqlite3_column_int64(stmt, 0);
+                result = sqlite3_step(stmt);
             }
 
-            if (sqlite3_step(stmt) != SQLITE_DONE){
-                std::cerr << "Error executing INSERT statement: " << sqlite3_errmsg(db) << std::endl;
-                sqlite3_finalize(stmt);
+            if (result != SQLITE_DONE){
+                LOG_ERROR("Error executing UPSERT statement: %s", sqlite3_errmsg(db));
+                releaseCached(stmt);
                 return false;
             }
 
-            sqlite3_finalize(stmt);
+            releaseCached(stmt);
+            captured.succeeded();
             return true;
         }
 
+        /**
+         * @brief Upserts a batch of records inside a single transaction.
+         * 
+         * All rows share one cached statement and one commit, which is what makes bulk
+         * synchronization fast. If any row fails, the whole batch is rolled back.
+         * 
+         * @param tableName The name of the table to write to.
+         * 
+         * @param conflictColumns The columns identifying an existing row; see upsert().
+         * 
+         * @param rows The data objects to write.
+         * 
+         * @param fieldMapping The column mapping shared by all rows.
+         * 
+         * @param returnedIds When not null, receives the id of every written row, in
+         *                    the order of rows.
+         * 
+         * @return true if every row was written; false if the batch was rolled back.
+         */
+        template <typename T>
+        bool upsertMany(const std::string &tableName, const std::vector<std::string> &conflictColumns, const std::vector<T> &rows, const FieldMapping<T> &fieldMapping, std::vector<sqlite3_int64> *returnedIds = nullptr){
+            return transaction([&]{
+                if (returnedIds){
+                    returnedIds->clear();
+                    returnedIds->reserve(rows.size());
+                }
+
+                for (const T &row : rows){
+                    sqlite3_int64 id = 0;
+                    if (!upsert(tableName, conflictColumns, row, fieldMapping, returnedIds ? &id : nullptr)){
+                        return false;
+                    }
+                    if (returnedIds){
+                        returnedIds->push_back(id);
+                    }
+                }
+                return true;
+            });
+        }
+
+        /**
+         * @brief Runs a unit of work atomically.
+         * 
+         * The outermost call opens a `BEGIN IMMEDIATE` transaction, so the write lock
+         * is taken up front under the busy handler instead of failing on a lock
+         * upgrade halfway through. If the work or the commit still fails with
+         * SQLITE_BUSY or SQLITE_LOCKED, the transaction is rolled back and the work is
+         * run again after a backoff, so it must be safe to re-run. Nested calls use a
+         * savepoint and leave retrying to the outermost call. The changes are kept if
+         * the work returns true and rolled back if it returns false.
+         * 
+         * @param work The function performing the database operations.
+         * 
+         * @return true if the work succeeded and was committed; false otherwise.
+         */
+        bool transaction(const std::function<bool()> &work);
+
+        /**
+         * @brief Returns the result code that made the last transaction() fail.
+         * 
+         * SQLITE_OK when it committed; otherwise the extended code of the call
+         * that failed, whether in the work, at BEGIN or at COMMIT. Read this
+         * rather than sqlite3_errcode() after a failed transaction: the rollback
+         * that follows the failure resets the connection's error code.
+         */
+        int lastTransactionError() const;
 
         /**
          * @brief Updates an existing record in the specified table.
@@ -158,62 +746,60 @@ class Database {
          * 
          * @param fieldMapping A map that associates column names in the table with
          *                     functions that retrieve the corresponding values from the
-         *                     data object. The functions should return a variant type
-         *                     containing either a string, int, or double.
+         *                     data object. The functions return a FieldValue: a
+         *                     string, int, sqlite3_int64, double or Money.
          * 
          * @return true if the update operation was successful; false otherwise. 
          * 
          * This method prepares the SQL statement, binds the values to the placeholders,
          * and executes the UPDATE operation. If any errors occur during preparation or
-         * execution, an error message is printed to standard error. Additionally, if no
+         * execution, an error message is written to the Logger. Additionally, if no
          * rows are affected by the update, a message is logged indicating that the ID may not exist.
          */
         template <typename T>
-        bool update(const std::string &tableName, const int &id, const T &data, const std::map<std::string, std::function<std::variant<std::string, int, double>(const T&)>> &fieldMapping){
-            std::string sql = "UPDATE "+ tableName +" SET ";
+        bool update(const std::string &tableName, const int &id, const T &data, const FieldMapping<T> &fieldMapping){
+            std::vector<std::string> columns;
             for (auto &[columnName, getter] : fieldMapping){
-                sql += columnName + "?, ";
-            }
-
-            sql.pop_back();
-            sql.pop_back();
-            sql += " WHERE id = ?;";
-
-            sqlite3_stmt *stmt;
-            if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK){
-                std::cerr << "Error preparing UPDATE statement: " << sqlite3_errmsg(db) << std::endl;
-                return false;
-            }
-
-            int index = 1;
-
-            for(auto &[columnName, getter] : fieldMapping){
-                std::variant<std::string, int, double> value = getter(data);
-                
-                if(std::holds_alternative<int>(value)){
-                    sqlite3_bind_int(stmt, index++, std::get<int>(value));
-                }else if(std::holds_alternative<double>(value)){
-                    sqlite3_bind_double(stmt, index++, std::get<double>(value));
-                }else if(std::holds_alternative<std::string>(value)){
-                    const std::string &strValue = std::get<std::string>(value);
-                    sqlite3_bind_text(stmt, index++, strValue.c_str(), -1, SQLITE_STATIC);
+                if (!isDerivedColumn(tableName, columnName)){
+                    columns.push_back(columnName);
                 }
             }
+            return updateColumns(tableName, id, data, fieldMapping, columns);
+        }
 
-            sqlite3_bind_int(stmt, index++, id);
-
-            if (sqlite3_step(stmt) != SQLITE_DONE){
-                std::cerr << "Error executing update statement: " << sqlite3_errmsg(db) << std::endl;
-                sqlite3_finalize(stmt);
-                return false;
+        /**
+         * @brief Writes only the modified fields of a tracked record.
+         * 
+         * The UPDATE statement lists just the columns reported dirty by the tracked
+         * record, so unchanged columns are neither rewritten nor trigger `UPDATE OF`
+         * triggers, and fewer index and WAL pages are touched. One statement is cached
+         * per distinct column subset. When nothing changed no statement is executed.
+         * On success the tracked record's baseline is reset to its current value.
+         * 
+         * @tparam T The type of the tracked data object.
+         * 
+         * @param tableName The name of the table where the record will be updated.
+         * 
+         * @param id The unique identifier of the record to be updated.
+         * 
+         * @param record The tracked record holding the original and current values.
+         * 
+         * @param fieldMapping The column mapping used to compare and bind fields.
+         * 
+         * @return true if the update succeeded or nothing had changed; false otherwise.
+         */
+        template <typename T>
+        bool update(const std::string &tableName, const int &id, Tracked<T> &record, const FieldMapping<T> &fieldMapping){
+            std::vector<std::string> columns = record.dirtyColumns(fieldMapping);
+            std::erase_if(columns, [&](const std::string &columnName){ return isDerivedColumn(tableName, columnName); });
+            if (columns.empty()){
+                return true;
             }
 
-            int changes = sqlite3_changes(db);
-            if (changes == 0) {
-                std::cerr << "No rows were updated. Check if the ID exists." << std::endl;
+            if (!updateColumns(tableName, id, record.get(), fieldMapping, columns)){
+                return false;
             }
-
-            sqlite3_finalize(stmt);
+            record.commit();
             return true;
         }
 
@@ -232,10 +818,116 @@ class Database {
          * @return true if the remove operation was successful; false otherwise.
          * 
          * If any errors occur during the execution of the DELETE statement, an error message
-         * is printed to standard error. Additionally, if no rows are affected by the delete,
+         * is written to the Logger. Additionally, if no rows are affected by the delete,
          * a message is logged indicating that the ID may not exist.
          */
         bool remove(const std::string &tableName, const int &id);
+
+        /**
+         * @brief Marks a record as deleted without removing it.
+         * 
+         * Sets the `deleted_at` column of an `item`, `category` or `suppliers` row to
+         * the current time. The row stays in place, so no foreign key checks run
+         * against the ledger; listings skip it through the partial indexes on live
+         * rows, and the Compactor purges it later in small background transactions.
+         * Its natural key is free again at once, for insert() and upsert().
+         * 
+         * @param tableName The name of the table holding the record.
+         * 
+         * @param id The unique identifier of the record to mark.
+         * 
+         * @return true if the statement executed successfully; false otherwise.
+         */
+        bool softRemove(const std::string &tableName, const int &id);
+
+        /**
+         * @brief Clears the deleted mark set by softRemove().
+         * 
+         * Fails with a constraint error if a live row has taken the record's
+         * natural key in the meantime.
+         * 
+         * @param tableName The name of the table holding the record.
+         * 
+         * @param id The unique identifier of the record to restore.
+         * 
+         * @return true if the statement executed successfully; false otherwise.
+         */
+        bool restore(const std::string &tableName, const int &id);
+
+        /**
+         * @brief Runs a query and collects every row it returns.
+         * 
+         * Integer columns are read as sqlite3_int64 (as Money when declared
+         * MONEY), floating-point columns as double and text or blob columns as
+         * string; NULL columns are omitted from the row.
+         * The statement is kept in the statement cache, so repeated queries
+         * should use parameters rather than literal values.
+         * 
+         * @param sql The SQL query, with `?` placeholders for the parameters.
+         * 
+         * @param parameters Values bound to the placeholders, in order.
+         * 
+         * @param rows Receives the rows; cleared first.
+         * 
+         * @return true if the query ran to completion; false otherwise.
+         */
+        bool query(const std::string &sql, const std::vector<FieldValue> &parameters, std::vector<Row> &rows);
+
+        /**
+         * @brief Removes a set of records, and optionally the rows that depend on them.
+         * 
+         * The ids are loaded into a temporary table and every statement works on the
+         * whole set at once (`WHERE ... IN (SELECT id FROM temp table)`), inside a
+         * single transaction. Before deleting anything, the foreign keys pointing at
+         * the table are followed to collect the dependent rows of `item`,
+         * `transaction_records` and any other referencing table. Without cascade the
+         * operation is refused if such rows exist, other than rows of a
+         * self-referencing table removed in the same call; with cascade the
+         * dependents are deleted first, so foreign key enforcement never has to
+         * reject a statement. Cascading follows the tables in topological order, so
+         * a table referenced through two parents (supplier_prices, through
+         * suppliers and item) is collected from both before it is followed further
+         * and deleted before either. A table that references itself, as category
+         * does through parent_id, is followed down to its deepest rows first, so a
+         * cascading removal takes the whole subtree and everything that refers to
+         * it. Tables that reference each other in a cycle are refused. The
+         * child-key indexes created by init() keep each of these lookups an index
+         * search instead of a table scan.
+         * 
+         * Foreign keys declared with an ON DELETE action are left to SQLite.
+         * 
+         * @param tableName The name of the table from which the records will be deleted.
+         * 
+         * @param ids The ids of the records to remove. Unknown ids are ignored.
+         * 
+         * @param cascade Whether dependent rows are removed too.
+         * 
+         * @param removedCount When not null, receives the number of rows removed
+         *                     from tableName.
+         * 
+         * @return true if the records were removed; false if dependents blocked the
+         *         removal or an error occurred, in which case nothing is removed.
+         */
+        bool removeMany(const std::string &tableName, const std::vector<int> &ids, bool cascade = false, size_t *removedCount = nullptr);
+
+        /**
+         * @brief Describes a foreign key column that references another table's id.
+         */
+        struct ForeignKeyReference {
+            std::string table;
+            std::string column;
+        };
+
+        /**
+         * @brief Lists the foreign keys that reference the given table without an ON DELETE CASCADE or SET action.
+         * 
+         * @param connection The connection whose schema is inspected.
+         * 
+         * @param tableName The referenced (parent) table.
+         * 
+         * @return One entry per referencing (child table, column) pair.
+         */
+        static std::vector<ForeignKeyReference> referencingTables(sqlite3 *connection, const std::string &tableName);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,229 @@
+#ifndef DB_EXECUTOR_HPP
+#define DB_EXECUTOR_HPP
+
+#include "database.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Outcome of an operation run by a DbExecutor.
+ */
+enum class DbStatus {
+    Ok,
+    Failed,
+    Cancelled
+};
+
+/**
+ * @brief Result of an awaited database operation.
+ */
+struct DbResult {
+    DbStatus status = DbStatus::Failed;
+
+    /**
+     * @brief Rows returned by a query; empty for writes.
+     */
+    std::vector<Row> rows;
+
+    bool ok() const { return status == DbStatus::Ok; }
+};
+
+/**
+ * @brief Handle used to cancel an operation queued on or running in a DbExecutor.
+ *
+ * A default-constructed token cannot be cancelled and costs nothing; create()
+ * makes one that can. Tokens are cheap to copy and may be shared by several
+ * operations, which are then cancelled together.
+ */
+class CancellationToken {
+    private :
+        std::shared_ptr<std::atomic<bool>> flag;
+
+        friend class DbExecutor;
+
+    public :
+        CancellationToken() = default;
+
+        /**
+         * @brief Returns a token that can be passed to DbExecutor::cancel().
+         */
+        static CancellationToken create();
+
+        /**
+         * @brief Returns true once the token was cancelled.
+         */
+        bool cancelled() const;
+};
+
+class DbExecutor;
+
+/**
+ * @brief Awaitable returned by the DbExecutor operations.
+ *
+ * Awaiting it queues the work on the executor's thread and suspends the
+ * coroutine; the coroutine is resumed with the DbResult once the work has
+ * run, been cancelled or been discarded because the executor shut down.
+ * The operation only starts when awaited; once the executor is shutting
+ * down it is not queued, and the coroutine continues at once with Cancelled.
+ */
+class DbOperation {
+    private :
+        DbExecutor &executor;
+        std::function<bool(Database&, std::vector<Row>&)> work;
+        CancellationToken token;
+        DbResult result;
+        std::coroutine_handle<> caller;
+
+        friend class DbExecutor;
+
+    public :
+        DbOperation(DbExecutor &executor, std::function<bool(Database&, std::vector<Row>&)> work, CancellationToken token);
+
+        bool await_ready() const noexcept { return false; }
+        /**
+         * @brief Queues the operation; returns false, resuming at once with Cancelled, after shutdown began.
+         */
+        bool await_suspend(std::coroutine_handle<> handle);
+        DbResult await_resume() { return std::move(result); }
+};
+
+/**
+ * @brief Runs database operations for coroutines on a dedicated thread.
+ *
+ * The executor owns a Database connection, initialised with Database::init(),
+ * and a worker thread that takes the awaited operations from a FIFO queue and
+ * runs them one at a time. Callers never block: any number of coroutines may
+ * await operations concurrently, and a handful of executors (one connection
+ * each) can serve thousands of logical requests.
+ *
+ * When an operation completes, the awaiting coroutine is handed to the
+ * resumer given at construction, typically a function posting it to the
+ * caller's event loop. Without a resumer the coroutine resumes on the
+ * executor's thread and must not block it.
+ *
+ * Cancelling a token skips its queued operations and interrupts a running
+ * one through sqlite3_interrupt() and a progress handler, so an interrupted
+ * write is rolled back by SQLite.
+ *
+ * GCC 12 mishandles temporaries created inside a co_await operand, so pass
+ * named objects: `Item item{...}; co_await executor.insert("item", item, mapping);`.
+ */
+class DbExecutor {
+    public :
+        using Resumer = std::function<void(std::coroutine_handle<>)>;
+
+    private :
+        Database database;
+        Resumer resumer;
+
+        std::deque<DbOperation*> queue;
+        std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        bool stopping = false;
+
+        /**
+         * @brief Cancellation flag of the operation being run; written under runningMutex.
+         */
+        std::atomic<bool> *running = nullptr;
+        std::mutex runningMutex;
+
+        std::thread worker;
+
+        /**
+         * @brief Progress handler that aborts the running statement once its token is cancelled.
+         */
+        static int progress(void *context);
+
+        /**
+         * @brief Hands a finished operation's coroutine to the resumer.
+         */
+        void complete(DbOperation &operation, DbStatus status);
+
+        /**
+         * @brief Body of the worker thread.
+         */
+        void run();
+
+    public :
+        /**
+         * @brief Opens the executor's connection and starts its thread.
+         *
+         * @param dbName Path of the database file.
+         * @param resumer Called with each coroutine to resume; resumes inline when empty.
+         */
+        explicit DbExecutor(const std::string &dbName, Resumer resumer = nullptr);
+
+        /**
+         * @brief Finishes the running operation, resumes the queued ones as Cancelled and stops the thread.
+         *
+         * Operations awaited from then on, including by the coroutines
+         * resumed here, complete as Cancelled without being queued.
+         */
+        ~DbExecutor();
+
+        DbExecutor(const DbExecutor&) = delete;
+        DbExecutor &operator=(const DbExecutor&) = delete;
+
+        /**
+         * @brief Queues an operation; called by DbOperation::await_suspend().
+         *
+         * @return false, with the operation marked Cancelled, once the
+         *         destructor has started; the caller is then not resumed.
+         */
+        bool submit(DbOperation &operation);
+
+        /**
+         * @brief Cancels every operation that carries the token.
+         */
+        void cancel(const CancellationToken &token);
+
+        /**
+         * @brief Returns the number of queued operations.
+         */
+        size_t pending();
+
+        /**
+         * @brief Awaitable Database::insert().
+         */
+        template <typename T>
+        DbOperation insert(const std::string &tableName, T data, FieldMapping<T> fieldMapping, CancellationToken token = CancellationToken()){
+            return DbOperation(*this, [tableName, data = std::move(data), fieldMapping = std::move(fieldMapping)](Database &db, std::vector<Row>&){
+                return db.insert(tableName, data, fieldMapping);
+            }, std::move(token));
+        }
+
+        /**
+         * @brief Awaitable Database::update().
+         */
+        template <typename T>
+        DbOperation update(const std::string &tableName, int id, T data, FieldMapping<T> fieldMapping, CancellationToken token = CancellationToken()){
+            return DbOperation(*this, [tableName, id, data = std::move(data), fieldMapping = std::move(fieldMapping)](Database &db, std::vector<Row>&){
+                return db.update(tableName, id, data, fieldMapping);
+            }, std::move(token));
+        }
+
+        /**
+         * @brief Awaitable Database::remove().
+         */
+        DbOperation remove(const std::string &tableName, int id, CancellationToken token = CancellationToken());
+
+        /**
+         * @brief Awaitable Database::query(); the rows are returned in DbResult::rows.
+         */
+        DbOperation query(const std::string &sql, std::vector<FieldValue> parameters = {}, CancellationToken token = CancellationToken());
+
+        /**
+         * @brief Awaitable arbitrary work on the executor's connection, e.g. a transaction().
+         */
+        DbOperation execute(std::function<bool(Database&)> work, CancellationToken token = CancellationToken());
+};
+
+#endif
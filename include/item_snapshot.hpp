@@ -0,0 +1,203 @@
+#ifndef ITEM_SNAPSHOT_HPP
+#define ITEM_SNAPSHOT_HPP
+
+#include "database.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @brief Vectorized kernels used by ItemSnapshot.
+ *
+ * Every kernel has a portable scalar implementation and, on x86-64, an AVX2
+ * implementation selected at runtime when the CPU supports it. The scalar
+ * variants are exposed so that benchmarks can compare both paths.
+ *
+ * Amounts are whole minor units (see Money). Sums are exact and
+ * overflow-checked: a kernel returns false when a running total leaves the
+ * int64 range. The AVX2 paths multiply 32-bit lanes and fall back to the
+ * scalar code when a price does not fit in 32 bits.
+ */
+namespace kernels {
+    /**
+     * @brief Returns true when the AVX2 kernels are used on this machine.
+     */
+    bool avx2Enabled();
+
+    /**
+     * @brief Computes the sum of quantities[i] * prices[i] over count rows.
+     */
+    bool sumProducts(const int *quantities, const int64_t *prices, size_t count, int64_t &total);
+    bool sumProductsScalar(const int *quantities, const int64_t *prices, size_t count, int64_t &total);
+
+    /**
+     * @brief Computes the plain sum of count values.
+     */
+    bool sum(const int64_t *values, size_t count, int64_t &total);
+    bool sumScalar(const int64_t *values, size_t count, int64_t &total);
+
+    /**
+     * @brief Appends to positions the index of every value strictly below threshold.
+     */
+    void collectBelow(const int *values, size_t count, int threshold, std::vector<size_t> &positions);
+    void collectBelowScalar(const int *values, size_t count, int threshold, std::vector<size_t> &positions);
+
+    /**
+     * @brief Writes quantities[i] * prices[i] into products[i] for count rows.
+     */
+    bool multiply(const int *quantities, const int64_t *prices, int64_t *products, size_t count);
+    bool multiplyScalar(const int *quantities, const int64_t *prices, int64_t *products, size_t count);
+}
+
+/**
+ * @brief Struct-of-arrays copy of the `item` table for dashboard aggregates.
+ *
+ * The snapshot keeps the numeric columns of every item in contiguous arrays so
+ * that valuation, per-category totals and low-stock scans run as tight vectorized
+ * loops instead of SQL queries. It subscribes to the change stream of the Database
+ * it was created from; refresh() drains the committed events and re-reads only the
+ * rows they name, so the snapshot stays current without reloading the whole table.
+ *
+ * Changes made through other connections are not observed; call load() to
+ * resynchronize after such writes.
+ */
+class ItemSnapshot {
+    private :
+        /**
+         * @brief The database the snapshot mirrors.
+         */
+        Database &database;
+
+        /**
+         * @brief Subscription on the database change stream.
+         */
+        std::unique_ptr<ChangeSubscription> subscription;
+
+        /**
+         * @brief Scratch buffer for events drained from the subscription.
+         */
+        std::vector<ChangeEvent> events;
+
+        /**
+         * @brief Column arrays, one element per item, all in the same row order.
+         */
+        std::vector<sqlite3_int64> ids;
+        std::vector<int> categoryIds;
+        std::vector<int> supplierIds;
+        std::vector<int> quantities;
+        std::vector<int64_t> unitPrices;
+        std::vector<int64_t> prices;
+
+        /**
+         * @brief Maps an item id to its position in the column arrays.
+         */
+        std::unordered_map<sqlite3_int64, size_t> positions;
+
+        /**
+         * @brief Ids of items changed since the last refresh().
+         */
+        std::unordered_set<sqlite3_int64> pendingRows;
+
+        /**
+         * @brief Writes one row into the column arrays, appending it if it is new.
+         */
+        void storeRow(sqlite3_int64 id, int categoryId, int supplierId, int quantity, int64_t unitPrice, int64_t price);
+
+        /**
+         * @brief Removes the row at the given position by moving the last row into its slot.
+         */
+        void eraseRow(size_t position);
+
+        /**
+         * @brief Drops every row from the column arrays.
+         */
+        void clear();
+
+    public :
+        /**
+         * @brief Creates an empty snapshot attached to the given database.
+         *
+         * The snapshot starts tracking changes immediately but holds no rows
+         * until load() is called.
+         *
+         * @param database The database whose `item` table is mirrored. It must
+         *                 outlive the snapshot.
+         */
+        explicit ItemSnapshot(Database &database);
+
+        ItemSnapshot(const ItemSnapshot&) = delete;
+        ItemSnapshot &operator=(const ItemSnapshot&) = delete;
+
+        /**
+         * @brief Reloads every row of the `item` table.
+         *
+         * @return true if the table was read successfully; false otherwise.
+         */
+        bool load();
+
+        /**
+         * @brief Applies the rows changed since the previous refresh.
+         *
+         * Each changed id is re-read from the database; ids that no longer exist
+         * are removed from the snapshot. When more than a quarter of the table
+         * changed, or when the subscription overflowed and events were lost, a full
+         * load() is performed instead.
+         *
+         * @return The number of changed rows that were applied.
+         */
+        size_t refresh();
+
+        /**
+         * @brief Returns the number of items currently held.
+         */
+        size_t size() const;
+
+        /**
+         * @brief Computes SUM(quantity * unit_price) over all items.
+         *
+         * @return false if the total overflows.
+         */
+        bool totalValuation(Money &total) const;
+
+        /**
+         * @brief Computes SUM(price) over all items.
+         *
+         * @return false if the total overflows.
+         */
+        bool totalPrice(Money &total) const;
+
+        /**
+         * @brief Computes SUM(quantity * unit_price) grouped by category_id.
+         *
+         * @return false if a product or a category total overflows.
+         */
+        bool valuationByCategory(std::map<int, Money> &totals) const;
+
+        /**
+         * @brief Returns SUM(quantity) grouped by category_id.
+         */
+        std::map<int, long long> quantityByCategory() const;
+
+        /**
+         * @brief Returns the ids of items whose quantity is below the threshold.
+         *
+         * @param threshold Items with quantity < threshold are reported.
+         */
+        std::vector<sqlite3_int64> lowStock(int threshold) const;
+
+        /**
+         * @brief Read-only access to the raw column arrays.
+         */
+        const std::vector<sqlite3_int64> &itemIds() const { return ids; }
+        const std::vector<int> &itemCategoryIds() const { return categoryIds; }
+        const std::vector<int> &itemSupplierIds() const { return supplierIds; }
+        const std::vector<int> &itemQuantities() const { return quantities; }
+        const std::vector<int64_t> &itemUnitPrices() const { return unitPrices; }
+        const std::vector<int64_t> &itemPrices() const { return prices; }
+};
+
+#endif
@@ -0,0 +1,267 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Severity of a log record, from least to most severe.
+ */
+enum class LogLevel : int {
+    Debug = 0,
+    Info = 1,
+    Warning = 2,
+    Error = 3,
+    Off = 4
+};
+
+/**
+ * @brief Per-call-site state used to rate limit repeated messages.
+ *
+ * One instance is created as a function-local static by every LOG_* macro.
+ * Within each window at most Logger::burstPerWindow records of the site are
+ * kept; the rest are counted and reported with the first record of the next
+ * window.
+ */
+struct LogSite {
+    const char *file;
+    int line;
+    std::atomic<int64_t> windowStart{0};
+    std::atomic<uint32_t> emitted{0};
+    std::atomic<uint32_t> suppressed{0};
+
+    LogSite(const char *file, int line) : file(file), line(line){}
+};
+
+/**
+ * @brief A formatted log record; fixed size so that rings never allocate.
+ */
+struct LogRecord {
+    static constexpr size_t messageCapacity = 224;
+
+    int64_t timestamp;
+    const char *file;
+    int line;
+    uint32_t thread;
+    LogLevel level;
+    char message[messageCapacity];
+};
+
+/**
+ * @brief Bounded single-producer/single-consumer ring of log records.
+ *
+ * The producer is the thread that owns the ring and the consumer is the
+ * flusher thread. A full ring drops the new record and counts it; logging
+ * never blocks the caller.
+ */
+class LogRing {
+    private :
+        std::vector<LogRecord> slots;
+        size_t mask;
+
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+        alignas(64) std::atomic<uint64_t> droppedRecords{0};
+
+    public :
+        /**
+         * @brief Set by the owning thread when it exits; the flusher then frees the ring once drained.
+         */
+        std::atomic<bool> closed{false};
+
+        /**
+         * @brief Creates a ring able to hold at least capacity records.
+         *
+         * @param capacity Requested capacity, rounded up to a power of two.
+         */
+        explicit LogRing(size_t capacity);
+
+        /**
+         * @brief Reserves the next slot; called by the producer only.
+         *
+         * @return The slot to fill, or nullptr if the ring is full.
+         */
+        LogRecord *claim();
+
+        /**
+         * @brief Makes the slot returned by claim() visible to the consumer.
+         */
+        void publish();
+
+        /**
+         * @brief Moves all queued records into out; called by the consumer only.
+         *
+         * @return The number of records appended to out.
+         */
+        size_t drain(std::vector<LogRecord> &out);
+
+        /**
+         * @brief Returns and resets the number of records dropped because the ring was full.
+         */
+        uint64_t takeDropped();
+
+        /**
+         * @brief Returns true if no records are queued.
+         */
+        bool empty() const;
+};
+
+/**
+ * @brief Process-wide asynchronous logger.
+ *
+ * Every thread formats its records into its own LogRing, so logging takes no
+ * lock and performs no I/O on the caller's thread. A background flusher
+ * drains the rings, orders the batch by timestamp and writes it to the output
+ * stream with a single flush per batch. Records below the minimum level are
+ * rejected before formatting, and repeated records from one call site are rate
+ * limited (see LogSite).
+ *
+ * Use the LOG_DEBUG, LOG_INFO, LOG_WARNING and LOG_ERROR macros rather than
+ * calling log() directly. Defining LOG_STRIP_DEBUG at compile time removes
+ * LOG_DEBUG statements entirely.
+ */
+class Logger {
+    private :
+        struct ThreadHandle;
+
+        std::atomic<int> minimumLevel{static_cast<int>(LogLevel::Info)};
+        std::atomic<uint32_t> nextThreadId{1};
+        std::atomic<uint64_t> dropped{0};
+
+        std::mutex ringsMutex;
+        std::vector<std::shared_ptr<LogRing>> rings;
+
+        std::mutex outputMutex;
+        FILE *output = stderr;
+        std::vector<LogRecord> batch;
+
+        std::thread flusher;
+        std::mutex stateMutex;
+        std::condition_variable stateCondition;
+        bool stopping = false;
+
+        Logger();
+
+        /**
+         * @brief Returns the calling thread's ring, creating it on first use.
+         */
+        LogRing &threadRing(uint32_t &threadId);
+
+        /**
+         * @brief Decides whether a record from the site may be emitted now.
+         *
+         * @param suppressedOut Set to the number of records suppressed in the previous window.
+         */
+        static bool admit(LogSite &site, int64_t now, uint32_t &suppressedOut);
+
+        /**
+         * @brief Drains every ring and writes the records; called with outputMutex held.
+         */
+        void drainAll();
+
+        /**
+         * @brief Body of the flusher thread.
+         */
+        void run();
+
+    public :
+        /**
+         * @brief Records kept per call site and window before suppression starts.
+         */
+        static constexpr uint32_t burstPerWindow = 10;
+
+        /**
+         * @brief Length of a rate-limiting window.
+         */
+        static constexpr std::chrono::milliseconds rateWindow{1000};
+
+        /**
+         * @brief How often the flusher wakes up to drain the rings.
+         */
+        static constexpr std::chrono::milliseconds flushInterval{20};
+
+        /**
+         * @brief Capacity of each thread's ring.
+         */
+        static constexpr size_t ringCapacity = 1024;
+
+        /**
+         * @brief Returns the logger, starting the flusher thread on first use.
+         */
+        static Logger &instance();
+
+        /**
+         * @brief Stops the flusher after writing every queued record.
+         */
+        ~Logger();
+
+        Logger(const Logger&) = delete;
+        Logger &operator=(const Logger&) = delete;
+
+        /**
+         * @brief Returns true if records of the given level are currently kept.
+         */
+        bool enabled(LogLevel level) const;
+
+        /**
+         * @brief Sets the minimum level of the records that are kept.
+         */
+        void setLevel(LogLevel level);
+
+        /**
+         * @brief Redirects the output; the stream is not closed by the logger.
+         */
+        void setOutput(FILE *stream);
+
+        /**
+         * @brief Formats a record into the calling thread's ring.
+         *
+         * @param level Severity of the record.
+         * @param site Call site, for rate limiting and the record's location.
+         * @param format printf-style format string; longer messages are truncated.
+         */
+        void log(LogLevel level, LogSite &site, const char *format, ...) __attribute__((format(printf, 4, 5)));
+
+        /**
+         * @brief Writes every record queued so far before returning.
+         */
+        void flush();
+
+        /**
+         * @brief Returns the number of records lost because a ring was full.
+         */
+        uint64_t droppedRecords() const;
+
+        /**
+         * @brief Does nothing; keeps stripped log statements type-checked.
+         */
+        __attribute__((format(printf, 1, 2))) static void discard(const char *, ...){}
+};
+
+#define LOG_AT(level, ...)                                                       \
+    do {                                                                         \
+        static LogSite logSite_(__FILE__, __LINE__);                             \
+        Logger &logger_ = Logger::instance();                                    \
+        if (logger_.enabled(level)){                                             \
+            logger_.log(level, logSite_, __VA_ARGS__);                           \
+        }                                                                        \
+    } while (0)
+
+#ifdef LOG_STRIP_DEBUG
+#define LOG_DEBUG(...) do { if (false){ Logger::discard(__VA_ARGS__); } } while (0)
+#else
+#define LOG_DEBUG(...) LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#endif
+
+#define LOG_INFO(...) LOG_AT(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(LogLevel::Warning, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::Error, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,281 @@
+#ifndef MAINTENANCE_HPP
+#define MAINTENANCE_HPP
+
+#include "database.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Hashed timing wheel for recurring tasks on a single thread.
+ *
+ * Time advances in fixed ticks. A task scheduled d ticks ahead is stored in
+ * slot (current + d) mod slots together with the number of full turns left,
+ * so scheduling and expiry are O(1) regardless of how many tasks are pending.
+ * The wheel is not thread-safe; it is driven by the thread that owns it.
+ */
+class TimerWheel {
+    private :
+        struct Timer {
+            uint64_t rounds;
+            std::function<void()> task;
+        };
+
+        std::chrono::milliseconds tick;
+        std::vector<std::vector<Timer>> slots;
+        uint64_t currentTick = 0;
+
+    public :
+        /**
+         * @brief Creates an empty wheel.
+         *
+         * @param tick Resolution of the wheel.
+         * @param slotCount Number of slots per turn.
+         */
+        TimerWheel(std::chrono::milliseconds tick, size_t slotCount);
+
+        /**
+         * @brief Schedules a task to run once after the given delay, rounded up to whole ticks.
+         */
+        void schedule(std::chrono::milliseconds delay, std::function<void()> task);
+
+        /**
+         * @brief Advances the wheel by one tick and runs the tasks that expired.
+         *
+         * Tasks may schedule new tasks, including themselves.
+         *
+         * @return The number of tasks run.
+         */
+        size_t advance();
+
+        /**
+         * @brief Returns the resolution of the wheel.
+         */
+        std::chrono::milliseconds resolution() const;
+};
+
+/**
+ * @brief Intervals and thresholds of the MaintenanceScheduler.
+ */
+struct MaintenanceOptions {
+    /**
+     * @brief Timer wheel resolution.
+     */
+    std::chrono::milliseconds tick{100};
+
+    /**
+     * @brief The database counts as idle when nothing was committed for this long.
+     */
+    std::chrono::milliseconds idleThreshold{5000};
+
+    /**
+     * @brief How often the WAL is checked for checkpointing.
+     */
+    std::chrono::milliseconds checkpointInterval{5000};
+
+    /**
+     * @brief Frames committed to the WAL since the last checkpoint that trigger a passive one.
+     *
+     * Checked on every tick, so this also bounds the WAL of a busy writer.
+     */
+    int passiveCheckpointFrames = 1000;
+
+    /**
+     * @brief WAL frames at which the committing connection checkpoints itself.
+     *
+     * A checkpoint that runs while the writer keeps appending never catches
+     * up, so the log would not restart under a steady writer. Past this size
+     * the Database's connection runs a passive checkpoint right after its
+     * commit, as SQLite's automatic checkpoint would.
+     */
+    int commitCheckpointFrames = 4000;
+
+    /**
+     * @brief How often the write volume is compared with analyzeWriteThreshold.
+     */
+    std::chrono::milliseconds analyzeInterval{60000};
+
+    /**
+     * @brief Changed rows since the last ANALYZE that make statistics stale.
+     */
+    uint64_t analyzeWriteThreshold = 50000;
+
+    /**
+     * @brief Rows sampled per index by ANALYZE (PRAGMA analysis_limit), 0 for no limit.
+     */
+    int analysisLimit = 1000;
+
+    /**
+     * @brief How often PRAGMA optimize runs.
+     */
+    std::chrono::milliseconds optimizeInterval{std::chrono::hours(1)};
+};
+
+/**
+ * @brief Counters and timings of the work done by the MaintenanceScheduler.
+ */
+struct MaintenanceMetrics {
+    uint64_t observedWrites = 0;
+    uint64_t passiveCheckpoints = 0;
+    uint64_t truncateCheckpoints = 0;
+
+    /**
+     * @brief Checkpoints run by the committing connection past commitCheckpointFrames.
+     */
+    uint64_t commitCheckpoints = 0;
+    uint64_t checkpointedFrames = 0;
+    uint64_t analyzeRuns = 0;
+    uint64_t optimizeRuns = 0;
+    uint64_t busySkips = 0;
+    double lastCheckpointMs = 0.0;
+    double lastAnalyzeMs = 0.0;
+    double lastOptimizeMs = 0.0;
+};
+
+/**
+ * @brief In-process scheduler for ANALYZE, PRAGMA optimize and WAL checkpoints.
+ *
+ * One background thread drives a TimerWheel with three recurring jobs:
+ *
+ * - checkpoint: a PASSIVE checkpoint once enough frames were committed since
+ *   the last one while writes are ongoing, and a TRUNCATE checkpoint when the
+ *   database is idle so the WAL file shrinks back to zero;
+ * - statistics: ANALYZE (bounded by analysis_limit) once enough rows changed
+ *   since the previous run, deferred until the database is idle;
+ * - optimize: PRAGMA optimize at a fixed interval.
+ *
+ * Write volume and idleness are measured from the Database's change stream
+ * plus `PRAGMA data_version` for commits made by other connections. The WAL
+ * size comes from the Database's WAL hook (Database::setWalObserver()), which
+ * reports the frames in the log after every commit; the file size is no use,
+ * since a checkpoint rewinds the log without shrinking the file. The hook
+ * takes the place of that connection's automatic checkpoint until the
+ * scheduler is destroyed, falling back to a checkpoint after the commit once
+ * the log reaches commitCheckpointFrames. Other connections keep
+ * checkpointing on their own.
+ *
+ * The scheduler works through its own connection, which uses a short busy
+ * timeout and skips a job rather than stall the application.
+ */
+class MaintenanceScheduler {
+    private :
+        sqlite3 *db = nullptr;
+        MaintenanceOptions options;
+
+        /**
+         * @brief The application's Database, whose WAL observer reports walFrames.
+         */
+        Database &database;
+        std::unique_ptr<ChangeSubscription> subscription;
+        std::vector<ChangeEvent> events;
+        TimerWheel wheel;
+
+        std::thread worker;
+        std::mutex stateMutex;
+        std::condition_variable stateCondition;
+        bool stopping = false;
+
+        /**
+         * @brief Write tracking, owned by the worker thread.
+         */
+        int lastDataVersion = -1;
+        uint64_t writesSinceAnalyze = 0;
+        uint64_t writesSinceCheckpoint = 0;
+        uint64_t lastDropped = 0;
+        std::chrono::steady_clock::time_point lastActivity;
+
+        /**
+         * @brief Frames in the WAL after the latest commit, set by the WAL hook.
+         */
+        std::atomic<int> walFrames{0};
+
+        /**
+         * @brief Frames of the current WAL already copied back by a checkpoint.
+         */
+        int checkpointedUpTo = 0;
+
+        /**
+         * @brief Metrics, guarded by metricsMutex for readers on other threads.
+         */
+        mutable std::mutex metricsMutex;
+        MaintenanceMetrics currentMetrics;
+
+        /**
+         * @brief Drains the change stream and checks data_version.
+         */
+        void observeWrites();
+
+        /**
+         * @brief Returns true when nothing was committed within the idle threshold.
+         */
+        bool idle() const;
+
+        /**
+         * @brief WAL observer: records the frame count after each commit and checkpoints an oversized log.
+         */
+        void walCommitted(sqlite3 *appDb, const char *name, int frames);
+
+        /**
+         * @brief Returns true once passiveCheckpointFrames were committed since the last checkpoint.
+         */
+        bool passiveCheckpointDue();
+
+        /**
+         * @brief Runs a PASSIVE or TRUNCATE checkpoint and records it in the metrics.
+         */
+        void checkpoint(bool truncate);
+
+        /**
+         * @brief Recurring jobs; each reschedules itself.
+         */
+        void checkpointJob();
+        void analyzeJob();
+        void optimizeJob();
+
+        /**
+         * @brief Body of the worker thread.
+         */
+        void run();
+
+    public :
+        /**
+         * @brief Opens the scheduler's connection to the database file.
+         *
+         * @param database The database to maintain. Its change stream is used to
+         *                 measure write volume; it must outlive the scheduler.
+         * @param options Intervals and thresholds.
+         */
+        MaintenanceScheduler(Database &database, const MaintenanceOptions &options = MaintenanceOptions());
+
+        /**
+         * @brief Stops the worker thread and closes the connection.
+         */
+        ~MaintenanceScheduler();
+
+        MaintenanceScheduler(const MaintenanceScheduler&) = delete;
+        MaintenanceScheduler &operator=(const MaintenanceScheduler&) = delete;
+
+        /**
+         * @brief Starts the background thread.
+         */
+        void start();
+
+        /**
+         * @brief Stops the background thread.
+         */
+        void stop();
+
+        /**
+         * @brief Returns a copy of the current metrics.
+         */
+        MaintenanceMetrics metrics() const;
+};
+
+#endif
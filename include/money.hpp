@@ -0,0 +1,151 @@
+#ifndef MONEY_HPP
+#define MONEY_HPP
+
+#include <cmath>
+#include <compare>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Signed decimal amount stored as a whole number of minor units.
+ *
+ * The value is units / 10^Decimals, so with two decimals 12.50 is held as
+ * 1250. Sums and products of whole units are exact and do not depend on the
+ * order they are added in, which makes aggregates reproducible where REAL
+ * arithmetic drifts. The arithmetic is overflow-checked: add(), subtract()
+ * and multiply() return false instead of wrapping.
+ *
+ * @tparam Decimals Digits after the decimal point, 0 to 9.
+ */
+template <int Decimals>
+class FixedPoint {
+    static_assert(Decimals >= 0 && Decimals <= 9, "FixedPoint supports 0 to 9 decimals");
+
+    private :
+        int64_t units = 0;
+
+        constexpr explicit FixedPoint(int64_t units) : units(units) {}
+
+        static constexpr int64_t powerOfTen(int exponent){
+            return exponent == 0 ? 1 : 10 * powerOfTen(exponent - 1);
+        }
+
+    public :
+        static constexpr int decimals = Decimals;
+
+        /**
+         * @brief Minor units per whole unit, 10^Decimals.
+         */
+        static constexpr int64_t scale = powerOfTen(Decimals);
+
+        constexpr FixedPoint() = default;
+
+        static constexpr FixedPoint fromUnits(int64_t units){ return FixedPoint(units); }
+
+        constexpr int64_t minorUnits() const { return units; }
+
+        /**
+         * @brief Converts a floating-point amount, rounding half away from zero.
+         *
+         * @return false if the value is not finite or out of range.
+         */
+        static bool fromDouble(double value, FixedPoint &result){
+            const double scaled = std::round(value * static_cast<double>(scale));
+            if (!std::isfinite(scaled) || scaled < -9.2e18 || scaled > 9.2e18){
+                return false;
+            }
+            result.units = static_cast<int64_t>(scaled);
+            return true;
+        }
+
+        double toDouble() const { return static_cast<double>(units) / static_cast<double>(scale); }
+
+        /**
+         * @brief Parses a plain decimal such as "12", "-3.5" or "+0.05".
+         *
+         * Parsing is exact: fraction digits beyond Decimals other than zeros,
+         * exponents, separators and out-of-range amounts are rejected rather
+         * than rounded.
+         */
+        static bool parse(const std::string &text, FixedPoint &result){
+            size_t position = 0;
+            const bool negative = !text.empty() && text[0] == '-';
+            if (!text.empty() && (text[0] == '-' || text[0] == '+')){
+                ++position;
+            }
+
+            uint64_t whole = 0;
+            int digits = 0;
+            for (; position < text.size() && text[position] >= '0' && text[position] <= '9'; ++position, ++digits){
+                if (__builtin_mul_overflow(whole, 10u, &whole) || __builtin_add_overflow(whole, static_cast<uint64_t>(text[position] - '0'), &whole)){
+                    return false;
+                }
+            }
+
+            uint64_t fraction = 0;
+            int fractionDigits = 0;
+            if (position < text.size() && text[position] == '.'){
+                for (++position; position < text.size() && text[position] >= '0' && text[position] <= '9'; ++position, ++digits){
+                    // Trailing zeros beyond the scale are harmless; other digits would be lost.
+                    if (fractionDigits == Decimals){
+                        if (text[position] != '0'){
+                            return false;
+                        }
+                        continue;
+                    }
+                    fraction = fraction * 10 + static_cast<uint64_t>(text[position] - '0');
+                    ++fractionDigits;
+                }
+            }
+            if (position != text.size() || digits == 0){
+                return false;
+            }
+
+            uint64_t magnitude;
+            if (__builtin_mul_overflow(whole, static_cast<uint64_t>(scale), &magnitude) ||
+                __builtin_add_overflow(magnitude, fraction * static_cast<uint64_t>(powerOfTen(Decimals - fractionDigits)), &magnitude) ||
+                magnitude > static_cast<uint64_t>(INT64_MAX) + (negative ? 1 : 0)){
+                return false;
+            }
+            result.units = negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+            return true;
+        }
+
+        /**
+         * @brief Formats the amount with exactly Decimals fraction digits, e.g. "-3.50".
+         */
+        std::string toString() const{
+            uint64_t magnitude = units < 0 ? 0 - static_cast<uint64_t>(units) : static_cast<uint64_t>(units);
+            std::string text = std::to_string(magnitude / static_cast<uint64_t>(scale));
+            if (Decimals > 0){
+                std::string fraction = std::to_string(magnitude % static_cast<uint64_t>(scale));
+                text += '.' + std::string(static_cast<size_t>(Decimals) - fraction.size(), '0') + fraction;
+            }
+            return units < 0 ? '-' + text : text;
+        }
+
+        static bool add(FixedPoint first, FixedPoint second, FixedPoint &result){
+            return !__builtin_add_overflow(first.units, second.units, &result.units);
+        }
+
+        static bool subtract(FixedPoint first, FixedPoint second, FixedPoint &result){
+            return !__builtin_sub_overflow(first.units, second.units, &result.units);
+        }
+
+        /**
+         * @brief Multiplies by a whole factor such as a quantity.
+         */
+        static bool multiply(FixedPoint amount, int64_t factor, FixedPoint &result){
+            return !__builtin_mul_overflow(amount.units, factor, &result.units);
+        }
+
+        friend constexpr bool operator==(FixedPoint, FixedPoint) = default;
+        friend constexpr auto operator<=>(FixedPoint, FixedPoint) = default;
+};
+
+/**
+ * @brief Currency amount in cents, as stored in the MONEY columns.
+ */
+using Money = FixedPoint<2>;
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef PAGINATOR_HPP
+#define PAGINATOR_HPP
+
+#include "database.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One page of a listing and the tokens that lead to its neighbours.
+ */
+struct Page {
+    std::vector<Row> rows;
+
+    /**
+     * @brief Token of the following page; empty on the last page.
+     */
+    std::string nextToken;
+
+    /**
+     * @brief Token of the preceding page; empty on the first page.
+     */
+    std::string previousToken;
+};
+
+/**
+ * @brief Keyset (seek) pagination over one table, ordered by any column.
+ *
+ * `LIMIT/OFFSET` makes SQLite step over every skipped row, so page n costs
+ * O(n). The paginator instead remembers the (sort value, id) pair at each edge
+ * of a page and continues from it with a row-value predicate such as
+ * `(name, id) > (?, ?)`, which seeks an index on the sort column (SQLite
+ * indexes implicitly end with the rowid, so an index on `name` orders by
+ * (name, id)). Every page then costs the same, however deep it is.
+ *
+ * The constructor checks the sort column against the table's schema and
+ * creates the index if no existing index starts with it. Tables with a
+ * `deleted_at` column only list live rows, and the index created for them is
+ * partial. NULL sort values are ordered first ascending and last descending,
+ * as SQLite does.
+ *
+ * Tokens are opaque strings bound to the table, sort column and order they
+ * were issued for; a token from another listing is rejected. Rows inserted or
+ * deleted between two fetches shift neither the following nor the preceding
+ * page, since pages are anchored on keys rather than positions.
+ */
+class Paginator {
+    private :
+        Database &database;
+        std::string tableName;
+        std::string sortColumn;
+        bool descending;
+        size_t pageSize;
+
+        bool valid = false;
+        bool softDelete = false;
+        bool nullable = false;
+
+        /**
+         * @brief Resolves the sort column and makes sure an index serves it.
+         */
+        bool prepare();
+
+        /**
+         * @brief Builds the token pointing before (backward) or after (forward) a row.
+         */
+        std::string encodeToken(const Row &row, bool backward) const;
+
+        /**
+         * @brief Decodes a token issued by this listing.
+         *
+         * @return false if the token is malformed or belongs to another listing.
+         */
+        bool decodeToken(const std::string &token, bool &backward, FieldValue &value, bool &isNull, sqlite3_int64 &id) const;
+
+        /**
+         * @brief Reads pageSize + 1 rows from an anchor in either direction and fills the page.
+         */
+        bool fetchFrom(bool backward, bool anchored, const FieldValue &value, bool isNull, sqlite3_int64 id, Page &page);
+
+    public :
+        /**
+         * @brief Creates a paginator and the index it needs.
+         *
+         * @param database The database to read from; it must outlive the paginator.
+         * @param tableName The table listed.
+         * @param sortColumn The column the listing is ordered by; ties are broken by id.
+         * @param descending Whether the listing is ordered from the largest value.
+         * @param pageSize Rows per page.
+         */
+        Paginator(Database &database, const std::string &tableName, const std::string &sortColumn, bool descending = false,
+                  size_t pageSize = 50);
+
+        /**
+         * @brief Returns the first page.
+         */
+        bool first(Page &page);
+
+        /**
+         * @brief Returns the last page.
+         */
+        bool last(Page &page);
+
+        /**
+         * @brief Returns the page a token points to.
+         *
+         * @param token A nextToken or previousToken from an earlier page; an
+         *              empty token gives the first page.
+         *
+         * @return false if the token is invalid or the query failed. A token
+         *         with nothing left beyond it gives an empty page.
+         */
+        bool fetch(const std::string &token, Page &page);
+
+        /**
+         * @brief Returns the token of the rows after, or before, a row of this listing.
+         *
+         * Lets a caller that keeps a window of rows extend it from either edge
+         * without holding on to page tokens. The id may be int or
+         * sqlite3_int64; a row without one gives a token fetch() rejects.
+         */
+        std::string after(const Row &row) const { return encodeToken(row, false); }
+        std::string before(const Row &row) const { return encodeToken(row, true); }
+
+        /**
+         * @brief Returns whether the sort column exists and its index is in place.
+         */
+        bool isValid() const { return valid; }
+};
+
+#endif
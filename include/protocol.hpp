@@ -0,0 +1,137 @@
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include "batch.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Binary protocol spoken between a Server and its clients.
+ *
+ * Every message is a frame: a 4-byte little-endian length followed by that
+ * many bytes of body. A request body is the request id (4 bytes), the opcode
+ * (1 byte) and the operands; a response body is the id of the request it
+ * answers, a Status byte and a varint count of rows. Operands and rows use
+ * the wire:: encoding.
+ *
+ * Operands by opcode:
+ *
+ *     Ping       -
+ *     Get        table, id
+ *     List       table, after id, limit      rows with a larger id, in id order
+ *     Add        table, row                  answers one row holding the new id
+ *     Update     table, id, row
+ *     Remove     table, count, ids
+ *     MoveStock  item id, signed quantity, user id (0 for the default), remarks
+ *     Report     name (empty for every report)
+ *
+ * A client may send any number of requests without waiting; responses come
+ * back on the same connection in request order.
+ */
+namespace protocol {
+    enum class Opcode : uint8_t {
+        Ping,
+        Get,
+        List,
+        Add,
+        Update,
+        Remove,
+        MoveStock,
+        Report
+    };
+
+    enum class Status : uint8_t {
+        Ok,
+        Failed,
+        BadRequest
+    };
+
+    /**
+     * @brief Largest accepted frame body; a longer frame closes the connection.
+     */
+    constexpr uint32_t maxFrameSize = 16 * 1024 * 1024;
+
+    struct Request {
+        uint32_t id = 0;
+        Opcode op = Opcode::Ping;
+
+        /**
+         * @brief Operands; Get and List keep the id in ids and the table in table.
+         */
+        BatchCommand command;
+        int limit = 0;
+    };
+
+    struct Response {
+        uint32_t id = 0;
+        Status status = Status::Ok;
+        std::vector<Row> rows;
+    };
+
+    /**
+     * @brief Returns true for the opcodes that change the database.
+     */
+    bool isWrite(Opcode op);
+
+    /**
+     * @brief Appends the frame of a message to out.
+     */
+    void encode(std::string &out, const Request &request);
+    void encode(std::string &out, const Response &response);
+
+    /**
+     * @brief Decodes a frame body, without its length prefix.
+     *
+     * @return false if the body is malformed; a request's id is still set when
+     *         the body was long enough to hold it.
+     */
+    bool decode(const char *body, size_t size, Request &request);
+    bool decode(const char *body, size_t size, Response &response);
+}
+
+/**
+ * @brief Blocking client of a Server, for tools and load generators.
+ *
+ * queue() only appends to a send buffer, so a caller can pipeline many
+ * requests with one flush() and then collect the responses in order.
+ */
+class ServerClient {
+    private :
+        int fd = -1;
+        std::string input;
+        size_t inputOffset = 0;
+        std::string output;
+
+    public :
+        ServerClient() = default;
+        ~ServerClient();
+
+        ServerClient(const ServerClient&) = delete;
+        ServerClient &operator=(const ServerClient&) = delete;
+
+        /**
+         * @brief Connects to the server's socket.
+         */
+        bool connect(const std::string &socketPath);
+
+        void queue(const protocol::Request &request);
+
+        /**
+         * @brief Sends every queued request.
+         */
+        bool flush();
+
+        /**
+         * @brief Waits for the next response.
+         */
+        bool receive(protocol::Response &response);
+
+        /**
+         * @brief Sends one request and waits for its response.
+         */
+        bool call(const protocol::Request &request, protocol::Response &response);
+};
+
+#endif
@@ -0,0 +1,245 @@
+#ifndef REPLICATION_HPP
+#define REPLICATION_HPP
+
+#include "database.hpp"
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Header written in front of every shipped changeset file.
+ *
+ * Files are named after their zero-padded sequence number so that a directory
+ * listing sorts them in apply order.
+ */
+struct ChangesetHeader {
+    char magic[8];
+    uint64_t sequence;
+    int64_t createdAtMicros;
+    uint32_t rawSize;
+    uint32_t compressedSize;
+    uint32_t checksum;
+    uint32_t reserved;
+};
+
+/**
+ * @brief Replication progress of a follower relative to what has been shipped.
+ */
+struct ReplicationLag {
+    /**
+     * @brief Number of shipped changesets not yet applied.
+     */
+    uint64_t changesetsBehind = 0;
+
+    /**
+     * @brief Age in seconds of the oldest unapplied changeset, 0 when caught up.
+     */
+    double secondsBehind = 0.0;
+};
+
+/**
+ * @brief Records changes on the primary database and ships them as compressed changesets.
+ *
+ * A sqlite3session is attached to the primary connection for the replicated
+ * tables. Each call to ship() extracts the changes recorded since the previous
+ * call, compresses them with zlib and writes them atomically into the shipping
+ * directory, which followers read from. The directory stands in for the network:
+ * it may be local, network-mounted or synchronized by an external tool.
+ *
+ * ship() must be called from the thread that writes through the primary
+ * Database, between transactions.
+ */
+class ReplicationPrimary {
+    private :
+        /**
+         * @brief The primary database.
+         */
+        Database &database;
+
+        /**
+         * @brief Directory changeset files are written to.
+         */
+        std::string directory;
+
+        /**
+         * @brief Tables recorded by the session.
+         */
+        std::vector<std::string> tables;
+
+        /**
+         * @brief Session recording changes since the last shipped changeset.
+         */
+        sqlite3_session *session = nullptr;
+
+        /**
+         * @brief Sequence number given to the next shipped changeset.
+         */
+        uint64_t nextSequence = 1;
+
+        /**
+         * @brief Totals of shipped bytes before and after compression.
+         */
+        uint64_t rawBytes = 0;
+        uint64_t compressedBytes = 0;
+
+        /**
+         * @brief Compressed changesets that could not be written yet, oldest first.
+         */
+        std::deque<std::pair<ChangesetHeader, std::vector<unsigned char>>> unshipped;
+
+        /**
+         * @brief Writes the unshipped changesets to the directory in order.
+         *
+         * @return true if nothing is left unshipped; false if a write failed.
+         */
+        bool flush();
+
+        /**
+         * @brief Creates a session attached to all replicated tables.
+         *
+         * @return The new session, or nullptr on error.
+         */
+        sqlite3_session *openSession();
+
+    public :
+        /**
+         * @brief Starts recording changes on the primary.
+         *
+         * @param database The primary database. It must outlive this object.
+         * @param directory Directory that receives the changeset files; created if missing.
+         * @param tables Tables to replicate. Defaults to the catalog tables.
+         */
+        ReplicationPrimary(Database &database, const std::string &directory,
+                           const std::vector<std::string> &tables = {"category", "suppliers", "item"});
+
+        /**
+         * @brief Stops recording; changes not yet shipped are discarded.
+         */
+        ~ReplicationPrimary();
+
+        ReplicationPrimary(const ReplicationPrimary&) = delete;
+        ReplicationPrimary &operator=(const ReplicationPrimary&) = delete;
+
+        /**
+         * @brief Ships the changes recorded since the previous call.
+         *
+         * A fresh session is started before the current one is read, so changes
+         * committed concurrently are recorded by both and shipped at least once;
+         * followers resolve the duplicates through their conflict handler.
+         *
+         * A changeset that cannot be written is kept in memory and written ahead of
+         * the next one, and when the changes cannot be extracted the session
+         * keeps recording until they can, so a transient error does not lose
+         * changes.
+         *
+         * @return true if everything recorded so far has been written; false if an
+         *         error occurred.
+         */
+        bool ship();
+
+        /**
+         * @brief Returns the sequence number of the last shipped changeset, 0 if none.
+         */
+        uint64_t lastShipped() const;
+
+        /**
+         * @brief Returns the shipped volume before compression, in bytes.
+         */
+        uint64_t shippedRawBytes() const;
+
+        /**
+         * @brief Returns the shipped volume after compression, in bytes.
+         */
+        uint64_t shippedCompressedBytes() const;
+};
+
+/**
+ * @brief Applies shipped changesets to a follower database.
+ *
+ * The follower keeps the sequence number of the last applied changeset in the
+ * `replication_state` table, updated in the same transaction as the changes
+ * themselves, so a crash never applies a changeset twice or skips one.
+ *
+ * Conflicts are resolved in favour of the primary: rows that differ or already
+ * exist are replaced, and changes to rows that no longer exist or that would
+ * violate a constraint are skipped and counted. A changeset that would leave
+ * foreign key violations is not applied at all: catchUp() stops in front of
+ * it, and lag() grows, until the follower's missing rows are restored.
+ */
+class ReplicationFollower {
+    private :
+        /**
+         * @brief The follower database.
+         */
+        Database &database;
+
+        /**
+         * @brief Directory changeset files are read from.
+         */
+        std::string directory;
+
+        /**
+         * @brief Conflict counters, by resolution.
+         */
+        uint64_t replacedRows = 0;
+        uint64_t omittedRows = 0;
+
+        /**
+         * @brief Conflict handler passed to sqlite3changeset_apply.
+         */
+        static int conflictHandler(void *context, int conflict, sqlite3_changeset_iter *iterator);
+
+        /**
+         * @brief Lists the sequence numbers of changeset files in the directory, sorted.
+         */
+        std::vector<uint64_t> availableSequences() const;
+
+        /**
+         * @brief Reads, verifies and applies one changeset file.
+         */
+        bool apply(uint64_t sequence);
+
+    public :
+        /**
+         * @brief Prepares a follower database for replication.
+         *
+         * Creates the `replication_state` table if needed. The follower schema is
+         * expected to have been created with Database::init().
+         *
+         * @param database The follower database. It must outlive this object.
+         * @param directory Directory the primary ships changesets to.
+         */
+        ReplicationFollower(Database &database, const std::string &directory);
+
+        /**
+         * @brief Applies every shipped changeset newer than the last applied one.
+         *
+         * Stops at the first changeset that fails to apply.
+         *
+         * @return The number of changesets applied.
+         */
+        size_t catchUp();
+
+        /**
+         * @brief Returns the sequence number of the last applied changeset, 0 if none.
+         */
+        uint64_t appliedSequence() const;
+
+        /**
+         * @brief Returns how far the follower is behind the shipped changesets.
+         */
+        ReplicationLag lag() const;
+
+        /**
+         * @brief Returns the number of conflicting rows replaced by the primary's version.
+         */
+        uint64_t replacedConflicts() const;
+
+        /**
+         * @brief Returns the number of conflicting changes skipped.
+         */
+        uint64_t omittedConflicts() const;
+};
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef REPORT_HPP
+#define REPORT_HPP
+
+#include "money.hpp"
+#include "task_pool.hpp"
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Aggregates of a report, keyed by group (category name, supplier, month...).
+ *
+ * Every column is additive (sums and counts), so partial tables computed over
+ * disjoint partitions merge by element-wise addition. Ratios such as averages
+ * are derived by a later stage from the merged sums. Amounts are summed as
+ * whole minor units (see Money), which doubles hold exactly up to 2^53, so
+ * totals do not depend on how the rows were partitioned.
+ *
+ * A key may carry a display label after a tab ("12\tTools / Hand tools"):
+ * the part before it identifies the group, so groups with the same label
+ * stay apart. reportLabel() splits the two.
+ */
+using ReportTable = std::map<std::string, std::vector<double>>;
+
+/**
+ * @brief Merged result of every stage, keyed by stage name.
+ */
+using ReportResults = std::map<std::string, ReportTable>;
+
+/**
+ * @brief One node of a ReportDag.
+ */
+struct ReportStage {
+    std::string name;
+
+    /**
+     * @brief Stages whose results must be complete before this one starts.
+     */
+    std::vector<std::string> dependencies;
+
+    /**
+     * @brief Number of independent partitions the stage is split into; 0 uses one per pool worker.
+     */
+    int partitions = 1;
+
+    /**
+     * @brief Computes the partial table of one partition into table.
+     *
+     * Called concurrently for different partitions. The results of the
+     * dependencies are complete and may be read from inputs. Returns false if
+     * a query failed (SQLITE_BUSY, a missing table...), so that a truncated
+     * table is never reported as the stage's result.
+     */
+    std::function<bool(sqlite3 *connection, int partition, int partitions, const ReportResults &inputs, ReportTable &table)> compute;
+
+    /**
+     * @brief Columns holding amounts in minor units, to be shown as Money.
+     */
+    std::vector<size_t> moneyColumns;
+};
+
+/**
+ * @brief Runs report stages in dependency order, in parallel where possible.
+ *
+ * Every partition of every stage whose dependencies are done becomes a task
+ * on a TaskPool, so independent reports, and the partitions of a single
+ * report, run on different read connections at the same time. When the last
+ * partition of a stage finishes, its partial tables are merged and the
+ * stages that depend on it are released. A stage with a failed partition
+ * fails as a whole, and so does every stage that depends on it, without
+ * running.
+ */
+class ReportDag {
+    private :
+        std::vector<ReportStage> stages;
+
+        /**
+         * @brief Returns the stage indexes in a dependency-respecting order, or false on an unknown name or a cycle.
+         */
+        bool order(std::vector<size_t> &sorted, std::vector<std::vector<size_t>> &dependents) const;
+
+    public :
+        /**
+         * @brief Adds a stage; names must be unique.
+         */
+        void addStage(ReportStage stage);
+
+        /**
+         * @brief Runs every stage on the pool and waits for the results.
+         *
+         * @param pool Pool whose read connections run the stages.
+         * @param results Receives the merged table of each stage that succeeded;
+         *                failed stages have no entry.
+         * @param timings When not null, receives each stage's wall time in milliseconds,
+         *                from its first partition starting to its merge.
+         *
+         * @return false if a dependency is unknown or cyclic, in which case
+         *         nothing is run, or if any stage failed.
+         */
+        bool run(TaskPool &pool, ReportResults &results, std::map<std::string, double> *timings = nullptr) const;
+
+        /**
+         * @brief Runs every stage and partition one after another on a single connection.
+         *
+         * Failures are handled as in run(): results only holds the stages that
+         * succeeded, and false is returned if any failed.
+         */
+        bool runSequential(sqlite3 *connection, ReportResults &results) const;
+
+        /**
+         * @brief Returns true if the column of the named stage holds amounts in minor units.
+         */
+        bool isMoneyColumn(const std::string &stageName, size_t column) const;
+
+        /**
+         * @brief Adds a partial table into a merged one, column by column.
+         */
+        static void merge(ReportTable &into, const ReportTable &partial);
+};
+
+/**
+ * @brief Splits a ReportTable key into the group and its label, which is empty when the key has none.
+ */
+void reportLabel(const std::string &key, std::string &group, std::string &label);
+
+/**
+ * @brief Builds the standard inventory reports.
+ *
+ * - category_valuation: per live category, stock value, units and item
+ *   count, keyed by category id and labelled with its path from the root;
+ * - supplier_spend: per live supplier, value and units of the "in"
+ *   transactions, keyed by supplier id and labelled with its name; purchases
+ *   are valued at the item's current unit_price;
+ * - movement_history: per month and transaction type, units and transaction count;
+ * - inventory_summary: totals derived from the two value reports.
+ *
+ * category_valuation reads the category_totals table that triggers keep
+ * current, so it costs one row per category. supplier_spend and
+ * movement_history are split into id ranges of their driving table.
+ *
+ * @param partitions Partitions per report; 0 uses one per pool worker.
+ */
+ReportDag inventoryReports(int partitions = 0);
+
+/**
+ * @brief One row of mostValuableItems().
+ */
+struct ValuedItem {
+    sqlite3_int64 id = 0;
+    std::string name;
+    int quantity = 0;
+    Money value;
+};
+
+/**
+ * @brief Lists the live items with the highest stock value, most valuable first.
+ *
+ * Walks the price index backwards and stops after limit rows instead of
+ * sorting the item table.
+ *
+ * @return false if the query failed.
+ */
+bool mostValuableItems(sqlite3 *connection, int limit, std::vector<ValuedItem> &items);
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef ROW_CACHE_HPP
+#define ROW_CACHE_HPP
+
+#include "database.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Capacity and layout of a RowCache.
+ */
+struct RowCacheOptions {
+    /**
+     * @brief Approximate bytes of decoded rows kept, split evenly over the shards.
+     */
+    size_t memoryBudget = 16 * 1024 * 1024;
+
+    /**
+     * @brief Number of independently locked shards; rounded up to a power of two.
+     */
+    size_t shards = 16;
+
+    /**
+     * @brief Tables whose rows are cached, by `id`.
+     */
+    std::vector<std::string> tables = {"item", "category", "suppliers"};
+};
+
+/**
+ * @brief Hit, miss and eviction counters of a RowCache.
+ */
+struct RowCacheMetrics {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t invalidations = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+
+    double hitRate() const { return hits + misses > 0 ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0; }
+};
+
+/**
+ * @brief Sharded, memory-bounded LRU cache of decoded rows keyed by (table, id).
+ *
+ * List rendering resolves the same category and supplier ids over and over;
+ * the cache answers them without a SQLite round trip. Each (table, id) key
+ * hashes to one shard holding an LRU list under its own mutex, so lookups from
+ * different threads rarely contend. When a shard exceeds its share of the
+ * memory budget the least recently used rows are evicted. Rows are shared as
+ * immutable snapshots, so a row handed out stays valid after eviction.
+ *
+ * Coherence comes from the Database's change stream: every committed insert,
+ * update or delete on a cached table invalidates its key before the next
+ * lookup, and a lost event clears the cache. Commits made through other
+ * connections are only seen by sync(), which compares `PRAGMA data_version`.
+ *
+ * Misses are loaded through the Database, so get() and getMany() must be
+ * called from the thread that owns it; lookup() only reads the cache and may
+ * be called from any thread.
+ */
+class RowCache {
+    private :
+        struct Entry {
+            int table;
+            sqlite3_int64 id;
+            std::shared_ptr<const Row> row;
+            size_t bytes;
+        };
+
+        struct Shard {
+            std::mutex mutex;
+            std::list<Entry> lru;
+            std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+            size_t bytes = 0;
+        };
+
+        Database &database;
+        RowCacheOptions options;
+        std::vector<std::unique_ptr<Shard>> shards;
+        size_t shardMask;
+        size_t shardBudget;
+
+        std::unique_ptr<ChangeSubscription> subscription;
+        std::vector<ChangeEvent> events;
+        std::mutex eventsMutex;
+        sqlite3_int64 lastDataVersion = -1;
+
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> evictions{0};
+        std::atomic<uint64_t> invalidations{0};
+
+        /**
+         * @brief Returns the position of a table in options.tables, or -1 if it is not cached.
+         */
+        int tableIndex(const std::string &tableName) const;
+        int tableIndex(const char *tableName) const;
+
+        static uint64_t key(int table, sqlite3_int64 id);
+        Shard &shardFor(uint64_t key);
+
+        /**
+         * @brief Estimates the heap footprint of a decoded row.
+         */
+        static size_t rowBytes(const Row &row);
+
+        /**
+         * @brief Inserts or replaces a row and evicts until the shard fits its budget.
+         */
+        void store(int table, sqlite3_int64 id, std::shared_ptr<const Row> row);
+
+        /**
+         * @brief Drops one key, if cached.
+         */
+        void invalidate(int table, sqlite3_int64 id);
+
+        /**
+         * @brief Applies the committed changes published since the last call.
+         */
+        void drainChanges();
+
+    public :
+        /**
+         * @brief Creates an empty cache attached to the database's change stream.
+         *
+         * @param database The database the rows are read from; it must outlive the cache.
+         * @param options Memory budget, shard count and cached tables.
+         */
+        RowCache(Database &database, const RowCacheOptions &options = RowCacheOptions());
+
+        RowCache(const RowCache&) = delete;
+        RowCache &operator=(const RowCache&) = delete;
+
+        /**
+         * @brief Returns the row, loading and caching it on a miss.
+         *
+         * @return The row, or nullptr if it does not exist or the table is not cached.
+         */
+        std::shared_ptr<const Row> get(const std::string &tableName, sqlite3_int64 id);
+
+        /**
+         * @brief Returns the rows of several ids, loading all misses with a single query.
+         *
+         * @return One entry per id, in the same order; nullptr for missing rows.
+         */
+        std::vector<std::shared_ptr<const Row>> getMany(const std::string &tableName, const std::vector<sqlite3_int64> &ids);
+
+        /**
+         * @brief Returns the cached row without touching the database.
+         */
+        std::shared_ptr<const Row> lookup(const std::string &tableName, sqlite3_int64 id);
+
+        /**
+         * @brief Applies pending change events and clears the cache if another connection committed.
+         *
+         * Call it once per screen refresh rather than per lookup.
+         */
+        void sync();
+
+        /**
+         * @brief Drops every cached row.
+         */
+        void clear();
+
+        /**
+         * @brief Returns the counters and current size.
+         */
+        RowCacheMetrics metrics();
+};
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+
+#include <sqlite3.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Tuning knobs of a SearchEngine.
+ */
+struct SearchOptions {
+    /**
+     * @brief Maximum number of hits returned per query.
+     */
+    size_t limit = 50;
+
+    /**
+     * @brief Hits published as soon as they are found, before the rest of the query runs.
+     */
+    size_t firstBatch = 10;
+
+    /**
+     * @brief How long the worker waits for another keystroke before querying.
+     */
+    std::chrono::milliseconds debounce{4};
+
+    /**
+     * @brief VM instructions between two checks for a superseding query.
+     */
+    int progressInterval = 1000;
+};
+
+/**
+ * @brief One item matching a search.
+ */
+struct SearchHit {
+    sqlite3_int64 id;
+    std::string name;
+    std::string sku;
+};
+
+/**
+ * @brief Hits of one query; published once or more as they accumulate.
+ */
+struct SearchResults {
+    /**
+     * @brief Generation returned by the submit() call this answers.
+     */
+    uint64_t generation = 0;
+    std::string query;
+    std::vector<SearchHit> hits;
+
+    /**
+     * @brief false while more hits may follow for the same generation.
+     */
+    bool complete = false;
+};
+
+/**
+ * @brief Search-as-you-type over item names and SKUs on a background thread.
+ *
+ * submit() only records the text and returns; a worker thread with its own
+ * read-only connection runs the query. A query made only of digits matches
+ * SKU prefixes, anything else matches name prefixes case-insensitively. Both
+ * are index range scans: names through the NOCASE index created by
+ * Database::init(), SKUs through the SKU index. Hits are ordered by the
+ * matched column, and the first few are published before the query finishes.
+ *
+ * Each keystroke supersedes the previous query: a progress handler aborts the
+ * running statement as soon as a newer generation is submitted, and the worker
+ * waits briefly (the debounce) for typing to settle before it starts. When the
+ * new text extends the previous one, the previous hits are filtered instead of
+ * re-read: they are already the first matches of the longer prefix, so they
+ * are published immediately and SQL only continues after the last of them,
+ * or not at all when the previous query had found every match.
+ *
+ * Results are delivered to the listener, on the worker thread, and kept for
+ * poll(). They carry the generation of the submit() they answer, and a query
+ * superseded while it runs is abandoned instead of finishing.
+ */
+class SearchEngine {
+    public :
+        using Listener = std::function<void(const SearchResults &results)>;
+
+    private :
+        /**
+         * @brief Which column a query matches.
+         */
+        enum class Field {
+            Name,
+            Sku
+        };
+
+        /**
+         * @brief The last completed query, reused when the next one extends it.
+         */
+        struct Previous {
+            bool valid = false;
+            Field field = Field::Name;
+            std::string prefix;
+            std::vector<SearchHit> hits;
+            bool exhausted = false;
+        };
+
+        SearchOptions options;
+        Listener listener;
+        sqlite3 *db = nullptr;
+        sqlite3_stmt *nameStatement = nullptr;
+        sqlite3_stmt *skuStatement = nullptr;
+
+        std::mutex queryMutex;
+        std::condition_variable condition;
+        std::string pendingQuery;
+        bool stopping = false;
+        std::atomic<uint64_t> generation{0};
+        uint64_t runningGeneration = 0;
+
+        SearchResults latest;
+        uint64_t polledGeneration = 0;
+        size_t polledHits = 0;
+        bool polledComplete = false;
+
+        Previous previous;
+        std::atomic<uint64_t> cancelled{0};
+        std::atomic<uint64_t> reused{0};
+
+        std::thread worker;
+
+        static int progress(void *context);
+
+        /**
+         * @brief Body of the worker thread.
+         */
+        void run();
+
+        /**
+         * @brief Runs one query and publishes its hits; false if it was superseded.
+         */
+        bool search(const std::string &query, uint64_t queryGeneration);
+
+        void publish(const SearchResults &results);
+
+    public :
+        /**
+         * @brief Opens a read-only connection and starts the worker.
+         *
+         * @param dbName Path of the database file, initialized by Database::init().
+         * @param listener Called on the worker thread for every batch of hits; may be empty.
+         */
+        SearchEngine(const std::string &dbName, const SearchOptions &options = SearchOptions(), Listener listener = nullptr);
+
+        /**
+         * @brief Aborts the running query and stops the worker.
+         */
+        ~SearchEngine();
+
+        SearchEngine(const SearchEngine&) = delete;
+        SearchEngine &operator=(const SearchEngine&) = delete;
+
+        /**
+         * @brief Starts searching for text, superseding any earlier query.
+         *
+         * @return The generation its results will carry.
+         */
+        uint64_t submit(const std::string &text);
+
+        /**
+         * @brief Copies the latest results if they changed since the previous call.
+         */
+        bool poll(SearchResults &results);
+
+        /**
+         * @brief Returns the number of queries aborted because a newer one arrived.
+         */
+        uint64_t cancelledQueries() const { return cancelled.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief Returns the number of queries answered at least partly from the previous hits.
+         */
+        uint64_t reusedQueries() const { return reused.load(std::memory_order_relaxed); }
+};
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include "database.hpp"
+#include "protocol.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Tuning knobs of a Server.
+ */
+struct ServerOptions {
+    /**
+     * @brief Most requests executed, and committed, together.
+     */
+    size_t maxGroup = 1024;
+
+    /**
+     * @brief Ledger user of move-stock requests that name none.
+     */
+    int userId = 1;
+
+    /**
+     * @brief Rows returned by one List request at most.
+     */
+    int maxListRows = 1000;
+};
+
+/**
+ * @brief Counters of a Server, readable from any thread.
+ */
+struct ServerStats {
+    std::atomic<uint64_t> connections{0};
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> writes{0};
+
+    /**
+     * @brief Transactions committed for groups holding at least one write.
+     */
+    std::atomic<uint64_t> commits{0};
+};
+
+/**
+ * @brief Serves the protocol:: requests over a Unix domain socket.
+ *
+ * One process owns the Database and clients on the same machine talk to it
+ * instead of opening the file themselves, so they never contend for its lock.
+ * run() is a single-threaded epoll loop over non-blocking sockets. Each
+ * wakeup reads everything the ready connections sent, decodes every complete
+ * frame, and executes the requests in arrival order. Requests of all clients
+ * gathered in one wakeup, up to maxGroup, form one group: if it contains a
+ * write, the whole group runs in a single transaction with a savepoint per
+ * request, so concurrent clients share one commit. Responses are only sent
+ * once their group has committed, and a connection's responses always come
+ * back in request order.
+ */
+class Server {
+    private :
+        struct Connection {
+            int fd = -1;
+            uint64_t serial = 0;
+            std::string input;
+            size_t inputOffset = 0;
+            std::string output;
+            size_t outputOffset = 0;
+            bool waitingToWrite = false;
+        };
+
+        /**
+         * @brief A decoded request waiting for its group to run.
+         */
+        struct Pending {
+            int fd;
+            uint64_t serial;
+            protocol::Request request;
+            protocol::Response response;
+        };
+
+        Database &database;
+        std::string socketPath;
+        ServerOptions options;
+        ServerStats counters;
+
+        int listenFd = -1;
+        int epollFd = -1;
+        int wakeFd = -1;
+        uint64_t nextSerial = 0;
+        std::unordered_map<int, Connection> connections;
+        std::vector<Pending> pending;
+
+        void accept();
+        void close(Connection &connection);
+
+        /**
+         * @brief Reads what the connection sent and queues its complete frames; false if it closed.
+         */
+        bool receive(Connection &connection);
+
+        /**
+         * @brief Sends as much of the output as the socket takes; false on error.
+         */
+        bool send(Connection &connection);
+
+        /**
+         * @brief Runs the pending requests in groups and queues their responses.
+         */
+        void executePending();
+
+        void handle(Pending &pending);
+
+    public :
+        /**
+         * @param database An initialized database; only run()'s thread may use it while serving.
+         */
+        Server(Database &database, const std::string &socketPath, const ServerOptions &options = ServerOptions());
+
+        /**
+         * @brief Closes every connection and removes the socket file.
+         */
+        ~Server();
+
+        Server(const Server&) = delete;
+        Server &operator=(const Server&) = delete;
+
+        /**
+         * @brief Creates the socket, replacing a stale socket file.
+         */
+        bool listen();
+
+        /**
+         * @brief Serves until stop() is called.
+         */
+        void run();
+
+        /**
+         * @brief Makes run() return; safe from any thread and from a signal handler.
+         */
+        void stop();
+
+        const ServerStats &stats() const { return counters; }
+};
+
+#endif
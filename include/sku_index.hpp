@@ -0,0 +1,235 @@
+#ifndef SKU_INDEX_HPP
+#define SKU_INDEX_HPP
+
+#include "database.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @brief Minimal perfect hash over a fixed set of strings (hash-and-displace).
+ *
+ * Keys are hashed once into 64 bits and grouped into buckets of about four
+ * keys. Buckets are placed largest first: for each one, a displacement is
+ * searched so that every key of the bucket lands on a distinct free slot. A
+ * lookup is then one hash, one displacement load and one slot computation,
+ * with no probing. The n keys map onto exactly n slots; a key outside the set
+ * also maps to some slot, so callers must verify the key stored there.
+ */
+class PerfectHash {
+    private :
+        std::vector<uint32_t> displacements;
+        uint64_t seed = 0;
+        uint32_t slotCount = 0;
+
+    public :
+        /**
+         * @brief Returns the 64-bit hash every other function works from.
+         */
+        static uint64_t hash(std::string_view key, uint64_t seed);
+
+        /**
+         * @brief Builds the function for the given distinct keys.
+         *
+         * @return false if no placement was found; only possible with duplicate keys.
+         */
+        bool build(const std::vector<std::string_view> &keys);
+
+        /**
+         * @brief Returns the slot of a key, in [0, size()).
+         */
+        uint32_t slot(std::string_view key) const{
+            const uint64_t h = hash(key, seed);
+            const uint32_t bucket = static_cast<uint32_t>(((h >> 32) * displacements.size()) >> 32);
+            return place(h, displacements[bucket]);
+        }
+
+        /**
+         * @brief Maps a key hash and a displacement onto a slot.
+         */
+        uint32_t place(uint64_t h, uint32_t displacement) const{
+            uint64_t mixed = (h ^ (displacement * 0x9E3779B97F4A7C15ULL)) * 0xBF58476D1CE4E5B9ULL;
+            mixed ^= mixed >> 31;
+            return static_cast<uint32_t>((static_cast<unsigned __int128>(mixed) * slotCount) >> 64);
+        }
+
+        /**
+         * @brief Returns the number of slots, equal to the number of keys.
+         */
+        uint32_t size() const { return slotCount; }
+};
+
+/**
+ * @brief In-process SKU/barcode to item id index for scan-to-item resolution.
+ *
+ * load() reads the SKU of every live item and builds a PerfectHash over them;
+ * each slot stores the SKU (to reject unknown codes) and the item id. Items
+ * whose SKU is added or changed afterwards go to a small delta map, and the
+ * slots of items whose SKU changed or that were deleted are masked, so find()
+ * stays exact between rebuilds. Writes that leave the SKU alone, such as stock
+ * movements, do not touch the index.
+ *
+ * refresh() never rebuilds the hash, so it stays cheap enough for the scan
+ * path. Once rebuildDue() reports that the delta holds more than an eighth of
+ * the hashed keys, the owner calls rebuild() at a quiet moment, e.g. from a
+ * maintenance task; it works from the keys already in memory.
+ *
+ * Like ItemSnapshot the index follows the Database's change stream and does
+ * not observe other connections; it is not thread-safe.
+ */
+class SkuIndex {
+    private :
+        /**
+         * @brief Transparent hashing, so find() can probe the delta with a string_view.
+         */
+        struct SkuHash {
+            using is_transparent = void;
+            size_t operator()(std::string_view sku) const { return std::hash<std::string_view>()(sku); }
+        };
+
+        Database &database;
+        std::unique_ptr<ChangeSubscription> subscription;
+        std::vector<ChangeEvent> events;
+
+        PerfectHash hash;
+
+        /**
+         * @brief One slot per hashed key, half a cache line each.
+         *
+         * Barcodes (EAN-13, UPC-A, GTIN-14) fit inline, so a lookup touches the
+         * displacement and the slot only; longer SKUs live in overflowKeys.
+         */
+        struct Slot {
+            static constexpr size_t inlineCapacity = 18;
+            static constexpr uint8_t overflowMarker = 0xFF;
+
+            sqlite3_int64 id;
+            uint32_t overflowOffset;
+            uint8_t length;
+            uint8_t live;
+
+            /**
+             * @brief The SKU itself, or for an overflow SKU its 32-bit length.
+             */
+            char key[inlineCapacity];
+
+            std::string_view sku(const std::string &overflowKeys) const{
+                if (length != overflowMarker){
+                    return std::string_view(key, length);
+                }
+                uint32_t size;
+                std::memcpy(&size, key, sizeof(size));
+                return std::string_view(overflowKeys.data() + overflowOffset, size);
+            }
+        };
+        static_assert(sizeof(Slot) == 32, "two slots per cache line");
+
+        std::vector<Slot> slots;
+        std::string overflowKeys;
+        std::unordered_map<sqlite3_int64, uint32_t> idSlots;
+
+        /**
+         * @brief SKUs added or changed since the last build, and the reverse map to retire them.
+         */
+        std::unordered_map<std::string, sqlite3_int64, SkuHash, std::equal_to<>> delta;
+        std::unordered_map<sqlite3_int64, std::string> deltaSkus;
+
+        std::unordered_set<sqlite3_int64> pendingRows;
+
+        /**
+         * @brief Forgets whatever SKU the item had, in the hash or in the delta.
+         */
+        void retire(sqlite3_int64 id);
+
+        /**
+         * @brief Finds the SKU the index currently holds for an item.
+         */
+        bool currentSku(sqlite3_int64 id, std::string_view &sku) const;
+
+        /**
+         * @brief Builds the perfect hash and its slots over the given keys and empties the delta.
+         *
+         * @param keyData The keys back to back; key i spans offsets[i] to offsets[i + 1].
+         */
+        bool build(const std::vector<sqlite3_int64> &ids, const std::string &keyData, const std::vector<uint32_t> &offsets);
+
+    public :
+        /**
+         * @brief Creates an empty index attached to the database's change stream.
+         *
+         * @param database The database whose `item` table is indexed. It must
+         *                 outlive the index.
+         */
+        explicit SkuIndex(Database &database);
+
+        SkuIndex(const SkuIndex&) = delete;
+        SkuIndex &operator=(const SkuIndex&) = delete;
+
+        /**
+         * @brief Rebuilds the perfect hash from every live item with a SKU.
+         */
+        bool load();
+
+        /**
+         * @brief Applies the item changes committed since the previous call.
+         *
+         * Only items whose SKU changed reach the delta. When the subscription
+         * overflowed and events were lost, the index is reloaded instead.
+         *
+         * @return The number of items re-read.
+         */
+        size_t refresh();
+
+        /**
+         * @brief Rebuilds the perfect hash over the hashed keys and the delta, without reading the database.
+         */
+        bool rebuild();
+
+        /**
+         * @brief Returns true once the delta is large enough that rebuild() should run.
+         */
+        bool rebuildDue() const { return delta.size() > hash.size() / 8 + 1024; }
+
+        /**
+         * @brief Resolves a scanned SKU.
+         *
+         * @param sku The scanned code.
+         * @param id Receives the item id when found.
+         *
+         * @return true if a live item has this SKU.
+         */
+        bool find(std::string_view sku, sqlite3_int64 &id) const{
+            if (!delta.empty()){
+                auto found = delta.find(sku);
+                if (found != delta.end()){
+                    id = found->second;
+                    return true;
+                }
+            }
+            if (hash.size() == 0){
+                return false;
+            }
+
+            const Slot &slot = slots[hash.slot(sku)];
+            if (!slot.live || slot.sku(overflowKeys) != sku){
+                return false;
+            }
+            id = slot.id;
+            return true;
+        }
+
+        /**
+         * @brief Returns the number of SKUs in the perfect hash and in the delta.
+         */
+        size_t hashedKeys() const { return hash.size(); }
+        size_t deltaKeys() const { return delta.size(); }
+};
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef SUPPLIER_PRICES_HPP
+#define SUPPLIER_PRICES_HPP
+
+#include "database.hpp"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @brief One line of a supplier price list.
+ */
+struct SupplierOffer {
+    /**
+     * @brief The supplier, or 0 when no supplier qualifies.
+     */
+    int supplierId = 0;
+    Money unitPrice;
+    int leadTimeDays = 0;
+
+    /**
+     * @brief Smallest quantity the supplier ships for this item.
+     */
+    int minimumOrder = 1;
+};
+
+/**
+ * @brief One line of a purchase order to source.
+ */
+struct PurchaseNeed {
+    int itemId = 0;
+    int quantity = 0;
+};
+
+/**
+ * @brief In-process copy of the `supplier_prices` table, sorted by price per item.
+ *
+ * load() packs the offers of every item into one array, grouped by item id
+ * and ordered by unit price, then lead time, then supplier id, so the cheapest
+ * offer of an item is found by scanning its group from the front: usually the
+ * first entry already qualifies. Items whose offers changed afterwards are
+ * re-read whole into a small delta map that shadows their packed group; once
+ * the delta holds more than an eighth of the items, refresh() repacks
+ * everything. Soft-deleting a supplier only flips its availability flag.
+ *
+ * Like SkuIndex the index follows the Database's change stream and does not
+ * observe other connections; it is not thread-safe.
+ */
+class SupplierPriceIndex {
+    private :
+        /**
+         * @brief A packed offer, 24 bytes with padding.
+         */
+        struct Offer {
+            int64_t unitPrice;
+            int32_t supplierId;
+            int32_t leadTimeDays;
+            int32_t minimumOrder;
+        };
+
+        Database &database;
+        std::unique_ptr<ChangeSubscription> subscription;
+        std::vector<ChangeEvent> events;
+
+        /**
+         * @brief Offers of item i are offers[itemOffsets[i]] to offers[itemOffsets[i + 1]].
+         */
+        std::vector<uint32_t> itemOffsets;
+        std::vector<Offer> offers;
+
+        /**
+         * @brief Items re-read since the last load(); their list replaces the packed group.
+         */
+        std::unordered_map<int, std::vector<Offer>> delta;
+
+        /**
+         * @brief Indexed by supplier id: 1 while the supplier is not soft-deleted.
+         */
+        std::vector<uint8_t> supplierLive;
+
+        /**
+         * @brief Item of every price list row, to find the item of a deleted row.
+         */
+        std::unordered_map<sqlite3_int64, int> rowItems;
+
+        std::unordered_set<sqlite3_int64> pendingRows;
+        std::unordered_set<int> pendingSuppliers;
+
+        static bool cheaper(const Offer &left, const Offer &right);
+
+        /**
+         * @brief Re-reads the availability of the given suppliers.
+         */
+        bool loadSuppliers(const std::unordered_set<int> *ids);
+
+        /**
+         * @brief Returns the offers of an item, from the delta or the packed array.
+         */
+        const Offer *offersOf(int itemId, const Offer *&end) const{
+            if (!delta.empty()){
+                auto found = delta.find(itemId);
+                if (found != delta.end()){
+                    end = found->second.data() + found->second.size();
+                    return found->second.data();
+                }
+            }
+            if (itemId < 0 || static_cast<size_t>(itemId) + 1 >= itemOffsets.size()){
+                end = nullptr;
+                return nullptr;
+            }
+            end = offers.data() + itemOffsets[static_cast<size_t>(itemId) + 1];
+            return offers.data() + itemOffsets[static_cast<size_t>(itemId)];
+        }
+
+    public :
+        /**
+         * @brief Creates an empty index attached to the database's change stream.
+         *
+         * @param database The database whose price lists are indexed. It must
+         *                 outlive the index.
+         */
+        explicit SupplierPriceIndex(Database &database);
+
+        SupplierPriceIndex(const SupplierPriceIndex&) = delete;
+        SupplierPriceIndex &operator=(const SupplierPriceIndex&) = delete;
+
+        /**
+         * @brief Repacks every price list row and supplier.
+         */
+        bool load();
+
+        /**
+         * @brief Applies the price list and supplier changes committed since the previous call.
+         *
+         * @return The number of price list rows and suppliers re-read.
+         */
+        size_t refresh();
+
+        /**
+         * @brief Picks the cheapest available supplier for every line of a purchase order.
+         *
+         * A supplier is available for a line when it is not soft-deleted, its
+         * minimum order does not exceed the quantity needed, and it delivers
+         * within maxLeadTimeDays. Ties on price go to the shorter lead time,
+         * then to the lower supplier id.
+         *
+         * @param needs The items and quantities to source.
+         * @param maxLeadTimeDays The longest acceptable lead time; negative for no limit.
+         * @param chosen Receives one offer per need, in the same order; supplierId
+         *               is 0 for needs no supplier can fill.
+         *
+         * @return The number of needs a supplier was found for.
+         */
+        size_t cheapest(const std::vector<PurchaseNeed> &needs, int maxLeadTimeDays, std::vector<SupplierOffer> &chosen) const;
+
+        /**
+         * @brief Lists every offer for an item, cheapest first, unavailable suppliers included.
+         */
+        void offersFor(int itemId, std::vector<SupplierOffer> &list) const;
+
+        /**
+         * @brief Returns the number of price list rows held.
+         */
+        size_t size() const { return rowItems.size(); }
+        size_t deltaItems() const { return delta.size(); }
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef TASK_POOL_HPP
+#define TASK_POOL_HPP
+
+#include <sqlite3.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Work-stealing thread pool whose workers each own a read-only connection.
+ *
+ * Every worker has its own deque of tasks. A task submitted from a worker is
+ * pushed onto that worker's deque and popped LIFO, keeping related work on
+ * the same core; tasks submitted from other threads are spread round-robin.
+ * A worker whose deque is empty steals the oldest task of another worker
+ * before going to sleep, so an uneven split of work evens out on its own.
+ *
+ * The workers form the read-connection set: each one opens the database file
+ * with SQLITE_OPEN_READONLY and hands its connection to the tasks it runs,
+ * which therefore may query freely but never write. In WAL mode the readers
+ * do not block the application's writer, and every task sees a consistent
+ * snapshot for the duration of its own statements.
+ */
+class TaskPool {
+    public :
+        using Task = std::function<void(sqlite3 *connection)>;
+
+    private :
+        struct Worker {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+            sqlite3 *connection = nullptr;
+            std::thread thread;
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<size_t> nextWorker{0};
+
+        /**
+         * @brief Tasks submitted but not yet taken, counted before they are queued; guarded by idleMutex for sleeping.
+         */
+        std::atomic<size_t> queued{0};
+        std::atomic<uint64_t> stolen{0};
+        std::mutex idleMutex;
+        std::condition_variable idleCondition;
+        bool stopping = false;
+
+        /**
+         * @brief Takes a task from the worker's own deque, or steals one from another.
+         */
+        bool take(size_t index, Task &task);
+
+        /**
+         * @brief Body of worker thread index.
+         */
+        void run(size_t index);
+
+    public :
+        /**
+         * @brief Opens one read-only connection per worker and starts the workers.
+         *
+         * @param dbName Path of the database file.
+         * @param threads Number of workers; 0 uses std::thread::hardware_concurrency().
+         */
+        TaskPool(const std::string &dbName, size_t threads = 0);
+
+        /**
+         * @brief Runs the tasks still queued, then stops the workers and closes their connections.
+         */
+        ~TaskPool();
+
+        TaskPool(const TaskPool&) = delete;
+        TaskPool &operator=(const TaskPool&) = delete;
+
+        /**
+         * @brief Queues a task.
+         */
+        void submit(Task task);
+
+        /**
+         * @brief Returns the number of workers.
+         */
+        size_t size() const;
+
+        /**
+         * @brief Returns how many tasks were run by a worker other than the one they were queued on.
+         */
+        uint64_t stolenTasks() const;
+};
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef TERMINAL_HPP
+#define TERMINAL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <termios.h>
+
+/**
+ * @brief Keys the terminal layer decodes from the input stream.
+ */
+enum class Key {
+    None,
+    Character,
+    Enter,
+    Tab,
+    Backspace,
+    Escape,
+    Up,
+    Down,
+    Left,
+    Right,
+    PageUp,
+    PageDown,
+    Home,
+    End,
+    Resize
+};
+
+/**
+ * @brief One decoded key press; character is set for Key::Character.
+ */
+struct KeyEvent {
+    Key key = Key::None;
+    char32_t character = 0;
+};
+
+/**
+ * @brief Appends the UTF-8 encoding of a character.
+ */
+void appendUtf8(std::string &out, char32_t character);
+
+/**
+ * @brief Raw-mode VT100/xterm terminal on standard input and output.
+ *
+ * The constructor switches the terminal to raw mode and to the alternate
+ * screen and hides the cursor; the destructor restores everything, so the
+ * shell is left as it was even when the application exits early. Output is
+ * accumulated and sent with a single write() per flush(), which matters on
+ * serial lines and SSH sessions where every packet costs a round of latency.
+ */
+class Terminal {
+    private :
+        termios original;
+        bool active = false;
+
+        std::string output;
+        std::string input;
+        uint64_t written = 0;
+
+        /**
+         * @brief Reads whatever bytes are available, waiting at most timeoutMs for the first.
+         */
+        bool fill(int timeoutMs);
+
+        /**
+         * @brief Decodes one key from the front of the input buffer.
+         */
+        bool decode(KeyEvent &event);
+
+    public :
+        Terminal();
+        ~Terminal();
+
+        Terminal(const Terminal&) = delete;
+        Terminal &operator=(const Terminal&) = delete;
+
+        /**
+         * @brief Returns true when both standard input and output are terminals.
+         */
+        static bool interactive();
+
+        /**
+         * @brief Returns true if raw mode could be entered.
+         */
+        bool isActive() const { return active; }
+
+        /**
+         * @brief Returns the current window size.
+         */
+        void size(int &rows, int &columns) const;
+
+        /**
+         * @brief Waits for the next key.
+         *
+         * @param timeoutMs Maximum wait in milliseconds; 0 only returns keys already typed.
+         *
+         * @return false if no key arrived in time. A window resize is reported as Key::Resize.
+         */
+        bool readKey(KeyEvent &event, int timeoutMs);
+
+        /**
+         * @brief Returns true if typed input is waiting to be read.
+         */
+        bool inputPending();
+
+        /**
+         * @brief Queues bytes for the next flush().
+         */
+        void write(std::string_view bytes) { output.append(bytes); }
+
+        /**
+         * @brief Sends the queued bytes.
+         */
+        void flush();
+
+        /**
+         * @brief Returns the number of bytes sent since construction.
+         */
+        uint64_t bytesWritten() const { return written; }
+};
+
+/**
+ * @brief Display attributes of a screen cell.
+ */
+enum class CellStyle : uint8_t {
+    Normal,
+    Header,
+    Selected,
+    Status,
+    Dim
+};
+
+/**
+ * @brief One character position on the screen.
+ */
+struct Cell {
+    char32_t character = U' ';
+    CellStyle style = CellStyle::Normal;
+
+    bool operator==(const Cell &other) const { return character == other.character && style == other.style; }
+};
+
+/**
+ * @brief Double-buffered screen that sends only the cells that changed.
+ *
+ * Views draw a complete frame into the back buffer. render() compares it with
+ * the front buffer, which mirrors what the terminal shows, and emits cursor
+ * moves, attribute changes and characters for the differing cells only. A
+ * short gap between two changes on the same line is bridged by rewriting the
+ * unchanged cells when that is cheaper than a cursor move. Scrolling a list is
+ * done with the terminal's own scroll region (scroll()), after which only the
+ * newly exposed lines differ. Characters are treated as one column wide.
+ */
+class Screen {
+    private :
+        struct PendingScroll {
+            int top;
+            int bottom;
+            int lines;
+        };
+
+        int rows = 0;
+        int columns = 0;
+        std::vector<Cell> front;
+        std::vector<Cell> back;
+        std::vector<PendingScroll> scrolls;
+        bool invalid = true;
+
+        /**
+         * @brief Applies a scroll to the front buffer and emits it.
+         */
+        void emitScroll(std::string &out, const PendingScroll &scroll);
+
+    public :
+        /**
+         * @brief Sets the screen size; the next render() repaints everything.
+         */
+        void resize(int rows, int columns);
+
+        int height() const { return rows; }
+        int width() const { return columns; }
+
+        /**
+         * @brief Blanks the back buffer.
+         */
+        void clear();
+
+        /**
+         * @brief Writes UTF-8 text at a position, padded or truncated to width columns.
+         *
+         * @param alignRight Whether text shorter than width is padded on the left.
+         *
+         * @return The column after the written field.
+         */
+        int put(int row, int column, std::string_view text, CellStyle style, int width, bool alignRight = false);
+
+        /**
+         * @brief Requests that lines top..bottom (inclusive) move up by lines rows (down if negative).
+         *
+         * The terminal performs the move itself on the next render(); the caller
+         * still draws the whole frame as it should appear afterwards.
+         */
+        void scroll(int top, int bottom, int lines);
+
+        /**
+         * @brief Sends the difference between the back and front buffers.
+         *
+         * @return The number of bytes queued on the terminal.
+         */
+        size_t render(Terminal &terminal);
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef TRACKED_HPP
+#define TRACKED_HPP
+
+#include "database.hpp"
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Wraps a record and remembers which of its fields were modified.
+ *
+ * A Tracked<T> keeps the value last known to be stored in the database next to
+ * the value being edited. Fields can be changed through set(), which marks the
+ * column explicitly, or directly through edit(); in both cases dirtyColumns()
+ * reports the columns whose mapped value differs from the stored one, and
+ * Database::update() writes only those columns.
+ *
+ * @tparam T The record type, usually the same type used with a FieldMapping<T>.
+ */
+template <typename T>
+class Tracked {
+    private :
+        /**
+         * @brief The value as last written to or read from the database.
+         */
+        T original;
+
+        /**
+         * @brief The value being edited.
+         */
+        T current;
+
+        /**
+         * @brief Columns marked dirty explicitly, regardless of their value.
+         */
+        std::set<std::string> markedColumns;
+
+    public :
+        /**
+         * @brief Starts tracking a record as it is currently stored.
+         *
+         * @param value The record as read from the database.
+         */
+        explicit Tracked(T value) : original(value), current(std::move(value)){
+        }
+
+        /**
+         * @brief Returns the current value.
+         */
+        const T &get() const{
+            return current;
+        }
+
+        /**
+         * @brief Returns the current value for modification.
+         *
+         * Changes made through this reference are detected by comparing mapped
+         * values in dirtyColumns().
+         */
+        T &edit(){
+            return current;
+        }
+
+        /**
+         * @brief Assigns a field and marks its column dirty.
+         *
+         * @param column The column name the field is mapped to.
+         * @param member Pointer to the field in T.
+         * @param value The new value.
+         */
+        template <typename Member, typename Value>
+        void set(const std::string &column, Member T::*member, Value &&value){
+            current.*member = std::forward<Value>(value);
+            markedColumns.insert(column);
+        }
+
+        /**
+         * @brief Marks a column dirty so it is written by the next update.
+         */
+        void markDirty(const std::string &column){
+            markedColumns.insert(column);
+        }
+
+        /**
+         * @brief Returns the mapped columns that need to be written.
+         *
+         * A column is dirty if it was marked explicitly or if its getter returns a
+         * different value for the current record than for the original one. The
+         * result follows the order of the mapping, so equal subsets always produce
+         * the same SQL text and share a cached statement.
+         *
+         * @param fieldMapping The column mapping of T.
+         */
+        std::vector<std::string> dirtyColumns(const FieldMapping<T> &fieldMapping) const{
+            std::vector<std::string> columns;
+            for (auto &[columnName, getter] : fieldMapping){
+                if (markedColumns.count(columnName) != 0 || getter(current) != getter(original)){
+                    columns.push_back(columnName);
+                }
+            }
+            return columns;
+        }
+
+        /**
+         * @brief Accepts the current value as stored, clearing all dirty state.
+         */
+        void commit(){
+            original = current;
+            markedColumns.clear();
+        }
+
+        /**
+         * @brief Discards edits, restoring the stored value.
+         */
+        void revert(){
+            current = original;
+            markedColumns.clear();
+        }
+};
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef TUI_HPP
+#define TUI_HPP
+
+#include "database.hpp"
+#include "paginator.hpp"
+#include "row_cache.hpp"
+#include "search.hpp"
+#include "terminal.hpp"
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A column shown by a ListView.
+ */
+struct ListColumn {
+    std::string name;
+    std::string title;
+    int width;
+    bool alignRight = false;
+
+    /**
+     * @brief When set, the column holds ids of this table and the cell shows the name of that row.
+     */
+    std::string lookupTable = "";
+};
+
+/**
+ * @brief Scrollable, virtualized listing of one table.
+ *
+ * The view never holds the table: it keeps a window of a few pages around the
+ * cursor, fetched with a keyset Paginator, and extends it from whichever edge
+ * the cursor approaches while dropping rows far from the other edge. Moving
+ * through a million rows therefore costs one page query per page scrolled and
+ * Home/End are a single query each, whatever the table size.
+ *
+ * Columns with a lookupTable are resolved through a RowCache: the few
+ * categories and suppliers a screenful refers to are read once and then
+ * served from memory on every frame.
+ */
+class ListView {
+    private :
+        Database &database;
+        RowCache *names;
+        std::string title;
+        std::string tableName;
+        std::vector<ListColumn> columns;
+        std::vector<std::string> sortColumns;
+        size_t sortIndex = 0;
+        bool descending = false;
+
+        std::unique_ptr<Paginator> paginator;
+        std::deque<Row> rows;
+        bool atStart = true;
+        bool atEnd = true;
+
+        size_t cursor = 0;
+        size_t top = 0;
+        int height = 1;
+
+        /**
+         * @brief Rows the viewport moved since the last takeScroll(); reset when it jumps.
+         */
+        long scrolled = 0;
+        bool jumped = true;
+
+        size_t pageSize() const;
+
+        /**
+         * @brief Appends or prepends one page; false at the end of the table.
+         */
+        bool extendForward();
+        bool extendBackward();
+
+        /**
+         * @brief Drops rows far from the cursor so the window stays a few pages long.
+         */
+        void trim();
+
+        /**
+         * @brief Recreates the paginator for the current order and loads the first or last page.
+         */
+        void reload(bool fromEnd);
+
+        /**
+         * @brief Moves top so that the cursor is visible, recording the scroll distance.
+         */
+        void follow();
+
+    public :
+        /**
+         * @brief Creates a view and loads its first page.
+         *
+         * @param sortColumns The orders the view cycles through; the first is the initial one.
+         * @param descending Whether the initial order starts from the largest value.
+         * @param names Resolves the columns that have a lookupTable; they show the bare id without it.
+         */
+        ListView(Database &database, const std::string &title, const std::string &tableName, const std::vector<ListColumn> &columns,
+                 const std::vector<std::string> &sortColumns, bool descending = false, RowCache *names = nullptr);
+
+        const std::string &name() const { return title; }
+
+        /**
+         * @brief Sets the number of visible rows.
+         */
+        void setHeight(int rows);
+
+        void moveCursor(long delta);
+        void home();
+        void end();
+
+        /**
+         * @brief Switches to the next sort column, or flips the direction of the current one.
+         */
+        void nextSort();
+        void reverseSort();
+
+        /**
+         * @brief Re-reads the rows around the cursor, keeping its position.
+         */
+        void refresh();
+
+        /**
+         * @brief Orders the view by column and puts the cursor on a row.
+         *
+         * @param anchor The row to show; needs its id and its value of column.
+         */
+        void seek(const std::string &column, const Row &anchor);
+
+        /**
+         * @brief Returns, and resets, how far the viewport scrolled since the last call.
+         *
+         * @param distance Rows moved, positive when the listing moved up.
+         *
+         * @return false if the view jumped and must be repainted instead.
+         */
+        bool takeScroll(long &distance);
+
+        /**
+         * @brief Draws the column header and the visible rows starting at screen row firstRow.
+         */
+        void draw(Screen &screen, int firstRow) const;
+
+        /**
+         * @brief Describes the order and the position for the status line.
+         */
+        std::string status() const;
+};
+
+/**
+ * @brief Terminal front end: item, supplier and ledger views over a read connection.
+ *
+ * The views read through their own connection, so in WAL mode scrolling never
+ * waits for writers. The main loop drains every pending key before drawing and
+ * draws at most one frame per 1/60 s; held-down keys are coalesced into one
+ * frame instead of queuing frames the terminal cannot keep up with. Each frame
+ * is a diff against what the terminal already shows, plus a hardware scroll
+ * when the list moved, so a line scroll costs one new line of output rather
+ * than a full repaint.
+ *
+ * `/` opens search-as-you-type over item names and SKUs; hits come from a
+ * SearchEngine on its own thread and are drawn as they arrive, so typing never
+ * waits for a query.
+ */
+class Tui {
+    private :
+        Database database;
+
+        /**
+         * @brief Category, supplier and item names shown in place of ids; synced once per frame.
+         */
+        RowCache names;
+        Terminal terminal;
+        Screen screen;
+        std::vector<std::unique_ptr<ListView>> views;
+        size_t active = 0;
+
+        SearchEngine search;
+        bool searching = false;
+        std::string searchText;
+        SearchResults searchResults;
+        size_t searchCursor = 0;
+
+        double lastFrameMs = 0;
+        size_t lastFrameBytes = 0;
+
+        void layout();
+        void drawFrame();
+        void drawSearch();
+
+        /**
+         * @brief Applies one key while the search line is open.
+         */
+        void handleSearch(const KeyEvent &event);
+
+        /**
+         * @brief Applies one key; returns false when the user quits.
+         */
+        bool handle(const KeyEvent &event);
+
+    public :
+        /**
+         * @brief Opens the read connection on an initialized database file.
+         */
+        explicit Tui(const std::string &dbPath);
+
+        /**
+         * @brief Runs until the user quits.
+         *
+         * @return The process exit status.
+         */
+        int run();
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef WIRE_HPP
+#define WIRE_HPP
+
+#include "database.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Compact binary encoding shared by the server protocol and workload traces.
+ *
+ * Integers are LEB128 varints, zigzag-encoded when signed; fixed-width
+ * integers and reals are little-endian; strings are a varint length followed
+ * by the bytes. A value is a type byte (1 integer, 2 real, 3 text, 4 money
+ * as signed minor units, 5 64-bit integer) followed by the value, and a row is a varint column count followed by (name, value)
+ * pairs.
+ */
+namespace wire {
+    /**
+     * @brief Appends encoded values to a string.
+     */
+    class Writer {
+        private :
+            std::string &out;
+
+        public :
+            explicit Writer(std::string &out) : out(out) {}
+
+            void byte(uint8_t value) { out += static_cast<char>(value); }
+            void fixed32(uint32_t value);
+            void varint(uint64_t value);
+            void signedVarint(int64_t value);
+            void real(double value);
+            void text(const std::string &value);
+            void value(const FieldValue &value);
+            void row(const Row &row);
+    };
+
+    /**
+     * @brief Decodes values from a buffer; every read returns false once the data runs out or is malformed.
+     */
+    class Reader {
+        private :
+            const uint8_t *position;
+            const uint8_t *end;
+
+        public :
+            Reader(const char *data, size_t size)
+                : position(reinterpret_cast<const uint8_t*>(data)), end(reinterpret_cast<const uint8_t*>(data) + size) {}
+
+            bool atEnd() const { return position == end; }
+
+            /**
+             * @brief Returns the number of bytes not read yet.
+             */
+            size_t remaining() const { return static_cast<size_t>(end - position); }
+
+            /**
+             * @brief Moves past count bytes; false if fewer remain.
+             */
+            bool skip(size_t count);
+
+            bool byte(uint8_t &value);
+            bool fixed32(uint32_t &value);
+            bool varint(uint64_t &value);
+            bool signedVarint(int64_t &value);
+
+            /**
+             * @brief Reads a varint that must fit a non-negative int (ids, limits).
+             */
+            bool integer(int &value);
+
+            /**
+             * @brief Reads a signed varint that must fit an int.
+             */
+            bool signedInteger(int &value);
+
+            bool real(double &value);
+            bool text(std::string &value);
+            bool value(FieldValue &value);
+            bool row(Row &row);
+    };
+}
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef WORKLOAD_HPP
+#define WORKLOAD_HPP
+
+#include "money.hpp"
+#include <sqlite3.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+class Database;
+
+/**
+ * @brief A traced value; the same type as FieldValue.
+ */
+using TraceValue = std::variant<std::string, int, double, Money, sqlite3_int64>;
+
+/**
+ * @brief Database operations a trace records.
+ *
+ * Begin and End bracket the operations of a Database::transaction() call;
+ * nested calls (savepoints) nest their brackets.
+ */
+enum class TraceOp : uint8_t {
+    Insert,
+    Upsert,
+    Update,
+    Remove,
+    SoftRemove,
+    Restore,
+    Query,
+    RemoveMany,
+    Begin,
+    End
+};
+
+/**
+ * @brief Returns the lower-case name of an operation, as printed in replay reports.
+ */
+const char *traceOpName(TraceOp op);
+
+/**
+ * @brief One recorded operation.
+ */
+struct TraceRecord {
+    TraceOp op = TraceOp::Query;
+
+    /**
+     * @brief Start time in microseconds since the capture was opened.
+     */
+    int64_t timestamp = 0;
+
+    /**
+     * @brief Wall time of the operation in microseconds; for End, of the whole transaction.
+     */
+    uint32_t duration = 0;
+
+    /**
+     * @brief Whether the operation succeeded; for End, whether the transaction committed.
+     */
+    bool ok = false;
+
+    /**
+     * @brief The table, or the SQL text of a Query.
+     */
+    std::string table;
+
+    /**
+     * @brief Columns written by Insert, Upsert and Update, in the order of values.
+     */
+    std::vector<std::string> columns;
+
+    /**
+     * @brief Conflict columns of an Upsert.
+     */
+    std::vector<std::string> keys;
+
+    /**
+     * @brief The column values followed by the id for Update; the id of Remove,
+     * SoftRemove and Restore; the ids of RemoveMany; the parameters of Query.
+     */
+    std::vector<TraceValue> values;
+
+    bool cascade = false;
+};
+
+/**
+ * @brief Appends trace records to a compact binary file.
+ *
+ * The file starts with the magic "INVTRACE" and a version byte, followed by
+ * the records, each prefixed by its varint length. Timestamps are stored as
+ * deltas from the previous record, table and column names and the SQL text of
+ * queries are written once and then referred to by index, and every field uses
+ * the wire:: encoding, so a record takes little more than its values. Records
+ * are encoded into a buffer under a mutex and written out in 1 MiB blocks, so
+ * one capture may be shared by several Database connections.
+ */
+class WorkloadCapture {
+    private :
+        FILE *file = nullptr;
+        std::chrono::steady_clock::time_point opened;
+
+        std::mutex bufferMutex;
+        std::string buffer;
+        std::string body;
+        std::unordered_map<std::string, uint64_t> names;
+        int64_t lastTimestamp = 0;
+        std::atomic<uint64_t> written{0};
+
+        void encode(const TraceRecord &record);
+
+    public :
+        /**
+         * @brief Creates, or truncates, the trace file.
+         */
+        explicit WorkloadCapture(const std::string &path);
+
+        /**
+         * @brief Flushes the buffered records and closes the file.
+         */
+        ~WorkloadCapture();
+
+        WorkloadCapture(const WorkloadCapture&) = delete;
+        WorkloadCapture &operator=(const WorkloadCapture&) = delete;
+
+        bool isOpen() const { return file != nullptr; }
+
+        /**
+         * @brief Returns microseconds since the capture was opened.
+         */
+        int64_t now() const;
+
+        void write(const TraceRecord &record);
+
+        /**
+         * @brief Writes the records of one transaction contiguously.
+         */
+        void write(const std::vector<TraceRecord> &records);
+
+        /**
+         * @brief Writes the buffered records to the file.
+         */
+        void flush();
+
+        /**
+         * @brief Returns the number of records written so far.
+         */
+        uint64_t records() const { return written.load(std::memory_order_relaxed); }
+};
+
+/**
+ * @brief Reads a whole trace file.
+ *
+ * @return false if the file cannot be opened or is not a trace; a truncated
+ *         last record is dropped with a warning.
+ */
+bool readTrace(const std::string &path, std::vector<TraceRecord> &records);
+
+/**
+ * @brief Returns the value a fraction of the values lie below; 1.0 gives the largest.
+ *
+ * Reorders values partially (nth_element). An empty set gives 0.
+ */
+double percentile(std::vector<double> &values, double fraction);
+
+/**
+ * @brief Tuning knobs of a WorkloadReplayer.
+ */
+struct ReplayOptions {
+    /**
+     * @brief Time compression: 1 keeps the original pacing, 10 replays ten times faster, 0 runs back to back.
+     */
+    double speed = 1.0;
+};
+
+/**
+ * @brief Re-executes a trace through the Database API and measures every operation.
+ *
+ * Operations are issued one after another on the replayer's Database, each
+ * top-level operation or transaction waiting for its original start time
+ * divided by the speed. A recorded transaction is replayed as one
+ * Database::transaction() call and commits or rolls back as the original did.
+ * The summary lists, per operation, the replayed and the original latency
+ * percentiles and how many operations ended differently from the capture.
+ */
+class WorkloadReplayer {
+    private :
+        struct Latencies {
+            std::vector<double> replayed;
+            std::vector<double> original;
+            size_t diverged = 0;
+        };
+
+        Database &database;
+        ReplayOptions options;
+        std::map<std::string, Latencies> latencies;
+        double elapsedMs = 0;
+        size_t replayedRecords = 0;
+
+        /**
+         * @brief Replays records[index], or the whole transaction it begins; returns the index after it.
+         */
+        size_t replay(const std::vector<TraceRecord> &records, size_t index, const std::vector<size_t> &ends);
+
+        bool execute(const TraceRecord &record);
+
+    public :
+        /**
+         * @param database The copy the trace is replayed against.
+         */
+        WorkloadReplayer(Database &database, const ReplayOptions &options = ReplayOptions());
+
+        /**
+         * @brief Replays every record.
+         *
+         * @return false if the transaction brackets of the trace do not match.
+         */
+        bool run(const std::vector<TraceRecord> &records);
+
+        /**
+         * @brief Prints the latency table of the last run().
+         */
+        void printSummary(FILE *out) const;
+
+        /**
+         * @brief Copies a database into a new file with the online backup API, replacing the file.
+         */
+        static bool copyDatabase(Database &source, const std::string &path);
+};
+
+#endif
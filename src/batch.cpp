@@ -0,0 +1,553 @@
+#include "batch.hpp"
+#include "report.hpp"
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <set>
+#include <thread>
+
+using namespace std;
+
+// Tables a script may write to; table names cannot be bound as parameters.
+static const set<string> scriptTables = {"item", "category", "suppliers", "user", "transaction_records", "supplier_prices"};
+
+struct Token {
+    string text;
+    bool quoted = false;
+
+    // Position of the first '=' outside quotes, or npos.
+    size_t equals = string::npos;
+};
+
+static bool tokenize(const string &line, vector<Token> &tokens, string &error){
+    size_t position = 0;
+    while (true){
+        while (position < line.size() && isspace(static_cast<unsigned char>(line[position]))){
+            ++position;
+        }
+        if (position == line.size()){
+            return true;
+        }
+
+        Token &token = tokens.emplace_back();
+        bool inQuotes = false;
+        for (; position < line.size() && (inQuotes || !isspace(static_cast<unsigned char>(line[position]))); ++position){
+            const char character = line[position];
+            if (character == '"'){
+                inQuotes = !inQuotes;
+                token.quoted = true;
+            }else if (character == '\\' && inQuotes && position + 1 < line.size()){
+                const char escaped = line[++position];
+                token.text += escaped == 'n' ? '\n' : escaped == 't' ? '\t' : escaped;
+            }else{
+                if (character == '=' && !inQuotes && token.equals == string::npos){
+                    token.equals = token.text.size();
+                }
+                token.text += character;
+            }
+        }
+        if (inQuotes){
+            error = "unterminated quote";
+            return false;
+        }
+    }
+}
+
+static bool parseInt(const string &text, int &value){
+    const char *first = text.data() + (text.starts_with('+') ? 1 : 0);
+    const char *last = text.data() + text.size();
+    auto [end, status] = from_chars(first, last, value);
+    return first != last && status == errc() && end == last;
+}
+
+// Unquoted numbers become int or double; anything else, and integers with a
+// leading zero such as "007" SKUs, stay text.
+static FieldValue toValue(const string &text, bool quoted){
+    if (quoted || text.empty()){
+        return text;
+    }
+
+    const size_t digits = text[0] == '-' ? 1 : 0;
+    int integer;
+    if (parseInt(text, integer) && !(text.size() > digits + 1 && text[digits] == '0')){
+        return integer;
+    }
+
+    double real;
+    const char *last = text.data() + text.size();
+    auto [end, status] = from_chars(text.data(), last, real);
+    if (status == errc() && end == last && isfinite(real)){
+        return real;
+    }
+    return text;
+}
+
+bool BatchRunner::validColumn(const string &text){
+    if (text.empty() || isdigit(static_cast<unsigned char>(text[0]))){
+        return false;
+    }
+    for (char character : text){
+        if (!isalnum(static_cast<unsigned char>(character)) && character != '_'){
+            return false;
+        }
+    }
+    return true;
+}
+
+// Converts a value written to a MONEY column the way Database::insert() binds
+// it: numbers are minor units (1250 is 12.50) and must be whole, text must be
+// an exact decimal amount.
+static bool toMoney(const FieldValue &value, Money &amount){
+    if (holds_alternative<Money>(value)){
+        amount = get<Money>(value);
+        return true;
+    }
+    if (holds_alternative<int>(value)){
+        amount = Money::fromUnits(get<int>(value));
+        return true;
+    }
+    if (holds_alternative<sqlite3_int64>(value)){
+        amount = Money::fromUnits(get<sqlite3_int64>(value));
+        return true;
+    }
+    if (holds_alternative<double>(value)){
+        const double units = get<double>(value);
+        if (!isfinite(units) || units != trunc(units) || fabs(units) > 9.2e18){
+            return false;
+        }
+        amount = Money::fromUnits(static_cast<int64_t>(units));
+        return true;
+    }
+    return Money::parse(get<string>(value), amount);
+}
+
+// Reads "column=value" tokens from index first on.
+static bool parseAssignments(const vector<Token> &tokens, size_t first, const string &tableName, Row &values, string &error){
+    for (size_t index = first; index < tokens.size(); ++index){
+        const Token &token = tokens[index];
+        if (token.equals == string::npos){
+            error = "expected column=value, got \"" + token.text + "\"";
+            return false;
+        }
+        const string column = token.text.substr(0, token.equals);
+        if (!BatchRunner::validColumn(column)){
+            error = "invalid column name \"" + column + "\"";
+            return false;
+        }
+        const string text = token.text.substr(token.equals + 1);
+
+        // Amounts are parsed from the text, so "19.99" is exactly 1999 cents.
+        Money amount;
+        if (Database::isMoneyColumn(tableName, column)){
+            if (!Money::parse(text, amount)){
+                error = column + ": expected an amount such as 12.50, got \"" + text + "\"";
+                return false;
+            }
+            values[column] = amount;
+            continue;
+        }
+        values[column] = toValue(text, token.quoted);
+    }
+    return true;
+}
+
+bool BatchRunner::knownTable(const string &tableName){
+    return scriptTables.count(tableName) != 0;
+}
+
+bool BatchRunner::parse(const string &line, BatchCommand &command, string &error){
+    error.clear();
+
+    const size_t start = line.find_first_not_of(" \t\r");
+    if (start == string::npos || line[start] == '#'){
+        return false;
+    }
+
+    vector<Token> tokens;
+    if (!tokenize(line, tokens, error)){
+        return false;
+    }
+
+    const string &verb = tokens[0].text;
+    auto parseTable = [&]{
+        if (tokens.size() < 2 || !scriptTables.count(tokens[1].text)){
+            error = verb + ": expected a table name";
+            return false;
+        }
+        command.table = tokens[1].text;
+        return true;
+    };
+    auto parseId = [&](size_t index){
+        int id;
+        if (index >= tokens.size() || !parseInt(tokens[index].text, id) || id <= 0){
+            error = verb + ": expected a row id";
+            return false;
+        }
+        command.ids.push_back(id);
+        return true;
+    };
+
+    if (verb == "add"){
+        command.kind = BatchCommand::Kind::Add;
+        if (!parseTable() || !parseAssignments(tokens, 2, command.table, command.values, error)){
+            return false;
+        }
+        if (command.values.empty()){
+            error = "add: no columns given";
+            return false;
+        }
+    }else if (verb == "update"){
+        command.kind = BatchCommand::Kind::Update;
+        if (!parseTable() || !parseId(2) || !parseAssignments(tokens, 3, command.table, command.values, error)){
+            return false;
+        }
+        if (command.values.empty()){
+            error = "update: no columns given";
+            return false;
+        }
+    }else if (verb == "remove"){
+        command.kind = BatchCommand::Kind::Remove;
+        if (!parseTable() || !parseId(2)){
+            return false;
+        }
+        for (size_t index = 3; index < tokens.size(); ++index){
+            if (!parseId(index)){
+                return false;
+            }
+        }
+    }else if (verb == "move-stock"){
+        command.kind = BatchCommand::Kind::MoveStock;
+        command.table = "item";
+        if (!parseId(1)){
+            return false;
+        }
+        if (tokens.size() < 3 || !parseInt(tokens[2].text, command.quantity) || command.quantity == 0){
+            error = "move-stock: expected a non-zero quantity such as +5 or -3";
+            return false;
+        }
+        if (!parseAssignments(tokens, 3, command.table, command.values, error)){
+            return false;
+        }
+        for (const auto &[key, value] : command.values){
+            if (key != "user" && key != "remarks"){
+                error = "move-stock: unknown option \"" + key + "\"";
+                return false;
+            }
+        }
+        auto user = command.values.find("user");
+        if (user != command.values.end() && !holds_alternative<int>(user->second)){
+            error = "move-stock: user must be an id";
+            return false;
+        }
+    }else if (verb == "report"){
+        command.kind = BatchCommand::Kind::Report;
+        if (tokens.size() == 3 && tokens[1].text == "top_items"){
+            if (!parseInt(tokens[2].text, command.quantity) || command.quantity <= 0){
+                error = "report: expected a positive item count";
+                return false;
+            }
+        }else if (tokens.size() > 2){
+            error = "report: expected at most one report name";
+            return false;
+        }
+        if (tokens.size() >= 2){
+            command.table = tokens[1].text;
+        }
+    }else if (verb == "commit"){
+        command.kind = BatchCommand::Kind::Commit;
+        if (tokens.size() > 1){
+            error = "commit: takes no arguments";
+            return false;
+        }
+    }else{
+        error = "unknown command \"" + verb + "\"";
+        return false;
+    }
+    return true;
+}
+
+BatchRunner::BatchRunner(Database &database, const BatchOptions &options, ostream &output)
+    : database(database), options(options), output(output){
+    this->options.commitEvery = max<size_t>(1, options.commitEvery);
+    this->options.queueCapacity = max(this->options.commitEvery, options.queueCapacity);
+}
+
+void BatchRunner::parseInput(istream &input){
+    string line;
+    string error;
+    size_t number = 0;
+    size_t commands = 0;
+    size_t malformed = 0;
+
+    while (getline(input, line)){
+        ++number;
+        BatchCommand command;
+        if (!parse(line, command, error)){
+            if (error.empty()){
+                continue;
+            }
+            LOG_ERROR("Line %zu: %s", number, error.c_str());
+            ++malformed;
+            if (options.stopOnError){
+                break;
+            }
+            continue;
+        }
+        command.line = number;
+        ++commands;
+
+        unique_lock<std::mutex> lock(queueMutex);
+        queueCondition.wait(lock, [this]{ return queue.size() < options.queueCapacity || aborted; });
+        if (aborted){
+            break;
+        }
+        // The executor only ever waits on an empty queue.
+        const bool wasEmpty = queue.empty();
+        queue.push_back(move(command));
+        lock.unlock();
+        if (wasEmpty){
+            queueCondition.notify_all();
+        }
+    }
+
+    {
+        lock_guard<std::mutex> lock(queueMutex);
+        inputDone = true;
+        counters.lines = number;
+        counters.commands = commands;
+        parseFailures = malformed;
+    }
+    queueCondition.notify_all();
+}
+
+bool BatchRunner::nextGroup(vector<BatchCommand> &group){
+    group.clear();
+
+    unique_lock<std::mutex> lock(queueMutex);
+    queueCondition.wait(lock, [this]{ return !queue.empty() || inputDone; });
+    if (queue.empty()){
+        return false;
+    }
+
+    // Fill the group until it is full, input pauses past the linger time or a barrier comes up.
+    const auto deadline = chrono::steady_clock::now() + options.linger;
+    while (group.size() < options.commitEvery){
+        if (queue.empty() && !queueCondition.wait_until(lock, deadline, [this]{ return !queue.empty() || inputDone; })){
+            break;
+        }
+        if (queue.empty()){
+            break;
+        }
+
+        const BatchCommand::Kind kind = queue.front().kind;
+        const bool barrier = kind == BatchCommand::Kind::Report || kind == BatchCommand::Kind::Commit;
+        if (barrier && !group.empty()){
+            break;
+        }
+        group.push_back(move(queue.front()));
+        queue.pop_front();
+        if (barrier){
+            break;
+        }
+    }
+
+    lock.unlock();
+    queueCondition.notify_all();
+    return true;
+}
+
+bool BatchRunner::apply(Database &database, const BatchCommand &command, int userId){
+    FieldMapping<Row> mapping;
+    const Row *values = &command.values;
+    Row converted;
+    if (command.kind == BatchCommand::Kind::Add || command.kind == BatchCommand::Kind::Update){
+        for (const auto &[column, value] : command.values){
+            mapping.emplace(column, [column](const Row &row){ return row.at(column); });
+
+            // Commands decoded from the server protocol may carry amounts as numbers.
+            if (Database::isMoneyColumn(command.table, column) && !holds_alternative<Money>(value)){
+                Money amount;
+                if (!toMoney(value, amount)){
+                    LOG_ERROR("Line %zu: %s is not an amount", command.line, column.c_str());
+                    return false;
+                }
+                if (values != &converted){
+                    converted = command.values;
+                    values = &converted;
+                }
+                converted[column] = amount;
+            }
+        }
+    }
+
+    switch (command.kind){
+        case BatchCommand::Kind::Add:
+            return database.insert(command.table, *values, mapping);
+        case BatchCommand::Kind::Update:
+            return database.update(command.table, command.ids.front(), *values, mapping);
+        case BatchCommand::Kind::Remove:
+            return command.ids.size() == 1 ? database.remove(command.table, command.ids.front())
+                                           : database.removeMany(command.table, command.ids);
+        case BatchCommand::Kind::MoveStock:
+            return moveStock(database, command, userId);
+        default:
+            return true;
+    }
+}
+
+bool BatchRunner::moveStock(Database &database, const BatchCommand &command, int userId){
+    const int itemId = command.ids.front();
+    const int quantity = command.quantity;
+
+    // Stock never goes negative; the price trigger follows the new quantity.
+    vector<Row> rows;
+    if (!database.query("UPDATE item SET quantity = quantity + ?1 "
+                        "WHERE id = ?2 AND deleted_at IS NULL AND quantity + ?1 >= 0 RETURNING id;",
+                        {quantity, itemId}, rows)){
+        return false;
+    }
+    if (rows.empty()){
+        LOG_ERROR("Line %zu: item %d does not exist or has less than %d in stock", command.line, itemId, -quantity);
+        return false;
+    }
+
+    auto user = command.values.find("user");
+    auto remarks = command.values.find("remarks");
+    string remarksText;
+    if (remarks != command.values.end()){
+        visit([&](const auto &value){
+            if constexpr (is_same_v<decay_t<decltype(value)>, string>){
+                remarksText = value;
+            }else if constexpr (is_same_v<decay_t<decltype(value)>, Money>){
+                remarksText = value.toString();
+            }else{
+                remarksText = to_string(value);
+            }
+        }, remarks->second);
+    }
+
+    return database.query("INSERT INTO transaction_records (item_id, transaction_type, quantity, transaction_date, user_id, remarks) "
+                          "VALUES (?, ?, ?, datetime('now'), ?, NULLIF(?, ''));",
+                          {itemId, string(quantity > 0 ? "in" : "out"), abs(quantity),
+                           user != command.values.end() ? user->second : FieldValue(userId), remarksText},
+                          rows);
+}
+
+bool BatchRunner::report(const BatchCommand &command){
+    if (command.table == "top_items"){
+        vector<ValuedItem> items;
+        if (!mostValuableItems(database.getDBConnection(), command.quantity > 0 ? command.quantity : 10, items)){
+            return false;
+        }
+        for (const ValuedItem &item : items){
+            output << "top_items\t" << item.id << '\t' << item.name << '\t' << item.quantity << '\t' << item.value.toString() << '\n';
+        }
+        output.flush();
+        return true;
+    }
+
+    const ReportDag reports = inventoryReports(1);
+    ReportResults results;
+    if (!reports.runSequential(database.getDBConnection(), results)){
+        return false;
+    }
+    if (!command.table.empty() && !results.count(command.table)){
+        LOG_ERROR("Line %zu: unknown report \"%s\"", command.line, command.table.c_str());
+        return false;
+    }
+
+    // One tab-separated line per group: report, group, then the aggregates.
+    char number[32];
+    for (const auto &[name, table] : results){
+        if (!command.table.empty() && name != command.table){
+            continue;
+        }
+        for (const auto &[group, values] : table){
+            output << name << '\t' << group;
+            for (size_t column = 0; column < values.size(); ++column){
+                if (reports.isMoneyColumn(name, column)){
+                    output << '\t' << Money::fromUnits(llround(values[column])).toString();
+                    continue;
+                }
+                snprintf(number, sizeof(number), "%.15g", values[column]);
+                output << '\t' << number;
+            }
+            output << '\n';
+        }
+    }
+    output.flush();
+    return true;
+}
+
+bool BatchRunner::executeGroup(const vector<BatchCommand> &group){
+    vector<size_t> failedLines;
+    const bool committed = database.transaction([&]{
+        // The work may be re-run after SQLITE_BUSY.
+        failedLines.clear();
+        for (const BatchCommand &command : group){
+            // A savepoint per command lets a failure be skipped without losing the group.
+            if (options.stopOnError ? apply(database, command, options.userId)
+                                   : database.transaction([&]{ return apply(database, command, options.userId); })){
+                continue;
+            }
+            failedLines.push_back(command.line);
+            if (options.stopOnError){
+                return false;
+            }
+        }
+        return true;
+    });
+
+    for (size_t line : failedLines){
+        LOG_ERROR("Line %zu: command failed%s", line, committed ? " and was skipped" : "");
+    }
+    counters.failed += failedLines.size();
+
+    if (!committed){
+        LOG_ERROR("Lines %zu-%zu: transaction rolled back", group.front().line, group.back().line);
+        if (failedLines.empty()){
+            counters.failed += group.size();
+        }
+        return !options.stopOnError;
+    }
+    ++counters.transactions;
+    return true;
+}
+
+bool BatchRunner::run(istream &input){
+    counters = BatchStats();
+    parseFailures = 0;
+    queue.clear();
+    inputDone = false;
+    aborted = false;
+
+    thread parser(&BatchRunner::parseInput, this, ref(input));
+
+    vector<BatchCommand> group;
+    bool proceed = true;
+    while (proceed && nextGroup(group)){
+        switch (group.front().kind){
+            case BatchCommand::Kind::Commit:
+                break;
+            case BatchCommand::Kind::Report:
+                if (!report(group.front())){
+                    ++counters.failed;
+                    proceed = !options.stopOnError;
+                }
+                break;
+            default:
+                proceed = executeGroup(group);
+                break;
+        }
+    }
+
+    {
+        lock_guard<std::mutex> lock(queueMutex);
+        aborted = true;
+    }
+    queueCondition.notify_all();
+    parser.join();
+
+    counters.failed += parseFailures;
+    return counters.failed == 0;
+}
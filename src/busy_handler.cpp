@@ -0,0 +1,85 @@
+#include "busy_handler.hpp"
+#include <random>
+#include <thread>
+
+using namespace std;
+
+BusyHandler::BusyHandler(const BusyPolicy &policy) : policy(policy){
+}
+
+void BusyHandler::install(sqlite3 *connection){
+    sqlite3_busy_handler(connection, &BusyHandler::callback, this);
+}
+
+void BusyHandler::setPolicy(const BusyPolicy &newPolicy){
+    policy = newPolicy;
+}
+
+const BusyPolicy &BusyHandler::currentPolicy() const{
+    return policy;
+}
+
+chrono::microseconds BusyHandler::backoff(int attempt) const{
+    thread_local mt19937 random(random_device{}());
+
+    long long delay = policy.initialDelay.count();
+    for (int i = 0; i < attempt && delay < policy.maxDelay.count(); ++i){
+        delay *= 2;
+    }
+    if (delay > policy.maxDelay.count()){
+        delay = policy.maxDelay.count();
+    }
+
+    // Keep (1 - jitter) of the delay and randomize the rest.
+    long long fixed = static_cast<long long>(delay * (1.0 - policy.jitter));
+    uniform_int_distribution<long long> spread(0, delay - fixed);
+    return chrono::microseconds(fixed + spread(random));
+}
+
+int BusyHandler::callback(void *context, int attempts){
+    BusyHandler *handler = static_cast<BusyHandler*>(context);
+    handler->handlerCalls.fetch_add(1, memory_order_relaxed);
+
+    // SQLite restarts the count for every new lock wait; remember when this one began.
+    thread_local chrono::steady_clock::time_point waitStart;
+    auto now = chrono::steady_clock::now();
+    if (attempts == 0){
+        waitStart = now;
+    }
+
+    if (now - waitStart >= handler->policy.timeout){
+        handler->timeouts.fetch_add(1, memory_order_relaxed);
+        return 0;
+    }
+
+    chrono::microseconds delay = handler->backoff(attempts);
+    this_thread::sleep_for(delay);
+    handler->waitMicros.fetch_add(static_cast<uint64_t>(delay.count()), memory_order_relaxed);
+    return 1;
+}
+
+bool BusyHandler::waitBeforeRetry(int attempt){
+    if (attempt >= policy.maxRetries){
+        return false;
+    }
+
+    chrono::microseconds delay = backoff(attempt);
+    this_thread::sleep_for(delay);
+    retries.fetch_add(1, memory_order_relaxed);
+    waitMicros.fetch_add(static_cast<uint64_t>(delay.count()), memory_order_relaxed);
+    return true;
+}
+
+bool BusyHandler::retryable(int resultCode){
+    int primary = resultCode & 0xff;
+    return primary == SQLITE_BUSY || primary == SQLITE_LOCKED;
+}
+
+BusyStats BusyHandler::stats() const{
+    BusyStats snapshot;
+    snapshot.handlerCalls = handlerCalls.load(memory_order_relaxed);
+    snapshot.retries = retries.load(memory_order_relaxed);
+    snapshot.timeouts = timeouts.load(memory_order_relaxed);
+    snapshot.waitMicros = waitMicros.load(memory_order_relaxed);
+    return snapshot;
+}
@@ -0,0 +1,134 @@
+#include "category_tree.hpp"
+
+using namespace std;
+
+// Categories without items have no category_totals row, hence the LEFT JOIN.
+static const char *totalsQuery = "SELECT COUNT(*), COALESCE(SUM(t.items), 0), COALESCE(SUM(t.quantity), 0), COALESCE(SUM(t.valuation), 0) "
+                                 "FROM category_tree AS c LEFT JOIN category_totals AS t ON t.category_id = c.descendant_id "
+                                 "WHERE c.ancestor_id = ?;";
+
+static const char *childTotalsQuery = "SELECT c.ancestor_id, COUNT(*), COALESCE(SUM(t.items), 0), COALESCE(SUM(t.quantity), 0), COALESCE(SUM(t.valuation), 0) "
+                                      "FROM category AS k JOIN category_tree AS c ON c.ancestor_id = k.id "
+                                      "LEFT JOIN category_totals AS t ON t.category_id = c.descendant_id "
+                                      "WHERE k.parent_id IS ? GROUP BY c.ancestor_id;";
+
+CategoryTree::CategoryTree(Database &database) : database(database){
+}
+
+CategoryTree::~CategoryTree(){
+    sqlite3_finalize(totalsStmt);
+    sqlite3_finalize(childTotalsStmt);
+    sqlite3_finalize(subtreeStmt);
+    sqlite3_finalize(pathStmt);
+}
+
+sqlite3_stmt *CategoryTree::prepare(sqlite3_stmt *&stmt, const char *sql){
+    if (stmt){
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        return stmt;
+    }
+
+    sqlite3 *db = database.getDBConnection();
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error preparing category tree query: %s", sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        stmt = nullptr;
+    }
+    return stmt;
+}
+
+bool CategoryTree::collectIds(sqlite3_stmt *stmt, vector<int> &ids){
+    ids.clear();
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW){
+        ids.push_back(sqlite3_column_int(stmt, 0));
+    }
+    sqlite3_reset(stmt);
+
+    if (result != SQLITE_DONE){
+        LOG_ERROR("Error reading category tree: %s", sqlite3_errmsg(database.getDBConnection()));
+        return false;
+    }
+    return true;
+}
+
+bool CategoryTree::move(int categoryId, int parentId){
+    // The triggers rewrite the closure rows and reject a move into the subtree itself.
+    vector<Row> rows;
+    if (!database.query("UPDATE category SET parent_id = NULLIF(?, 0) WHERE id = ? RETURNING id;", {parentId, categoryId}, rows)){
+        return false;
+    }
+    if (rows.empty()){
+        LOG_ERROR("Category %d does not exist", categoryId);
+        return false;
+    }
+    return true;
+}
+
+bool CategoryTree::subtree(int categoryId, vector<int> &ids){
+    sqlite3_stmt *stmt = prepare(subtreeStmt, "SELECT descendant_id FROM category_tree WHERE ancestor_id = ? ORDER BY depth;");
+    if (!stmt){
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, categoryId);
+    return collectIds(stmt, ids);
+}
+
+bool CategoryTree::path(int categoryId, vector<int> &ids){
+    sqlite3_stmt *stmt = prepare(pathStmt, "SELECT ancestor_id FROM category_tree WHERE descendant_id = ? ORDER BY depth DESC;");
+    if (!stmt){
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, categoryId);
+    return collectIds(stmt, ids);
+}
+
+bool CategoryTree::totals(int categoryId, SubtreeTotals &totals){
+    sqlite3_stmt *stmt = prepare(totalsStmt, totalsQuery);
+    if (!stmt){
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, categoryId);
+
+    if (sqlite3_step(stmt) != SQLITE_ROW){
+        LOG_ERROR("Error reading category subtree totals: %s", sqlite3_errmsg(database.getDBConnection()));
+        sqlite3_reset(stmt);
+        return false;
+    }
+    totals.categories = sqlite3_column_int64(stmt, 0);
+    totals.items = sqlite3_column_int64(stmt, 1);
+    totals.quantity = sqlite3_column_int64(stmt, 2);
+    totals.valuation = Money::fromUnits(sqlite3_column_int64(stmt, 3));
+    sqlite3_reset(stmt);
+    return true;
+}
+
+bool CategoryTree::childTotals(int parentId, map<int, SubtreeTotals> &totals){
+    sqlite3_stmt *stmt = prepare(childTotalsStmt, childTotalsQuery);
+    if (!stmt){
+        return false;
+    }
+    if (parentId > 0){
+        sqlite3_bind_int(stmt, 1, parentId);
+    }else{
+        sqlite3_bind_null(stmt, 1);
+    }
+
+    totals.clear();
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW){
+        SubtreeTotals &child = totals[sqlite3_column_int(stmt, 0)];
+        child.categories = sqlite3_column_int64(stmt, 1);
+        child.items = sqlite3_column_int64(stmt, 2);
+        child.quantity = sqlite3_column_int64(stmt, 3);
+        child.valuation = Money::fromUnits(sqlite3_column_int64(stmt, 4));
+    }
+    sqlite3_reset(stmt);
+
+    if (result != SQLITE_DONE){
+        LOG_ERROR("Error reading category child totals: %s", sqlite3_errmsg(database.getDBConnection()));
+        return false;
+    }
+    return true;
+}
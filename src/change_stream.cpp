@@ -0,0 +1,177 @@
+#include "change_stream.hpp"
+
+using namespace std;
+
+// ChangeRing
+
+static size_t roundUpToPowerOfTwo(size_t value){
+    size_t result = 1;
+    while (result < value){
+        result <<= 1;
+    }
+    return result;
+}
+
+ChangeRing::ChangeRing(size_t capacity) : slots(roundUpToPowerOfTwo(capacity < 2 ? 2 : capacity)), mask(slots.size() - 1){
+}
+
+bool ChangeRing::push(const ChangeEvent &event){
+    size_t currentHead = head.load(memory_order_relaxed);
+    if (currentHead - tail.load(memory_order_acquire) >= slots.size()){
+        droppedEvents.fetch_add(1, memory_order_relaxed);
+        overflowFlag.store(true, memory_order_release);
+        return false;
+    }
+
+    slots[currentHead & mask] = event;
+    head.store(currentHead + 1, memory_order_release);
+    return true;
+}
+
+size_t ChangeRing::pop(vector<ChangeEvent> &out, size_t maxEvents){
+    size_t currentTail = tail.load(memory_order_relaxed);
+    size_t available = head.load(memory_order_acquire) - currentTail;
+    size_t count = available < maxEvents ? available : maxEvents;
+
+    for (size_t i = 0; i < count; ++i){
+        out.push_back(slots[(currentTail + i) & mask]);
+    }
+
+    tail.store(currentTail + count, memory_order_release);
+    return count;
+}
+
+uint64_t ChangeRing::dropped() const{
+    return droppedEvents.load(memory_order_relaxed);
+}
+
+bool ChangeRing::takeOverflow(){
+    return overflowFlag.exchange(false, memory_order_acq_rel);
+}
+
+// ChangeSubscription
+
+ChangeSubscription::ChangeSubscription(ChangeStream &stream, shared_ptr<ChangeRing> ring) : stream(stream), ring(move(ring)){
+    lastSequence = stream.lastSequence();
+}
+
+ChangeSubscription::~ChangeSubscription(){
+    stream.unsubscribe(ring);
+}
+
+size_t ChangeSubscription::poll(vector<ChangeEvent> &out, size_t maxEvents){
+    return ring->pop(out, maxEvents);
+}
+
+bool ChangeSubscription::wait(chrono::milliseconds timeout){
+    return stream.waitForCommit(lastSequence, timeout);
+}
+
+bool ChangeSubscription::overflowed(){
+    return ring->takeOverflow();
+}
+
+uint64_t ChangeSubscription::dropped() const{
+    return ring->dropped();
+}
+
+// ChangeStream
+
+ChangeStream::ChangeStream() : rings(make_shared<const vector<shared_ptr<ChangeRing>>>()){
+}
+
+void ChangeStream::recordChange(int operation, const char *tableName, sqlite3_int64 rowId){
+    const string &table = *tableNames.emplace(tableName).first;
+    pending.push_back({table.c_str(), operation, rowId, 0});
+}
+
+void ChangeStream::stage(){
+    // A COMMIT that failed with SQLITE_BUSY and is retried calls the hook again.
+    committing.insert(committing.end(), pending.begin(), pending.end());
+    pending.clear();
+}
+
+void ChangeStream::publish(){
+    if (committing.empty()){
+        return;
+    }
+
+    uint64_t transaction = sequence.load(memory_order_relaxed) + 1;
+    auto currentRings = atomic_load(&rings);
+
+    for (ChangeEvent &event : committing){
+        event.transaction = transaction;
+        for (const auto &ring : *currentRings){
+            ring->push(event);
+        }
+    }
+
+    publishedEvents.fetch_add(committing.size(), memory_order_relaxed);
+    committing.clear();
+    // Sequentially consistent so that a subscriber registering as a waiter
+    // either sees the new sequence or is seen here and notified.
+    sequence.store(transaction);
+
+    if (waiters.load() > 0){
+        lock_guard<mutex> lock(waitMutex);
+        waitCondition.notify_all();
+    }
+}
+
+void ChangeStream::rollback(){
+    discardedEvents.fetch_add(pending.size() + committing.size(), memory_order_relaxed);
+    pending.clear();
+    committing.clear();
+}
+
+unique_ptr<ChangeSubscription> ChangeStream::subscribe(size_t capacity){
+    auto ring = make_shared<ChangeRing>(capacity);
+    {
+        lock_guard<mutex> lock(subscribersMutex);
+        auto updated = make_shared<vector<shared_ptr<ChangeRing>>>(*atomic_load(&rings));
+        updated->push_back(ring);
+        atomic_store(&rings, shared_ptr<const vector<shared_ptr<ChangeRing>>>(updated));
+    }
+    return make_unique<ChangeSubscription>(*this, ring);
+}
+
+void ChangeStream::unsubscribe(const shared_ptr<ChangeRing> &ring){
+    lock_guard<mutex> lock(subscribersMutex);
+    auto updated = make_shared<vector<shared_ptr<ChangeRing>>>();
+    for (const auto &existing : *atomic_load(&rings)){
+        if (existing != ring){
+            updated->push_back(existing);
+        }
+    }
+    atomic_store(&rings, shared_ptr<const vector<shared_ptr<ChangeRing>>>(updated));
+}
+
+bool ChangeStream::waitForCommit(uint64_t &lastSeen, chrono::milliseconds timeout){
+    uint64_t current = sequence.load(memory_order_acquire);
+    if (current != lastSeen){
+        lastSeen = current;
+        return true;
+    }
+
+    waiters.fetch_add(1);
+    unique_lock<mutex> lock(waitMutex);
+    bool changed = waitCondition.wait_for(lock, timeout, [&]{
+        return sequence.load() != lastSeen;
+    });
+    waiters.fetch_sub(1);
+
+    lastSeen = sequence.load(memory_order_acquire);
+    return changed;
+}
+
+uint64_t ChangeStream::lastSequence() const{
+    return sequence.load(memory_order_acquire);
+}
+
+uint64_t ChangeStream::published() const{
+    return publishedEvents.load(memory_order_relaxed);
+}
+
+uint64_t ChangeStream::discarded() const{
+    return discardedEvents.load(memory_order_relaxed);
+}
@@ -0,0 +1,170 @@
+#include "compactor.hpp"
+
+using namespace std;
+
+Compactor::Compactor(const Database &database, const CompactorOptions &options) : options(options){
+    const string path = database.getDBPath();
+    if (path.empty()){
+        LOG_ERROR("Compactor needs a file-backed database");
+        return;
+    }
+
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK){
+        LOG_ERROR("Can't open database for compactor: %s", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        db = nullptr;
+        return;
+    }
+
+    // Yield quickly to the application's writers instead of queueing behind them.
+    sqlite3_busy_timeout(db, 50);
+    sqlite3_exec(db, "PRAGMA foreign_keys = ON;", nullptr, nullptr, nullptr);
+
+    // A tombstone may only go once nothing references it any more.
+    for (const string &table : options.tables){
+        string sql = "DELETE FROM " + table + " WHERE rowid IN (SELECT doomed.id FROM " + table +
+                     " AS doomed WHERE doomed.deleted_at IS NOT NULL AND doomed.deleted_at <= datetime('now', ?)";
+        for (const Database::ForeignKeyReference &reference : Database::referencingTables(db, table)){
+            sql += " AND NOT EXISTS (SELECT 1 FROM " + reference.table + " WHERE " + reference.table + "." +
+                   reference.column + " = doomed.id)";
+        }
+        sql += " LIMIT ?);";
+        purgeQueries.push_back(sql);
+    }
+
+    lastActivity = chrono::steady_clock::now();
+}
+
+Compactor::~Compactor(){
+    stop();
+    if (db){
+        sqlite3_close(db);
+    }
+}
+
+void Compactor::start(){
+    if (!db || worker.joinable()){
+        return;
+    }
+    {
+        lock_guard<mutex> lock(stateMutex);
+        stopping = false;
+    }
+    worker = thread(&Compactor::run, this);
+}
+
+void Compactor::stop(){
+    {
+        lock_guard<mutex> lock(stateMutex);
+        stopping = true;
+    }
+    stateCondition.notify_all();
+    if (worker.joinable()){
+        worker.join();
+    }
+}
+
+int Compactor::queryInt(const char *sql){
+    sqlite3_stmt *stmt;
+    int value = 0;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW){
+        value = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+bool Compactor::idle(){
+    // data_version changes whenever another connection commits.
+    int dataVersion = queryInt("PRAGMA data_version;");
+    auto now = chrono::steady_clock::now();
+
+    if (dataVersion != lastDataVersion){
+        lastDataVersion = dataVersion;
+        lastActivity = now;
+        return false;
+    }
+    return now - lastActivity >= options.idleThreshold;
+}
+
+size_t Compactor::runOnce(){
+    if (!db){
+        return 0;
+    }
+
+    const string retention = "-" + to_string(options.retention.count()) + " seconds";
+    size_t total = 0;
+
+    for (const string &sql : purgeQueries){
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK){
+            LOG_ERROR("Error preparing compactor purge: %s", sqlite3_errmsg(db));
+            continue;
+        }
+
+        sqlite3_bind_text(stmt, 1, retention.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, options.batchSize);
+
+        // Each step is its own small transaction; stop early if asked to.
+        while (true){
+            if (sqlite3_step(stmt) != SQLITE_DONE){
+                // Busy or locked: the application is writing, try again next pass.
+                break;
+            }
+            int deleted = sqlite3_changes(db);
+            sqlite3_reset(stmt);
+            total += static_cast<size_t>(deleted);
+
+            bool stopRequested;
+            {
+                lock_guard<mutex> lock(stateMutex);
+                stopRequested = stopping;
+            }
+            if (deleted < options.batchSize || stopRequested){
+                break;
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+    purged.fetch_add(total, memory_order_relaxed);
+
+    int freePages = queryInt("PRAGMA freelist_count;");
+    if (freePages >= options.freelistThreshold){
+        const string vacuum = "PRAGMA incremental_vacuum(" + to_string(options.vacuumPages) + ");";
+        if (sqlite3_exec(db, vacuum.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK){
+            int released = freePages - queryInt("PRAGMA freelist_count;");
+            vacuumed.fetch_add(static_cast<uint64_t>(released > 0 ? released : 0), memory_order_relaxed);
+        }
+    }
+
+    passes.fetch_add(1, memory_order_relaxed);
+    return total;
+}
+
+void Compactor::run(){
+    unique_lock<mutex> lock(stateMutex);
+    while (!stopping){
+        stateCondition.wait_for(lock, options.interval, [this]{ return stopping; });
+        if (stopping){
+            break;
+        }
+
+        lock.unlock();
+        if (idle()){
+            runOnce();
+        }
+        lock.lock();
+    }
+}
+
+uint64_t Compactor::purgedRows() const{
+    return purged.load(memory_order_relaxed);
+}
+
+uint64_t Compactor::vacuumedPages() const{
+    return vacuumed.load(memory_order_relaxed);
+}
+
+uint64_t Compactor::completedPasses() const{
+    return passes.load(memory_order_relaxed);
+}
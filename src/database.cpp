@@ -1,18 +1,51 @@
 #include "database.hpp"
+#include <algorithm>
+#include <cstring>
 #include <string>
+#include <strings.h>
 
 using namespace std;
 
 Database::Database(const string &dbName){
     if(sqlite3_open(dbName.c_str(), &db)){
-        cerr << "Can't open database" << sqlite3_errmsg(db) << endl;
+        LOG_ERROR("Can't open database: %s", sqlite3_errmsg(db));
     }
+
+    busyHandler.install(db);
+    sqlite3_update_hook(db, &Database::updateHook, this);
+    sqlite3_commit_hook(db, &Database::commitHook, this);
+    sqlite3_rollback_hook(db, &Database::rollbackHook, this);
+    sqlite3_wal_hook(db, &Database::walHook, this);
 }
 
 Database::~Database(){
+    for (auto &[sql, stmt] : statementCache){
+        sqlite3_finalize(stmt);
+    }
     sqlite3_close(db);
 }
 
+// Prices are MONEY: whole minor units, which the checks keep from being
+// written as REAL amounts by mistake. price is quantity * unit_price, kept by
+// the item_price triggers rather than as a generated column: the session
+// extension cannot build changesets for tables with generated columns, which
+// would stop replication of the item table.
+static const char *itemTableDefinition = "("
+                                         "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                                         "name TEXT NOT NULL, "
+                                         "description TEXT NOT NULL, "
+                                         "category_id INTEGRE NOT NULL, "
+                                         "quantity INTEGER NOT NULL, "
+                                         "unit_measurement TEXT NOT NULL, "
+                                         "unit_price MONEY NOT NULL CHECK (typeof(unit_price) = 'integer'), "
+                                         "price MONEY NOT NULL DEFAULT 0 CHECK (typeof(price) = 'integer'), "
+                                         "supplier_id INTEGER NOT NULL, "
+                                         "deleted_at TEXT, "
+                                         "sku TEXT, "
+                                         "FOREIGN KEY(category_id) REFERENCES category(id), "
+                                         "FOREIGN KEY(supplier_id) REFERENCES suppliers(id)"
+                                         ")";
+
 void Database::init(){
     // Initialize needed Table
     char *errMsg = nullptr;
@@ -22,20 +55,55 @@ void Database::init(){
     int execute_sql = sqlite3_exec(db, foreignKeySupport, 0, 0, &errMsg);
     
     if (execute_sql!= SQLITE_OK) {
-        cerr << "Error enabling foreign keys: " << errMsg << endl;
+        LOG_ERROR("Error enabling foreign keys: %s", errMsg);
+        sqlite3_free(errMsg);
+    }
+
+    // Incremental auto-vacuum lets the compactor return free pages in small
+    // steps. The mode only applies to a new file; converting an existing one
+    // takes a full, blocking VACUUM, which is left to enableIncrementalVacuum().
+    sqlite3_stmt *stmt;
+    int autoVacuum = 0;
+    bool hasSchema = false;
+    if (sqlite3_prepare_v2(db, "SELECT (SELECT auto_vacuum FROM pragma_auto_vacuum), EXISTS (SELECT 1 FROM sqlite_master);", -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW){
+        autoVacuum = sqlite3_column_int(stmt, 0);
+        hasSchema = sqlite3_column_int(stmt, 1) != 0;
+    }
+    sqlite3_finalize(stmt);
+
+    if (autoVacuum != 2 && hasSchema){
+        LOG_WARNING("Incremental vacuum is not enabled on this database; free pages are kept until it is converted with --vacuum-incremental");
+    }else if (autoVacuum != 2){
+        execute_sql = sqlite3_exec(db, "PRAGMA auto_vacuum = INCREMENTAL;", nullptr, nullptr, &errMsg);
+        if (execute_sql != SQLITE_OK) {
+            LOG_ERROR("Error enabling incremental vacuum: %s", errMsg);
+            sqlite3_free(errMsg);
+        }
+    }
+
+    // Write-ahead logging lets readers proceed during writes; checkpoints are
+    // left to the MaintenanceScheduler and SQLite's automatic checkpointing.
+    // Commits stay durable unless setFastCommit() asked otherwise.
+    execute_sql = sqlite3_exec(db, "PRAGMA journal_mode = WAL;", nullptr, nullptr, &errMsg);
+    if (execute_sql != SQLITE_OK) {
+        LOG_ERROR("Error enabling WAL: %s", errMsg);
         sqlite3_free(errMsg);
     }
+    setFastCommit(fastCommit);
 
     // Category Table
     const char *categoryTableQuery = "CREATE TABLE IF NOT EXISTS category ("
                                      "id INTEGER PRIMARY KEY AUTOINCREMENT, "
                                      "name TEXT NOT NULL, "
-                                     "description TEXT NOT NULL);";
+                                     "description TEXT NOT NULL, "
+                                     "deleted_at TEXT, "
+                                     "parent_id INTEGER REFERENCES category(id));";
     
 
     execute_sql = sqlite3_exec(db, categoryTableQuery, nullptr, nullptr, &errMsg);
     if (execute_sql != SQLITE_OK) {
-        cerr << "Error Creating Category Table: " << errMsg << std::endl;
+        LOG_ERROR("Error Creating Category Table: %s", errMsg);
         sqlite3_free(errMsg);
     }
 
@@ -45,35 +113,67 @@ void Database::init(){
                                      "name TEXT NOT NULL, "
                                      "address TEXT NOT NULL, "
                                      "phone TEXT, "
-                                     "email TEXT);";
+                                     "email TEXT, "
+                                     "deleted_at TEXT);";
     
     execute_sql = sqlite3_exec(db, supplierTableQuery, nullptr, nullptr, &errMsg);
     if (execute_sql != SQLITE_OK) {
-        cerr << "Error Creating Supplier Table: " << errMsg << std::endl;
+        LOG_ERROR("Error Creating Supplier Table: %s", errMsg);
         sqlite3_free(errMsg);
     }
 
 
     // Items Table
-    const char *itemTableQuery = "CREATE TABLE IF NOT EXISTS item ("
-                                 "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-                                 "name TEXT NOT NULL, "
-                                 "description TEXT NOT NULL, "
-                                 "category_id INTEGRE NOT NULL, "
-                                 "quantity INTEGER NOT NULL, "
-                                 "unit_measurement TEXT NOT NULL, "
-                                 "unit_price REAL NOT NULL, "
-                                 "price REAL NOT NULL, "
-                                 "supplier_id INTEGER NOT NULL, "
-                                 "FOREIGN KEY(category_id) REFERENCES category(id), "
-                                 "FOREIGN KEY(supplier_id) REFERENCES suppliers(id)"
-                                 ");";
-    execute_sql = sqlite3_exec(db, itemTableQuery, nullptr, nullptr, &errMsg);
+    const string itemTableQuery = string("CREATE TABLE IF NOT EXISTS item ") + itemTableDefinition + ";";
+    execute_sql = sqlite3_exec(db, itemTableQuery.c_str(), nullptr, nullptr, &errMsg);
     if (execute_sql != SQLITE_OK) {
-        cerr << "Error Creating Items Table: " << errMsg << std::endl;
+        LOG_ERROR("Error Creating Items Table: %s", errMsg);
         sqlite3_free(errMsg);
     }    
 
+    // Databases created before prices became MONEY hold REAL amounts, and
+    // for a while price was a generated column; rebuild the table with whole
+    // cents and a plain price, after adding the columns it is copied from.
+    addColumnIfMissing("item", "deleted_at", "TEXT");
+    addColumnIfMissing("item", "sku", "TEXT");
+    const bool moneyPrices = columnType("item", "unit_price") == "MONEY";
+    if (!moneyPrices || columnIsGenerated("item", "price")){
+        const string unitPrice = moneyPrices ? string("unit_price")
+                               : "CAST(ROUND(unit_price * " + to_string(Money::scale) + ") AS INTEGER)";
+        rebuildTable("item", itemTableDefinition,
+                     "id, name, description, category_id, quantity, unit_measurement, unit_price, price, supplier_id, deleted_at, sku",
+                     "id, name, description, category_id, quantity, unit_measurement, " + unitPrice + ", quantity * " + unitPrice + ", supplier_id, deleted_at, sku");
+    }
+
+    // price follows quantity and unit_price: the triggers recompute it after
+    // every write and refuse a price written directly that disagrees. Like the
+    // other triggers they go away when the table is rebuilt, and prices are
+    // recomputed whenever they are missing.
+    bool priceTracked = false;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'trigger' AND name = 'item_price_insert';", -1, &stmt, nullptr) == SQLITE_OK){
+        priceTracked = sqlite3_step(stmt) == SQLITE_ROW;
+    }
+    sqlite3_finalize(stmt);
+
+    const char *itemPriceQuery =
+        "BEGIN IMMEDIATE; "
+        "UPDATE item SET price = quantity * unit_price WHERE price IS NOT quantity * unit_price; "
+        "CREATE TRIGGER item_price_insert AFTER INSERT ON item WHEN NEW.price IS NOT NEW.quantity * NEW.unit_price BEGIN "
+        "UPDATE item SET price = NEW.quantity * NEW.unit_price WHERE id = NEW.id; "
+        "END; "
+        "CREATE TRIGGER item_price_update AFTER UPDATE OF quantity, unit_price ON item WHEN NEW.price IS NOT NEW.quantity * NEW.unit_price BEGIN "
+        "UPDATE item SET price = NEW.quantity * NEW.unit_price WHERE id = NEW.id; "
+        "END; "
+        "CREATE TRIGGER item_price_check BEFORE UPDATE OF price ON item WHEN NEW.price IS NOT NEW.quantity * NEW.unit_price BEGIN "
+        "SELECT RAISE(ABORT, 'item.price is quantity * unit_price and cannot be written directly'); "
+        "END; "
+        "COMMIT;";
+    if (!priceTracked && sqlite3_exec(db, itemPriceQuery, nullptr, nullptr, &errMsg) != SQLITE_OK){
+        LOG_ERROR("Error Creating Item Price Triggers: %s", errMsg);
+        sqlite3_free(errMsg);
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+
     const char *userTableQuery = "CREATE TABLE IF NOT EXISTS user ("
                                  "id INTEGER PRIMARY KEY AUTOINCREMENT, "
                                  "username TEXT NOT NULL, "
@@ -84,7 +184,7 @@ void Database::init(){
 
     execute_sql = sqlite3_exec(db, userTableQuery, nullptr, nullptr, &errMsg);
     if (execute_sql != SQLITE_OK) {
-        cerr << "Error Creating User Table: " << errMsg << std::endl;
+        LOG_ERROR("Error Creating User Table: %s", errMsg);
         sqlite3_free(errMsg);
     }
 
@@ -101,11 +201,897 @@ void Database::init(){
                                         ");";
     execute_sql = sqlite3_exec(db, transactionTableQuery, nullptr, nullptr, &errMsg);
     if (execute_sql != SQLITE_OK) {
-        cerr << "Error Creating Transaction Table: " << errMsg << std::endl;
+        LOG_ERROR("Error Creating Transaction Table: %s", errMsg);
         sqlite3_free(errMsg);
     }
+
+    // Soft delete: tables created before the column existed are upgraded in place
+    addColumnIfMissing("category", "deleted_at", "TEXT");
+    addColumnIfMissing("suppliers", "deleted_at", "TEXT");
+
+    // Natural keys used as upsert conflict targets. They only cover live rows,
+    // so a soft-deleted row does not hold on to its key until it is purged;
+    // indexes created before that are replaced.
+    bool naturalKeysPartial = false;
+    if (sqlite3_prepare_v2(db, "SELECT COUNT(*) = 2 FROM sqlite_master WHERE type = 'index' AND name IN ('idx_item_name_supplier', 'idx_suppliers_name') AND sql LIKE '%WHERE deleted_at IS NULL';", -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW){
+        naturalKeysPartial = sqlite3_column_int(stmt, 0) != 0;
+    }
+    sqlite3_finalize(stmt);
+
+    if (!naturalKeysPartial){
+        sqlite3_exec(db, "DROP INDEX IF EXISTS idx_item_name_supplier; DROP INDEX IF EXISTS idx_suppliers_name;", nullptr, nullptr, nullptr);
+    }
+    const char *naturalKeyIndexQuery = "CREATE UNIQUE INDEX IF NOT EXISTS idx_item_name_supplier ON item(name, supplier_id) WHERE deleted_at IS NULL; "
+                                       "CREATE UNIQUE INDEX IF NOT EXISTS idx_suppliers_name ON suppliers(name) WHERE deleted_at IS NULL;";
+    execute_sql = sqlite3_exec(db, naturalKeyIndexQuery, nullptr, nullptr, &errMsg);
+    if (execute_sql != SQLITE_OK) {
+        LOG_ERROR("Error Creating Natural Key Indexes: %s", errMsg);
+        sqlite3_free(errMsg);
+    }
+
+    // Child-key indexes, so foreign key checks on delete are index lookups
+    const char *childKeyIndexQuery = "CREATE INDEX IF NOT EXISTS idx_item_category ON item(category_id); "
+                                     "CREATE INDEX IF NOT EXISTS idx_item_supplier ON item(supplier_id); "
+                                     "CREATE INDEX IF NOT EXISTS idx_transaction_item ON transaction_records(item_id); "
+                                     "CREATE INDEX IF NOT EXISTS idx_transaction_user ON transaction_records(user_id);";
+    execute_sql = sqlite3_exec(db, childKeyIndexQuery, nullptr, nullptr, &errMsg);
+    if (execute_sql != SQLITE_OK) {
+        LOG_ERROR("Error Creating Child Key Indexes: %s", errMsg);
+        sqlite3_free(errMsg);
+    }
+
+    // Partial indexes: live rows for listings, tombstones for the compactor
+    const char *softDeleteIndexQuery = "CREATE INDEX IF NOT EXISTS idx_item_active_name ON item(name) WHERE deleted_at IS NULL; "
+                                       "CREATE INDEX IF NOT EXISTS idx_category_active_name ON category(name) WHERE deleted_at IS NULL; "
+                                       "CREATE INDEX IF NOT EXISTS idx_suppliers_active_name ON suppliers(name) WHERE deleted_at IS NULL; "
+                                       "CREATE INDEX IF NOT EXISTS idx_item_deleted ON item(deleted_at) WHERE deleted_at IS NOT NULL; "
+                                       "CREATE INDEX IF NOT EXISTS idx_category_deleted ON category(deleted_at) WHERE deleted_at IS NOT NULL; "
+                                       "CREATE INDEX IF NOT EXISTS idx_suppliers_deleted ON suppliers(deleted_at) WHERE deleted_at IS NOT NULL;";
+    execute_sql = sqlite3_exec(db, softDeleteIndexQuery, nullptr, nullptr, &errMsg);
+    if (execute_sql != SQLITE_OK) {
+        LOG_ERROR("Error Creating Soft Delete Indexes: %s", errMsg);
+        sqlite3_free(errMsg);
+    }
+
+    // Search-as-you-type: case-insensitive name prefixes become NOCASE range scans
+    const char *searchIndexQuery = "CREATE INDEX IF NOT EXISTS idx_item_name_nocase ON item(name COLLATE NOCASE) WHERE deleted_at IS NULL;";
+    execute_sql = sqlite3_exec(db, searchIndexQuery, nullptr, nullptr, &errMsg);
+    if (execute_sql != SQLITE_OK) {
+        LOG_ERROR("Error Creating Search Index: %s", errMsg);
+        sqlite3_free(errMsg);
+    }
+
+    // SKU / barcode: unique when set, several items may still have none
+    const char *skuIndexQuery = "CREATE UNIQUE INDEX IF NOT EXISTS idx_item_sku ON item(sku) WHERE sku IS NOT NULL;";
+    execute_sql = sqlite3_exec(db, skuIndexQuery, nullptr, nullptr, &errMsg);
+    if (execute_sql != SQLITE_OK) {
+        LOG_ERROR("Error Creating SKU Index: %s", errMsg);
+        sqlite3_free(errMsg);
+    }
+
+    // Valuation: live items by price for the most valuable items report
+    const char *valuationIndexQuery = "CREATE INDEX IF NOT EXISTS idx_item_active_price ON item(price) WHERE deleted_at IS NULL;";
+    execute_sql = sqlite3_exec(db, valuationIndexQuery, nullptr, nullptr, &errMsg);
+    if (execute_sql != SQLITE_OK) {
+        LOG_ERROR("Error Creating Valuation Index: %s", errMsg);
+        sqlite3_free(errMsg);
+    }
+
+    // Per-category totals of the live items, kept current by triggers. The
+    // triggers go away with the item table when it is rebuilt, so the totals
+    // are recomputed whenever they are missing. NEW.price may not have been
+    // recomputed yet when they fire, so they value new rows from their stock.
+    bool totalsTracked = false;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'trigger' AND name = 'item_totals_insert';", -1, &stmt, nullptr) == SQLITE_OK){
+        totalsTracked = sqlite3_step(stmt) == SQLITE_ROW;
+    }
+    sqlite3_finalize(stmt);
+
+    const char *categoryTotalsQuery =
+        "BEGIN IMMEDIATE; "
+        "CREATE TABLE IF NOT EXISTS category_totals ("
+        "category_id INTEGER PRIMARY KEY, "
+        "valuation MONEY NOT NULL CHECK (typeof(valuation) = 'integer'), "
+        "quantity INTEGER NOT NULL, "
+        "items INTEGER NOT NULL); "
+        "DELETE FROM category_totals; "
+        "INSERT INTO category_totals (category_id, valuation, quantity, items) "
+        "SELECT category_id, SUM(price), SUM(quantity), COUNT(*) FROM item WHERE deleted_at IS NULL GROUP BY category_id; "
+        "CREATE TRIGGER item_totals_insert AFTER INSERT ON item WHEN NEW.deleted_at IS NULL BEGIN "
+        "INSERT INTO category_totals (category_id, valuation, quantity, items) VALUES (NEW.category_id, NEW.quantity * NEW.unit_price, NEW.quantity, 1) "
+        "ON CONFLICT (category_id) DO UPDATE SET valuation = valuation + excluded.valuation, quantity = quantity + excluded.quantity, items = items + 1; "
+        "END; "
+        "CREATE TRIGGER item_totals_delete AFTER DELETE ON item WHEN OLD.deleted_at IS NULL BEGIN "
+        "UPDATE category_totals SET valuation = valuation - OLD.price, quantity = quantity - OLD.quantity, items = items - 1 "
+        "WHERE category_id = OLD.category_id; "
+        "END; "
+        // A stock movement stays in its category: one row is adjusted in place.
+        "CREATE TRIGGER item_totals_update AFTER UPDATE OF category_id, quantity, unit_price, deleted_at ON item "
+        "WHEN OLD.category_id = NEW.category_id AND OLD.deleted_at IS NULL AND NEW.deleted_at IS NULL BEGIN "
+        "UPDATE category_totals SET valuation = valuation + NEW.quantity * NEW.unit_price - OLD.price, quantity = quantity + NEW.quantity - OLD.quantity "
+        "WHERE category_id = NEW.category_id; "
+        "END; "
+        "CREATE TRIGGER item_totals_move AFTER UPDATE OF category_id, quantity, unit_price, deleted_at ON item "
+        "WHEN NOT (OLD.category_id = NEW.category_id AND OLD.deleted_at IS NULL AND NEW.deleted_at IS NULL) BEGIN "
+        "UPDATE category_totals SET valuation = valuation - OLD.price, quantity = quantity - OLD.quantity, items = items - 1 "
+        "WHERE OLD.deleted_at IS NULL AND category_id = OLD.category_id; "
+        "INSERT INTO category_totals (category_id, valuation, quantity, items) SELECT NEW.category_id, NEW.quantity * NEW.unit_price, NEW.quantity, 1 "
+        "WHERE NEW.deleted_at IS NULL "
+        "ON CONFLICT (category_id) DO UPDATE SET valuation = valuation + excluded.valuation, quantity = quantity + excluded.quantity, items = items + 1; "
+        "END; "
+        "COMMIT;";
+    if (!totalsTracked && sqlite3_exec(db, categoryTotalsQuery, nullptr, nullptr, &errMsg) != SQLITE_OK){
+        LOG_ERROR("Error Creating Category Totals: %s", errMsg);
+        sqlite3_free(errMsg);
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+
+    // Category hierarchy: parent_id links, plus a closure table holding one row
+    // per (ancestor, descendant) pair, so subtree queries are a single range
+    // scan. Like the totals, it is kept by triggers and rebuilt from parent_id
+    // when they are missing.
+    addColumnIfMissing("category", "parent_id", "INTEGER REFERENCES category(id)");
+    const char *categoryParentIndexQuery = "CREATE INDEX IF NOT EXISTS idx_category_parent ON category(parent_id);";
+    execute_sql = sqlite3_exec(db, categoryParentIndexQuery, nullptr, nullptr, &errMsg);
+    if (execute_sql != SQLITE_OK) {
+        LOG_ERROR("Error Creating Category Parent Index: %s", errMsg);
+        sqlite3_free(errMsg);
+    }
+
+    bool treeTracked = false;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'trigger' AND name = 'category_tree_insert';", -1, &stmt, nullptr) == SQLITE_OK){
+        treeTracked = sqlite3_step(stmt) == SQLITE_ROW;
+    }
+    sqlite3_finalize(stmt);
+
+    const char *categoryTreeQuery =
+        "BEGIN IMMEDIATE; "
+        "CREATE TABLE IF NOT EXISTS category_tree ("
+        "ancestor_id INTEGER NOT NULL, "
+        "descendant_id INTEGER NOT NULL, "
+        "depth INTEGER NOT NULL, "
+        "PRIMARY KEY (ancestor_id, descendant_id)) WITHOUT ROWID; "
+        "CREATE INDEX IF NOT EXISTS idx_category_tree_descendant ON category_tree(descendant_id, depth); "
+        "DELETE FROM category_tree; "
+        "WITH RECURSIVE paths(ancestor_id, descendant_id, depth) AS ("
+        "SELECT id, id, 0 FROM category "
+        "UNION ALL SELECT p.ancestor_id, c.id, p.depth + 1 FROM paths AS p JOIN category AS c ON c.parent_id = p.descendant_id) "
+        "INSERT INTO category_tree (ancestor_id, descendant_id, depth) SELECT ancestor_id, descendant_id, depth FROM paths; "
+        "CREATE TRIGGER category_tree_insert AFTER INSERT ON category BEGIN "
+        "INSERT INTO category_tree (ancestor_id, descendant_id, depth) "
+        "SELECT ancestor_id, NEW.id, depth + 1 FROM category_tree WHERE descendant_id = NEW.parent_id "
+        "UNION ALL SELECT NEW.id, NEW.id, 0; "
+        "END; "
+        "CREATE TRIGGER category_tree_cycle BEFORE UPDATE OF parent_id ON category "
+        "WHEN EXISTS (SELECT 1 FROM category_tree WHERE ancestor_id = NEW.id AND descendant_id = NEW.parent_id) BEGIN "
+        "SELECT RAISE(ABORT, 'a category cannot move into its own subtree'); "
+        "END; "
+        // Moving a subtree: detach it from its old ancestors, then pair every
+        // ancestor of the new parent with every node of the subtree.
+        "CREATE TRIGGER category_tree_move AFTER UPDATE OF parent_id ON category WHEN OLD.parent_id IS NOT NEW.parent_id BEGIN "
+        "DELETE FROM category_tree "
+        "WHERE descendant_id IN (SELECT descendant_id FROM category_tree WHERE ancestor_id = NEW.id) "
+        "AND ancestor_id IN (SELECT ancestor_id FROM category_tree WHERE descendant_id = NEW.id AND depth > 0); "
+        "INSERT INTO category_tree (ancestor_id, descendant_id, depth) "
+        "SELECT above.ancestor_id, below.descendant_id, above.depth + below.depth + 1 "
+        "FROM category_tree AS above JOIN category_tree AS below "
+        "WHERE above.descendant_id = NEW.parent_id AND below.ancestor_id = NEW.id; "
+        "END; "
+        "CREATE TRIGGER category_tree_delete AFTER DELETE ON category BEGIN "
+        "DELETE FROM category_tree WHERE descendant_id = OLD.id; "
+        "END; "
+        "COMMIT;";
+    if (!treeTracked && sqlite3_exec(db, categoryTreeQuery, nullptr, nullptr, &errMsg) != SQLITE_OK){
+        LOG_ERROR("Error Creating Category Tree: %s", errMsg);
+        sqlite3_free(errMsg);
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+
+    // Supplier price lists: any number of suppliers per item, each with its
+    // own price, lead time and minimum order. item.supplier_id stays the
+    // item's default supplier. The (item_id, unit_price) index serves the
+    // cheapest-offer lookups, the supplier index the foreign key checks.
+    const char *supplierPricesQuery = "CREATE TABLE IF NOT EXISTS supplier_prices ("
+                                      "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                                      "supplier_id INTEGER NOT NULL REFERENCES suppliers(id), "
+                                      "item_id INTEGER NOT NULL REFERENCES item(id), "
+                                      "unit_price MONEY NOT NULL CHECK (typeof(unit_price) = 'integer'), "
+                                      "lead_time_days INTEGER NOT NULL DEFAULT 0 CHECK (lead_time_days >= 0), "
+                                      "minimum_order INTEGER NOT NULL DEFAULT 1 CHECK (minimum_order >= 1), "
+                                      "UNIQUE (item_id, supplier_id)); "
+                                      "CREATE INDEX IF NOT EXISTS idx_supplier_prices_item_price ON supplier_prices(item_id, unit_price); "
+                                      "CREATE INDEX IF NOT EXISTS idx_supplier_prices_supplier ON supplier_prices(supplier_id);";
+    execute_sql = sqlite3_exec(db, supplierPricesQuery, nullptr, nullptr, &errMsg);
+    if (execute_sql != SQLITE_OK) {
+        LOG_ERROR("Error Creating Supplier Prices Table: %s", errMsg);
+        sqlite3_free(errMsg);
+    }
+}
+
+void Database::addColumnIfMissing(const string &tableName, const string &columnName, const string &definition){
+    sqlite3_stmt *stmt;
+    bool exists = false;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM pragma_table_info(?) WHERE name = ?;", -1, &stmt, nullptr) == SQLITE_OK){
+        sqlite3_bind_text(stmt, 1, tableName.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, columnName.c_str(), -1, SQLITE_TRANSIENT);
+        exists = sqlite3_step(stmt) == SQLITE_ROW;
+    }
+    sqlite3_finalize(stmt);
+
+    if (exists){
+        return;
+    }
+
+    char *errMsg = nullptr;
+    const string sql = "ALTER TABLE " + tableName + " ADD COLUMN " + columnName + " " + definition + ";";
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK){
+        LOG_ERROR("Error adding column %s.%s: %s", tableName.c_str(), columnName.c_str(), errMsg);
+        sqlite3_free(errMsg);
+    }
+}
+
+string Database::columnType(const string &tableName, const string &columnName){
+    sqlite3_stmt *stmt;
+    string type;
+    if (sqlite3_prepare_v2(db, "SELECT type FROM pragma_table_xinfo(?) WHERE name = ?;", -1, &stmt, nullptr) == SQLITE_OK){
+        sqlite3_bind_text(stmt, 1, tableName.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, columnName.c_str(), -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt) == SQLITE_ROW){
+            type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        }
+    }
+    sqlite3_finalize(stmt);
+    return type;
+}
+
+bool Database::columnIsGenerated(const string &tableName, const string &columnName){
+    sqlite3_stmt *stmt;
+    bool generated = false;
+    // table_xinfo reports virtual generated columns as hidden = 2 and stored ones as 3.
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM pragma_table_xinfo(?) WHERE name = ? AND hidden IN (2, 3);", -1, &stmt, nullptr) == SQLITE_OK){
+        sqlite3_bind_text(stmt, 1, tableName.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, columnName.c_str(), -1, SQLITE_TRANSIENT);
+        generated = sqlite3_step(stmt) == SQLITE_ROW;
+    }
+    sqlite3_finalize(stmt);
+    return generated;
+}
+
+bool Database::rebuildTable(const string &tableName, const string &definition, const string &columns, const string &select){
+    const string rebuilt = tableName + "_rebuild";
+    const string sql = "BEGIN IMMEDIATE; "
+                       "CREATE TABLE " + rebuilt + " " + definition + "; "
+                       "INSERT INTO " + rebuilt + " (" + columns + ") SELECT " + select + " FROM " + tableName + "; "
+                       "DELETE FROM sqlite_sequence WHERE name = '" + rebuilt + "'; "
+                       "INSERT INTO sqlite_sequence (name, seq) SELECT '" + rebuilt + "', seq FROM sqlite_sequence WHERE name = '" + tableName + "'; "
+                       "DROP TABLE " + tableName + "; "
+                       "ALTER TABLE " + rebuilt + " RENAME TO " + tableName + "; "
+                       "COMMIT;";
+
+    // Foreign keys are switched off around the transaction; the pragma is a no-op inside one.
+    char *errMsg = nullptr;
+    sqlite3_exec(db, "PRAGMA foreign_keys = OFF;", nullptr, nullptr, nullptr);
+    bool rebuiltTable = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) == SQLITE_OK;
+    if (!rebuiltTable){
+        LOG_ERROR("Error rebuilding table %s: %s", tableName.c_str(), errMsg);
+        sqlite3_free(errMsg);
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+    sqlite3_exec(db, "PRAGMA foreign_keys = ON;", nullptr, nullptr, nullptr);
+    return rebuiltTable;
+}
+
+bool Database::isDerivedColumn(const string &tableName, const string &columnName){
+    return tableName == "item" && columnName == "price";
+}
+
+bool Database::isSoftDeleteTable(const string &tableName){
+    return tableName == "item" || tableName == "category" || tableName == "suppliers";
+}
+
+bool Database::isMoneyColumn(const string &tableName, const string &columnName){
+    return (tableName == "item" && (columnName == "unit_price" || columnName == "price")) ||
+           (tableName == "supplier_prices" && columnName == "unit_price");
 }
 
 sqlite3 *Database::getDBConnection() const{
     return db;
-}
\ No newline at end of file
+}
+
+string Database::getDBPath() const{
+    const char *path = sqlite3_db_filename(db, "main");
+    return path ? path : "";
+}
+
+bool Database::remove(const string &tableName, const int &id){
+    CapturedOperation captured(*this, TraceOp::Remove, tableName);
+    if (captured){
+        captured.record.values.emplace_back(std::in_place_type<int>, id);
+    }
+    sqlite3_stmt *stmt = prepareCached("DELETE FROM " + tableName + " WHERE id = ?;");
+    if (!stmt){
+        LOG_ERROR("Error preparing DELETE statement: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    sqlite3_bind_int(stmt, 1, id);
+
+    if (step(stmt) != SQLITE_DONE){
+        LOG_ERROR("Error executing DELETE statement: %s", sqlite3_errmsg(db));
+        releaseCached(stmt);
+        return false;
+    }
+
+    if (sqlite3_changes(db) == 0){
+        LOG_WARNING("No rows were deleted. Check if the ID exists.");
+    }
+
+    releaseCached(stmt);
+    captured.succeeded();
+    return true;
+}
+
+bool Database::softRemove(const string &tableName, const int &id){
+    CapturedOperation captured(*this, TraceOp::SoftRemove, tableName);
+    if (captured){
+        captured.record.values.emplace_back(std::in_place_type<int>, id);
+    }
+    sqlite3_stmt *stmt = prepareCached("UPDATE " + tableName + " SET deleted_at = datetime('now') WHERE id = ? AND deleted_at IS NULL;");
+    if (!stmt){
+        LOG_ERROR("Error preparing soft delete statement: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    sqlite3_bind_int(stmt, 1, id);
+
+    if (step(stmt) != SQLITE_DONE){
+        LOG_ERROR("Error executing soft delete statement: %s", sqlite3_errmsg(db));
+        releaseCached(stmt);
+        return false;
+    }
+
+    if (sqlite3_changes(db) == 0){
+        LOG_WARNING("No rows were deleted. Check if the ID exists.");
+    }
+
+    releaseCached(stmt);
+    captured.succeeded();
+    return true;
+}
+
+bool Database::restore(const string &tableName, const int &id){
+    CapturedOperation captured(*this, TraceOp::Restore, tableName);
+    if (captured){
+        captured.record.values.emplace_back(std::in_place_type<int>, id);
+    }
+    sqlite3_stmt *stmt = prepareCached("UPDATE " + tableName + " SET deleted_at = NULL WHERE id = ?;");
+    if (!stmt){
+        LOG_ERROR("Error preparing restore statement: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    sqlite3_bind_int(stmt, 1, id);
+
+    if (step(stmt) != SQLITE_DONE){
+        LOG_ERROR("Error executing restore statement: %s", sqlite3_errmsg(db));
+        releaseCached(stmt);
+        return false;
+    }
+
+    releaseCached(stmt);
+    captured.succeeded();
+    return true;
+}
+
+vector<Database::ForeignKeyReference> Database::referencingTables(sqlite3 *connection, const string &tableName){
+    vector<ForeignKeyReference> references;
+
+    sqlite3_stmt *stmt;
+    const char *query = "SELECT m.name, f.\"from\" FROM sqlite_master AS m, pragma_foreign_key_list(m.name) AS f "
+                        "WHERE m.type = 'table' AND f.\"table\" = ? COLLATE NOCASE AND f.on_delete IN ('NO ACTION', 'RESTRICT');";
+    if (sqlite3_prepare_v2(connection, query, -1, &stmt, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error reading foreign keys: %s", sqlite3_errmsg(connection));
+        return references;
+    }
+
+    sqlite3_bind_text(stmt, 1, tableName.c_str(), -1, SQLITE_TRANSIENT);
+    while (sqlite3_step(stmt) == SQLITE_ROW){
+        references.push_back({reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)),
+                              reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1))});
+    }
+
+    sqlite3_finalize(stmt);
+    return references;
+}
+
+bool Database::removeMany(const string &tableName, const vector<int> &ids, bool cascade, size_t *removedCount){
+    if (removedCount){
+        *removedCount = 0;
+    }
+    if (ids.empty()){
+        return true;
+    }
+
+    CapturedOperation captured(*this, TraceOp::RemoveMany, tableName);
+    if (captured){
+        captured.record.values.assign(ids.begin(), ids.end());
+        captured.record.cascade = cascade;
+    }
+
+    auto execute = [this](const string &sql){
+        char *errMsg = nullptr;
+        if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK){
+            LOG_ERROR("Error executing \"%s\": %s", sql.c_str(), errMsg);
+            sqlite3_free(errMsg);
+            return false;
+        }
+        return true;
+    };
+
+    // Each table touched by the removal gets a temporary table of doomed rowids.
+    auto prepareIdTable = [&](const string &table){
+        return execute("CREATE TEMP TABLE IF NOT EXISTS remove_" + table + " (id INTEGER PRIMARY KEY); "
+                       "DELETE FROM temp.remove_" + table + ";");
+    };
+
+    const bool removed = transaction([&]{
+        if (!prepareIdTable(tableName)){
+            return false;
+        }
+
+        sqlite3_stmt *stmt = prepareCached("INSERT OR IGNORE INTO temp.remove_" + tableName + " (id) VALUES (?);");
+        if (!stmt){
+            LOG_ERROR("Error preparing id set insert: %s", sqlite3_errmsg(db));
+            return false;
+        }
+        for (int id : ids){
+            sqlite3_bind_int(stmt, 1, id);
+            if (sqlite3_step(stmt) != SQLITE_DONE){
+                LOG_ERROR("Error building id set: %s", sqlite3_errmsg(db));
+                releaseCached(stmt);
+                return false;
+            }
+            sqlite3_reset(stmt);
+        }
+        releaseCached(stmt);
+
+        // Plan: find the tables the removal reaches through foreign keys. A
+        // self-reference (category.parent_id) goes first in its table's list.
+        map<string, vector<ForeignKeyReference>> references;
+        vector<string> pending = {tableName};
+        while (!pending.empty()){
+            const string parent = pending.back();
+            pending.pop_back();
+            if (references.count(parent)){
+                continue;
+            }
+
+            vector<ForeignKeyReference> &children = references[parent];
+            children = referencingTables(db, parent);
+            stable_partition(children.begin(), children.end(), [&](const ForeignKeyReference &reference){
+                return reference.table == parent;
+            });
+            if (cascade){
+                for (const ForeignKeyReference &reference : children){
+                    pending.push_back(reference.table);
+                }
+            }
+        }
+
+        // Order them so every table comes after all the tables referencing
+        // rows it loses (Kahn's algorithm). Its id set is then complete before
+        // it is followed further, even when it is reached through two parents.
+        map<string, size_t> incoming;
+        for (const auto &[parent, children] : references){
+            for (const ForeignKeyReference &reference : children){
+                if (reference.table != parent && references.count(reference.table)){
+                    ++incoming[reference.table];
+                }
+            }
+        }
+        vector<string> order;
+        for (const auto &entry : references){
+            if (!incoming.count(entry.first)){
+                order.push_back(entry.first);
+            }
+        }
+        for (size_t next = 0; next < order.size(); ++next){
+            for (const ForeignKeyReference &reference : references[order[next]]){
+                if (reference.table != order[next] && references.count(reference.table) && --incoming[reference.table] == 0){
+                    order.push_back(reference.table);
+                }
+            }
+        }
+        if (order.size() != references.size()){
+            LOG_ERROR("Cannot remove from %s: the tables it cascades to reference each other in a cycle.", tableName.c_str());
+            return false;
+        }
+
+        for (const string &table : order){
+            if (table != tableName && !prepareIdTable(table)){
+                return false;
+            }
+        }
+
+        // Collect the dependent rows of every table, parents first, before
+        // anything is deleted.
+        for (const string &parent : order){
+            for (const ForeignKeyReference &reference : references[parent]){
+                const string dependents = "SELECT rowid FROM " + reference.table + " WHERE " + reference.column +
+                                          " IN (SELECT id FROM temp.remove_" + parent + ")";
+
+                if (!cascade){
+                    // Rows removed along with their parent (a category and its
+                    // child in the same call) do not hold the removal back.
+                    string check = dependents;
+                    if (reference.table == parent){
+                        check += " AND rowid NOT IN (SELECT id FROM temp.remove_" + parent + ")";
+                    }
+                    sqlite3_stmt *exists = prepareCached("SELECT EXISTS (" + check + ");");
+                    if (!exists){
+                        LOG_ERROR("Error preparing reference check: %s", sqlite3_errmsg(db));
+                        return false;
+                    }
+                    bool found = false;
+                    if (sqlite3_step(exists) == SQLITE_ROW){
+                        found = sqlite3_column_int(exists, 0) != 0;
+                    }
+                    releaseCached(exists);
+
+                    if (found){
+                        LOG_ERROR("Cannot remove from %s: rows in %s still reference them.", tableName.c_str(), reference.table.c_str());
+                        return false;
+                    }
+                    continue;
+                }
+
+                // A self-reference repeats until no new rows turn up, so the
+                // other tables see the whole subtree.
+                do {
+                    if (!execute("INSERT OR IGNORE INTO temp.remove_" + reference.table + " (id) " + dependents + ";")){
+                        return false;
+                    }
+                } while (reference.table == parent && sqlite3_changes(db) > 0);
+            }
+        }
+
+        // Execute: delete children before parents.
+        for (auto table = order.rbegin(); table != order.rend(); ++table){
+            if (!execute("DELETE FROM " + *table + " WHERE rowid IN (SELECT id FROM temp.remove_" + *table + ");")){
+                return false;
+            }
+            if (removedCount && *table == tableName){
+                *removedCount = static_cast<size_t>(sqlite3_changes(db));
+            }
+        }
+        return true;
+    });
+    if (removed){
+        captured.succeeded();
+    }
+    return removed;
+}
+
+bool Database::query(const string &sql, const vector<FieldValue> &parameters, vector<Row> &rows){
+    rows.clear();
+
+    CapturedOperation captured(*this, TraceOp::Query, sql);
+    if (captured){
+        captured.record.values = parameters;
+    }
+    sqlite3_stmt *stmt = prepareCached(sql);
+    if (!stmt){
+        LOG_ERROR("Error preparing query: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    for (size_t index = 0; index < parameters.size(); ++index){
+        bindValue(stmt, static_cast<int>(index + 1), parameters[index]);
+    }
+
+    // Columns read straight from a MONEY column come back as Money.
+    const int columns = sqlite3_column_count(stmt);
+    vector<bool> money(static_cast<size_t>(columns));
+    for (int column = 0; column < columns; ++column){
+        const char *declared = sqlite3_column_decltype(stmt, column);
+        money[static_cast<size_t>(column)] = declared && strcasecmp(declared, "MONEY") == 0;
+    }
+
+    // Only the first step may be retried; later ones would repeat rows already read.
+    int result = step(stmt);
+    for (; result == SQLITE_ROW; result = sqlite3_step(stmt)){
+        Row &row = rows.emplace_back();
+        for (int column = 0; column < columns; ++column){
+            const char *name = sqlite3_column_name(stmt, column);
+            switch (sqlite3_column_type(stmt, column)){
+                case SQLITE_INTEGER:
+                    if (money[static_cast<size_t>(column)]){
+                        row.emplace(name, Money::fromUnits(sqlite3_column_int64(stmt, column)));
+                    }else{
+                        row.emplace(name, sqlite3_column_int64(stmt, column));
+                    }
+                    break;
+                case SQLITE_FLOAT:
+                    row.emplace(name, sqlite3_column_double(stmt, column));
+                    break;
+                case SQLITE_NULL:
+                    break;
+                default:
+                    row.emplace(name, string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, column)),
+                                             static_cast<size_t>(sqlite3_column_bytes(stmt, column))));
+                    break;
+            }
+        }
+    }
+
+    if (result == SQLITE_INTERRUPT){
+        LOG_DEBUG("Query interrupted: %s", sql.c_str());
+        releaseCached(stmt);
+        return false;
+    }
+    if (result != SQLITE_DONE){
+        LOG_ERROR("Error executing query: %s", sqlite3_errmsg(db));
+        releaseCached(stmt);
+        return false;
+    }
+
+    releaseCached(stmt);
+    captured.succeeded();
+    return true;
+}
+
+sqlite3_stmt *Database::prepareCached(const string &sql){
+    auto found = statementCache.find(sql);
+    if (found != statementCache.end()){
+        return found->second;
+    }
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v3(db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK){
+        return nullptr;
+    }
+    statementCache.emplace(sql, stmt);
+    return stmt;
+}
+
+void Database::releaseCached(sqlite3_stmt *stmt){
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+void Database::bindValue(sqlite3_stmt *stmt, int index, const FieldValue &value){
+    if(holds_alternative<int>(value)){
+        sqlite3_bind_int(stmt, index, get<int>(value));
+    }else if(holds_alternative<double>(value)){
+        sqlite3_bind_double(stmt, index, get<double>(value));
+    }else if(holds_alternative<Money>(value)){
+        sqlite3_bind_int64(stmt, index, get<Money>(value).minorUnits());
+    }else if(holds_alternative<sqlite3_int64>(value)){
+        sqlite3_bind_int64(stmt, index, get<sqlite3_int64>(value));
+    }else if(holds_alternative<string>(value)){
+        const string &strValue = get<string>(value);
+        sqlite3_bind_text(stmt, index, strValue.c_str(), static_cast<int>(strValue.size()), SQLITE_TRANSIENT);
+    }
+}
+
+bool Database::transaction(const function<bool()> &work){
+    if (!capture || captureDepth > 0){
+        return runTransaction(work);
+    }
+
+    // The records of the transaction are buffered and written when the
+    // outermost one ends; a retried attempt discards those of the last one.
+    const bool outermost = sqlite3_get_autocommit(db);
+    const size_t mark = transactionTrace.size();
+    TraceRecord &begin = transactionTrace.emplace_back();
+    begin.op = TraceOp::Begin;
+    begin.timestamp = capture->now();
+
+    const bool committed = runTransaction([&]{
+        transactionTrace.resize(mark + 1);
+        return work();
+    });
+
+    TraceRecord &end = transactionTrace.emplace_back();
+    end.op = TraceOp::End;
+    end.timestamp = capture->now();
+    end.duration = static_cast<uint32_t>(end.timestamp - transactionTrace[mark].timestamp);
+    end.ok = committed;
+
+    if (outermost){
+        capture->write(transactionTrace);
+        transactionTrace.clear();
+    }
+    return committed;
+}
+
+bool Database::runTransaction(const function<bool()> &work){
+    char *errMsg = nullptr;
+    transactionError = SQLITE_OK;
+
+    // Nested: a savepoint inside the caller's transaction.
+    if (!sqlite3_get_autocommit(db)){
+        if (sqlite3_exec(db, "SAVEPOINT db_transaction;", nullptr, nullptr, &errMsg) != SQLITE_OK){
+            transactionError = sqlite3_extended_errcode(db);
+            LOG_ERROR("Error starting transaction: %s", errMsg);
+            sqlite3_free(errMsg);
+            return false;
+        }
+
+        if (!work()){
+            transactionError = sqlite3_extended_errcode(db);
+            sqlite3_exec(db, "ROLLBACK TO db_transaction; RELEASE db_transaction;", nullptr, nullptr, nullptr);
+            return false;
+        }
+
+        if (sqlite3_exec(db, "RELEASE db_transaction;", nullptr, nullptr, &errMsg) != SQLITE_OK){
+            transactionError = sqlite3_extended_errcode(db);
+            LOG_ERROR("Error committing transaction: %s", errMsg);
+            sqlite3_free(errMsg);
+            sqlite3_exec(db, "ROLLBACK TO db_transaction; RELEASE db_transaction;", nullptr, nullptr, nullptr);
+            return false;
+        }
+        return true;
+    }
+
+    for (int attempt = 0;; ++attempt){
+        if (sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, &errMsg) != SQLITE_OK){
+            int code = sqlite3_extended_errcode(db);
+            if (BusyHandler::retryable(code) && busyHandler.waitBeforeRetry(attempt)){
+                sqlite3_free(errMsg);
+                continue;
+            }
+            transactionError = code;
+            LOG_ERROR("Error starting transaction: %s", errMsg);
+            sqlite3_free(errMsg);
+            return false;
+        }
+
+        if (work()){
+            if (sqlite3_exec(db, "COMMIT;", nullptr, nullptr, &errMsg) == SQLITE_OK){
+                transactionError = SQLITE_OK;
+                publishCommitted();
+                return true;
+            }
+            int code = sqlite3_extended_errcode(db);
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            if (BusyHandler::retryable(code) && busyHandler.waitBeforeRetry(attempt)){
+                sqlite3_free(errMsg);
+                continue;
+            }
+            transactionError = code;
+            LOG_ERROR("Error committing transaction: %s", errMsg);
+            sqlite3_free(errMsg);
+            return false;
+        }
+
+        int code = sqlite3_extended_errcode(db);
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        if (!BusyHandler::retryable(code) || !busyHandler.waitBeforeRetry(attempt)){
+            transactionError = code;
+            return false;
+        }
+        LOG_DEBUG("Retrying transaction after %s", sqlite3_errstr(code));
+    }
+}
+
+int Database::lastTransactionError() const{
+    return transactionError;
+}
+
+int Database::step(sqlite3_stmt *stmt){
+    int result = sqlite3_step(stmt);
+
+    for (int attempt = 0; BusyHandler::retryable(result) && sqlite3_get_autocommit(db) && busyHandler.waitBeforeRetry(attempt); ++attempt){
+        LOG_DEBUG("Retrying \"%s\" after %s", sqlite3_sql(stmt), sqlite3_errstr(result));
+        sqlite3_reset(stmt);
+        result = sqlite3_step(stmt);
+    }
+    publishCommitted();
+    return result;
+}
+
+void Database::setBusyPolicy(const BusyPolicy &policy){
+    busyHandler.setPolicy(policy);
+}
+
+bool Database::enableIncrementalVacuum(){
+    char *errMsg = nullptr;
+    if (sqlite3_exec(db, "PRAGMA auto_vacuum = INCREMENTAL; VACUUM;", nullptr, nullptr, &errMsg) != SQLITE_OK){
+        LOG_ERROR("Error converting to incremental vacuum: %s", errMsg);
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+bool Database::setFastCommit(bool enabled){
+    char *errMsg = nullptr;
+    if (sqlite3_exec(db, enabled ? "PRAGMA synchronous = NORMAL;" : "PRAGMA synchronous = FULL;", nullptr, nullptr, &errMsg) != SQLITE_OK){
+        LOG_ERROR("Error setting synchronous mode: %s", errMsg);
+        sqlite3_free(errMsg);
+        return false;
+    }
+    fastCommit = enabled;
+    return true;
+}
+
+BusyStats Database::busyStats() const{
+    return busyHandler.stats();
+}
+
+ChangeStream &Database::changes(){
+    return changeStream;
+}
+
+void Database::setWalObserver(function<void(sqlite3 *db, const char *databaseName, int frames)> observer){
+    walObserver = move(observer);
+}
+
+void Database::publishCommitted(){
+    if (sqlite3_get_autocommit(db)){
+        changeStream.publish();
+    }
+}
+
+void Database::setCapture(WorkloadCapture *capture){
+    this->capture = capture;
+}
+
+Database::CapturedOperation::CapturedOperation(Database &database, TraceOp op, const string &tableName)
+    : database(database), active(database.capture && database.captureDepth == 0){
+    if (active){
+        ++database.captureDepth;
+        record.op = op;
+        record.table = tableName;
+        record.timestamp = database.capture->now();
+    }
+}
+
+Database::CapturedOperation::~CapturedOperation(){
+    if (!active){
+        return;
+    }
+    --database.captureDepth;
+    record.duration = static_cast<uint32_t>(database.capture->now() - record.timestamp);
+    if (database.transactionTrace.empty()){
+        database.capture->write(record);
+    }else{
+        database.transactionTrace.push_back(std::move(record));
+    }
+}
+
+void Database::updateHook(void *context, int operation, const char *databaseName, const char *tableName, sqlite3_int64 rowId){
+    // Temporary tables (the id sets of removeMany()) are private to this
+    // connection; subscribers only follow the database file.
+    if (strcmp(databaseName, "main") != 0){
+        return;
+    }
+    static_cast<Database*>(context)->changeStream.recordChange(operation, tableName, rowId);
+}
+
+int Database::commitHook(void *context){
+    // The commit may still fail; changes are published by walHook() or
+    // publishCommitted() once it has succeeded, and dropped by rollbackHook().
+    static_cast<Database*>(context)->changeStream.stage();
+    // Returning zero lets the commit proceed.
+    return 0;
+}
+
+void Database::rollbackHook(void *context){
+    static_cast<Database*>(context)->changeStream.rollback();
+}
+
+int Database::walHook(void *context, sqlite3 *db, const char *databaseName, int frames){
+    Database *database = static_cast<Database*>(context);
+    database->changeStream.publish();
+
+    if (database->walObserver){
+        database->walObserver(db, databaseName, frames);
+    }else if (frames >= 1000){
+        // What SQLite's automatic checkpoint, replaced by this hook, would do.
+        sqlite3_wal_checkpoint(db, databaseName);
+    }
+    return SQLITE_OK;
+}
@@ -0,0 +1,163 @@
+#include "db_executor.hpp"
+
+using namespace std;
+
+// CancellationToken
+
+CancellationToken CancellationToken::create(){
+    CancellationToken token;
+    token.flag = make_shared<atomic<bool>>(false);
+    return token;
+}
+
+bool CancellationToken::cancelled() const{
+    return flag && flag->load(memory_order_acquire);
+}
+
+// DbOperation
+
+DbOperation::DbOperation(DbExecutor &executor, function<bool(Database&, vector<Row>&)> work, CancellationToken token)
+    : executor(executor), work(move(work)), token(move(token)){
+}
+
+bool DbOperation::await_suspend(coroutine_handle<> handle){
+    caller = handle;
+    return executor.submit(*this);
+}
+
+// DbExecutor
+
+DbExecutor::DbExecutor(const string &dbName, Resumer resumer) : database(dbName), resumer(move(resumer)){
+    database.init();
+
+    // Checked every 1000 virtual machine instructions of a running statement.
+    sqlite3_progress_handler(database.getDBConnection(), 1000, &DbExecutor::progress, this);
+    worker = thread(&DbExecutor::run, this);
+}
+
+DbExecutor::~DbExecutor(){
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_all();
+    if (worker.joinable()){
+        worker.join();
+    }
+}
+
+int DbExecutor::progress(void *context){
+    DbExecutor *executor = static_cast<DbExecutor*>(context);
+    return executor->running && executor->running->load(memory_order_acquire) ? 1 : 0;
+}
+
+bool DbExecutor::submit(DbOperation &operation){
+    {
+        lock_guard<mutex> lock(queueMutex);
+        if (stopping){
+            // Nothing would ever take it off the queue; a coroutine resumed
+            // during shutdown that awaits again must not hang.
+            operation.result.status = DbStatus::Cancelled;
+            return false;
+        }
+        queue.push_back(&operation);
+    }
+    queueCondition.notify_one();
+    return true;
+}
+
+void DbExecutor::cancel(const CancellationToken &token){
+    if (!token.flag){
+        return;
+    }
+    token.flag->store(true, memory_order_release);
+
+    // Interrupt only if the token's operation is the one running right now.
+    lock_guard<mutex> lock(runningMutex);
+    if (running == token.flag.get()){
+        sqlite3_interrupt(database.getDBConnection());
+    }
+}
+
+size_t DbExecutor::pending(){
+    lock_guard<mutex> lock(queueMutex);
+    return queue.size();
+}
+
+void DbExecutor::complete(DbOperation &operation, DbStatus status){
+    operation.result.status = status;
+
+    // The operation lives in the coroutine frame and may be gone once resumed.
+    coroutine_handle<> caller = operation.caller;
+    if (resumer){
+        resumer(caller);
+    }else{
+        caller.resume();
+    }
+}
+
+void DbExecutor::run(){
+    while (true){
+        DbOperation *operation;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this]{ return stopping || !queue.empty(); });
+            if (stopping){
+                break;
+            }
+            operation = queue.front();
+            queue.pop_front();
+        }
+
+        if (operation->token.cancelled()){
+            complete(*operation, DbStatus::Cancelled);
+            continue;
+        }
+
+        {
+            lock_guard<mutex> lock(runningMutex);
+            running = operation->token.flag.get();
+        }
+        bool ok = operation->work(database, operation->result.rows);
+        {
+            lock_guard<mutex> lock(runningMutex);
+            running = nullptr;
+        }
+
+        if (operation->token.cancelled()){
+            operation->result.rows.clear();
+            complete(*operation, DbStatus::Cancelled);
+        }else{
+            complete(*operation, ok ? DbStatus::Ok : DbStatus::Failed);
+        }
+    }
+
+    // Nothing runs after shutdown; let the waiting coroutines observe it.
+    // Those that await again are turned away by submit().
+    deque<DbOperation*> abandoned;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        abandoned.swap(queue);
+    }
+    for (DbOperation *operation : abandoned){
+        complete(*operation, DbStatus::Cancelled);
+    }
+}
+
+DbOperation DbExecutor::remove(const string &tableName, int id, CancellationToken token){
+    return DbOperation(*this, [tableName, id](Database &db, vector<Row>&){
+        return db.remove(tableName, id);
+    }, move(token));
+}
+
+DbOperation DbExecutor::query(const string &sql, vector<FieldValue> parameters, CancellationToken token){
+    return DbOperation(*this, [sql, parameters = move(parameters)](Database &db, vector<Row> &rows){
+        return db.query(sql, parameters, rows);
+    }, move(token));
+}
+
+DbOperation DbExecutor::execute(function<bool(Database&)> work, CancellationToken token){
+    return DbOperation(*this, [work = move(work)](Database &db, vector<Row>&){
+        return work(db);
+    }, move(token));
+}
@@ -0,0 +1,509 @@
+#include "item_snapshot.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ITEM_SNAPSHOT_HAS_AVX2 1
+#endif
+
+using namespace std;
+
+// Scalar kernels
+
+bool kernels::sumProductsScalar(const int *quantities, const int64_t *prices, size_t count, int64_t &total){
+    int64_t sum = 0;
+    for (size_t i = 0; i < count; ++i){
+        int64_t product;
+        if (__builtin_mul_overflow(static_cast<int64_t>(quantities[i]), prices[i], &product) || __builtin_add_overflow(sum, product, &sum)){
+            return false;
+        }
+    }
+    total = sum;
+    return true;
+}
+
+bool kernels::sumScalar(const int64_t *values, size_t count, int64_t &total){
+    int64_t sum = 0;
+    for (size_t i = 0; i < count; ++i){
+        if (__builtin_add_overflow(sum, values[i], &sum)){
+            return false;
+        }
+    }
+    total = sum;
+    return true;
+}
+
+void kernels::collectBelowScalar(const int *values, size_t count, int threshold, vector<size_t> &positions){
+    for (size_t i = 0; i < count; ++i){
+        if (values[i] < threshold){
+            positions.push_back(i);
+        }
+    }
+}
+
+bool kernels::multiplyScalar(const int *quantities, const int64_t *prices, int64_t *products, size_t count){
+    for (size_t i = 0; i < count; ++i){
+        if (__builtin_mul_overflow(static_cast<int64_t>(quantities[i]), prices[i], &products[i])){
+            return false;
+        }
+    }
+    return true;
+}
+
+// AVX2 kernels, compiled for AVX2 regardless of the global flags and only
+// called after a runtime CPU check. There is no 64x64-bit multiply in AVX2,
+// so products use _mm256_mul_epi32 on the low halves; a block whose prices do
+// not fit in 32 bits is detected and the whole call is redone with the
+// checked scalar code. The same happens when a lane of a running sum
+// overflows, so both paths agree on every input.
+
+#ifdef ITEM_SNAPSHOT_HAS_AVX2
+// All-zero for every lane that holds a sign-extended 32-bit value.
+__attribute__((target("avx2")))
+static __m256i outside32Bits(__m256i values){
+    return _mm256_srli_epi64(_mm256_add_epi64(values, _mm256_set1_epi64x(0x80000000LL)), 32);
+}
+
+// Sign bit set in every lane where sum = first + second wrapped around.
+__attribute__((target("avx2")))
+static __m256i addOverflow(__m256i first, __m256i second, __m256i sum){
+    return _mm256_and_si256(_mm256_xor_si256(first, sum), _mm256_xor_si256(second, sum));
+}
+
+__attribute__((target("avx2")))
+static bool laneSum(__m256i first, __m256i second, int64_t tail, int64_t &total){
+    alignas(32) int64_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), first);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes + 4), second);
+    for (int64_t lane : lanes){
+        if (__builtin_add_overflow(tail, lane, &tail)){
+            return false;
+        }
+    }
+    total = tail;
+    return true;
+}
+
+__attribute__((target("avx2")))
+static bool sumProductsAvx2(const int *quantities, const int64_t *prices, size_t count, int64_t &total){
+    __m256i first = _mm256_setzero_si256();
+    __m256i second = _mm256_setzero_si256();
+    __m256i wide = _mm256_setzero_si256();
+    __m256i overflow = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8){
+        __m256i lowPrices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prices + i));
+        __m256i highPrices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prices + i + 4));
+        __m256i lowQuantities = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(quantities + i)));
+        __m256i highQuantities = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(quantities + i + 4)));
+        wide = _mm256_or_si256(wide, _mm256_or_si256(outside32Bits(lowPrices), outside32Bits(highPrices)));
+
+        __m256i lowProducts = _mm256_mul_epi32(lowQuantities, lowPrices);
+        __m256i highProducts = _mm256_mul_epi32(highQuantities, highPrices);
+        __m256i lowSum = _mm256_add_epi64(first, lowProducts);
+        __m256i highSum = _mm256_add_epi64(second, highProducts);
+        overflow = _mm256_or_si256(overflow, _mm256_or_si256(addOverflow(first, lowProducts, lowSum), addOverflow(second, highProducts, highSum)));
+        first = lowSum;
+        second = highSum;
+    }
+
+    int64_t tail;
+    if (!_mm256_testz_si256(wide, wide) || _mm256_movemask_pd(_mm256_castsi256_pd(overflow)) != 0 ||
+        !kernels::sumProductsScalar(quantities + i, prices + i, count - i, tail) || !laneSum(first, second, tail, total)){
+        return kernels::sumProductsScalar(quantities, prices, count, total);
+    }
+    return true;
+}
+
+__attribute__((target("avx2")))
+static bool sumAvx2(const int64_t *values, size_t count, int64_t &total){
+    __m256i first = _mm256_setzero_si256();
+    __m256i second = _mm256_setzero_si256();
+    __m256i overflow = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8){
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i + 4));
+        __m256i lowSum = _mm256_add_epi64(first, low);
+        __m256i highSum = _mm256_add_epi64(second, high);
+        overflow = _mm256_or_si256(overflow, _mm256_or_si256(addOverflow(first, low, lowSum), addOverflow(second, high, highSum)));
+        first = lowSum;
+        second = highSum;
+    }
+
+    int64_t tail;
+    if (_mm256_movemask_pd(_mm256_castsi256_pd(overflow)) != 0 || !kernels::sumScalar(values + i, count - i, tail) ||
+        !laneSum(first, second, tail, total)){
+        return kernels::sumScalar(values, count, total);
+    }
+    return true;
+}
+
+__attribute__((target("avx2")))
+static void collectBelowAvx2(const int *values, size_t count, int threshold, vector<size_t> &positions){
+    const __m256i limit = _mm256_set1_epi32(threshold);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8){
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(limit, block))));
+        while (mask != 0){
+            positions.push_back(i + static_cast<size_t>(__builtin_ctz(mask)));
+            mask &= mask - 1;
+        }
+    }
+
+    for (; i < count; ++i){
+        if (values[i] < threshold){
+            positions.push_back(i);
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static bool multiplyAvx2(const int *quantities, const int64_t *prices, int64_t *products, size_t count){
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4){
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prices + i));
+        __m256i wide = outside32Bits(block);
+        if (!_mm256_testz_si256(wide, wide)){
+            if (!kernels::multiplyScalar(quantities + i, prices + i, products + i, 4)){
+                return false;
+            }
+            continue;
+        }
+        // A product of two 32-bit values always fits in 64 bits.
+        __m256i widened = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(quantities + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(products + i), _mm256_mul_epi32(widened, block));
+    }
+
+    return kernels::multiplyScalar(quantities + i, prices + i, products + i, count - i);
+}
+#endif
+
+// Dispatch
+
+bool kernels::avx2Enabled(){
+#ifdef ITEM_SNAPSHOT_HAS_AVX2
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+bool kernels::sumProducts(const int *quantities, const int64_t *prices, size_t count, int64_t &total){
+#ifdef ITEM_SNAPSHOT_HAS_AVX2
+    if (avx2Enabled()){
+        return sumProductsAvx2(quantities, prices, count, total);
+    }
+#endif
+    return sumProductsScalar(quantities, prices, count, total);
+}
+
+bool kernels::sum(const int64_t *values, size_t count, int64_t &total){
+#ifdef ITEM_SNAPSHOT_HAS_AVX2
+    if (avx2Enabled()){
+        return sumAvx2(values, count, total);
+    }
+#endif
+    return sumScalar(values, count, total);
+}
+
+void kernels::collectBelow(const int *values, size_t count, int threshold, vector<size_t> &positions){
+#ifdef ITEM_SNAPSHOT_HAS_AVX2
+    if (avx2Enabled()){
+        collectBelowAvx2(values, count, threshold, positions);
+        return;
+    }
+#endif
+    collectBelowScalar(values, count, threshold, positions);
+}
+
+bool kernels::multiply(const int *quantities, const int64_t *prices, int64_t *products, size_t count){
+#ifdef ITEM_SNAPSHOT_HAS_AVX2
+    if (avx2Enabled()){
+        return multiplyAvx2(quantities, prices, products, count);
+    }
+#endif
+    return multiplyScalar(quantities, prices, products, count);
+}
+
+// ItemSnapshot
+
+// Soft-deleted items are not part of the snapshot.
+static const char *itemColumnsQuery = "SELECT id, category_id, supplier_id, quantity, unit_price, price FROM item WHERE deleted_at IS NULL";
+
+ItemSnapshot::ItemSnapshot(Database &database) : database(database), subscription(database.changes().subscribe(1 << 16)){
+}
+
+void ItemSnapshot::storeRow(sqlite3_int64 id, int categoryId, int supplierId, int quantity, int64_t unitPrice, int64_t price){
+    auto found = positions.find(id);
+    if (found == positions.end()){
+        positions.emplace(id, ids.size());
+        ids.push_back(id);
+        categoryIds.push_back(categoryId);
+        supplierIds.push_back(supplierId);
+        quantities.push_back(quantity);
+        unitPrices.push_back(unitPrice);
+        prices.push_back(price);
+        return;
+    }
+
+    size_t position = found->second;
+    categoryIds[position] = categoryId;
+    supplierIds[position] = supplierId;
+    quantities[position] = quantity;
+    unitPrices[position] = unitPrice;
+    prices[position] = price;
+}
+
+void ItemSnapshot::eraseRow(size_t position){
+    size_t last = ids.size() - 1;
+    positions.erase(ids[position]);
+
+    if (position != last){
+        ids[position] = ids[last];
+        categoryIds[position] = categoryIds[last];
+        supplierIds[position] = supplierIds[last];
+        quantities[position] = quantities[last];
+        unitPrices[position] = unitPrices[last];
+        prices[position] = prices[last];
+        positions[ids[position]] = position;
+    }
+
+    ids.pop_back();
+    categoryIds.pop_back();
+    supplierIds.pop_back();
+    quantities.pop_back();
+    unitPrices.pop_back();
+    prices.pop_back();
+}
+
+void ItemSnapshot::clear(){
+    ids.clear();
+    categoryIds.clear();
+    supplierIds.clear();
+    quantities.clear();
+    unitPrices.clear();
+    prices.clear();
+    positions.clear();
+}
+
+bool ItemSnapshot::load(){
+    sqlite3 *db = database.getDBConnection();
+
+    // Everything committed so far is about to be read, so queued events are stale.
+    events.clear();
+    subscription->poll(events);
+    subscription->overflowed();
+    events.clear();
+    pendingRows.clear();
+    clear();
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM item WHERE deleted_at IS NULL;", -1, &stmt, nullptr) == SQLITE_OK){
+        if (sqlite3_step(stmt) == SQLITE_ROW){
+            size_t rowCount = static_cast<size_t>(sqlite3_column_int64(stmt, 0));
+            ids.reserve(rowCount);
+            categoryIds.reserve(rowCount);
+            supplierIds.reserve(rowCount);
+            quantities.reserve(rowCount);
+            unitPrices.reserve(rowCount);
+            prices.reserve(rowCount);
+            positions.reserve(rowCount);
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    const string sql = string(itemColumnsQuery) + ";";
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error preparing item snapshot query: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW){
+        storeRow(sqlite3_column_int64(stmt, 0),
+                 sqlite3_column_int(stmt, 1),
+                 sqlite3_column_int(stmt, 2),
+                 sqlite3_column_int(stmt, 3),
+                 sqlite3_column_int64(stmt, 4),
+                 sqlite3_column_int64(stmt, 5));
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (result != SQLITE_DONE){
+        LOG_ERROR("Error loading item snapshot: %s", sqlite3_errmsg(db));
+        return false;
+    }
+    return true;
+}
+
+size_t ItemSnapshot::refresh(){
+    events.clear();
+    subscription->poll(events);
+    if (subscription->overflowed()){
+        size_t lost = events.size();
+        load();
+        return lost;
+    }
+
+    for (const ChangeEvent &event : events){
+        if (strcmp(event.table, "item") == 0){
+            pendingRows.insert(event.rowId);
+        }
+    }
+
+    if (pendingRows.empty()){
+        return 0;
+    }
+
+    unordered_set<sqlite3_int64> changed;
+    changed.swap(pendingRows);
+
+    if (changed.size() > ids.size() / 4 + 64){
+        load();
+        return changed.size();
+    }
+
+    sqlite3 *db = database.getDBConnection();
+    const string sql = string(itemColumnsQuery) + " AND id = ?;";
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error preparing item snapshot refresh: %s", sqlite3_errmsg(db));
+        pendingRows.insert(changed.begin(), changed.end());
+        return 0;
+    }
+
+    for (sqlite3_int64 id : changed){
+        sqlite3_bind_int64(stmt, 1, id);
+
+        if (sqlite3_step(stmt) == SQLITE_ROW){
+            storeRow(id,
+                     sqlite3_column_int(stmt, 1),
+                     sqlite3_column_int(stmt, 2),
+                     sqlite3_column_int(stmt, 3),
+                     sqlite3_column_int64(stmt, 4),
+                     sqlite3_column_int64(stmt, 5));
+        }else{
+            auto found = positions.find(id);
+            if (found != positions.end()){
+                eraseRow(found->second);
+            }
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    sqlite3_finalize(stmt);
+    return changed.size();
+}
+
+size_t ItemSnapshot::size() const{
+    return ids.size();
+}
+
+bool ItemSnapshot::totalValuation(Money &total) const{
+    int64_t units;
+    if (!kernels::sumProducts(quantities.data(), unitPrices.data(), quantities.size(), units)){
+        return false;
+    }
+    total = Money::fromUnits(units);
+    return true;
+}
+
+bool ItemSnapshot::totalPrice(Money &total) const{
+    int64_t units;
+    if (!kernels::sum(prices.data(), prices.size(), units)){
+        return false;
+    }
+    total = Money::fromUnits(units);
+    return true;
+}
+
+bool ItemSnapshot::valuationByCategory(map<int, Money> &totals) const{
+    // Products are computed a block at a time with the vector kernel, then
+    // scattered into a dense accumulator indexed by category id.
+    const size_t blockSize = 1024;
+    int64_t products[blockSize];
+
+    int maxCategory = 0;
+    for (int categoryId : categoryIds){
+        maxCategory = max(maxCategory, categoryId);
+    }
+
+    totals.clear();
+    auto accumulate = [](map<int, Money> &sums, int categoryId, int64_t units){
+        Money &sum = sums[categoryId];
+        return Money::add(sum, Money::fromUnits(units), sum);
+    };
+
+    if (static_cast<size_t>(maxCategory) > ids.size() * 4 + 1024){
+        // Sparse ids would make the dense accumulator wasteful.
+        for (size_t i = 0; i < ids.size(); ++i){
+            int64_t product;
+            if (__builtin_mul_overflow(static_cast<int64_t>(quantities[i]), unitPrices[i], &product) || !accumulate(totals, categoryIds[i], product)){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    vector<int64_t> dense(static_cast<size_t>(maxCategory) + 1, 0);
+    vector<bool> seen(dense.size(), false);
+
+    for (size_t start = 0; start < ids.size(); start += blockSize){
+        size_t count = min(blockSize, ids.size() - start);
+        if (!kernels::multiply(quantities.data() + start, unitPrices.data() + start, products, count)){
+            return false;
+        }
+
+        for (size_t i = 0; i < count; ++i){
+            int categoryId = categoryIds[start + i];
+            if (categoryId < 0){
+                if (!accumulate(totals, categoryId, products[i])){
+                    return false;
+                }
+                continue;
+            }
+            if (__builtin_add_overflow(dense[categoryId], products[i], &dense[categoryId])){
+                return false;
+            }
+            seen[categoryId] = true;
+        }
+    }
+
+    for (size_t categoryId = 0; categoryId < dense.size(); ++categoryId){
+        if (seen[categoryId] && !accumulate(totals, static_cast<int>(categoryId), dense[categoryId])){
+            return false;
+        }
+    }
+    return true;
+}
+
+map<int, long long> ItemSnapshot::quantityByCategory() const{
+    map<int, long long> totals;
+    for (size_t i = 0; i < ids.size(); ++i){
+        totals[categoryIds[i]] += quantities[i];
+    }
+    return totals;
+}
+
+vector<sqlite3_int64> ItemSnapshot::lowStock(int threshold) const{
+    vector<size_t> matches;
+    kernels::collectBelow(quantities.data(), quantities.size(), threshold, matches);
+
+    vector<sqlite3_int64> result;
+    result.reserve(matches.size());
+    for (size_t position : matches){
+        result.push_back(ids[position]);
+    }
+    return result;
+}
@@ -0,0 +1,242 @@
+#include "logger.hpp"
+#include <algorithm>
+#include <cstdarg>
+#include <cstring>
+#include <ctime>
+
+using namespace std;
+
+static int64_t nowNanos(){
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static const char *levelName(LogLevel level){
+    switch (level){
+        case LogLevel::Debug: return "DEBUG";
+        case LogLevel::Info: return "INFO";
+        case LogLevel::Warning: return "WARN";
+        case LogLevel::Error: return "ERROR";
+        default: return "OFF";
+    }
+}
+
+// LogRing
+
+LogRing::LogRing(size_t capacity){
+    size_t size = 1;
+    while (size < capacity){
+        size <<= 1;
+    }
+    slots.resize(size);
+    mask = size - 1;
+}
+
+LogRecord *LogRing::claim(){
+    size_t currentTail = tail.load(memory_order_relaxed);
+    if (currentTail - head.load(memory_order_acquire) > mask){
+        droppedRecords.fetch_add(1, memory_order_relaxed);
+        return nullptr;
+    }
+    return &slots[currentTail & mask];
+}
+
+void LogRing::publish(){
+    tail.store(tail.load(memory_order_relaxed) + 1, memory_order_release);
+}
+
+size_t LogRing::drain(vector<LogRecord> &out){
+    size_t currentHead = head.load(memory_order_relaxed);
+    size_t currentTail = tail.load(memory_order_acquire);
+
+    for (size_t position = currentHead; position != currentTail; ++position){
+        out.push_back(slots[position & mask]);
+    }
+    head.store(currentTail, memory_order_release);
+    return currentTail - currentHead;
+}
+
+uint64_t LogRing::takeDropped(){
+    return droppedRecords.exchange(0, memory_order_relaxed);
+}
+
+bool LogRing::empty() const{
+    return head.load(memory_order_acquire) == tail.load(memory_order_acquire);
+}
+
+// Logger
+
+struct Logger::ThreadHandle {
+    shared_ptr<LogRing> ring;
+    uint32_t id = 0;
+
+    ~ThreadHandle(){
+        if (ring){
+            ring->closed.store(true, memory_order_release);
+        }
+    }
+};
+
+Logger::Logger(){
+    flusher = thread(&Logger::run, this);
+}
+
+Logger::~Logger(){
+    {
+        lock_guard<mutex> lock(stateMutex);
+        stopping = true;
+    }
+    stateCondition.notify_all();
+    if (flusher.joinable()){
+        flusher.join();
+    }
+    flush();
+}
+
+Logger &Logger::instance(){
+    static Logger logger;
+    return logger;
+}
+
+bool Logger::enabled(LogLevel level) const{
+    return static_cast<int>(level) >= minimumLevel.load(memory_order_relaxed);
+}
+
+void Logger::setLevel(LogLevel level){
+    minimumLevel.store(static_cast<int>(level), memory_order_relaxed);
+}
+
+void Logger::setOutput(FILE *stream){
+    lock_guard<mutex> lock(outputMutex);
+    fflush(output);
+    output = stream;
+}
+
+uint64_t Logger::droppedRecords() const{
+    return dropped.load(memory_order_relaxed);
+}
+
+LogRing &Logger::threadRing(uint32_t &threadId){
+    thread_local ThreadHandle handle;
+
+    if (!handle.ring){
+        handle.ring = make_shared<LogRing>(ringCapacity);
+        handle.id = nextThreadId.fetch_add(1, memory_order_relaxed);
+
+        lock_guard<mutex> lock(ringsMutex);
+        rings.push_back(handle.ring);
+    }
+    threadId = handle.id;
+    return *handle.ring;
+}
+
+bool Logger::admit(LogSite &site, int64_t now, uint32_t &suppressedOut){
+    const int64_t window = chrono::duration_cast<chrono::nanoseconds>(rateWindow).count();
+    int64_t start = site.windowStart.load(memory_order_relaxed);
+
+    // The thread that moves the window forward also reports what the old one suppressed.
+    suppressedOut = 0;
+    if (now - start >= window && site.windowStart.compare_exchange_strong(start, now, memory_order_relaxed)){
+        site.emitted.store(0, memory_order_relaxed);
+        suppressedOut = site.suppressed.exchange(0, memory_order_relaxed);
+    }
+
+    if (site.emitted.fetch_add(1, memory_order_relaxed) < burstPerWindow){
+        return true;
+    }
+    site.suppressed.fetch_add(1, memory_order_relaxed);
+    return false;
+}
+
+void Logger::log(LogLevel level, LogSite &site, const char *format, ...){
+    int64_t now = nowNanos();
+    uint32_t suppressed;
+    if (!admit(site, now, suppressed)){
+        return;
+    }
+
+    uint32_t threadId;
+    LogRing &ring = threadRing(threadId);
+    LogRecord *record = ring.claim();
+    if (!record){
+        return;
+    }
+
+    record->timestamp = now;
+    record->file = site.file;
+    record->line = site.line;
+    record->thread = threadId;
+    record->level = level;
+
+    va_list arguments;
+    va_start(arguments, format);
+    int length = vsnprintf(record->message, LogRecord::messageCapacity, format, arguments);
+    va_end(arguments);
+
+    if (suppressed > 0 && length >= 0 && static_cast<size_t>(length) < LogRecord::messageCapacity){
+        snprintf(record->message + length, LogRecord::messageCapacity - static_cast<size_t>(length),
+                 " (%u similar messages suppressed)", suppressed);
+    }
+    ring.publish();
+}
+
+void Logger::drainAll(){
+    batch.clear();
+    uint64_t lost = 0;
+    {
+        lock_guard<mutex> lock(ringsMutex);
+        for (const shared_ptr<LogRing> &ring : rings){
+            ring->drain(batch);
+            lost += ring->takeDropped();
+        }
+
+        // Rings of exited threads go once nothing is left in them.
+        rings.erase(remove_if(rings.begin(), rings.end(), [](const shared_ptr<LogRing> &ring){
+            return ring->closed.load(memory_order_acquire) && ring->empty();
+        }), rings.end());
+    }
+
+    if (lost > 0){
+        dropped.fetch_add(lost, memory_order_relaxed);
+    }
+    if (batch.empty() && lost == 0){
+        return;
+    }
+
+    stable_sort(batch.begin(), batch.end(), [](const LogRecord &left, const LogRecord &right){
+        return left.timestamp < right.timestamp;
+    });
+
+    for (const LogRecord &record : batch){
+        time_t seconds = static_cast<time_t>(record.timestamp / 1000000000);
+        int micros = static_cast<int>((record.timestamp % 1000000000) / 1000);
+        tm local;
+        localtime_r(&seconds, &local);
+
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+
+        const char *file = strrchr(record.file, '/');
+        fprintf(output, "%s.%06d %-5s [%u] %s:%d: %s\n", stamp, micros, levelName(record.level), record.thread,
+                file ? file + 1 : record.file, record.line, record.message);
+    }
+    if (lost > 0){
+        fprintf(output, "%llu log records dropped: ring full\n", static_cast<unsigned long long>(lost));
+    }
+    fflush(output);
+}
+
+void Logger::flush(){
+    lock_guard<mutex> lock(outputMutex);
+    drainAll();
+}
+
+void Logger::run(){
+    unique_lock<mutex> lock(stateMutex);
+    while (!stopping){
+        stateCondition.wait_for(lock, flushInterval, [this]{ return stopping; });
+
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
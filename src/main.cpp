@@ -1,9 +1,167 @@
+#include "batch.hpp"
+#include "compactor.hpp"
 #include "database.hpp"
+#include "maintenance.hpp"
+#include "server.hpp"
+#include "terminal.hpp"
+#include "tui.hpp"
+#include "workload.hpp"
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <memory>
 
-int main(){
+// Usage: inventory_manager.out [--batch [script]] [--commit-every N] [--stop-on-error] [--capture trace] [--fast-commit]
+//        inventory_manager.out --serve [socket] [--capture trace] [--fast-commit]
+//        inventory_manager.out --replay trace [--speed X]
+//        inventory_manager.out --vacuum-incremental
+//
+// Without a script, batch mode reads standard input; it is also the mode used
+// whenever the program does not run on a terminal. Server mode runs until
+// SIGINT or SIGTERM. --capture trace records every database operation of batch
+// or server mode and saves the starting database as trace.db; --replay runs
+// the trace against a copy of that snapshot and prints the latencies.
+// --fast-commit drops the fsync of every commit (synchronous = NORMAL); the
+// last commits before a power failure may then be lost. --vacuum-incremental
+// converts an existing database to incremental auto-vacuum with a one-time
+// full VACUUM, which blocks every other user of the file while it runs.
+
+static Server *activeServer = nullptr;
+
+static void onStopSignal(int){
+    if (activeServer){
+        activeServer->stop();
+    }
+}
+
+int main(int argc, char **argv){
     Database *db = new Database("inventaris_app.db");
 
     db->init();
 
-    return 0;
-}
\ No newline at end of file
+    bool batch = !Terminal::interactive();
+    const char *script = nullptr;
+    const char *socketPath = nullptr;
+    const char *capturePath = nullptr;
+    const char *replayPath = nullptr;
+    bool vacuumIncremental = false;
+    ReplayOptions replayOptions;
+    BatchOptions options;
+    for (int i = 1; i < argc; ++i){
+        if (strcmp(argv[i], "--batch") == 0){
+            batch = true;
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0){
+                script = argv[++i];
+            }
+        }else if (strcmp(argv[i], "--serve") == 0){
+            socketPath = i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0 ? argv[++i] : "inventory_manager.sock";
+        }else if (strcmp(argv[i], "--commit-every") == 0 && i + 1 < argc){
+            options.commitEvery = static_cast<size_t>(atol(argv[++i]));
+        }else if (strcmp(argv[i], "--stop-on-error") == 0){
+            options.stopOnError = true;
+        }else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc){
+            capturePath = argv[++i];
+        }else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc){
+            replayPath = argv[++i];
+        }else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc){
+            replayOptions.speed = atof(argv[++i]);
+        }else if (strcmp(argv[i], "--vacuum-incremental") == 0){
+            vacuumIncremental = true;
+        }else if (strcmp(argv[i], "--fast-commit") == 0){
+            db->setFastCommit(true);
+        }else{
+            LOG_ERROR("Unknown argument: %s", argv[i]);
+            return 2;
+        }
+    }
+
+    if (vacuumIncremental){
+        const bool converted = db->enableIncrementalVacuum();
+        if (converted){
+            LOG_INFO("Converted inventaris_app.db to incremental vacuum");
+        }
+        Logger::instance().flush();
+        return converted ? 0 : 1;
+    }
+
+    if (replayPath){
+        std::vector<TraceRecord> records;
+        const char *copyPath = "inventaris_app.replay.db";
+        if (!readTrace(replayPath, records)){
+            return 1;
+        }
+        // The snapshot taken when the capture started; the live database
+        // already holds the rows the trace inserts.
+        const std::string snapshotPath = std::string(replayPath) + ".db";
+        if (!std::ifstream(snapshotPath)){
+            LOG_ERROR("Missing database snapshot %s", snapshotPath.c_str());
+            return 1;
+        }
+        Database snapshot(snapshotPath);
+        if (!WorkloadReplayer::copyDatabase(snapshot, copyPath)){
+            return 1;
+        }
+        Database copy(copyPath);
+        copy.init();
+        WorkloadReplayer replayer(copy, replayOptions);
+        const bool replayed = replayer.run(records);
+        replayer.printSummary(stdout);
+        Logger::instance().flush();
+        return replayed ? 0 : 1;
+    }
+
+    std::unique_ptr<WorkloadCapture> capture;
+    if (capturePath){
+        capture = std::make_unique<WorkloadCapture>(capturePath);
+        if (!capture->isOpen() || !WorkloadReplayer::copyDatabase(*db, std::string(capturePath) + ".db")){
+            return 2;
+        }
+        db->setCapture(capture.get());
+    }
+
+    if (socketPath){
+        Server server(*db, socketPath);
+        if (!server.listen()){
+            return 1;
+        }
+        // A long-running server is where checkpoints, fresh statistics and
+        // purged tombstones pay off; both work through their own connections.
+        MaintenanceScheduler maintenance(*db);
+        Compactor compactor(*db);
+        maintenance.start();
+        compactor.start();
+        activeServer = &server;
+        signal(SIGINT, onStopSignal);
+        signal(SIGTERM, onStopSignal);
+        LOG_INFO("Serving on %s", socketPath);
+        server.run();
+        activeServer = nullptr;
+        compactor.stop();
+        maintenance.stop();
+        Logger::instance().flush();
+        return 0;
+    }
+
+    if (batch){
+        BatchRunner runner(*db, options);
+        bool succeeded;
+        if (script){
+            std::ifstream input(script);
+            if (!input){
+                LOG_ERROR("Can't open script: %s", script);
+                return 2;
+            }
+            succeeded = runner.run(input);
+        }else{
+            succeeded = runner.run(std::cin);
+        }
+
+        const BatchStats &stats = runner.stats();
+        LOG_INFO("%zu commands, %zu failed, %zu transactions", stats.commands, stats.failed, stats.transactions);
+        Logger::instance().flush();
+        return succeeded ? 0 : 1;
+    }
+
+    Tui tui("inventaris_app.db");
+    return tui.run();
+}
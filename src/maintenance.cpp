@@ -0,0 +1,294 @@
+#include "maintenance.hpp"
+#include <algorithm>
+
+using namespace std;
+
+static double elapsedMs(chrono::steady_clock::time_point start){
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// TimerWheel
+
+TimerWheel::TimerWheel(chrono::milliseconds tick, size_t slotCount) : tick(tick.count() > 0 ? tick : chrono::milliseconds(1)), slots(slotCount > 0 ? slotCount : 1){
+}
+
+void TimerWheel::schedule(chrono::milliseconds delay, function<void()> task){
+    uint64_t ticks = static_cast<uint64_t>((delay.count() + tick.count() - 1) / tick.count());
+    if (ticks == 0){
+        ticks = 1;
+    }
+
+    size_t slot = static_cast<size_t>((currentTick + ticks) % slots.size());
+    slots[slot].push_back({(ticks - 1) / slots.size(), move(task)});
+}
+
+size_t TimerWheel::advance(){
+    ++currentTick;
+    vector<Timer> &slot = slots[currentTick % slots.size()];
+
+    // Tasks may schedule into this very slot, so collect the expired ones first.
+    vector<function<void()>> expired;
+    for (size_t i = 0; i < slot.size();){
+        if (slot[i].rounds == 0){
+            expired.push_back(move(slot[i].task));
+            slot[i] = move(slot.back());
+            slot.pop_back();
+        }else{
+            --slot[i].rounds;
+            ++i;
+        }
+    }
+
+    for (auto &task : expired){
+        task();
+    }
+    return expired.size();
+}
+
+chrono::milliseconds TimerWheel::resolution() const{
+    return tick;
+}
+
+// MaintenanceScheduler
+
+MaintenanceScheduler::MaintenanceScheduler(Database &database, const MaintenanceOptions &options)
+    : options(options), database(database), subscription(database.changes().subscribe()), wheel(options.tick, 512){
+    const string path = database.getDBPath();
+    if (path.empty()){
+        LOG_ERROR("Maintenance scheduler needs a file-backed database");
+        return;
+    }
+
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK){
+        LOG_ERROR("Can't open database for maintenance: %s", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        db = nullptr;
+        return;
+    }
+    sqlite3_busy_timeout(db, 20);
+
+    // The observer replaces the application connection's automatic
+    // checkpoint; the worker checkpoints instead, off the committing thread.
+    database.setWalObserver([this](sqlite3 *appDb, const char *name, int frames){ walCommitted(appDb, name, frames); });
+
+    if (options.analysisLimit > 0){
+        const string limit = "PRAGMA analysis_limit = " + to_string(options.analysisLimit) + ";";
+        sqlite3_exec(db, limit.c_str(), nullptr, nullptr, nullptr);
+    }
+
+    lastActivity = chrono::steady_clock::now();
+}
+
+MaintenanceScheduler::~MaintenanceScheduler(){
+    stop();
+    if (db){
+        // Hand checkpointing back to the automatic checkpoint.
+        database.setWalObserver(nullptr);
+        sqlite3_close(db);
+    }
+}
+
+void MaintenanceScheduler::walCommitted(sqlite3 *appDb, const char *name, int frames){
+    walFrames.store(frames, memory_order_relaxed);
+    if (frames < options.commitCheckpointFrames){
+        return;
+    }
+
+    // Busy when the worker is checkpointing right now; the next commit retries.
+    int logFrames = 0;
+    int checkpointedFrames = 0;
+    if (sqlite3_wal_checkpoint_v2(appDb, name, SQLITE_CHECKPOINT_PASSIVE, &logFrames, &checkpointedFrames) == SQLITE_OK){
+        lock_guard<mutex> lock(metricsMutex);
+        ++currentMetrics.commitCheckpoints;
+        currentMetrics.checkpointedFrames += static_cast<uint64_t>(checkpointedFrames > 0 ? checkpointedFrames : 0);
+    }
+}
+
+void MaintenanceScheduler::start(){
+    if (!db || worker.joinable()){
+        return;
+    }
+    {
+        lock_guard<mutex> lock(stateMutex);
+        stopping = false;
+    }
+
+    wheel.schedule(options.checkpointInterval, [this]{ checkpointJob(); });
+    wheel.schedule(options.analyzeInterval, [this]{ analyzeJob(); });
+    wheel.schedule(options.optimizeInterval, [this]{ optimizeJob(); });
+    worker = thread(&MaintenanceScheduler::run, this);
+}
+
+void MaintenanceScheduler::stop(){
+    {
+        lock_guard<mutex> lock(stateMutex);
+        stopping = true;
+    }
+    stateCondition.notify_all();
+    if (worker.joinable()){
+        worker.join();
+    }
+}
+
+MaintenanceMetrics MaintenanceScheduler::metrics() const{
+    lock_guard<mutex> lock(metricsMutex);
+    return currentMetrics;
+}
+
+void MaintenanceScheduler::observeWrites(){
+    uint64_t writes = 0;
+
+    events.clear();
+    subscription->poll(events);
+    writes += events.size();
+    if (subscription->overflowed()){
+        // Events were lost; count them from the drop counter instead.
+        writes += subscription->dropped() - lastDropped;
+        lastDropped = subscription->dropped();
+    }
+
+    // Commits from other connections only show up in data_version.
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "PRAGMA data_version;", -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW){
+        int dataVersion = sqlite3_column_int(stmt, 0);
+        if (lastDataVersion != -1 && dataVersion != lastDataVersion && writes == 0){
+            writes = 1;
+        }
+        lastDataVersion = dataVersion;
+    }
+    sqlite3_finalize(stmt);
+
+    if (writes > 0){
+        lastActivity = chrono::steady_clock::now();
+        writesSinceAnalyze += writes;
+        writesSinceCheckpoint += writes;
+
+        lock_guard<mutex> lock(metricsMutex);
+        currentMetrics.observedWrites += writes;
+    }
+}
+
+bool MaintenanceScheduler::idle() const{
+    return chrono::steady_clock::now() - lastActivity >= options.idleThreshold;
+}
+
+bool MaintenanceScheduler::passiveCheckpointDue(){
+    // The WAL restarts from its first frame once a checkpoint has copied every
+    // frame back, so a count below the checkpointed mark means a new log.
+    const int frames = walFrames.load(memory_order_relaxed);
+    if (frames < checkpointedUpTo){
+        checkpointedUpTo = 0;
+    }
+    return frames - checkpointedUpTo >= options.passiveCheckpointFrames;
+}
+
+void MaintenanceScheduler::checkpoint(bool truncate){
+    int logFrames = 0;
+    int checkpointedFrames = 0;
+    auto start = chrono::steady_clock::now();
+    int mode = truncate ? SQLITE_CHECKPOINT_TRUNCATE : SQLITE_CHECKPOINT_PASSIVE;
+    int result = sqlite3_wal_checkpoint_v2(db, "main", mode, &logFrames, &checkpointedFrames);
+
+    lock_guard<mutex> lock(metricsMutex);
+    if (result != SQLITE_OK){
+        ++currentMetrics.busySkips;
+        return;
+    }
+
+    currentMetrics.lastCheckpointMs = elapsedMs(start);
+    currentMetrics.checkpointedFrames += static_cast<uint64_t>(checkpointedFrames > 0 ? checkpointedFrames : 0);
+    if (truncate){
+        ++currentMetrics.truncateCheckpoints;
+        checkpointedUpTo = 0;
+        writesSinceCheckpoint = 0;
+    }else{
+        ++currentMetrics.passiveCheckpoints;
+        checkpointedUpTo = max(checkpointedFrames, 0);
+    }
+}
+
+void MaintenanceScheduler::checkpointJob(){
+    wheel.schedule(options.checkpointInterval, [this]{ checkpointJob(); });
+
+    if (writesSinceCheckpoint == 0){
+        return;
+    }
+    if (idle()){
+        checkpoint(true);
+    }else if (passiveCheckpointDue()){
+        checkpoint(false);
+    }
+}
+
+void MaintenanceScheduler::analyzeJob(){
+    if (writesSinceAnalyze < options.analyzeWriteThreshold){
+        wheel.schedule(options.analyzeInterval, [this]{ analyzeJob(); });
+        return;
+    }
+
+    // Statistics are stale; refresh as soon as the database goes quiet.
+    if (!idle()){
+        wheel.schedule(options.tick * 10, [this]{ analyzeJob(); });
+        return;
+    }
+
+    auto start = chrono::steady_clock::now();
+    int result = sqlite3_exec(db, "ANALYZE;", nullptr, nullptr, nullptr);
+
+    {
+        lock_guard<mutex> lock(metricsMutex);
+        if (result == SQLITE_OK){
+            ++currentMetrics.analyzeRuns;
+            currentMetrics.lastAnalyzeMs = elapsedMs(start);
+            writesSinceAnalyze = 0;
+        }else{
+            ++currentMetrics.busySkips;
+        }
+    }
+    wheel.schedule(options.analyzeInterval, [this]{ analyzeJob(); });
+}
+
+void MaintenanceScheduler::optimizeJob(){
+    wheel.schedule(options.optimizeInterval, [this]{ optimizeJob(); });
+
+    // 0x10002 asks optimize to consider every table, not only those this
+    // connection has queried.
+    auto start = chrono::steady_clock::now();
+    int result = sqlite3_exec(db, "PRAGMA optimize(0x10002);", nullptr, nullptr, nullptr);
+
+    lock_guard<mutex> lock(metricsMutex);
+    if (result == SQLITE_OK){
+        ++currentMetrics.optimizeRuns;
+        currentMetrics.lastOptimizeMs = elapsedMs(start);
+    }else{
+        ++currentMetrics.busySkips;
+    }
+}
+
+void MaintenanceScheduler::run(){
+    auto nextTick = chrono::steady_clock::now() + wheel.resolution();
+    unique_lock<mutex> lock(stateMutex);
+
+    while (!stopping){
+        stateCondition.wait_until(lock, nextTick, [this]{ return stopping; });
+        if (stopping){
+            break;
+        }
+
+        lock.unlock();
+        observeWrites();
+
+        // A busy writer may fill the WAL well before the next checkpoint job.
+        if (passiveCheckpointDue()){
+            checkpoint(false);
+        }
+
+        // Catch up on ticks missed while a job was running.
+        auto now = chrono::steady_clock::now();
+        while (nextTick <= now){
+            wheel.advance();
+            nextTick += wheel.resolution();
+        }
+        lock.lock();
+    }
+}
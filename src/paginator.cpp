@@ -0,0 +1,319 @@
+#include "paginator.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
+using namespace std;
+
+static const char *base64Alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// URL-safe base64 without padding, so tokens can travel in links and forms.
+static string base64Encode(const string &data){
+    string encoded;
+    encoded.reserve((data.size() * 4 + 2) / 3);
+
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (unsigned char byte : data){
+        buffer = (buffer << 8) | byte;
+        bits += 8;
+        while (bits >= 6){
+            bits -= 6;
+            encoded += base64Alphabet[(buffer >> bits) & 0x3F];
+        }
+    }
+    if (bits > 0){
+        encoded += base64Alphabet[(buffer << (6 - bits)) & 0x3F];
+    }
+    return encoded;
+}
+
+static bool base64Decode(const string &encoded, string &data){
+    data.clear();
+
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (char symbol : encoded){
+        const char *position = strchr(base64Alphabet, symbol);
+        if (symbol == '\0' || !position){
+            return false;
+        }
+        buffer = (buffer << 6) | static_cast<uint32_t>(position - base64Alphabet);
+        bits += 6;
+        if (bits >= 8){
+            bits -= 8;
+            data += static_cast<char>((buffer >> bits) & 0xFF);
+        }
+    }
+    return true;
+}
+
+static const char fieldSeparator = '\x1F';
+
+// Outside the base64 alphabet, so fetch() rejects it.
+static const char *invalidToken = "!";
+
+Paginator::Paginator(Database &database, const string &tableName, const string &sortColumn, bool descending, size_t pageSize)
+    : database(database), tableName(tableName), sortColumn(sortColumn), descending(descending), pageSize(max<size_t>(pageSize, 1)){
+    valid = prepare();
+}
+
+bool Paginator::prepare(){
+    vector<Row> rows;
+    if (!database.query("SELECT name, \"notnull\" AS required, pk FROM pragma_table_info(?);", {tableName}, rows)){
+        return false;
+    }
+
+    bool found = false;
+    for (const Row &row : rows){
+        const string &name = std::get<string>(row.at("name"));
+        if (name == sortColumn){
+            found = true;
+            nullable = std::get<sqlite3_int64>(row.at("required")) == 0 && std::get<sqlite3_int64>(row.at("pk")) == 0;
+        }
+        softDelete = softDelete || name == "deleted_at";
+    }
+    if (!found){
+        LOG_ERROR("Cannot paginate %s: no column %s", tableName.c_str(), sortColumn.c_str());
+        return false;
+    }
+    if (sortColumn == "id"){
+        return true;
+    }
+
+    // Any index led by the sort column will do, unless its WHERE clause excludes rows we list.
+    if (!database.query("SELECT list.name AS name, list.partial AS partial, master.sql AS sql "
+                        "FROM pragma_index_list(?) AS list "
+                        "JOIN pragma_index_info(list.name) AS info "
+                        "LEFT JOIN sqlite_master AS master ON master.name = list.name "
+                        "WHERE info.seqno = 0 AND info.name = ?;", {tableName, sortColumn}, rows)){
+        return false;
+    }
+    for (const Row &row : rows){
+        if (std::get<sqlite3_int64>(row.at("partial")) == 0){
+            return true;
+        }
+        auto sql = row.find("sql");
+        if (softDelete && sql != row.end() && std::get<string>(sql->second).ends_with("WHERE deleted_at IS NULL")){
+            return true;
+        }
+    }
+
+    string sql = "CREATE INDEX IF NOT EXISTS idx_" + tableName + "_page_" + sortColumn + " ON " + tableName + "(" + sortColumn + ")";
+    if (softDelete){
+        sql += " WHERE deleted_at IS NULL";
+    }
+    sql += ";";
+
+    char *errMsg = nullptr;
+    if (sqlite3_exec(database.getDBConnection(), sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK){
+        LOG_ERROR("Error Creating Pagination Index: %s", errMsg);
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+string Paginator::encodeToken(const Row &row, bool backward) const{
+    auto idColumn = row.find("id");
+    sqlite3_int64 id = 0;
+    if (idColumn == row.end() || !integerValue(idColumn->second, id)){
+        LOG_ERROR("Cannot paginate %s from a row without an integer id", tableName.c_str());
+        return invalidToken;
+    }
+    string token = tableName + fieldSeparator + sortColumn + fieldSeparator + (descending ? 'd' : 'a') + fieldSeparator +
+                   (backward ? 'b' : 'f') + fieldSeparator + to_string(id) + fieldSeparator;
+
+    auto value = row.find(sortColumn);
+    sqlite3_int64 integer = 0;
+    if (value == row.end()){
+        token += 'n';
+    }else if (integerValue(value->second, integer)){
+        token += 'i' + to_string(integer);
+    }else if (std::holds_alternative<double>(value->second)){
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.17g", std::get<double>(value->second));
+        token += 'r';
+        token += buffer;
+    }else if (std::holds_alternative<Money>(value->second)){
+        token += 'm' + to_string(std::get<Money>(value->second).minorUnits());
+    }else{
+        token += 't' + std::get<string>(value->second);
+    }
+    return base64Encode(token);
+}
+
+bool Paginator::decodeToken(const string &token, bool &backward, FieldValue &value, bool &isNull, sqlite3_int64 &id) const{
+    string data;
+    if (!base64Decode(token, data)){
+        return false;
+    }
+
+    // table, column, order, direction and id; the value is last since text may contain anything.
+    vector<string> fields;
+    size_t start = 0;
+    while (fields.size() < 5){
+        size_t end = data.find(fieldSeparator, start);
+        if (end == string::npos){
+            return false;
+        }
+        fields.push_back(data.substr(start, end - start));
+        start = end + 1;
+    }
+    const string encodedValue = data.substr(start);
+
+    if (fields[0] != tableName || fields[1] != sortColumn || fields[2] != (descending ? "d" : "a") ||
+        (fields[3] != "f" && fields[3] != "b") || fields[4].empty() || encodedValue.empty()){
+        return false;
+    }
+    backward = fields[3] == "b";
+
+    char *end;
+    id = strtoll(fields[4].c_str(), &end, 10);
+    if (*end != '\0'){
+        return false;
+    }
+
+    isNull = false;
+    const string text = encodedValue.substr(1);
+    switch (encodedValue[0]){
+        case 'n':
+            isNull = true;
+            value = 0;
+            return true;
+        case 'i':
+            value = static_cast<sqlite3_int64>(strtoll(text.c_str(), &end, 10));
+            return *end == '\0';
+        case 'r':
+            value = strtod(text.c_str(), &end);
+            return *end == '\0';
+        case 'm':
+            value = Money::fromUnits(strtoll(text.c_str(), &end, 10));
+            return *end == '\0';
+        case 't':
+            value = text;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Paginator::fetchFrom(bool backward, bool anchored, const FieldValue &value, bool isNull, sqlite3_int64 id, Page &page){
+    page.rows.clear();
+    page.nextToken.clear();
+    page.previousToken.clear();
+    if (!valid){
+        return false;
+    }
+
+    // Reading backward walks the index the other way and reverses the page afterwards.
+    const bool ascending = descending == backward;
+    const string &column = sortColumn;
+
+    // The listing is a NULL run and a value run; an anchor in one may continue into the other.
+    // Each run is its own query, so both stay index seeks instead of one scan filtering an OR.
+    struct Segment {
+        string condition;
+        vector<FieldValue> parameters;
+    };
+    vector<Segment> segments;
+    if (!anchored){
+        segments.push_back({"", {}});
+    }else if (column == "id"){
+        segments.push_back({ascending ? "id > ?" : "id < ?", {id}});
+    }else if (isNull){
+        segments.push_back({column + (ascending ? " IS NULL AND id > ?" : " IS NULL AND id < ?"), {id}});
+        if (ascending){
+            segments.push_back({column + " IS NOT NULL", {}});
+        }
+    }else{
+        segments.push_back({"(" + column + ", id) " + (ascending ? ">" : "<") + " (?, ?)", {value, id}});
+        if (!ascending && nullable){
+            segments.push_back({column + " IS NULL", {}});
+        }
+    }
+
+    const char *order = ascending ? " ASC" : " DESC";
+    const string orderBy = column == "id" ? string(" ORDER BY id") + order : " ORDER BY " + column + order + ", id" + order;
+
+    vector<Row> rows;
+    for (const Segment &segment : segments){
+        if (page.rows.size() > pageSize){
+            break;
+        }
+
+        string sql = "SELECT * FROM " + tableName;
+        if (softDelete || !segment.condition.empty()){
+            sql += " WHERE ";
+            sql += softDelete ? "deleted_at IS NULL" : "";
+            sql += softDelete && !segment.condition.empty() ? " AND " : "";
+            sql += segment.condition;
+        }
+        sql += orderBy + " LIMIT ?;";
+
+        vector<FieldValue> parameters = segment.parameters;
+        parameters.push_back(static_cast<int>(pageSize + 1 - page.rows.size()));
+        if (!database.query(sql, parameters, rows)){
+            page.rows.clear();
+            return false;
+        }
+        move(rows.begin(), rows.end(), back_inserter(page.rows));
+    }
+
+    // The extra row only tells whether there is more in this direction.
+    const bool more = page.rows.size() > pageSize;
+    if (more){
+        page.rows.pop_back();
+    }
+
+    if (page.rows.empty()){
+        return true;
+    }
+
+    if (backward){
+        reverse(page.rows.begin(), page.rows.end());
+        if (more){
+            page.previousToken = encodeToken(page.rows.front(), true);
+        }
+        if (anchored){
+            page.nextToken = encodeToken(page.rows.back(), false);
+        }
+    }else{
+        if (more){
+            page.nextToken = encodeToken(page.rows.back(), false);
+        }
+        if (anchored){
+            page.previousToken = encodeToken(page.rows.front(), true);
+        }
+    }
+    return true;
+}
+
+bool Paginator::first(Page &page){
+    return fetchFrom(false, false, 0, true, 0, page);
+}
+
+bool Paginator::last(Page &page){
+    return fetchFrom(true, false, 0, true, 0, page);
+}
+
+bool Paginator::fetch(const string &token, Page &page){
+    if (token.empty()){
+        return first(page);
+    }
+
+    bool backward;
+    FieldValue value;
+    bool isNull;
+    sqlite3_int64 id;
+    if (!decodeToken(token, backward, value, isNull, id)){
+        LOG_WARNING("Invalid page token for %s ordered by %s", tableName.c_str(), sortColumn.c_str());
+        page.rows.clear();
+        page.nextToken.clear();
+        page.previousToken.clear();
+        return false;
+    }
+    return fetchFrom(backward, true, value, isNull, id, page);
+}
@@ -0,0 +1,293 @@
+#include "protocol.hpp"
+#include "wire.hpp"
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+using wire::Reader;
+using wire::Writer;
+
+namespace {
+    // Reserves the length prefix, to be filled in once the body is written.
+    size_t beginFrame(string &out){
+        const size_t start = out.size();
+        out.append(4, '\0');
+        return start;
+    }
+
+    void endFrame(string &out, size_t start){
+        const uint32_t size = static_cast<uint32_t>(out.size() - start - 4);
+        for (int index = 0; index < 4; ++index){
+            out[start + static_cast<size_t>(index)] = static_cast<char>(size >> (8 * index));
+        }
+    }
+}
+
+bool protocol::isWrite(Opcode op){
+    return op == Opcode::Add || op == Opcode::Update || op == Opcode::Remove || op == Opcode::MoveStock;
+}
+
+void protocol::encode(string &out, const Request &request){
+    const size_t start = beginFrame(out);
+    Writer writer(out);
+    writer.fixed32(request.id);
+    writer.byte(static_cast<uint8_t>(request.op));
+
+    const BatchCommand &command = request.command;
+    const int id = command.ids.empty() ? 0 : command.ids.front();
+    switch (request.op){
+        case Opcode::Ping:
+            break;
+        case Opcode::Get:
+            writer.text(command.table);
+            writer.varint(static_cast<uint64_t>(id));
+            break;
+        case Opcode::List:
+            writer.text(command.table);
+            writer.varint(static_cast<uint64_t>(id));
+            writer.varint(static_cast<uint64_t>(request.limit));
+            break;
+        case Opcode::Add:
+            writer.text(command.table);
+            writer.row(command.values);
+            break;
+        case Opcode::Update:
+            writer.text(command.table);
+            writer.varint(static_cast<uint64_t>(id));
+            writer.row(command.values);
+            break;
+        case Opcode::Remove:
+            writer.text(command.table);
+            writer.varint(command.ids.size());
+            for (int removed : command.ids){
+                writer.varint(static_cast<uint64_t>(removed));
+            }
+            break;
+        case Opcode::MoveStock: {
+            writer.varint(static_cast<uint64_t>(id));
+            writer.signedVarint(command.quantity);
+            auto user = command.values.find("user");
+            auto remarks = command.values.find("remarks");
+            writer.varint(user != command.values.end() && holds_alternative<int>(user->second) ? static_cast<uint64_t>(get<int>(user->second)) : 0);
+            writer.text(remarks != command.values.end() && holds_alternative<string>(remarks->second) ? get<string>(remarks->second) : "");
+            break;
+        }
+        case Opcode::Report:
+            writer.text(command.table);
+            break;
+    }
+    endFrame(out, start);
+}
+
+void protocol::encode(string &out, const Response &response){
+    const size_t start = beginFrame(out);
+    Writer writer(out);
+    writer.fixed32(response.id);
+    writer.byte(static_cast<uint8_t>(response.status));
+    writer.varint(response.rows.size());
+    for (const Row &row : response.rows){
+        writer.row(row);
+    }
+    endFrame(out, start);
+}
+
+bool protocol::decode(const char *body, size_t size, Request &request){
+    Reader reader(body, size);
+    uint8_t op;
+    if (!reader.fixed32(request.id) || !reader.byte(op) || op > static_cast<uint8_t>(Opcode::Report)){
+        return false;
+    }
+    request.op = static_cast<Opcode>(op);
+
+    BatchCommand &command = request.command;
+    auto table = [&]{
+        return reader.text(command.table) && BatchRunner::knownTable(command.table);
+    };
+    // Column names are pasted into SQL.
+    auto columns = [&]{
+        if (!reader.row(command.values) || command.values.empty()){
+            return false;
+        }
+        for (const auto &[name, value] : command.values){
+            if (!BatchRunner::validColumn(name)){
+                return false;
+            }
+        }
+        return true;
+    };
+    auto id = [&]{
+        int value;
+        if (!reader.integer(value)){
+            return false;
+        }
+        command.ids.push_back(value);
+        return true;
+    };
+
+    bool valid = true;
+    switch (request.op){
+        case Opcode::Ping:
+            break;
+        case Opcode::Get:
+            valid = table() && id();
+            break;
+        case Opcode::List:
+            valid = table() && id() && reader.integer(request.limit);
+            break;
+        case Opcode::Add:
+            command.kind = BatchCommand::Kind::Add;
+            valid = table() && columns();
+            break;
+        case Opcode::Update:
+            command.kind = BatchCommand::Kind::Update;
+            valid = table() && id() && columns();
+            break;
+        case Opcode::Remove: {
+            command.kind = BatchCommand::Kind::Remove;
+            uint64_t count;
+            valid = table() && reader.varint(count) && count > 0 && count <= size;
+            for (uint64_t index = 0; valid && index < count; ++index){
+                valid = id();
+            }
+            break;
+        }
+        case Opcode::MoveStock: {
+            command.kind = BatchCommand::Kind::MoveStock;
+            command.table = "item";
+            int user;
+            string remarks;
+            valid = id() && reader.signedInteger(command.quantity) && command.quantity != 0 && reader.integer(user) && reader.text(remarks);
+            if (valid && user != 0){
+                command.values["user"] = user;
+            }
+            if (valid && !remarks.empty()){
+                command.values["remarks"] = remarks;
+            }
+            break;
+        }
+        case Opcode::Report:
+            command.kind = BatchCommand::Kind::Report;
+            valid = reader.text(command.table);
+            break;
+    }
+    return valid && reader.atEnd();
+}
+
+bool protocol::decode(const char *body, size_t size, Response &response){
+    Reader reader(body, size);
+    uint8_t status;
+    uint64_t count;
+    if (!reader.fixed32(response.id) || !reader.byte(status) || status > static_cast<uint8_t>(Status::BadRequest) || !reader.varint(count) ||
+        count > size){
+        return false;
+    }
+    response.status = static_cast<Status>(status);
+
+    response.rows.clear();
+    response.rows.resize(static_cast<size_t>(count));
+    for (Row &row : response.rows){
+        if (!reader.row(row)){
+            return false;
+        }
+    }
+    return reader.atEnd();
+}
+
+// ServerClient
+
+ServerClient::~ServerClient(){
+    if (fd >= 0){
+        close(fd);
+    }
+}
+
+bool ServerClient::connect(const string &socketPath){
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)){
+        LOG_ERROR("Socket path too long: %s", socketPath.c_str());
+        return false;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0){
+        LOG_ERROR("Can't connect to %s: %s", socketPath.c_str(), strerror(errno));
+        if (fd >= 0){
+            close(fd);
+            fd = -1;
+        }
+        return false;
+    }
+    return true;
+}
+
+void ServerClient::queue(const protocol::Request &request){
+    protocol::encode(output, request);
+}
+
+bool ServerClient::flush(){
+    size_t sent = 0;
+    while (sent < output.size()){
+        ssize_t written = send(fd, output.data() + sent, output.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR){
+            continue;
+        }
+        if (written <= 0){
+            LOG_ERROR("Error sending request: %s", strerror(errno));
+            return false;
+        }
+        sent += static_cast<size_t>(written);
+    }
+    output.clear();
+    return true;
+}
+
+bool ServerClient::receive(protocol::Response &response){
+    while (true){
+        const size_t available = input.size() - inputOffset;
+        if (available >= 4){
+            const uint8_t *prefix = reinterpret_cast<const uint8_t*>(input.data() + inputOffset);
+            const uint32_t size = prefix[0] | prefix[1] << 8 | prefix[2] << 16 | static_cast<uint32_t>(prefix[3]) << 24;
+            if (size > protocol::maxFrameSize){
+                LOG_ERROR("Response frame of %u bytes is too large", size);
+                return false;
+            }
+            if (available >= 4 + static_cast<size_t>(size)){
+                const bool valid = protocol::decode(input.data() + inputOffset + 4, size, response);
+                inputOffset += 4 + size;
+                if (inputOffset == input.size()){
+                    input.clear();
+                    inputOffset = 0;
+                }
+                return valid;
+            }
+        }
+
+        if (inputOffset > 0){
+            input.erase(0, inputOffset);
+            inputOffset = 0;
+        }
+        char buffer[65536];
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR){
+            continue;
+        }
+        if (received <= 0){
+            if (received < 0){
+                LOG_ERROR("Error receiving response: %s", strerror(errno));
+            }
+            return false;
+        }
+        input.append(buffer, static_cast<size_t>(received));
+    }
+}
+
+bool ServerClient::call(const protocol::Request &request, protocol::Response &response){
+    queue(request);
+    return flush() && receive(response);
+}
@@ -0,0 +1,366 @@
+#include "replication.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <zlib.h>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static const char changesetMagic[8] = {'I', 'N', 'V', 'C', 'S', 'E', 'T', '1'};
+
+static int64_t nowMicros(){
+    return chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static string changesetPath(const string &directory, uint64_t sequence){
+    char name[32];
+    snprintf(name, sizeof(name), "%020llu.changeset", static_cast<unsigned long long>(sequence));
+    return (fs::path(directory) / name).string();
+}
+
+static bool parseSequence(const fs::path &path, uint64_t &sequence){
+    if (path.extension() != ".changeset"){
+        return false;
+    }
+    const string stem = path.stem().string();
+    if (stem.empty() || stem.find_first_not_of("0123456789") != string::npos){
+        return false;
+    }
+    sequence = stoull(stem);
+    return true;
+}
+
+static bool readHeader(const string &path, ChangesetHeader &header){
+    ifstream file(path, ios::binary);
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))){
+        return false;
+    }
+    return memcmp(header.magic, changesetMagic, sizeof(changesetMagic)) == 0;
+}
+
+// ReplicationPrimary
+
+ReplicationPrimary::ReplicationPrimary(Database &database, const string &directory, const vector<string> &tables)
+    : database(database), directory(directory), tables(tables){
+    error_code error;
+    fs::create_directories(directory, error);
+    if (error){
+        LOG_ERROR("Error creating replication directory: %s", error.message().c_str());
+    }
+
+    // Continue numbering after whatever has already been shipped.
+    for (const auto &entry : fs::directory_iterator(directory, error)){
+        uint64_t sequence;
+        if (parseSequence(entry.path(), sequence) && sequence >= nextSequence){
+            nextSequence = sequence + 1;
+        }
+    }
+
+    session = openSession();
+}
+
+ReplicationPrimary::~ReplicationPrimary(){
+    if (session){
+        sqlite3session_delete(session);
+    }
+}
+
+sqlite3_session *ReplicationPrimary::openSession(){
+    sqlite3 *db = database.getDBConnection();
+    sqlite3_session *created;
+
+    if (sqlite3session_create(db, "main", &created) != SQLITE_OK){
+        LOG_ERROR("Error creating replication session: %s", sqlite3_errmsg(db));
+        return nullptr;
+    }
+
+    for (const string &table : tables){
+        if (sqlite3session_attach(created, table.c_str()) != SQLITE_OK){
+            LOG_ERROR("Error attaching replication session to %s: %s", table.c_str(), sqlite3_errmsg(db));
+            sqlite3session_delete(created);
+            return nullptr;
+        }
+    }
+    return created;
+}
+
+bool ReplicationPrimary::ship(){
+    if (!session){
+        session = openSession();
+        return false;
+    }
+
+    sqlite3_session *previous = session;
+    session = openSession();
+    if (!session){
+        session = previous;
+        return false;
+    }
+
+    int size = 0;
+    void *changeset = nullptr;
+    int result = sqlite3session_changeset(previous, &size, &changeset);
+    if (result != SQLITE_OK){
+        // The old session still holds everything since the last shipped
+        // changeset; keep recording into it and retry on the next call.
+        LOG_ERROR("Error extracting changeset: %s", sqlite3_errstr(result));
+        sqlite3_free(changeset);
+        sqlite3session_delete(session);
+        session = previous;
+        return false;
+    }
+    sqlite3session_delete(previous);
+
+    if (size == 0){
+        sqlite3_free(changeset);
+        return flush();
+    }
+
+    uLongf compressedSize = compressBound(static_cast<uLong>(size));
+    vector<unsigned char> compressed(compressedSize);
+    int zlibResult = compress2(compressed.data(), &compressedSize, static_cast<const Bytef*>(changeset), static_cast<uLong>(size), Z_BEST_SPEED);
+    uint32_t checksum = static_cast<uint32_t>(crc32(0L, static_cast<const Bytef*>(changeset), static_cast<uInt>(size)));
+    sqlite3_free(changeset);
+
+    if (zlibResult != Z_OK){
+        LOG_ERROR("Error compressing changeset: zlib error %d", zlibResult);
+        return false;
+    }
+    compressed.resize(compressedSize);
+
+    ChangesetHeader header{};
+    memcpy(header.magic, changesetMagic, sizeof(changesetMagic));
+    header.createdAtMicros = nowMicros();
+    header.rawSize = static_cast<uint32_t>(size);
+    header.compressedSize = static_cast<uint32_t>(compressedSize);
+    header.checksum = checksum;
+    unshipped.emplace_back(header, move(compressed));
+
+    return flush();
+}
+
+bool ReplicationPrimary::flush(){
+    while (!unshipped.empty()){
+        ChangesetHeader &header = unshipped.front().first;
+        const vector<unsigned char> &compressed = unshipped.front().second;
+        header.sequence = nextSequence;
+
+        // Write under a temporary name and rename, so followers never see a partial file.
+        const string path = changesetPath(directory, nextSequence);
+        const string temporaryPath = path + ".tmp";
+        {
+            ofstream file(temporaryPath, ios::binary | ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(compressed.data()), static_cast<streamsize>(compressed.size()));
+            if (!file){
+                LOG_ERROR("Error writing changeset file: %s", temporaryPath.c_str());
+                return false;
+            }
+        }
+
+        error_code error;
+        fs::rename(temporaryPath, path, error);
+        if (error){
+            LOG_ERROR("Error publishing changeset file: %s", error.message().c_str());
+            return false;
+        }
+
+        rawBytes += header.rawSize;
+        compressedBytes += header.compressedSize;
+        ++nextSequence;
+        unshipped.pop_front();
+    }
+    return true;
+}
+
+uint64_t ReplicationPrimary::lastShipped() const{
+    return nextSequence - 1;
+}
+
+uint64_t ReplicationPrimary::shippedRawBytes() const{
+    return rawBytes;
+}
+
+uint64_t ReplicationPrimary::shippedCompressedBytes() const{
+    return compressedBytes;
+}
+
+// ReplicationFollower
+
+ReplicationFollower::ReplicationFollower(Database &database, const string &directory) : database(database), directory(directory){
+    char *errMsg = nullptr;
+    const char *stateTableQuery = "CREATE TABLE IF NOT EXISTS replication_state ("
+                                  "id INTEGER PRIMARY KEY CHECK (id = 1), "
+                                  "applied_sequence INTEGER NOT NULL, "
+                                  "applied_at INTEGER NOT NULL);";
+
+    if (sqlite3_exec(database.getDBConnection(), stateTableQuery, nullptr, nullptr, &errMsg) != SQLITE_OK){
+        LOG_ERROR("Error Creating Replication State Table: %s", errMsg);
+        sqlite3_free(errMsg);
+    }
+}
+
+int ReplicationFollower::conflictHandler(void *context, int conflict, sqlite3_changeset_iter *iterator){
+    ReplicationFollower *follower = static_cast<ReplicationFollower*>(context);
+
+    switch (conflict){
+        case SQLITE_CHANGESET_DATA:
+        case SQLITE_CHANGESET_CONFLICT:
+            ++follower->replacedRows;
+            return SQLITE_CHANGESET_REPLACE;
+        case SQLITE_CHANGESET_FOREIGN_KEY: {
+            // Reported once for the whole changeset, after every row has been
+            // applied: omitting would commit the violating rows, so refuse it.
+            int violations = 0;
+            sqlite3changeset_fk_conflicts(iterator, &violations);
+            LOG_ERROR("Changeset would leave %d foreign key violations on the follower", violations);
+            return SQLITE_CHANGESET_ABORT;
+        }
+        default:
+            // NOTFOUND and CONSTRAINT: the follower cannot reconstruct the
+            // row, so skip the change.
+            ++follower->omittedRows;
+            return SQLITE_CHANGESET_OMIT;
+    }
+}
+
+vector<uint64_t> ReplicationFollower::availableSequences() const{
+    vector<uint64_t> sequences;
+    error_code error;
+
+    for (const auto &entry : fs::directory_iterator(directory, error)){
+        uint64_t sequence;
+        if (parseSequence(entry.path(), sequence)){
+            sequences.push_back(sequence);
+        }
+    }
+
+    sort(sequences.begin(), sequences.end());
+    return sequences;
+}
+
+bool ReplicationFollower::apply(uint64_t sequence){
+    const string path = changesetPath(directory, sequence);
+    ifstream file(path, ios::binary);
+
+    ChangesetHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        memcmp(header.magic, changesetMagic, sizeof(changesetMagic)) != 0 || header.sequence != sequence){
+        LOG_ERROR("Invalid changeset header: %s", path.c_str());
+        return false;
+    }
+
+    vector<unsigned char> compressed(header.compressedSize);
+    if (!file.read(reinterpret_cast<char*>(compressed.data()), static_cast<streamsize>(compressed.size()))){
+        LOG_ERROR("Truncated changeset file: %s", path.c_str());
+        return false;
+    }
+
+    vector<unsigned char> changeset(header.rawSize);
+    uLongf rawSize = header.rawSize;
+    if (uncompress(changeset.data(), &rawSize, compressed.data(), header.compressedSize) != Z_OK ||
+        rawSize != header.rawSize ||
+        crc32(0L, changeset.data(), static_cast<uInt>(rawSize)) != header.checksum){
+        LOG_ERROR("Corrupt changeset file: %s", path.c_str());
+        return false;
+    }
+
+    sqlite3 *db = database.getDBConnection();
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error starting replication transaction: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    int result = sqlite3changeset_apply(db, static_cast<int>(changeset.size()), changeset.data(),
+                                        nullptr, &ReplicationFollower::conflictHandler, this);
+    if (result != SQLITE_OK){
+        LOG_ERROR("Error applying changeset %llu: %s", static_cast<unsigned long long>(sequence), sqlite3_errstr(result));
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+
+    sqlite3_stmt *stmt;
+    const char *stateQuery = "INSERT INTO replication_state (id, applied_sequence, applied_at) VALUES (1, ?, ?) "
+                             "ON CONFLICT(id) DO UPDATE SET applied_sequence = excluded.applied_sequence, applied_at = excluded.applied_at;";
+    if (sqlite3_prepare_v2(db, stateQuery, -1, &stmt, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error preparing replication state update: %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+
+    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(sequence));
+    sqlite3_bind_int64(stmt, 2, header.createdAtMicros);
+    result = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if (result != SQLITE_DONE || sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error committing changeset %llu: %s", static_cast<unsigned long long>(sequence), sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    return true;
+}
+
+size_t ReplicationFollower::catchUp(){
+    uint64_t applied = appliedSequence();
+    size_t count = 0;
+
+    for (uint64_t sequence : availableSequences()){
+        if (sequence <= applied){
+            continue;
+        }
+        if (!apply(sequence)){
+            break;
+        }
+        ++count;
+    }
+    return count;
+}
+
+uint64_t ReplicationFollower::appliedSequence() const{
+    sqlite3 *db = database.getDBConnection();
+    sqlite3_stmt *stmt;
+    uint64_t applied = 0;
+
+    if (sqlite3_prepare_v2(db, "SELECT applied_sequence FROM replication_state WHERE id = 1;", -1, &stmt, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error reading replication state: %s", sqlite3_errmsg(db));
+        return 0;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW){
+        applied = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    return applied;
+}
+
+ReplicationLag ReplicationFollower::lag() const{
+    ReplicationLag lag;
+    uint64_t applied = appliedSequence();
+    bool oldestFound = false;
+
+    for (uint64_t sequence : availableSequences()){
+        if (sequence <= applied){
+            continue;
+        }
+        ++lag.changesetsBehind;
+
+        ChangesetHeader header;
+        if (!oldestFound && readHeader(changesetPath(directory, sequence), header)){
+            lag.secondsBehind = (nowMicros() - header.createdAtMicros) / 1e6;
+            oldestFound = true;
+        }
+    }
+    return lag;
+}
+
+uint64_t ReplicationFollower::replacedConflicts() const{
+    return replacedRows;
+}
+
+uint64_t ReplicationFollower::omittedConflicts() const{
+    return omittedRows;
+}
@@ -0,0 +1,350 @@
+#include "report.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+using namespace std;
+
+void ReportDag::addStage(ReportStage stage){
+    stages.push_back(move(stage));
+}
+
+bool ReportDag::isMoneyColumn(const string &stageName, size_t column) const{
+    for (const ReportStage &stage : stages){
+        if (stage.name == stageName){
+            return find(stage.moneyColumns.begin(), stage.moneyColumns.end(), column) != stage.moneyColumns.end();
+        }
+    }
+    return false;
+}
+
+void ReportDag::merge(ReportTable &into, const ReportTable &partial){
+    for (const auto &[key, values] : partial){
+        vector<double> &target = into[key];
+        if (target.size() < values.size()){
+            target.resize(values.size(), 0.0);
+        }
+        for (size_t column = 0; column < values.size(); ++column){
+            target[column] += values[column];
+        }
+    }
+}
+
+bool ReportDag::order(vector<size_t> &sorted, vector<vector<size_t>> &dependents) const{
+    map<string, size_t> indexes;
+    for (size_t index = 0; index < stages.size(); ++index){
+        if (!indexes.emplace(stages[index].name, index).second){
+            LOG_ERROR("Duplicate report stage: %s", stages[index].name.c_str());
+            return false;
+        }
+    }
+
+    dependents.assign(stages.size(), {});
+    vector<size_t> waiting(stages.size(), 0);
+    for (size_t index = 0; index < stages.size(); ++index){
+        for (const string &dependency : stages[index].dependencies){
+            auto found = indexes.find(dependency);
+            if (found == indexes.end()){
+                LOG_ERROR("Report stage %s depends on unknown stage %s", stages[index].name.c_str(), dependency.c_str());
+                return false;
+            }
+            dependents[found->second].push_back(index);
+            ++waiting[index];
+        }
+    }
+
+    // Kahn's algorithm; anything left over sits on a cycle.
+    sorted.clear();
+    for (size_t index = 0; index < stages.size(); ++index){
+        if (waiting[index] == 0){
+            sorted.push_back(index);
+        }
+    }
+    for (size_t position = 0; position < sorted.size(); ++position){
+        for (size_t dependent : dependents[sorted[position]]){
+            if (--waiting[dependent] == 0){
+                sorted.push_back(dependent);
+            }
+        }
+    }
+
+    if (sorted.size() != stages.size()){
+        LOG_ERROR("Report stages form a dependency cycle");
+        return false;
+    }
+    return true;
+}
+
+bool ReportDag::run(TaskPool &pool, ReportResults &results, map<string, double> *timings) const{
+    vector<size_t> sorted;
+    vector<vector<size_t>> dependents;
+    if (!order(sorted, dependents)){
+        return false;
+    }
+
+    // Every key exists before any task runs, so tasks only ever assign to existing entries.
+    results.clear();
+    for (const ReportStage &stage : stages){
+        results[stage.name];
+    }
+    if (stages.empty()){
+        return true;
+    }
+
+    const size_t count = stages.size();
+    vector<int> partitionCounts(count);
+    unique_ptr<atomic<int>[]> partitionsLeft(new atomic<int>[count]);
+    unique_ptr<atomic<size_t>[]> dependenciesLeft(new atomic<size_t>[count]);
+    vector<vector<ReportTable>> partials(count);
+    vector<chrono::steady_clock::time_point> started(count);
+    vector<double> elapsed(count, 0.0);
+    unique_ptr<atomic<bool>[]> failed(new atomic<bool>[count]);
+
+    for (size_t index = 0; index < count; ++index){
+        int partitions = stages[index].partitions > 0 ? stages[index].partitions : static_cast<int>(pool.size());
+        partitionCounts[index] = partitions;
+        partitionsLeft[index].store(partitions);
+        dependenciesLeft[index].store(stages[index].dependencies.size());
+        partials[index].resize(static_cast<size_t>(partitions));
+        failed[index].store(false);
+    }
+
+    mutex doneMutex;
+    condition_variable doneCondition;
+    size_t stagesLeft = count;
+
+    function<void(size_t)> release;
+    auto finish = [&](size_t index){
+        // find() rather than operator[]: other tasks read results concurrently.
+        ReportTable &merged = results.find(stages[index].name)->second;
+        if (failed[index].load(memory_order_acquire)){
+            LOG_ERROR("Report stage %s failed", stages[index].name.c_str());
+        }else{
+            for (const ReportTable &partial : partials[index]){
+                merge(merged, partial);
+            }
+        }
+        partials[index].clear();
+        elapsed[index] = chrono::duration<double, milli>(chrono::steady_clock::now() - started[index]).count();
+
+        for (size_t dependent : dependents[index]){
+            // Released before the dependent's tasks are submitted, so they see the mark.
+            if (failed[index].load(memory_order_acquire)){
+                failed[dependent].store(true, memory_order_release);
+            }
+            if (dependenciesLeft[dependent].fetch_sub(1, memory_order_acq_rel) == 1){
+                release(dependent);
+            }
+        }
+
+        lock_guard<mutex> lock(doneMutex);
+        if (--stagesLeft == 0){
+            doneCondition.notify_all();
+        }
+    };
+
+    release = [&](size_t index){
+        started[index] = chrono::steady_clock::now();
+        const ReportStage &stage = stages[index];
+        const int partitions = partitionCounts[index];
+
+        for (int partition = 0; partition < partitions; ++partition){
+            pool.submit([&, index, partition, partitions](sqlite3 *connection){
+                // A failed dependency leaves the inputs incomplete; nothing is computed from them.
+                if (stage.compute && !failed[index].load(memory_order_acquire) &&
+                    !stage.compute(connection, partition, partitions, results, partials[index][static_cast<size_t>(partition)])){
+                    failed[index].store(true, memory_order_release);
+                }
+                if (partitionsLeft[index].fetch_sub(1, memory_order_acq_rel) == 1){
+                    finish(index);
+                }
+            });
+        }
+    };
+
+    for (size_t index = 0; index < count; ++index){
+        if (stages[index].dependencies.empty()){
+            release(index);
+        }
+    }
+
+    unique_lock<mutex> lock(doneMutex);
+    doneCondition.wait(lock, [&]{ return stagesLeft == 0; });
+
+    if (timings){
+        timings->clear();
+        for (size_t index = 0; index < count; ++index){
+            (*timings)[stages[index].name] = elapsed[index];
+        }
+    }
+
+    bool succeeded = true;
+    for (size_t index = 0; index < count; ++index){
+        if (failed[index].load(memory_order_relaxed)){
+            results.erase(stages[index].name);
+            succeeded = false;
+        }
+    }
+    return succeeded;
+}
+
+bool ReportDag::runSequential(sqlite3 *connection, ReportResults &results) const{
+    vector<size_t> sorted;
+    vector<vector<size_t>> dependents;
+    if (!order(sorted, dependents)){
+        return false;
+    }
+
+    results.clear();
+    bool succeeded = true;
+    for (size_t index : sorted){
+        const ReportStage &stage = stages[index];
+        const int partitions = stage.partitions > 0 ? stage.partitions : 1;
+
+        // A stage whose dependency failed is skipped, like in run().
+        bool failed = false;
+        for (const string &dependency : stage.dependencies){
+            failed = failed || !results.count(dependency);
+        }
+
+        ReportTable merged;
+        for (int partition = 0; partition < partitions && stage.compute && !failed; ++partition){
+            ReportTable partial;
+            failed = !stage.compute(connection, partition, partitions, results, partial);
+            merge(merged, partial);
+        }
+        if (failed){
+            LOG_ERROR("Report stage %s failed", stage.name.c_str());
+            succeeded = false;
+            continue;
+        }
+        results[stage.name] = move(merged);
+    }
+    return succeeded;
+}
+
+// Standard reports
+
+/**
+ * @brief Runs an aggregate query over one id range: ?1 is the partition, ?2 the partition count.
+ *
+ * The first column is the group key and the others are the additive aggregates.
+ *
+ * @return false if the query could not be prepared or stopped before its last row.
+ */
+static bool aggregate(sqlite3 *connection, const char *sql, int partition, int partitions, ReportTable &table){
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(connection, sql, -1, &stmt, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error preparing report query: %s", sqlite3_errmsg(connection));
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, partition);
+    sqlite3_bind_int(stmt, 2, partitions);
+
+    const int columns = sqlite3_column_count(stmt);
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW){
+        const unsigned char *key = sqlite3_column_text(stmt, 0);
+        vector<double> &values = table[key ? reinterpret_cast<const char*>(key) : ""];
+        values.resize(static_cast<size_t>(columns - 1), 0.0);
+        for (int column = 1; column < columns; ++column){
+            values[static_cast<size_t>(column - 1)] += sqlite3_column_double(stmt, column);
+        }
+    }
+    if (result != SQLITE_DONE){
+        LOG_ERROR("Error running report query: %s", sqlite3_errmsg(connection));
+    }
+
+    sqlite3_finalize(stmt);
+    return result == SQLITE_DONE;
+}
+
+// Splits the rowid space [1, max(id)] of a table into ?2 equal ranges and keeps range ?1;
+// each range is a rowid seek, so partitions never read each other's rows.
+#define ID_RANGE(alias, table) \
+    " " alias ".id > (SELECT max(id) FROM " table ") * ?1 / ?2 AND " alias ".id <= (SELECT max(id) FROM " table ") * (?1 + 1) / ?2 "
+
+void reportLabel(const string &key, string &group, string &label){
+    const size_t tab = key.find('\t');
+    group = key.substr(0, tab);
+    label = tab == string::npos ? "" : key.substr(tab + 1);
+}
+
+ReportDag inventoryReports(int partitions){
+    ReportDag dag;
+
+    // Already aggregated by the item triggers; one partition reads every category.
+    // Names repeat across the tree, so the group is the id, labelled with the
+    // path from the root through the closure table.
+    dag.addStage({"category_valuation", {}, 1, [](sqlite3 *connection, int partition, int count, const ReportResults&, ReportTable &table){
+        return aggregate(connection,
+            "SELECT c.id || char(9) || (SELECT group_concat(name, ' / ') FROM ("
+            "SELECT a.name FROM category_tree AS p JOIN category AS a ON a.id = p.ancestor_id "
+            "WHERE p.descendant_id = c.id ORDER BY p.depth DESC)), t.valuation, t.quantity, t.items "
+            "FROM category_totals AS t JOIN category AS c ON c.id = t.category_id "
+            "WHERE t.items > 0 AND c.deleted_at IS NULL;", partition, count, table);
+    }, {0}});
+
+    // Keyed by supplier id and labelled with the name, as names can repeat.
+    // Transactions carry no price, so purchases are valued at the item's
+    // current unit_price rather than the price paid at the time.
+    dag.addStage({"supplier_spend", {}, partitions, [](sqlite3 *connection, int partition, int count, const ReportResults&, ReportTable &table){
+        return aggregate(connection,
+            "SELECT s.id || char(9) || s.name, SUM(t.quantity * i.unit_price), SUM(t.quantity) "
+            "FROM transaction_records AS t JOIN item AS i ON i.id = t.item_id JOIN suppliers AS s ON s.id = i.supplier_id "
+            "WHERE t.transaction_type = 'in' AND s.deleted_at IS NULL AND" ID_RANGE("t", "transaction_records")
+            "GROUP BY s.id;", partition, count, table);
+    }, {0}});
+
+    dag.addStage({"movement_history", {}, partitions, [](sqlite3 *connection, int partition, int count, const ReportResults&, ReportTable &table){
+        return aggregate(connection,
+            "SELECT strftime('%Y-%m', t.transaction_date) || ' ' || t.transaction_type, SUM(t.quantity), COUNT(*) "
+            "FROM transaction_records AS t "
+            "WHERE" ID_RANGE("t", "transaction_records")
+            "GROUP BY 1;", partition, count, table);
+    }, {}});
+
+    dag.addStage({"inventory_summary", {"category_valuation", "supplier_spend"}, 1, [](sqlite3*, int, int, const ReportResults &inputs, ReportTable &summary){
+        summary["stock"] = {0.0, 0.0, 0.0};
+        summary["purchases"] = {0.0, 0.0};
+
+        for (const auto &[category, values] : inputs.at("category_valuation")){
+            ReportDag::merge(summary, {{"stock", values}});
+        }
+        for (const auto &[supplier, values] : inputs.at("supplier_spend")){
+            ReportDag::merge(summary, {{"purchases", values}});
+        }
+        return true;
+    }, {0}});
+
+    return dag;
+}
+
+bool mostValuableItems(sqlite3 *connection, int limit, vector<ValuedItem> &items){
+    items.clear();
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(connection, "SELECT id, name, quantity, price FROM item WHERE deleted_at IS NULL ORDER BY price DESC LIMIT ?;",
+                           -1, &stmt, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error preparing most valuable items query: %s", sqlite3_errmsg(connection));
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, limit);
+
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW){
+        const unsigned char *name = sqlite3_column_text(stmt, 1);
+        items.push_back({sqlite3_column_int64(stmt, 0), name ? reinterpret_cast<const char*>(name) : "", sqlite3_column_int(stmt, 2),
+                         Money::fromUnits(sqlite3_column_int64(stmt, 3))});
+    }
+    sqlite3_finalize(stmt);
+
+    if (result != SQLITE_DONE){
+        LOG_ERROR("Error running most valuable items query: %s", sqlite3_errmsg(connection));
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,226 @@
+#include "row_cache.hpp"
+#include <cstring>
+
+using namespace std;
+
+RowCache::RowCache(Database &database, const RowCacheOptions &options)
+    : database(database), options(options), subscription(database.changes().subscribe()){
+    size_t count = 1;
+    while (count < options.shards){
+        count <<= 1;
+    }
+    for (size_t index = 0; index < count; ++index){
+        shards.push_back(make_unique<Shard>());
+    }
+    shardMask = count - 1;
+    shardBudget = options.memoryBudget / count;
+
+    // Record the starting data_version so the first sync() can detect foreign commits.
+    sync();
+}
+
+int RowCache::tableIndex(const string &tableName) const{
+    return tableIndex(tableName.c_str());
+}
+
+int RowCache::tableIndex(const char *tableName) const{
+    for (size_t index = 0; index < options.tables.size(); ++index){
+        if (strcmp(options.tables[index].c_str(), tableName) == 0){
+            return static_cast<int>(index);
+        }
+    }
+    return -1;
+}
+
+uint64_t RowCache::key(int table, sqlite3_int64 id){
+    return (static_cast<uint64_t>(table) << 56) | (static_cast<uint64_t>(id) & 0x00FFFFFFFFFFFFFFULL);
+}
+
+RowCache::Shard &RowCache::shardFor(uint64_t key){
+    // Fibonacci hashing spreads consecutive ids over all shards.
+    return *shards[(key * 0x9E3779B97F4A7C15ULL >> 40) & shardMask];
+}
+
+size_t RowCache::rowBytes(const Row &row){
+    // Map node plus the column name and value strings when they do not fit inline.
+    size_t bytes = sizeof(Row) + sizeof(Entry) + 64;
+    for (const auto &[column, value] : row){
+        bytes += 64 + column.capacity();
+        if (std::holds_alternative<string>(value)){
+            bytes += std::get<string>(value).capacity();
+        }
+    }
+    return bytes;
+}
+
+void RowCache::store(int table, sqlite3_int64 id, shared_ptr<const Row> row){
+    const uint64_t entryKey = key(table, id);
+    const size_t bytes = rowBytes(*row);
+    Shard &shard = shardFor(entryKey);
+
+    lock_guard<mutex> lock(shard.mutex);
+    auto found = shard.index.find(entryKey);
+    if (found != shard.index.end()){
+        shard.bytes -= found->second->bytes;
+        shard.lru.erase(found->second);
+        shard.index.erase(found);
+    }
+
+    shard.lru.push_front({table, id, move(row), bytes});
+    shard.index.emplace(entryKey, shard.lru.begin());
+    shard.bytes += bytes;
+
+    while (shard.bytes > shardBudget && shard.lru.size() > 1){
+        Entry &victim = shard.lru.back();
+        shard.bytes -= victim.bytes;
+        shard.index.erase(key(victim.table, victim.id));
+        shard.lru.pop_back();
+        evictions.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+void RowCache::invalidate(int table, sqlite3_int64 id){
+    const uint64_t entryKey = key(table, id);
+    Shard &shard = shardFor(entryKey);
+
+    lock_guard<mutex> lock(shard.mutex);
+    auto found = shard.index.find(entryKey);
+    if (found != shard.index.end()){
+        shard.bytes -= found->second->bytes;
+        shard.lru.erase(found->second);
+        shard.index.erase(found);
+        invalidations.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+void RowCache::drainChanges(){
+    lock_guard<mutex> lock(eventsMutex);
+
+    events.clear();
+    subscription->poll(events);
+    if (subscription->overflowed()){
+        clear();
+        return;
+    }
+
+    for (const ChangeEvent &event : events){
+        int table = tableIndex(event.table);
+        if (table >= 0){
+            invalidate(table, event.rowId);
+        }
+    }
+}
+
+shared_ptr<const Row> RowCache::lookup(const string &tableName, sqlite3_int64 id){
+    int table = tableIndex(tableName);
+    if (table < 0){
+        return nullptr;
+    }
+
+    const uint64_t entryKey = key(table, id);
+    Shard &shard = shardFor(entryKey);
+
+    lock_guard<mutex> lock(shard.mutex);
+    auto found = shard.index.find(entryKey);
+    if (found == shard.index.end()){
+        return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+    return found->second->row;
+}
+
+shared_ptr<const Row> RowCache::get(const string &tableName, sqlite3_int64 id){
+    return getMany(tableName, {id}).front();
+}
+
+vector<shared_ptr<const Row>> RowCache::getMany(const string &tableName, const vector<sqlite3_int64> &ids){
+    vector<shared_ptr<const Row>> rows(ids.size());
+    int table = tableIndex(tableName);
+    if (table < 0){
+        return rows;
+    }
+
+    drainChanges();
+
+    string missing;
+    unordered_map<sqlite3_int64, vector<size_t>> missingPositions;
+    for (size_t position = 0; position < ids.size(); ++position){
+        rows[position] = lookup(tableName, ids[position]);
+        if (rows[position]){
+            hits.fetch_add(1, memory_order_relaxed);
+            continue;
+        }
+
+        misses.fetch_add(1, memory_order_relaxed);
+        vector<size_t> &positions = missingPositions[ids[position]];
+        if (positions.empty()){
+            missing += missing.empty() ? "[" : ",";
+            missing += to_string(ids[position]);
+        }
+        positions.push_back(position);
+    }
+    if (missing.empty()){
+        return rows;
+    }
+    missing += "]";
+
+    // One statement for any number of ids: they travel as a single JSON array.
+    vector<Row> loaded;
+    const string sql = "SELECT * FROM " + tableName + " WHERE id IN (SELECT value FROM json_each(?));";
+    if (!database.query(sql, {missing}, loaded)){
+        return rows;
+    }
+
+    for (Row &row : loaded){
+        auto idColumn = row.find("id");
+        sqlite3_int64 id = 0;
+        if (idColumn == row.end() || !integerValue(idColumn->second, id)){
+            continue;
+        }
+
+        auto shared = make_shared<const Row>(move(row));
+        store(table, id, shared);
+        for (size_t position : missingPositions[id]){
+            rows[position] = shared;
+        }
+    }
+    return rows;
+}
+
+void RowCache::sync(){
+    drainChanges();
+
+    vector<Row> result;
+    if (database.query("PRAGMA data_version;", {}, result) && !result.empty()){
+        const Row &row = result.front();
+        sqlite3_int64 dataVersion = row.empty() ? -1 : std::get<sqlite3_int64>(row.begin()->second);
+        if (lastDataVersion != -1 && dataVersion != lastDataVersion){
+            clear();
+        }
+        lastDataVersion = dataVersion;
+    }
+}
+
+void RowCache::clear(){
+    for (auto &shard : shards){
+        lock_guard<mutex> lock(shard->mutex);
+        shard->lru.clear();
+        shard->index.clear();
+        shard->bytes = 0;
+    }
+}
+
+RowCacheMetrics RowCache::metrics(){
+    RowCacheMetrics snapshot;
+    snapshot.hits = hits.load(memory_order_relaxed);
+    snapshot.misses = misses.load(memory_order_relaxed);
+    snapshot.evictions = evictions.load(memory_order_relaxed);
+    snapshot.invalidations = invalidations.load(memory_order_relaxed);
+
+    for (auto &shard : shards){
+        lock_guard<mutex> lock(shard->mutex);
+        snapshot.entries += shard->lru.size();
+        snapshot.bytes += shard->bytes;
+    }
+    return snapshot;
+}
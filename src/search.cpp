@@ -0,0 +1,234 @@
+#include "search.hpp"
+#include "logger.hpp"
+#include <algorithm>
+
+using namespace std;
+
+// Lower-cases ASCII letters only, exactly as SQLite's NOCASE collation does.
+static string foldCase(const string &text){
+    string folded = text;
+    for (char &character : folded){
+        if (character >= 'A' && character <= 'Z'){
+            character = static_cast<char>(character - 'A' + 'a');
+        }
+    }
+    return folded;
+}
+
+// Smallest string above every string starting with prefix.
+static string upperBound(string prefix){
+    while (!prefix.empty() && static_cast<unsigned char>(prefix.back()) == 0xFF){
+        prefix.pop_back();
+    }
+    if (prefix.empty()){
+        return string(4, '\xFF');
+    }
+    prefix.back() = static_cast<char>(static_cast<unsigned char>(prefix.back()) + 1);
+    return prefix;
+}
+
+SearchEngine::SearchEngine(const string &dbName, const SearchOptions &options, Listener listener)
+    : options(options), listener(move(listener)){
+    if (sqlite3_open_v2(dbName.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK){
+        LOG_ERROR("Can't open read connection for search: %s", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        db = nullptr;
+    }else{
+        sqlite3_busy_timeout(db, 1000);
+        sqlite3_progress_handler(db, options.progressInterval, &SearchEngine::progress, this);
+
+        // ?1 is both the lower bound and the key to continue after, with ?3 the id beside it.
+        const char *nameSql = "SELECT id, name, sku FROM item "
+                              "WHERE deleted_at IS NULL AND name >= ?1 COLLATE NOCASE AND name < ?2 COLLATE NOCASE "
+                              "AND (name COLLATE NOCASE, id) > (?1, ?3) "
+                              "ORDER BY name COLLATE NOCASE, id LIMIT ?4;";
+        const char *skuSql = "SELECT id, name, sku FROM item "
+                             "WHERE deleted_at IS NULL AND sku >= ?1 AND sku < ?2 AND (sku, id) > (?1, ?3) "
+                             "ORDER BY sku, id LIMIT ?4;";
+        if (sqlite3_prepare_v3(db, nameSql, -1, SQLITE_PREPARE_PERSISTENT, &nameStatement, nullptr) != SQLITE_OK ||
+            sqlite3_prepare_v3(db, skuSql, -1, SQLITE_PREPARE_PERSISTENT, &skuStatement, nullptr) != SQLITE_OK){
+            LOG_ERROR("Error preparing search queries: %s", sqlite3_errmsg(db));
+        }
+    }
+
+    worker = thread(&SearchEngine::run, this);
+}
+
+SearchEngine::~SearchEngine(){
+    {
+        lock_guard<std::mutex> lock(queryMutex);
+        stopping = true;
+        // A new generation makes the progress handler abort the running statement.
+        generation.fetch_add(1, memory_order_release);
+    }
+    condition.notify_all();
+    if (worker.joinable()){
+        worker.join();
+    }
+
+    sqlite3_finalize(nameStatement);
+    sqlite3_finalize(skuStatement);
+    sqlite3_close(db);
+}
+
+int SearchEngine::progress(void *context){
+    SearchEngine *engine = static_cast<SearchEngine*>(context);
+    return engine->generation.load(memory_order_acquire) != engine->runningGeneration ? 1 : 0;
+}
+
+uint64_t SearchEngine::submit(const string &text){
+    uint64_t submitted;
+    {
+        lock_guard<std::mutex> lock(queryMutex);
+        pendingQuery = text;
+        submitted = generation.fetch_add(1, memory_order_release) + 1;
+    }
+    condition.notify_one();
+    return submitted;
+}
+
+bool SearchEngine::poll(SearchResults &results){
+    lock_guard<std::mutex> lock(queryMutex);
+    if (latest.generation == polledGeneration && latest.hits.size() == polledHits && latest.complete == polledComplete){
+        return false;
+    }
+    results = latest;
+    polledGeneration = latest.generation;
+    polledHits = latest.hits.size();
+    polledComplete = latest.complete;
+    return true;
+}
+
+void SearchEngine::publish(const SearchResults &results){
+    {
+        lock_guard<std::mutex> lock(queryMutex);
+        latest = results;
+    }
+    if (listener){
+        listener(results);
+    }
+}
+
+void SearchEngine::run(){
+    unique_lock<std::mutex> lock(queryMutex);
+    while (true){
+        condition.wait(lock, [this]{ return stopping || generation.load(memory_order_acquire) != runningGeneration; });
+        if (stopping){
+            break;
+        }
+
+        // Debounce: every keystroke inside the window restarts it.
+        uint64_t seen = generation.load(memory_order_acquire);
+        while (!stopping && condition.wait_for(lock, options.debounce, [&]{ return stopping || generation.load(memory_order_acquire) != seen; })){
+            seen = generation.load(memory_order_acquire);
+        }
+        if (stopping){
+            break;
+        }
+
+        runningGeneration = seen;
+        const string query = pendingQuery;
+        lock.unlock();
+        if (!search(query, seen)){
+            cancelled.fetch_add(1, memory_order_relaxed);
+        }
+        lock.lock();
+    }
+}
+
+bool SearchEngine::search(const string &query, uint64_t queryGeneration){
+    SearchResults results;
+    results.generation = queryGeneration;
+    results.query = query;
+
+    if (query.empty() || !nameStatement || !skuStatement){
+        previous.valid = false;
+        results.complete = true;
+        publish(results);
+        return true;
+    }
+
+    const Field field = all_of(query.begin(), query.end(), [](char character){ return character >= '0' && character <= '9'; }) ? Field::Sku
+                                                                                                                           : Field::Name;
+    const string prefix = field == Field::Name ? foldCase(query) : query;
+    auto matches = [&](const SearchHit &hit){
+        return (field == Field::Name ? foldCase(hit.name) : hit.sku).starts_with(prefix);
+    };
+
+    // Where SQL starts: at the prefix itself, or just after the last reused hit.
+    string startKey = prefix;
+    sqlite3_int64 startId = -1;
+
+    if (previous.valid && previous.field == field && prefix.starts_with(previous.prefix)){
+        reused.fetch_add(1, memory_order_relaxed);
+        for (const SearchHit &hit : previous.hits){
+            if (matches(hit)){
+                results.hits.push_back(hit);
+            }
+        }
+
+        if (previous.exhausted || results.hits.size() >= options.limit){
+            const bool exhausted = previous.exhausted && results.hits.size() <= options.limit;
+            results.hits.resize(min(results.hits.size(), options.limit));
+            results.complete = true;
+            publish(results);
+            previous = {true, field, prefix, results.hits, exhausted};
+            return true;
+        }
+        if (!results.hits.empty()){
+            publish(results);
+        }
+
+        if (!previous.hits.empty()){
+            const SearchHit &last = previous.hits.back();
+            const string lastKey = field == Field::Name ? foldCase(last.name) : last.sku;
+            if (lastKey >= prefix){
+                startKey = field == Field::Name ? last.name : last.sku;
+                startId = last.id;
+            }
+        }
+    }
+
+    const string upper = upperBound(prefix);
+    const int wanted = static_cast<int>(options.limit - results.hits.size());
+    sqlite3_stmt *stmt = field == Field::Name ? nameStatement : skuStatement;
+    sqlite3_bind_text(stmt, 1, startKey.c_str(), static_cast<int>(startKey.size()), SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, upper.c_str(), static_cast<int>(upper.size()), SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 3, startId);
+    sqlite3_bind_int(stmt, 4, wanted);
+
+    int fetched = 0;
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW){
+        SearchHit &hit = results.hits.emplace_back();
+        hit.id = sqlite3_column_int64(stmt, 0);
+        hit.name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        const unsigned char *sku = sqlite3_column_text(stmt, 2);
+        hit.sku = sku ? reinterpret_cast<const char*>(sku) : "";
+        ++fetched;
+
+        // The top hits go out first; the rest of the list follows when the query ends.
+        if (results.hits.size() == options.firstBatch){
+            if (generation.load(memory_order_acquire) != queryGeneration){
+                result = SQLITE_INTERRUPT;
+                break;
+            }
+            publish(results);
+        }
+    }
+    sqlite3_reset(stmt);
+
+    if (result == SQLITE_INTERRUPT || generation.load(memory_order_acquire) != queryGeneration){
+        return false;
+    }
+    if (result != SQLITE_DONE){
+        LOG_ERROR("Error running search for \"%s\": %s", query.c_str(), sqlite3_errmsg(db));
+        previous.valid = false;
+        return true;
+    }
+
+    results.complete = true;
+    publish(results);
+    previous = {true, field, prefix, results.hits, fetched < wanted};
+    return true;
+}
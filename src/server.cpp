@@ -0,0 +1,354 @@
+#include "server.hpp"
+#include "report.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Tables whose rows are soft deleted; listings skip their tombstones.
+static bool hasTombstones(const string &tableName){
+    return tableName == "item" || tableName == "category" || tableName == "suppliers";
+}
+
+Server::Server(Database &database, const string &socketPath, const ServerOptions &options)
+    : database(database), socketPath(socketPath), options(options){
+    this->options.maxGroup = max<size_t>(1, options.maxGroup);
+}
+
+Server::~Server(){
+    for (auto &[fd, connection] : connections){
+        ::close(fd);
+    }
+    if (listenFd >= 0){
+        ::close(listenFd);
+        unlink(socketPath.c_str());
+    }
+    if (epollFd >= 0){
+        ::close(epollFd);
+    }
+    if (wakeFd >= 0){
+        ::close(wakeFd);
+    }
+}
+
+bool Server::listen(){
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)){
+        LOG_ERROR("Socket path too long: %s", socketPath.c_str());
+        return false;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (listenFd < 0 || epollFd < 0 || wakeFd < 0){
+        LOG_ERROR("Error creating server descriptors: %s", strerror(errno));
+        return false;
+    }
+
+    // A socket file left by a crashed server would make bind() fail.
+    unlink(socketPath.c_str());
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listenFd, SOMAXCONN) != 0){
+        LOG_ERROR("Can't listen on %s: %s", socketPath.c_str(), strerror(errno));
+        return false;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    return true;
+}
+
+void Server::stop(){
+    const uint64_t one = 1;
+    if (wakeFd >= 0 && write(wakeFd, &one, sizeof(one)) < 0){
+        // Already signalled: the counter is saturated or the loop is gone.
+    }
+}
+
+void Server::run(){
+    if (epollFd < 0){
+        LOG_ERROR("Server::run() called before a successful listen()");
+        return;
+    }
+
+    epoll_event events[256];
+    bool running = true;
+    while (running){
+        int count = epoll_wait(epollFd, events, 256, -1);
+        if (count < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            LOG_ERROR("epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+
+        for (int index = 0; index < count; ++index){
+            const int fd = events[index].data.fd;
+            if (fd == wakeFd){
+                running = false;
+                continue;
+            }
+            if (fd == listenFd){
+                accept();
+                continue;
+            }
+
+            auto found = connections.find(fd);
+            if (found == connections.end()){
+                continue;
+            }
+            Connection &connection = found->second;
+            if ((events[index].events & EPOLLOUT) && !send(connection)){
+                close(connection);
+                continue;
+            }
+            if ((events[index].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !receive(connection)){
+                close(connection);
+            }
+        }
+
+        executePending();
+    }
+}
+
+void Server::accept(){
+    while (true){
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0){
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                LOG_WARNING("accept failed: %s", strerror(errno));
+            }
+            return;
+        }
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+        Connection &connection = connections[fd];
+        connection.fd = fd;
+        connection.serial = ++nextSerial;
+        counters.connections.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+void Server::close(Connection &connection){
+    // Responses still pending for this serial are dropped when their group finishes.
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+    ::close(connection.fd);
+    connections.erase(connection.fd);
+}
+
+bool Server::receive(Connection &connection){
+    bool open = true;
+    char buffer[65536];
+    while (true){
+        ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (received > 0){
+            connection.input.append(buffer, static_cast<size_t>(received));
+            continue;
+        }
+        if (received < 0 && errno == EINTR){
+            continue;
+        }
+        open = received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        break;
+    }
+
+    // Queue every complete frame; a partial one waits for the next read.
+    while (connection.input.size() - connection.inputOffset >= 4){
+        const uint8_t *prefix = reinterpret_cast<const uint8_t*>(connection.input.data() + connection.inputOffset);
+        const uint32_t size = prefix[0] | prefix[1] << 8 | prefix[2] << 16 | static_cast<uint32_t>(prefix[3]) << 24;
+        if (size > protocol::maxFrameSize){
+            LOG_WARNING("Closing connection: frame of %u bytes is too large", size);
+            return false;
+        }
+        if (connection.input.size() - connection.inputOffset < 4 + static_cast<size_t>(size)){
+            break;
+        }
+
+        Pending &request = pending.emplace_back();
+        request.fd = connection.fd;
+        request.serial = connection.serial;
+        if (!protocol::decode(connection.input.data() + connection.inputOffset + 4, size, request.request)){
+            request.request.op = protocol::Opcode::Ping;
+            request.response.status = protocol::Status::BadRequest;
+        }
+        request.response.id = request.request.id;
+        connection.inputOffset += 4 + size;
+    }
+
+    if (connection.inputOffset == connection.input.size()){
+        connection.input.clear();
+        connection.inputOffset = 0;
+    }else if (connection.inputOffset > connection.input.size() / 2){
+        connection.input.erase(0, connection.inputOffset);
+        connection.inputOffset = 0;
+    }
+    return open;
+}
+
+bool Server::send(Connection &connection){
+    while (connection.outputOffset < connection.output.size()){
+        ssize_t written = ::send(connection.fd, connection.output.data() + connection.outputOffset,
+                                 connection.output.size() - connection.outputOffset, MSG_NOSIGNAL);
+        if (written > 0){
+            connection.outputOffset += static_cast<size_t>(written);
+            continue;
+        }
+        if (written < 0 && errno == EINTR){
+            continue;
+        }
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            break;
+        }
+        return false;
+    }
+
+    const bool drained = connection.outputOffset == connection.output.size();
+    if (drained){
+        connection.output.clear();
+        connection.outputOffset = 0;
+    }
+
+    // Only ask for EPOLLOUT while there is something left to send.
+    if (drained == connection.waitingToWrite){
+        connection.waitingToWrite = !drained;
+        epoll_event event{};
+        event.events = drained ? EPOLLIN : EPOLLIN | EPOLLOUT;
+        event.data.fd = connection.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    }
+    return true;
+}
+
+void Server::executePending(){
+    for (size_t first = 0; first < pending.size(); first += options.maxGroup){
+        const size_t last = min(pending.size(), first + options.maxGroup);
+
+        size_t writes = 0;
+        for (size_t index = first; index < last; ++index){
+            writes += protocol::isWrite(pending[index].request.op) && pending[index].response.status == protocol::Status::Ok;
+        }
+        counters.writes.fetch_add(writes, memory_order_relaxed);
+
+        auto work = [&]{
+            for (size_t index = first; index < last; ++index){
+                handle(pending[index]);
+            }
+            return true;
+        };
+
+        // Reads alone need no transaction; with a write the group shares one commit.
+        if (writes == 0){
+            work();
+        }else if (database.transaction(work)){
+            counters.commits.fetch_add(1, memory_order_relaxed);
+        }else{
+            for (size_t index = first; index < last; ++index){
+                pending[index].response.status = protocol::Status::Failed;
+                pending[index].response.rows.clear();
+            }
+        }
+        counters.requests.fetch_add(last - first, memory_order_relaxed);
+
+        for (size_t index = first; index < last; ++index){
+            Pending &request = pending[index];
+            auto found = connections.find(request.fd);
+            if (found != connections.end() && found->second.serial == request.serial){
+                protocol::encode(found->second.output, request.response);
+            }
+        }
+    }
+    pending.clear();
+
+    for (auto connection = connections.begin(); connection != connections.end();){
+        auto current = connection++;
+        if (current->second.output.size() > current->second.outputOffset && !current->second.waitingToWrite && !send(current->second)){
+            close(current->second);
+        }
+    }
+}
+
+void Server::handle(Pending &pending){
+    protocol::Response &response = pending.response;
+    const protocol::Request &request = pending.request;
+
+    // A malformed frame keeps its BadRequest answer.
+    if (response.status == protocol::Status::BadRequest){
+        return;
+    }
+    // The work may be re-run after SQLITE_BUSY.
+    response.status = protocol::Status::Ok;
+    response.rows.clear();
+
+    const BatchCommand &command = request.command;
+    bool succeeded = true;
+    switch (request.op){
+        case protocol::Opcode::Ping:
+            break;
+        case protocol::Opcode::Get:
+            succeeded = database.query("SELECT * FROM " + command.table + " WHERE id = ?;", {command.ids.front()}, response.rows);
+            break;
+        case protocol::Opcode::List: {
+            const string live = hasTombstones(command.table) ? " AND deleted_at IS NULL" : "";
+            succeeded = database.query("SELECT * FROM " + command.table + " WHERE id > ?" + live + " ORDER BY id LIMIT ?;",
+                                       {command.ids.front(), min(request.limit, options.maxListRows)}, response.rows);
+            break;
+        }
+        case protocol::Opcode::Report: {
+            const ReportDag reports = inventoryReports(1);
+            ReportResults results;
+            succeeded = reports.runSequential(database.getDBConnection(), results) &&
+                        (command.table.empty() || results.count(command.table));
+            for (const auto &[name, table] : results){
+                if (!succeeded || (!command.table.empty() && name != command.table)){
+                    continue;
+                }
+                for (const auto &[key, values] : table){
+                    Row &row = response.rows.emplace_back();
+                    string group;
+                    string label;
+                    reportLabel(key, group, label);
+                    row["report"] = name;
+                    row["group"] = group;
+                    if (!label.empty()){
+                        row["label"] = label;
+                    }
+                    for (size_t column = 0; column < values.size(); ++column){
+                        if (reports.isMoneyColumn(name, column)){
+                            row["v" + to_string(column)] = Money::fromUnits(llround(values[column]));
+                        }else{
+                            row["v" + to_string(column)] = values[column];
+                        }
+                    }
+                }
+            }
+            break;
+        }
+        default:
+            succeeded = database.transaction([&]{ return BatchRunner::apply(database, command, options.userId); });
+            if (succeeded && request.op == protocol::Opcode::Add){
+                response.rows.push_back({{"id", sqlite3_last_insert_rowid(database.getDBConnection())}});
+            }
+            break;
+    }
+
+    if (!succeeded){
+        response.status = protocol::Status::Failed;
+        response.rows.clear();
+    }
+}
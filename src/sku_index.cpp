@@ -0,0 +1,278 @@
+#include "sku_index.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// PerfectHash
+
+static uint64_t mix(uint64_t x){
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+uint64_t PerfectHash::hash(string_view key, uint64_t seed){
+    uint64_t h = seed ^ (key.size() * 0x9E3779B97F4A7C15ULL);
+
+    size_t position = 0;
+    for (; position + 8 <= key.size(); position += 8){
+        uint64_t word;
+        memcpy(&word, key.data() + position, 8);
+        h = mix(h ^ word);
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, key.data() + position, key.size() - position);
+    return mix(h ^ tail);
+}
+
+bool PerfectHash::build(const vector<string_view> &keys){
+    slotCount = static_cast<uint32_t>(keys.size());
+    displacements.assign(keys.size() / 4 + 1, 0);
+    if (keys.empty()){
+        return true;
+    }
+
+    // A few seeds, in case two keys collide on all 64 bits of their hash.
+    for (uint64_t attempt = 0; attempt < 4; ++attempt){
+        seed = mix(attempt + 1);
+
+        vector<uint64_t> hashes(keys.size());
+        vector<vector<uint32_t>> buckets(displacements.size());
+        for (size_t index = 0; index < keys.size(); ++index){
+            hashes[index] = hash(keys[index], seed);
+            buckets[((hashes[index] >> 32) * displacements.size()) >> 32].push_back(static_cast<uint32_t>(index));
+        }
+
+        vector<uint32_t> order(buckets.size());
+        for (uint32_t bucket = 0; bucket < order.size(); ++bucket){
+            order[bucket] = bucket;
+        }
+        stable_sort(order.begin(), order.end(), [&](uint32_t left, uint32_t right){
+            return buckets[left].size() > buckets[right].size();
+        });
+
+        // Largest buckets first, while most slots are still free.
+        vector<uint8_t> taken(keys.size(), 0);
+        vector<uint32_t> positions;
+        bool placed = true;
+        for (uint32_t bucket : order){
+            const vector<uint32_t> &members = buckets[bucket];
+            if (members.empty()){
+                break;
+            }
+
+            bool found = false;
+            for (uint32_t displacement = 0; displacement < (1u << 26) && !found; ++displacement){
+                positions.clear();
+                found = true;
+                for (uint32_t member : members){
+                    uint32_t position = place(hashes[member], displacement);
+                    if (taken[position] || find(positions.begin(), positions.end(), position) != positions.end()){
+                        found = false;
+                        break;
+                    }
+                    positions.push_back(position);
+                }
+                if (found){
+                    displacements[bucket] = displacement;
+                }
+            }
+
+            if (!found){
+                placed = false;
+                break;
+            }
+            for (uint32_t position : positions){
+                taken[position] = 1;
+            }
+        }
+
+        if (placed){
+            return true;
+        }
+        displacements.assign(displacements.size(), 0);
+    }
+    return false;
+}
+
+// SkuIndex
+
+SkuIndex::SkuIndex(Database &database) : database(database), subscription(database.changes().subscribe(1 << 16)){
+}
+
+bool SkuIndex::load(){
+    subscription->poll(events);
+    subscription->overflowed();
+    events.clear();
+    pendingRows.clear();
+
+    // Read straight from the statement: a Row per item would dominate the rebuild.
+    sqlite3 *db = database.getDBConnection();
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "SELECT id, sku FROM item WHERE sku IS NOT NULL AND deleted_at IS NULL;", -1, &stmt, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error preparing SKU index load: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    string keyData;
+    vector<uint32_t> offsets;
+    vector<sqlite3_int64> ids;
+    while (sqlite3_step(stmt) == SQLITE_ROW){
+        ids.push_back(sqlite3_column_int64(stmt, 0));
+        offsets.push_back(static_cast<uint32_t>(keyData.size()));
+        keyData.append(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)), static_cast<size_t>(sqlite3_column_bytes(stmt, 1)));
+    }
+    offsets.push_back(static_cast<uint32_t>(keyData.size()));
+    sqlite3_finalize(stmt);
+
+    return build(ids, keyData, offsets);
+}
+
+bool SkuIndex::rebuild(){
+    // Copy the keys out first: build() overwrites the slots they live in.
+    string keyData;
+    vector<uint32_t> offsets;
+    vector<sqlite3_int64> ids;
+    ids.reserve(idSlots.size() + deltaSkus.size());
+    for (const auto &[id, position] : idSlots){
+        ids.push_back(id);
+        offsets.push_back(static_cast<uint32_t>(keyData.size()));
+        keyData.append(slots[position].sku(overflowKeys));
+    }
+    for (const auto &[id, sku] : deltaSkus){
+        ids.push_back(id);
+        offsets.push_back(static_cast<uint32_t>(keyData.size()));
+        keyData.append(sku);
+    }
+    offsets.push_back(static_cast<uint32_t>(keyData.size()));
+
+    return build(ids, keyData, offsets);
+}
+
+bool SkuIndex::build(const vector<sqlite3_int64> &ids, const string &keyData, const vector<uint32_t> &offsets){
+    vector<string_view> keys;
+    keys.reserve(ids.size());
+    for (size_t index = 0; index < ids.size(); ++index){
+        keys.emplace_back(keyData.data() + offsets[index], offsets[index + 1] - offsets[index]);
+    }
+
+    if (!hash.build(keys)){
+        LOG_ERROR("Error building SKU perfect hash over %zu keys", keys.size());
+        return false;
+    }
+
+    slots.assign(keys.size(), Slot());
+    overflowKeys.clear();
+    idSlots.clear();
+    idSlots.reserve(keys.size());
+
+    for (size_t index = 0; index < keys.size(); ++index){
+        const uint32_t position = hash.slot(keys[index]);
+        Slot &slot = slots[position];
+        slot.id = ids[index];
+        slot.live = 1;
+
+        if (keys[index].size() <= Slot::inlineCapacity){
+            slot.length = static_cast<uint8_t>(keys[index].size());
+            memcpy(slot.key, keys[index].data(), keys[index].size());
+        }else{
+            const uint32_t size = static_cast<uint32_t>(keys[index].size());
+            slot.length = Slot::overflowMarker;
+            slot.overflowOffset = static_cast<uint32_t>(overflowKeys.size());
+            memcpy(slot.key, &size, sizeof(size));
+            overflowKeys.append(keys[index]);
+        }
+        idSlots.emplace(ids[index], position);
+    }
+
+    delta.clear();
+    deltaSkus.clear();
+    return true;
+}
+
+void SkuIndex::retire(sqlite3_int64 id){
+    auto slot = idSlots.find(id);
+    if (slot != idSlots.end()){
+        slots[slot->second].live = 0;
+        idSlots.erase(slot);
+    }
+
+    // The SKU may already have passed to another item in the same refresh.
+    auto sku = deltaSkus.find(id);
+    if (sku != deltaSkus.end()){
+        auto owner = delta.find(sku->second);
+        if (owner != delta.end() && owner->second == id){
+            delta.erase(owner);
+        }
+        deltaSkus.erase(sku);
+    }
+}
+
+bool SkuIndex::currentSku(sqlite3_int64 id, string_view &sku) const{
+    auto inDelta = deltaSkus.find(id);
+    if (inDelta != deltaSkus.end()){
+        sku = inDelta->second;
+        return true;
+    }
+    auto slot = idSlots.find(id);
+    if (slot != idSlots.end()){
+        sku = slots[slot->second].sku(overflowKeys);
+        return true;
+    }
+    return false;
+}
+
+size_t SkuIndex::refresh(){
+    events.clear();
+    subscription->poll(events);
+    if (subscription->overflowed()){
+        load();
+        return events.size();
+    }
+
+    for (const ChangeEvent &event : events){
+        if (strcmp(event.table, "item") == 0){
+            pendingRows.insert(event.rowId);
+        }
+    }
+    if (pendingRows.empty()){
+        return 0;
+    }
+
+    sqlite3 *db = database.getDBConnection();
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "SELECT sku FROM item WHERE id = ? AND sku IS NOT NULL AND deleted_at IS NULL;", -1, &stmt, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error preparing SKU index refresh: %s", sqlite3_errmsg(db));
+        return 0;
+    }
+
+    // Most item writes are stock movements and price changes; only a new,
+    // changed or vanished SKU touches the index.
+    const size_t changed = pendingRows.size();
+    for (sqlite3_int64 id : pendingRows){
+        sqlite3_bind_int64(stmt, 1, id);
+        const bool live = sqlite3_step(stmt) == SQLITE_ROW;
+        const string_view sku = live ? string_view(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), static_cast<size_t>(sqlite3_column_bytes(stmt, 0)))
+                                     : string_view();
+
+        string_view known;
+        const bool indexed = currentSku(id, known);
+        if (live != indexed || (live && sku != known)){
+            retire(id);
+            if (live){
+                string key(sku);
+                delta[key] = id;
+                deltaSkus[id] = move(key);
+            }
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    pendingRows.clear();
+    return changed;
+}
@@ -0,0 +1,274 @@
+#include "supplier_prices.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+using namespace std;
+
+SupplierPriceIndex::SupplierPriceIndex(Database &database) : database(database), subscription(database.changes().subscribe(1 << 16)){
+}
+
+bool SupplierPriceIndex::cheaper(const Offer &left, const Offer &right){
+    if (left.unitPrice != right.unitPrice){
+        return left.unitPrice < right.unitPrice;
+    }
+    if (left.leadTimeDays != right.leadTimeDays){
+        return left.leadTimeDays < right.leadTimeDays;
+    }
+    return left.supplierId < right.supplierId;
+}
+
+bool SupplierPriceIndex::loadSuppliers(const unordered_set<int> *ids){
+    sqlite3 *db = database.getDBConnection();
+    sqlite3_stmt *stmt;
+    const char *sql = ids ? "SELECT id, deleted_at IS NULL FROM suppliers WHERE id = ?;" : "SELECT id, deleted_at IS NULL FROM suppliers;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error preparing supplier availability query: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    auto store = [this](int id, uint8_t live){
+        if (id < 0){
+            return;
+        }
+        if (static_cast<size_t>(id) >= supplierLive.size()){
+            supplierLive.resize(static_cast<size_t>(id) + 1, 0);
+        }
+        supplierLive[static_cast<size_t>(id)] = live;
+    };
+
+    int result = SQLITE_DONE;
+    if (!ids){
+        supplierLive.clear();
+        while ((result = sqlite3_step(stmt)) == SQLITE_ROW){
+            store(sqlite3_column_int(stmt, 0), static_cast<uint8_t>(sqlite3_column_int(stmt, 1)));
+        }
+    }else{
+        // A supplier that is gone entirely can no longer be ordered from either.
+        for (int id : *ids){
+            sqlite3_bind_int(stmt, 1, id);
+            const int step = sqlite3_step(stmt);
+            store(id, step == SQLITE_ROW ? static_cast<uint8_t>(sqlite3_column_int(stmt, 1)) : 0);
+            sqlite3_reset(stmt);
+            if (step != SQLITE_ROW && step != SQLITE_DONE){
+                result = step;
+                break;
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    if (result != SQLITE_DONE){
+        LOG_ERROR("Error reading supplier availability: %s", sqlite3_errmsg(db));
+        return false;
+    }
+    return true;
+}
+
+bool SupplierPriceIndex::load(){
+    // Everything committed so far is about to be read, so queued events are stale.
+    events.clear();
+    subscription->poll(events);
+    subscription->overflowed();
+    events.clear();
+    pendingRows.clear();
+    pendingSuppliers.clear();
+
+    if (!loadSuppliers(nullptr)){
+        return false;
+    }
+
+    sqlite3 *db = database.getDBConnection();
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "SELECT id, item_id, supplier_id, unit_price, lead_time_days, minimum_order FROM supplier_prices;", -1, &stmt, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error preparing supplier price load: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    vector<Offer> unsorted;
+    vector<int> itemIds;
+    rowItems.clear();
+    int maxItemId = -1;
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW){
+        const int itemId = sqlite3_column_int(stmt, 1);
+        if (itemId < 0){
+            continue;
+        }
+        rowItems.emplace(sqlite3_column_int64(stmt, 0), itemId);
+        itemIds.push_back(itemId);
+        unsorted.push_back({sqlite3_column_int64(stmt, 3), sqlite3_column_int(stmt, 2), sqlite3_column_int(stmt, 4), sqlite3_column_int(stmt, 5)});
+        maxItemId = max(maxItemId, itemId);
+    }
+    sqlite3_finalize(stmt);
+
+    if (result != SQLITE_DONE){
+        LOG_ERROR("Error loading supplier prices: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    // Counting sort by item id, then each item's group by price: cheaper than
+    // an ORDER BY over the whole table.
+    itemOffsets.assign(static_cast<size_t>(maxItemId) + 2, 0);
+    for (int itemId : itemIds){
+        ++itemOffsets[static_cast<size_t>(itemId) + 1];
+    }
+    for (size_t index = 1; index < itemOffsets.size(); ++index){
+        itemOffsets[index] += itemOffsets[index - 1];
+    }
+
+    offers.resize(unsorted.size());
+    vector<uint32_t> next(itemOffsets.begin(), itemOffsets.end() - 1);
+    for (size_t index = 0; index < unsorted.size(); ++index){
+        offers[next[static_cast<size_t>(itemIds[index])]++] = unsorted[index];
+    }
+    for (size_t item = 0; item + 1 < itemOffsets.size(); ++item){
+        if (itemOffsets[item + 1] - itemOffsets[item] > 1){
+            sort(offers.begin() + itemOffsets[item], offers.begin() + itemOffsets[item + 1], cheaper);
+        }
+    }
+
+    delta.clear();
+    return true;
+}
+
+size_t SupplierPriceIndex::refresh(){
+    events.clear();
+    subscription->poll(events);
+    if (subscription->overflowed()){
+        load();
+        return events.size();
+    }
+
+    for (const ChangeEvent &event : events){
+        if (strcmp(event.table, "supplier_prices") == 0){
+            pendingRows.insert(event.rowId);
+        }else if (strcmp(event.table, "suppliers") == 0){
+            pendingSuppliers.insert(static_cast<int>(event.rowId));
+        }
+    }
+    const size_t changed = pendingRows.size() + pendingSuppliers.size();
+    if (changed == 0){
+        return 0;
+    }
+
+    if (!pendingSuppliers.empty() && loadSuppliers(&pendingSuppliers)){
+        pendingSuppliers.clear();
+    }
+    if (pendingRows.empty()){
+        return changed;
+    }
+
+    sqlite3 *db = database.getDBConnection();
+    sqlite3_stmt *rowStmt;
+    sqlite3_stmt *itemStmt;
+    if (sqlite3_prepare_v2(db, "SELECT item_id FROM supplier_prices WHERE id = ?;", -1, &rowStmt, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error preparing supplier price refresh: %s", sqlite3_errmsg(db));
+        return 0;
+    }
+    if (sqlite3_prepare_v2(db, "SELECT unit_price, supplier_id, lead_time_days, minimum_order FROM supplier_prices WHERE item_id = ?;", -1, &itemStmt, nullptr) != SQLITE_OK){
+        LOG_ERROR("Error preparing supplier price refresh: %s", sqlite3_errmsg(db));
+        sqlite3_finalize(rowStmt);
+        return 0;
+    }
+
+    // A row moved to another item changes the lists of both.
+    unordered_set<int> items;
+    for (sqlite3_int64 rowId : pendingRows){
+        auto previous = rowItems.find(rowId);
+        if (previous != rowItems.end()){
+            items.insert(previous->second);
+            rowItems.erase(previous);
+        }
+
+        sqlite3_bind_int64(rowStmt, 1, rowId);
+        if (sqlite3_step(rowStmt) == SQLITE_ROW){
+            const int itemId = sqlite3_column_int(rowStmt, 0);
+            rowItems.emplace(rowId, itemId);
+            items.insert(itemId);
+        }
+        sqlite3_reset(rowStmt);
+    }
+    pendingRows.clear();
+    sqlite3_finalize(rowStmt);
+
+    for (int itemId : items){
+        vector<Offer> &list = delta[itemId];
+        list.clear();
+        sqlite3_bind_int(itemStmt, 1, itemId);
+        while (sqlite3_step(itemStmt) == SQLITE_ROW){
+            list.push_back({sqlite3_column_int64(itemStmt, 0), sqlite3_column_int(itemStmt, 1), sqlite3_column_int(itemStmt, 2), sqlite3_column_int(itemStmt, 3)});
+        }
+        sqlite3_reset(itemStmt);
+        sort(list.begin(), list.end(), cheaper);
+    }
+    sqlite3_finalize(itemStmt);
+
+    if (delta.size() > itemOffsets.size() / 8 + 1024){
+        load();
+    }
+    return changed;
+}
+
+size_t SupplierPriceIndex::cheapest(const vector<PurchaseNeed> &needs, int maxLeadTimeDays, vector<SupplierOffer> &chosen) const{
+    chosen.assign(needs.size(), SupplierOffer());
+    const int32_t leadTimeLimit = maxLeadTimeDays < 0 ? INT32_MAX : maxLeadTimeDays;
+
+    // The groups of a purchase order are scattered over the packed array, so
+    // each lookup is two dependent cache misses. Fetching the offsets a few
+    // lines ahead and the group of the line after lets the misses overlap.
+    constexpr size_t offsetsAhead = 16;
+    constexpr size_t groupAhead = 8;
+    auto packedIndex = [this](int itemId) -> size_t {
+        return itemId >= 0 && static_cast<size_t>(itemId) + 1 < itemOffsets.size() ? static_cast<size_t>(itemId) : SIZE_MAX;
+    };
+
+    size_t found = 0;
+    for (size_t line = 0; line < needs.size(); ++line){
+        if (line + offsetsAhead < needs.size()){
+            const size_t ahead = packedIndex(needs[line + offsetsAhead].itemId);
+            if (ahead != SIZE_MAX){
+                __builtin_prefetch(itemOffsets.data() + ahead);
+            }
+        }
+        if (line + groupAhead < needs.size()){
+            const size_t ahead = packedIndex(needs[line + groupAhead].itemId);
+            if (ahead != SIZE_MAX){
+                __builtin_prefetch(offers.data() + itemOffsets[ahead]);
+            }
+        }
+
+        const PurchaseNeed &need = needs[line];
+        const Offer *end;
+        for (const Offer *offer = offersOf(need.itemId, end); offer != end; ++offer){
+            if (offer->minimumOrder > need.quantity || offer->leadTimeDays > leadTimeLimit){
+                continue;
+            }
+            if (offer->supplierId < 0 || static_cast<size_t>(offer->supplierId) >= supplierLive.size() || !supplierLive[static_cast<size_t>(offer->supplierId)]){
+                continue;
+            }
+
+            SupplierOffer &result = chosen[line];
+            result.supplierId = offer->supplierId;
+            result.unitPrice = Money::fromUnits(offer->unitPrice);
+            result.leadTimeDays = offer->leadTimeDays;
+            result.minimumOrder = offer->minimumOrder;
+            ++found;
+            break;
+        }
+    }
+    return found;
+}
+
+void SupplierPriceIndex::offersFor(int itemId, vector<SupplierOffer> &list) const{
+    list.clear();
+    const Offer *end;
+    for (const Offer *offer = offersOf(itemId, end); offer != end; ++offer){
+        SupplierOffer entry;
+        entry.supplierId = offer->supplierId;
+        entry.unitPrice = Money::fromUnits(offer->unitPrice);
+        entry.leadTimeDays = offer->leadTimeDays;
+        entry.minimumOrder = offer->minimumOrder;
+        list.push_back(entry);
+    }
+}
@@ -0,0 +1,118 @@
+#include "task_pool.hpp"
+#include "logger.hpp"
+
+using namespace std;
+
+// Pool and worker index of the calling thread when it is a pool worker.
+static thread_local const TaskPool *currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+TaskPool::TaskPool(const string &dbName, size_t threads){
+    if (threads == 0){
+        threads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+    }
+
+    for (size_t index = 0; index < threads; ++index){
+        auto worker = make_unique<Worker>();
+        if (sqlite3_open_v2(dbName.c_str(), &worker->connection, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK){
+            LOG_ERROR("Can't open read connection for task pool: %s", sqlite3_errmsg(worker->connection));
+            sqlite3_close(worker->connection);
+            worker->connection = nullptr;
+        }else{
+            sqlite3_busy_timeout(worker->connection, 1000);
+        }
+        workers.push_back(move(worker));
+    }
+
+    for (size_t index = 0; index < workers.size(); ++index){
+        workers[index]->thread = thread(&TaskPool::run, this, index);
+    }
+}
+
+TaskPool::~TaskPool(){
+    {
+        lock_guard<mutex> lock(idleMutex);
+        stopping = true;
+    }
+    idleCondition.notify_all();
+
+    for (auto &worker : workers){
+        if (worker->thread.joinable()){
+            worker->thread.join();
+        }
+        sqlite3_close(worker->connection);
+    }
+}
+
+size_t TaskPool::size() const{
+    return workers.size();
+}
+
+uint64_t TaskPool::stolenTasks() const{
+    return stolen.load(memory_order_relaxed);
+}
+
+void TaskPool::submit(Task task){
+    size_t index = currentPool == this ? currentWorker : nextWorker.fetch_add(1, memory_order_relaxed) % workers.size();
+
+    // Counted before it can be taken, so a thief's decrement never runs
+    // ahead of the increment and wraps the counter.
+    queued.fetch_add(1, memory_order_release);
+    {
+        lock_guard<mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(move(task));
+    }
+
+    // Taking idleMutex orders the increment with a worker about to sleep.
+    {
+        lock_guard<mutex> lock(idleMutex);
+    }
+    idleCondition.notify_one();
+}
+
+bool TaskPool::take(size_t index, Task &task){
+    {
+        Worker &own = *workers[index];
+        lock_guard<mutex> lock(own.mutex);
+        if (!own.tasks.empty()){
+            task = move(own.tasks.back());
+            own.tasks.pop_back();
+            queued.fetch_sub(1, memory_order_acq_rel);
+            return true;
+        }
+    }
+
+    for (size_t offset = 1; offset < workers.size(); ++offset){
+        Worker &victim = *workers[(index + offset) % workers.size()];
+        lock_guard<mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()){
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1, memory_order_acq_rel);
+            stolen.fetch_add(1, memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskPool::run(size_t index){
+    currentPool = this;
+    currentWorker = index;
+    sqlite3 *connection = workers[index]->connection;
+
+    Task task;
+    while (true){
+        if (take(index, task)){
+            task(connection);
+            task = nullptr;
+            continue;
+        }
+
+        unique_lock<mutex> lock(idleMutex);
+        idleCondition.wait(lock, [this]{ return stopping || queued.load(memory_order_acquire) > 0; });
+        if (stopping && queued.load(memory_order_acquire) == 0){
+            break;
+        }
+    }
+}
@@ -0,0 +1,372 @@
+#include "terminal.hpp"
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+using namespace std;
+
+static volatile sig_atomic_t resized = 0;
+
+static void onResize(int){
+    resized = 1;
+}
+
+void appendUtf8(string &out, char32_t character){
+    if (character < 0x80){
+        out += static_cast<char>(character);
+    }else if (character < 0x800){
+        out += static_cast<char>(0xC0 | (character >> 6));
+        out += static_cast<char>(0x80 | (character & 0x3F));
+    }else if (character < 0x10000){
+        out += static_cast<char>(0xE0 | (character >> 12));
+        out += static_cast<char>(0x80 | ((character >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (character & 0x3F));
+    }else{
+        out += static_cast<char>(0xF0 | (character >> 18));
+        out += static_cast<char>(0x80 | ((character >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((character >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (character & 0x3F));
+    }
+}
+
+// Decodes one UTF-8 sequence; malformed bytes come out as U+FFFD.
+static char32_t nextUtf8(string_view text, size_t &position){
+    const unsigned char lead = static_cast<unsigned char>(text[position++]);
+    int continuation = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+    if (lead >= 0x80 && continuation == 0){
+        return U'\uFFFD';
+    }
+
+    char32_t character = continuation == 0 ? lead : lead & (0x3F >> continuation);
+    for (; continuation > 0; --continuation){
+        if (position >= text.size() || (static_cast<unsigned char>(text[position]) & 0xC0) != 0x80){
+            return U'\uFFFD';
+        }
+        character = (character << 6) | (static_cast<unsigned char>(text[position++]) & 0x3F);
+    }
+    return character;
+}
+
+// Terminal
+
+Terminal::Terminal(){
+    if (!interactive() || tcgetattr(STDIN_FILENO, &original) != 0){
+        return;
+    }
+
+    termios raw = original;
+    cfmakeraw(&raw);
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != 0){
+        return;
+    }
+    active = true;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onResize;
+    sigaction(SIGWINCH, &action, nullptr);
+
+    // Alternate screen, hidden cursor, no line wrapping.
+    write("\x1b[?1049h\x1b[?25l\x1b[?7l");
+    flush();
+}
+
+Terminal::~Terminal(){
+    if (!active){
+        return;
+    }
+    write("\x1b[0m\x1b[?7h\x1b[?25h\x1b[?1049l");
+    flush();
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &original);
+    signal(SIGWINCH, SIG_DFL);
+}
+
+bool Terminal::interactive(){
+    return isatty(STDIN_FILENO) && isatty(STDOUT_FILENO);
+}
+
+void Terminal::size(int &rows, int &columns) const{
+    winsize window;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &window) == 0 && window.ws_row > 0 && window.ws_col > 0){
+        rows = window.ws_row;
+        columns = window.ws_col;
+    }else{
+        rows = 24;
+        columns = 80;
+    }
+}
+
+bool Terminal::fill(int timeoutMs){
+    pollfd descriptor = {STDIN_FILENO, POLLIN, 0};
+    if (poll(&descriptor, 1, timeoutMs) <= 0){
+        return false;
+    }
+
+    char buffer[256];
+    ssize_t count = read(STDIN_FILENO, buffer, sizeof(buffer));
+    if (count <= 0){
+        return false;
+    }
+    input.append(buffer, static_cast<size_t>(count));
+    return true;
+}
+
+bool Terminal::decode(KeyEvent &event){
+    if (input.empty()){
+        return false;
+    }
+
+    event = KeyEvent();
+    size_t used = 1;
+    const unsigned char first = static_cast<unsigned char>(input[0]);
+
+    if (first == 0x1B){
+        // An escape sequence arrives in one read; a lone ESC is the Escape key.
+        if (input.size() >= 3 && (input[1] == '[' || input[1] == 'O')){
+            size_t end = 2;
+            while (end < input.size() && (input[end] < 0x40 || input[end] > 0x7E)){
+                ++end;
+            }
+            if (end == input.size()){
+                event.key = Key::Escape;
+            }else{
+                const string parameters = input.substr(2, end - 2);
+                switch (input[end]){
+                    case 'A': event.key = Key::Up; break;
+                    case 'B': event.key = Key::Down; break;
+                    case 'C': event.key = Key::Right; break;
+                    case 'D': event.key = Key::Left; break;
+                    case 'H': event.key = Key::Home; break;
+                    case 'F': event.key = Key::End; break;
+                    case '~':
+                        if (parameters == "1" || parameters == "7"){
+                            event.key = Key::Home;
+                        }else if (parameters == "4" || parameters == "8"){
+                            event.key = Key::End;
+                        }else if (parameters == "5"){
+                            event.key = Key::PageUp;
+                        }else if (parameters == "6"){
+                            event.key = Key::PageDown;
+                        }
+                        break;
+                    default:
+                        break;
+                }
+                used = end + 1;
+            }
+        }else{
+            event.key = Key::Escape;
+        }
+    }else if (first == '\r' || first == '\n'){
+        event.key = Key::Enter;
+    }else if (first == '\t'){
+        event.key = Key::Tab;
+    }else if (first == 0x7F || first == 0x08){
+        event.key = Key::Backspace;
+    }else{
+        size_t position = 0;
+        event.key = Key::Character;
+        event.character = nextUtf8(input, position);
+        used = position;
+    }
+
+    input.erase(0, used);
+    return true;
+}
+
+bool Terminal::readKey(KeyEvent &event, int timeoutMs){
+    if (resized){
+        resized = 0;
+        event = KeyEvent();
+        event.key = Key::Resize;
+        return true;
+    }
+    if (decode(event)){
+        return true;
+    }
+    if (!fill(timeoutMs)){
+        if (resized){
+            resized = 0;
+            event = KeyEvent();
+            event.key = Key::Resize;
+            return true;
+        }
+        return false;
+    }
+    return decode(event);
+}
+
+bool Terminal::inputPending(){
+    return resized || !input.empty() || fill(0);
+}
+
+void Terminal::flush(){
+    size_t offset = 0;
+    while (offset < output.size()){
+        ssize_t count = ::write(STDOUT_FILENO, output.data() + offset, output.size() - offset);
+        if (count <= 0){
+            break;
+        }
+        offset += static_cast<size_t>(count);
+    }
+    written += offset;
+    output.clear();
+}
+
+// Screen
+
+static const char *styleSequence(CellStyle style){
+    switch (style){
+        case CellStyle::Header: return "\x1b[0;1;4m";
+        case CellStyle::Selected: return "\x1b[0;7m";
+        case CellStyle::Status: return "\x1b[0;7m";
+        case CellStyle::Dim: return "\x1b[0;2m";
+        default: return "\x1b[0m";
+    }
+}
+
+void Screen::resize(int rows, int columns){
+    this->rows = max(rows, 1);
+    this->columns = max(columns, 1);
+    front.assign(static_cast<size_t>(this->rows * this->columns), Cell());
+    back.assign(front.size(), Cell());
+    scrolls.clear();
+    invalid = true;
+}
+
+void Screen::clear(){
+    fill(back.begin(), back.end(), Cell());
+}
+
+int Screen::put(int row, int column, string_view text, CellStyle style, int width, bool alignRight){
+    if (row < 0 || row >= rows){
+        return column + width;
+    }
+
+    vector<char32_t> characters;
+    for (size_t position = 0; position < text.size() && static_cast<int>(characters.size()) < width;){
+        char32_t character = nextUtf8(text, position);
+        characters.push_back(character < 0x20 ? U' ' : character);
+    }
+
+    const int padding = width - static_cast<int>(characters.size());
+    int target = column;
+    for (int index = 0; index < width; ++index, ++target){
+        if (target < 0 || target >= columns){
+            continue;
+        }
+        int source = alignRight ? index - padding : index;
+        Cell &cell = back[static_cast<size_t>(row * columns + target)];
+        cell.character = source >= 0 && source < static_cast<int>(characters.size()) ? characters[static_cast<size_t>(source)] : U' ';
+        cell.style = style;
+    }
+    return column + width;
+}
+
+void Screen::scroll(int top, int bottom, int lines){
+    top = max(top, 0);
+    bottom = min(bottom, rows - 1);
+    if (lines == 0 || top >= bottom || abs(lines) > bottom - top){
+        return;
+    }
+    scrolls.push_back({top, bottom, lines});
+}
+
+void Screen::emitScroll(string &out, const PendingScroll &scroll){
+    char sequence[32];
+    snprintf(sequence, sizeof(sequence), "\x1b[0m\x1b[%d;%dr", scroll.top + 1, scroll.bottom + 1);
+    out += sequence;
+
+    // Line feed at the bottom margin and reverse index at the top margin are plain VT100.
+    const int count = abs(scroll.lines);
+    snprintf(sequence, sizeof(sequence), "\x1b[%d;1H", (scroll.lines > 0 ? scroll.bottom : scroll.top) + 1);
+    out += sequence;
+    for (int index = 0; index < count; ++index){
+        out += scroll.lines > 0 ? "\n" : "\x1bM";
+    }
+    out += "\x1b[r";
+
+    const size_t width = static_cast<size_t>(columns);
+    auto rowBegin = [&](int row){ return front.begin() + static_cast<ptrdiff_t>(static_cast<size_t>(row) * width); };
+    if (scroll.lines > 0){
+        move(rowBegin(scroll.top + count), rowBegin(scroll.bottom + 1), rowBegin(scroll.top));
+        fill(rowBegin(scroll.bottom + 1 - count), rowBegin(scroll.bottom + 1), Cell());
+    }else{
+        move_backward(rowBegin(scroll.top), rowBegin(scroll.bottom + 1 - count), rowBegin(scroll.bottom + 1));
+        fill(rowBegin(scroll.top), rowBegin(scroll.top + count), Cell());
+    }
+}
+
+size_t Screen::render(Terminal &terminal){
+    string out;
+    if (invalid){
+        out += "\x1b[0m\x1b[2J";
+        fill(front.begin(), front.end(), Cell());
+        scrolls.clear();
+        invalid = false;
+    }
+    for (const PendingScroll &scroll : scrolls){
+        emitScroll(out, scroll);
+    }
+    scrolls.clear();
+
+    // Position and attributes are unknown after a scroll region reset; assume nothing.
+    int cursorRow = -1;
+    int cursorColumn = -1;
+    bool styleKnown = false;
+    CellStyle currentStyle = CellStyle::Normal;
+
+    for (int row = 0; row < rows; ++row){
+        for (int column = 0; column < columns; ++column){
+            const size_t index = static_cast<size_t>(row * columns + column);
+            if (back[index] == front[index]){
+                continue;
+            }
+
+            // Rewriting a few unchanged cells is cheaper than a cursor move.
+            bool bridged = false;
+            if (cursorRow == row && cursorColumn < column && column - cursorColumn <= 4){
+                bridged = true;
+                for (int between = cursorColumn; between < column; ++between){
+                    if (!styleKnown || front[static_cast<size_t>(row * columns + between)].style != currentStyle){
+                        bridged = false;
+                        break;
+                    }
+                }
+                if (bridged){
+                    for (int between = cursorColumn; between < column; ++between){
+                        appendUtf8(out, front[static_cast<size_t>(row * columns + between)].character);
+                    }
+                }
+            }
+            if (!bridged && (cursorRow != row || cursorColumn != column)){
+                char sequence[32];
+                snprintf(sequence, sizeof(sequence), "\x1b[%d;%dH", row + 1, column + 1);
+                out += sequence;
+            }
+
+            if (!styleKnown || back[index].style != currentStyle){
+                out += styleSequence(back[index].style);
+                currentStyle = back[index].style;
+                styleKnown = true;
+            }
+            appendUtf8(out, back[index].character);
+            front[index] = back[index];
+
+            cursorRow = row;
+            cursorColumn = column + 1;
+            if (cursorColumn >= columns){
+                cursorRow = -1;
+            }
+        }
+    }
+
+    terminal.write(out);
+    return out.size();
+}
@@ -0,0 +1,552 @@
+#include "tui.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+
+// Pages kept in a view's window; the far edge is dropped beyond that.
+static const size_t windowPages = 6;
+
+static string formatValue(const Row &row, const string &column){
+    auto value = row.find(column);
+    if (value == row.end()){
+        return "";
+    }
+    if (std::holds_alternative<sqlite3_int64>(value->second)){
+        return to_string(std::get<sqlite3_int64>(value->second));
+    }
+    if (std::holds_alternative<int>(value->second)){
+        return to_string(std::get<int>(value->second));
+    }
+    if (std::holds_alternative<double>(value->second)){
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.2f", std::get<double>(value->second));
+        return buffer;
+    }
+    if (std::holds_alternative<Money>(value->second)){
+        return std::get<Money>(value->second).toString();
+    }
+    return std::get<string>(value->second);
+}
+
+// ListView
+
+ListView::ListView(Database &database, const string &title, const string &tableName, const vector<ListColumn> &columns,
+                   const vector<string> &sortColumns, bool descending, RowCache *names)
+    : database(database), names(names), title(title), tableName(tableName), columns(columns), sortColumns(sortColumns), descending(descending){
+    reload(false);
+}
+
+size_t ListView::pageSize() const{
+    return max<size_t>(100, static_cast<size_t>(height));
+}
+
+void ListView::reload(bool fromEnd){
+    paginator = make_unique<Paginator>(database, tableName, sortColumns[sortIndex], descending, pageSize());
+    rows.clear();
+    cursor = 0;
+    top = 0;
+    jumped = true;
+
+    Page page;
+    if (!(fromEnd ? paginator->last(page) : paginator->first(page))){
+        atStart = atEnd = true;
+        return;
+    }
+    rows.assign(make_move_iterator(page.rows.begin()), make_move_iterator(page.rows.end()));
+    atStart = fromEnd ? page.previousToken.empty() : true;
+    atEnd = fromEnd ? true : page.nextToken.empty();
+
+    if (fromEnd && !rows.empty()){
+        cursor = rows.size() - 1;
+        top = rows.size() > static_cast<size_t>(height) ? rows.size() - static_cast<size_t>(height) : 0;
+    }
+}
+
+bool ListView::extendForward(){
+    if (atEnd || rows.empty()){
+        return false;
+    }
+
+    Page page;
+    if (!paginator->fetch(paginator->after(rows.back()), page) || page.rows.empty()){
+        atEnd = true;
+        return false;
+    }
+    move(page.rows.begin(), page.rows.end(), back_inserter(rows));
+    atEnd = page.nextToken.empty();
+    return true;
+}
+
+bool ListView::extendBackward(){
+    if (atStart || rows.empty()){
+        return false;
+    }
+
+    Page page;
+    if (!paginator->fetch(paginator->before(rows.front()), page) || page.rows.empty()){
+        atStart = true;
+        return false;
+    }
+    const size_t added = page.rows.size();
+    rows.insert(rows.begin(), make_move_iterator(page.rows.begin()), make_move_iterator(page.rows.end()));
+    cursor += added;
+    top += added;
+    atStart = page.previousToken.empty();
+    return true;
+}
+
+void ListView::trim(){
+    const size_t limit = pageSize() * windowPages;
+    if (rows.size() <= limit){
+        return;
+    }
+    const size_t excess = rows.size() - limit;
+
+    // Keep a page of margin on both sides of the viewport.
+    const size_t frontSpare = top > pageSize() ? top - pageSize() : 0;
+    const size_t visibleEnd = top + static_cast<size_t>(height) + pageSize();
+    const size_t backSpare = rows.size() > visibleEnd ? rows.size() - visibleEnd : 0;
+
+    if (frontSpare >= backSpare){
+        const size_t dropped = min(excess, frontSpare);
+        rows.erase(rows.begin(), rows.begin() + static_cast<ptrdiff_t>(dropped));
+        cursor -= dropped;
+        top -= dropped;
+        atStart = atStart && dropped == 0;
+    }else{
+        const size_t dropped = min(excess, backSpare);
+        rows.erase(rows.end() - static_cast<ptrdiff_t>(dropped), rows.end());
+        atEnd = atEnd && dropped == 0;
+    }
+}
+
+void ListView::follow(){
+    size_t newTop = top;
+    if (cursor < top){
+        newTop = cursor;
+    }else if (cursor >= top + static_cast<size_t>(height)){
+        newTop = cursor - static_cast<size_t>(height) + 1;
+    }
+    scrolled += static_cast<long>(newTop) - static_cast<long>(top);
+    top = newTop;
+}
+
+void ListView::setHeight(int rows){
+    height = max(rows, 1);
+    follow();
+    jumped = true;
+}
+
+void ListView::moveCursor(long delta){
+    if (rows.empty()){
+        return;
+    }
+
+    long target = static_cast<long>(cursor) + delta;
+    // Fetch ahead, so the next screenful is already there when the cursor gets to it.
+    while (target + height >= static_cast<long>(rows.size()) && extendForward()){
+    }
+    while (target - height < 0 && !atStart){
+        const size_t before = rows.size();
+        if (!extendBackward()){
+            break;
+        }
+        target += static_cast<long>(rows.size() - before);
+    }
+
+    cursor = static_cast<size_t>(clamp<long>(target, 0, static_cast<long>(rows.size()) - 1));
+    follow();
+    trim();
+}
+
+void ListView::home(){
+    reload(false);
+}
+
+void ListView::end(){
+    reload(true);
+}
+
+void ListView::nextSort(){
+    sortIndex = (sortIndex + 1) % sortColumns.size();
+    descending = false;
+    reload(false);
+}
+
+void ListView::reverseSort(){
+    descending = !descending;
+    reload(false);
+}
+
+void ListView::refresh(){
+    if (rows.empty()){
+        reload(false);
+        return;
+    }
+    if (top == 0 && !atStart){
+        extendBackward();
+    }
+
+    // Continue from the row above the viewport, so the visible rows are re-read in place.
+    const size_t offset = cursor - top;
+    Page page;
+    bool loaded = top > 0 ? paginator->fetch(paginator->after(rows[top - 1]), page) : paginator->first(page);
+    const bool fromStart = top == 0;
+    if (!loaded || page.rows.empty()){
+        reload(false);
+        return;
+    }
+
+    rows.assign(make_move_iterator(page.rows.begin()), make_move_iterator(page.rows.end()));
+    atStart = fromStart;
+    atEnd = page.nextToken.empty();
+    top = 0;
+    cursor = min(offset, rows.size() - 1);
+    jumped = true;
+    extendBackward();
+}
+
+void ListView::seek(const string &column, const Row &anchor){
+    auto found = find(sortColumns.begin(), sortColumns.end(), column);
+    if (found == sortColumns.end()){
+        return;
+    }
+    sortIndex = static_cast<size_t>(found - sortColumns.begin());
+    descending = false;
+    reload(false);
+
+    // Start just before the anchor: same value, previous id.
+    auto anchorId = anchor.find("id");
+    sqlite3_int64 id = 0;
+    if (anchorId == anchor.end() || !integerValue(anchorId->second, id)){
+        return;
+    }
+    Row before = anchor;
+    before["id"] = id - 1;
+    Page page;
+    if (!paginator->fetch(paginator->after(before), page) || page.rows.empty()){
+        return;
+    }
+    rows.assign(make_move_iterator(page.rows.begin()), make_move_iterator(page.rows.end()));
+    atStart = false;
+    atEnd = page.nextToken.empty();
+    cursor = 0;
+    top = 0;
+    extendBackward();
+    follow();
+    if (top + static_cast<size_t>(height) / 2 <= cursor){
+        top = cursor - static_cast<size_t>(height) / 2;
+    }
+    jumped = true;
+}
+
+bool ListView::takeScroll(long &distance){
+    distance = scrolled;
+    scrolled = 0;
+    if (jumped){
+        jumped = false;
+        return false;
+    }
+    return true;
+}
+
+void ListView::draw(Screen &screen, int firstRow) const{
+    int column = 0;
+    for (const ListColumn &field : columns){
+        column = screen.put(firstRow, column, field.title, CellStyle::Header, field.width, field.alignRight);
+        column = screen.put(firstRow, column, "", CellStyle::Header, 1);
+    }
+    screen.put(firstRow, column, "", CellStyle::Header, screen.width() - column);
+
+    // Resolve the ids of the visible rows with one cache call per column.
+    const size_t visible = top < rows.size() ? min(rows.size() - top, static_cast<size_t>(height)) : 0;
+    vector<vector<shared_ptr<const Row>>> resolved(columns.size());
+    for (size_t field = 0; field < columns.size() && names; ++field){
+        if (columns[field].lookupTable.empty()){
+            continue;
+        }
+        vector<sqlite3_int64> ids(visible, 0);
+        for (size_t line = 0; line < visible; ++line){
+            auto value = rows[top + line].find(columns[field].name);
+            if (value != rows[top + line].end()){
+                integerValue(value->second, ids[line]);
+            }
+        }
+        resolved[field] = names->getMany(columns[field].lookupTable, ids);
+    }
+
+    for (int line = 0; line < height; ++line){
+        const size_t index = top + static_cast<size_t>(line);
+        if (index >= rows.size()){
+            break;
+        }
+        const CellStyle style = index == cursor ? CellStyle::Selected : CellStyle::Normal;
+        column = 0;
+        for (size_t field = 0; field < columns.size(); ++field){
+            const ListColumn &shown = columns[field];
+            const vector<shared_ptr<const Row>> &lookups = resolved[field];
+            if (static_cast<size_t>(line) < lookups.size() && lookups[static_cast<size_t>(line)]){
+                column = screen.put(firstRow + 1 + line, column, formatValue(*lookups[static_cast<size_t>(line)], "name"), style, shown.width);
+            }else{
+                column = screen.put(firstRow + 1 + line, column, formatValue(rows[index], shown.name), style, shown.width, shown.alignRight);
+            }
+            column = screen.put(firstRow + 1 + line, column, "", style, 1);
+        }
+        screen.put(firstRow + 1 + line, column, "", style, screen.width() - column);
+    }
+}
+
+string ListView::status() const{
+    string text = title + "  by " + sortColumns[sortIndex] + (descending ? " desc" : " asc");
+    if (rows.empty()){
+        return text + "  (empty)";
+    }
+    if (atStart && atEnd){
+        text += "  " + to_string(cursor + 1) + "/" + to_string(rows.size());
+    }
+    return text + "  id " + formatValue(rows[cursor], "id");
+}
+
+// Tui
+
+Tui::Tui(const string &dbPath) : database(dbPath), names(database), search(dbPath){
+    views.push_back(make_unique<ListView>(database, "Items", "item",
+                                          vector<ListColumn>{{"id", "ID", 8, true},
+                                                             {"sku", "SKU", 14},
+                                                             {"name", "Name", 30},
+                                                             {"quantity", "Qty", 9, true},
+                                                             {"unit_measurement", "Unit", 6},
+                                                             {"unit_price", "Unit price", 12, true},
+                                                             {"category_id", "Category", 16, false, "category"},
+                                                             {"supplier_id", "Supplier", 20, false, "suppliers"}},
+                                          vector<string>{"name", "id", "sku", "quantity", "unit_price"}, false, &names));
+    views.push_back(make_unique<ListView>(database, "Suppliers", "suppliers",
+                                          vector<ListColumn>{{"id", "ID", 8, true},
+                                                             {"name", "Name", 30},
+                                                             {"phone", "Phone", 16},
+                                                             {"email", "Email", 28},
+                                                             {"address", "Address", 40}},
+                                          vector<string>{"name", "id"}));
+    views.push_back(make_unique<ListView>(database, "Ledger", "transaction_records",
+                                          vector<ListColumn>{{"id", "ID", 8, true},
+                                                             {"transaction_date", "Date", 20},
+                                                             {"transaction_type", "Type", 8},
+                                                             {"item_id", "Item", 24, false, "item"},
+                                                             {"quantity", "Qty", 9, true},
+                                                             {"user_id", "User", 6, true},
+                                                             {"remarks", "Remarks", 40}},
+                                          vector<string>{"transaction_date", "id", "item_id"}, true, &names));
+}
+
+void Tui::layout(){
+    int rows, columns;
+    terminal.size(rows, columns);
+    screen.resize(rows, columns);
+    for (auto &view : views){
+        view->setHeight(rows - 3);
+    }
+}
+
+void Tui::drawFrame(){
+    const auto start = chrono::steady_clock::now();
+    ListView &view = *views[active];
+
+    screen.clear();
+    int column = 0;
+    for (size_t index = 0; index < views.size(); ++index){
+        const string tab = " " + to_string(index + 1) + " " + views[index]->name() + " ";
+        column = screen.put(0, column, tab, index == active ? CellStyle::Selected : CellStyle::Normal, static_cast<int>(tab.size())) + 1;
+    }
+
+    char metrics[96];
+    if (searching){
+        drawSearch();
+        snprintf(metrics, sizeof(metrics), "  %zu hits%s  %.1f ms %zu B", searchResults.hits.size(), searchResults.complete && searchResults.query == searchText ? "" : "...",
+                 lastFrameMs, lastFrameBytes);
+        screen.put(screen.height() - 1, 0, "Search: " + searchText + "_" + metrics, CellStyle::Status, screen.width());
+    }else{
+        // The list scrolls between the column header and the status line.
+        long distance;
+        if (view.takeScroll(distance) && distance != 0){
+            screen.scroll(2, screen.height() - 2, static_cast<int>(distance));
+        }
+        names.sync();
+        view.draw(screen, 1);
+
+        snprintf(metrics, sizeof(metrics), "  %.1f ms %zu B  /:search s:sort d:desc r:refresh q:quit", lastFrameMs, lastFrameBytes);
+        screen.put(screen.height() - 1, 0, view.status() + metrics, CellStyle::Status, screen.width());
+    }
+
+    lastFrameBytes = screen.render(terminal);
+    terminal.flush();
+    lastFrameMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void Tui::drawSearch(){
+    int column = 0;
+    column = screen.put(1, column, "ID", CellStyle::Header, 8, true);
+    column = screen.put(1, column, "", CellStyle::Header, 1);
+    column = screen.put(1, column, "SKU", CellStyle::Header, 14);
+    column = screen.put(1, column, "", CellStyle::Header, 1);
+    screen.put(1, column, "Name", CellStyle::Header, screen.width() - column);
+
+    const int height = screen.height() - 3;
+    const size_t first = searchCursor >= static_cast<size_t>(height) ? searchCursor - static_cast<size_t>(height) + 1 : 0;
+    for (int line = 0; line < height && first + static_cast<size_t>(line) < searchResults.hits.size(); ++line){
+        const size_t index = first + static_cast<size_t>(line);
+        const SearchHit &hit = searchResults.hits[index];
+        const CellStyle style = index == searchCursor ? CellStyle::Selected : CellStyle::Normal;
+        column = screen.put(2 + line, 0, to_string(hit.id), style, 8, true);
+        column = screen.put(2 + line, column, "", style, 1);
+        column = screen.put(2 + line, column, hit.sku, style, 14);
+        column = screen.put(2 + line, column, "", style, 1);
+        screen.put(2 + line, column, hit.name, style, screen.width() - column);
+    }
+}
+
+void Tui::handleSearch(const KeyEvent &event){
+    switch (event.key){
+        case Key::Escape:
+            searching = false;
+            return;
+        case Key::Up:
+            searchCursor = searchCursor > 0 ? searchCursor - 1 : 0;
+            return;
+        case Key::Down:
+            if (searchCursor + 1 < searchResults.hits.size()){
+                ++searchCursor;
+            }
+            return;
+        case Key::Enter:
+            if (searchCursor < searchResults.hits.size()){
+                const SearchHit &hit = searchResults.hits[searchCursor];
+                active = 0;
+                views[active]->seek("name", Row{{"id", hit.id}, {"name", hit.name}});
+            }
+            searching = false;
+            return;
+        case Key::Backspace:
+            // Drop the whole last UTF-8 character.
+            while (!searchText.empty() && (static_cast<unsigned char>(searchText.back()) & 0xC0) == 0x80){
+                searchText.pop_back();
+            }
+            if (!searchText.empty()){
+                searchText.pop_back();
+            }
+            break;
+        case Key::Character:
+            if (event.character < 0x20){
+                return;
+            }
+            appendUtf8(searchText, event.character);
+            break;
+        default:
+            return;
+    }
+    searchCursor = 0;
+    search.submit(searchText);
+}
+
+bool Tui::handle(const KeyEvent &event){
+    if (searching && event.key != Key::Resize){
+        handleSearch(event);
+        return true;
+    }
+
+    ListView &view = *views[active];
+    const long page = max(1, screen.height() - 4);
+
+    switch (event.key){
+        case Key::Up: view.moveCursor(-1); break;
+        case Key::Down: view.moveCursor(1); break;
+        case Key::PageUp: view.moveCursor(-page); break;
+        case Key::PageDown: view.moveCursor(page); break;
+        case Key::Home: view.home(); break;
+        case Key::End: view.end(); break;
+        case Key::Tab: active = (active + 1) % views.size(); break;
+        case Key::Resize: layout(); break;
+        case Key::Escape: return false;
+        case Key::Character:
+            if (event.character == U'q'){
+                return false;
+            }else if (event.character >= U'1' && event.character < U'1' + views.size()){
+                active = event.character - U'1';
+            }else if (event.character == U'/'){
+                searching = true;
+                searchText.clear();
+                searchResults = SearchResults();
+                searchCursor = 0;
+            }else if (event.character == U's'){
+                view.nextSort();
+            }else if (event.character == U'd'){
+                view.reverseSort();
+            }else if (event.character == U'r'){
+                view.refresh();
+            }else if (event.character == U'k'){
+                view.moveCursor(-1);
+            }else if (event.character == U'j'){
+                view.moveCursor(1);
+            }else if (event.character == 0x0C){
+                layout();
+            }
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+int Tui::run(){
+    if (!terminal.isActive()){
+        LOG_ERROR("The terminal UI needs an interactive terminal");
+        return 1;
+    }
+
+    // Log records would be drawn over the screen; keep them in a file instead.
+    FILE *log = fopen("inventory_manager.log", "a");
+    if (log){
+        Logger::instance().setOutput(log);
+    }
+
+    const auto frameInterval = chrono::microseconds(16667);
+    auto lastFrame = chrono::steady_clock::now() - frameInterval;
+    bool dirty = true;
+    bool running = true;
+    layout();
+
+    while (running){
+        const auto sinceFrame = chrono::steady_clock::now() - lastFrame;
+        int timeout = searching ? 2 : 1000;
+        if (dirty){
+            timeout = sinceFrame >= frameInterval ? 0 : static_cast<int>(chrono::duration_cast<chrono::milliseconds>(frameInterval - sinceFrame).count()) + 1;
+        }
+
+        // Take everything already typed before drawing; auto-repeat then costs one frame, not one per key.
+        KeyEvent event;
+        if (terminal.readKey(event, timeout)){
+            do {
+                running = handle(event);
+                dirty = true;
+            } while (running && terminal.readKey(event, 0));
+        }
+        if (searching && search.poll(searchResults)){
+            searchCursor = min(searchCursor, searchResults.hits.empty() ? 0 : searchResults.hits.size() - 1);
+            dirty = true;
+        }
+
+        if (running && dirty && chrono::steady_clock::now() - lastFrame >= frameInterval){
+            lastFrame = chrono::steady_clock::now();
+            drawFrame();
+            dirty = false;
+        }
+    }
+
+    Logger::instance().flush();
+    if (log){
+        Logger::instance().setOutput(stderr);
+        fclose(log);
+    }
+    return 0;
+}
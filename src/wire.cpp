@@ -0,0 +1,235 @@
+#include "wire.hpp"
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+enum ValueType : uint8_t {
+    IntegerValue = 1,
+    RealValue = 2,
+    TextValue = 3,
+    MoneyValue = 4,
+    Integer64Value = 5
+};
+
+// Writer
+
+void wire::Writer::fixed32(uint32_t value){
+    for (int shift = 0; shift < 32; shift += 8){
+        byte(static_cast<uint8_t>(value >> shift));
+    }
+}
+
+void wire::Writer::varint(uint64_t value){
+    while (value >= 0x80){
+        byte(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    byte(static_cast<uint8_t>(value));
+}
+
+void wire::Writer::signedVarint(int64_t value){
+    varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void wire::Writer::real(double value){
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int shift = 0; shift < 64; shift += 8){
+        byte(static_cast<uint8_t>(bits >> shift));
+    }
+}
+
+void wire::Writer::text(const string &value){
+    varint(value.size());
+    out += value;
+}
+
+void wire::Writer::value(const FieldValue &value){
+    if (holds_alternative<int>(value)){
+        byte(IntegerValue);
+        signedVarint(get<int>(value));
+    }else if (holds_alternative<double>(value)){
+        byte(RealValue);
+        real(get<double>(value));
+    }else if (holds_alternative<Money>(value)){
+        byte(MoneyValue);
+        signedVarint(get<Money>(value).minorUnits());
+    }else if (holds_alternative<sqlite3_int64>(value)){
+        byte(Integer64Value);
+        signedVarint(get<sqlite3_int64>(value));
+    }else{
+        byte(TextValue);
+        text(get<string>(value));
+    }
+}
+
+void wire::Writer::row(const Row &row){
+    varint(row.size());
+    for (const auto &[name, field] : row){
+        text(name);
+        value(field);
+    }
+}
+
+// Reader
+
+bool wire::Reader::skip(size_t count){
+    if (count > remaining()){
+        return false;
+    }
+    position += count;
+    return true;
+}
+
+bool wire::Reader::byte(uint8_t &value){
+    if (position == end){
+        return false;
+    }
+    value = *position++;
+    return true;
+}
+
+bool wire::Reader::fixed32(uint32_t &value){
+    value = 0;
+    for (int shift = 0; shift < 32; shift += 8){
+        uint8_t part;
+        if (!byte(part)){
+            return false;
+        }
+        value |= static_cast<uint32_t>(part) << shift;
+    }
+    return true;
+}
+
+bool wire::Reader::varint(uint64_t &value){
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7){
+        uint8_t part;
+        if (!byte(part)){
+            return false;
+        }
+        value |= static_cast<uint64_t>(part & 0x7F) << shift;
+        if (!(part & 0x80)){
+            return true;
+        }
+    }
+    return false;
+}
+
+bool wire::Reader::signedVarint(int64_t &value){
+    uint64_t encoded;
+    if (!varint(encoded)){
+        return false;
+    }
+    value = static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1);
+    return true;
+}
+
+bool wire::Reader::integer(int &value){
+    uint64_t wide;
+    if (!varint(wide) || wide > static_cast<uint64_t>(numeric_limits<int>::max())){
+        return false;
+    }
+    value = static_cast<int>(wide);
+    return true;
+}
+
+bool wire::Reader::signedInteger(int &value){
+    int64_t wide;
+    if (!signedVarint(wide) || wide < numeric_limits<int>::min() || wide > numeric_limits<int>::max()){
+        return false;
+    }
+    value = static_cast<int>(wide);
+    return true;
+}
+
+bool wire::Reader::real(double &value){
+    uint64_t bits = 0;
+    for (int shift = 0; shift < 64; shift += 8){
+        uint8_t part;
+        if (!byte(part)){
+            return false;
+        }
+        bits |= static_cast<uint64_t>(part) << shift;
+    }
+    memcpy(&value, &bits, sizeof(value));
+    return true;
+}
+
+bool wire::Reader::text(string &value){
+    uint64_t size;
+    if (!varint(size) || size > remaining()){
+        return false;
+    }
+    value.assign(reinterpret_cast<const char*>(position), static_cast<size_t>(size));
+    position += size;
+    return true;
+}
+
+bool wire::Reader::value(FieldValue &value){
+    uint8_t type;
+    if (!byte(type)){
+        return false;
+    }
+    switch (type){
+        case IntegerValue: {
+            int integer;
+            if (!signedInteger(integer)){
+                return false;
+            }
+            value = integer;
+            return true;
+        }
+        case RealValue: {
+            double number;
+            if (!real(number)){
+                return false;
+            }
+            value = number;
+            return true;
+        }
+        case MoneyValue: {
+            int64_t units;
+            if (!signedVarint(units)){
+                return false;
+            }
+            value = Money::fromUnits(units);
+            return true;
+        }
+        case Integer64Value: {
+            int64_t integer;
+            if (!signedVarint(integer)){
+                return false;
+            }
+            value = static_cast<sqlite3_int64>(integer);
+            return true;
+        }
+        case TextValue: {
+            string content;
+            if (!text(content)){
+                return false;
+            }
+            value = move(content);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool wire::Reader::row(Row &row){
+    uint64_t count;
+    if (!varint(count) || count > remaining()){
+        return false;
+    }
+    for (uint64_t index = 0; index < count; ++index){
+        string name;
+        FieldValue field;
+        if (!text(name) || !value(field)){
+            return false;
+        }
+        row[move(name)] = move(field);
+    }
+    return true;
+}
@@ -0,0 +1,361 @@
+#include "workload.hpp"
+#include "database.hpp"
+#include "wire.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+using namespace std;
+
+static const char traceMagic[] = "INVTRACE";
+static const uint8_t traceVersion = 1;
+static const size_t flushThreshold = 1 << 20;
+
+const char *traceOpName(TraceOp op){
+    switch (op){
+        case TraceOp::Insert: return "insert";
+        case TraceOp::Upsert: return "upsert";
+        case TraceOp::Update: return "update";
+        case TraceOp::Remove: return "remove";
+        case TraceOp::SoftRemove: return "soft_remove";
+        case TraceOp::Restore: return "restore";
+        case TraceOp::Query: return "query";
+        case TraceOp::RemoveMany: return "remove_many";
+        case TraceOp::Begin: return "begin";
+        case TraceOp::End: return "transaction";
+    }
+    return "unknown";
+}
+
+// WorkloadCapture
+
+WorkloadCapture::WorkloadCapture(const string &path) : opened(chrono::steady_clock::now()){
+    file = fopen(path.c_str(), "wb");
+    if (!file){
+        LOG_ERROR("Can't create trace file: %s", path.c_str());
+        return;
+    }
+    buffer.append(traceMagic, sizeof(traceMagic) - 1);
+    buffer += static_cast<char>(traceVersion);
+}
+
+WorkloadCapture::~WorkloadCapture(){
+    if (file){
+        flush();
+        fclose(file);
+    }
+}
+
+int64_t WorkloadCapture::now() const{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - opened).count();
+}
+
+void WorkloadCapture::encode(const TraceRecord &record){
+    body.clear();
+    wire::Writer writer(body);
+    // Names repeat in nearly every record: the first occurrence is written as
+    // 0 followed by the text, later ones as the varint index + 1.
+    auto name = [&](const string &text){
+        auto [found, added] = names.try_emplace(text, names.size() + 1);
+        writer.varint(added ? 0 : found->second);
+        if (added){
+            writer.text(text);
+        }
+    };
+    writer.byte(static_cast<uint8_t>(record.op));
+    writer.signedVarint(record.timestamp - lastTimestamp);
+    writer.varint(record.duration);
+    writer.byte(static_cast<uint8_t>((record.ok ? 1 : 0) | (record.cascade ? 2 : 0)));
+    name(record.table);
+    writer.varint(record.columns.size());
+    for (const string &column : record.columns){
+        name(column);
+    }
+    writer.varint(record.keys.size());
+    for (const string &key : record.keys){
+        name(key);
+    }
+    writer.varint(record.values.size());
+    for (const TraceValue &value : record.values){
+        writer.value(value);
+    }
+    lastTimestamp = record.timestamp;
+
+    wire::Writer(buffer).varint(body.size());
+    buffer += body;
+}
+
+void WorkloadCapture::write(const TraceRecord &record){
+    if (!file){
+        return;
+    }
+    lock_guard<std::mutex> lock(bufferMutex);
+    encode(record);
+    written.fetch_add(1, memory_order_relaxed);
+    if (buffer.size() >= flushThreshold){
+        fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+    }
+}
+
+void WorkloadCapture::write(const vector<TraceRecord> &records){
+    if (!file){
+        return;
+    }
+    lock_guard<std::mutex> lock(bufferMutex);
+    for (const TraceRecord &record : records){
+        encode(record);
+    }
+    written.fetch_add(records.size(), memory_order_relaxed);
+    if (buffer.size() >= flushThreshold){
+        fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+    }
+}
+
+void WorkloadCapture::flush(){
+    if (!file){
+        return;
+    }
+    lock_guard<std::mutex> lock(bufferMutex);
+    fwrite(buffer.data(), 1, buffer.size(), file);
+    buffer.clear();
+    fflush(file);
+}
+
+bool readTrace(const string &path, vector<TraceRecord> &records){
+    records.clear();
+
+    ifstream input(path, ios::binary);
+    if (!input){
+        LOG_ERROR("Can't open trace file: %s", path.c_str());
+        return false;
+    }
+    const string data((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+    const size_t headerSize = sizeof(traceMagic);
+    if (data.size() < headerSize || data.compare(0, headerSize - 1, traceMagic) != 0 || static_cast<uint8_t>(data[headerSize - 1]) != traceVersion){
+        LOG_ERROR("Not a version %d trace file: %s", traceVersion, path.c_str());
+        return false;
+    }
+
+    wire::Reader reader(data.data() + headerSize, data.size() - headerSize);
+    int64_t timestamp = 0;
+    vector<string> names;
+    while (!reader.atEnd()){
+        uint64_t size;
+        if (!reader.varint(size) || size > reader.remaining()){
+            LOG_WARNING("Trace %s ends with a truncated record", path.c_str());
+            break;
+        }
+        const char *body = data.data() + (data.size() - reader.remaining());
+        reader.skip(static_cast<size_t>(size));
+
+        TraceRecord &record = records.emplace_back();
+        wire::Reader fields(body, static_cast<size_t>(size));
+        uint8_t op;
+        int64_t delta;
+        uint64_t duration;
+        uint8_t flags;
+        uint64_t count;
+        auto name = [&](string &text){
+            uint64_t index;
+            if (!fields.varint(index)){
+                return false;
+            }
+            if (index == 0){
+                if (!fields.text(text)){
+                    return false;
+                }
+                names.push_back(text);
+                return true;
+            }
+            if (index > names.size()){
+                return false;
+            }
+            text = names[index - 1];
+            return true;
+        };
+        bool valid = fields.byte(op) && op <= static_cast<uint8_t>(TraceOp::End) && fields.signedVarint(delta) && fields.varint(duration) &&
+                     fields.byte(flags) && name(record.table);
+        for (vector<string> *list : {&record.columns, &record.keys}){
+            valid = valid && fields.varint(count) && count <= fields.remaining();
+            for (uint64_t index = 0; valid && index < count; ++index){
+                valid = name(list->emplace_back());
+            }
+        }
+        valid = valid && fields.varint(count) && count <= fields.remaining();
+        for (uint64_t index = 0; valid && index < count; ++index){
+            valid = fields.value(record.values.emplace_back());
+        }
+        if (!valid){
+            LOG_ERROR("Malformed record %zu in trace %s", records.size(), path.c_str());
+            records.pop_back();
+            return false;
+        }
+
+        timestamp += delta;
+        record.op = static_cast<TraceOp>(op);
+        record.timestamp = timestamp;
+        record.duration = static_cast<uint32_t>(duration);
+        record.ok = flags & 1;
+        record.cascade = flags & 2;
+    }
+    return true;
+}
+
+// WorkloadReplayer
+
+WorkloadReplayer::WorkloadReplayer(Database &database, const ReplayOptions &options) : database(database), options(options){
+}
+
+bool WorkloadReplayer::copyDatabase(Database &source, const string &path){
+    std::remove(path.c_str());
+    sqlite3 *target;
+    if (sqlite3_open(path.c_str(), &target) != SQLITE_OK){
+        LOG_ERROR("Can't create database copy %s: %s", path.c_str(), sqlite3_errmsg(target));
+        sqlite3_close(target);
+        return false;
+    }
+
+    sqlite3_backup *backup = sqlite3_backup_init(target, "main", source.getDBConnection(), "main");
+    int result = backup ? sqlite3_backup_step(backup, -1) : SQLITE_ERROR;
+    sqlite3_backup_finish(backup);
+    if (result != SQLITE_DONE){
+        LOG_ERROR("Error copying database to %s: %s", path.c_str(), sqlite3_errmsg(target));
+    }
+    sqlite3_close(target);
+    return result == SQLITE_DONE;
+}
+
+bool WorkloadReplayer::execute(const TraceRecord &record){
+    Row row;
+    FieldMapping<Row> mapping;
+    for (size_t index = 0; index < record.columns.size() && index < record.values.size(); ++index){
+        const string &column = record.columns[index];
+        row[column] = record.values[index];
+        mapping.emplace(column, [column](const Row &data){ return data.at(column); });
+    }
+    auto id = [&](size_t index){
+        return index < record.values.size() && holds_alternative<int>(record.values[index]) ? get<int>(record.values[index]) : 0;
+    };
+
+    switch (record.op){
+        case TraceOp::Insert:
+            return database.insert(record.table, row, mapping);
+        case TraceOp::Upsert:
+            return database.upsert(record.table, record.keys, row, mapping);
+        case TraceOp::Update:
+            return database.update(record.table, id(record.columns.size()), row, mapping);
+        case TraceOp::Remove:
+            return database.remove(record.table, id(0));
+        case TraceOp::SoftRemove:
+            return database.softRemove(record.table, id(0));
+        case TraceOp::Restore:
+            return database.restore(record.table, id(0));
+        case TraceOp::Query: {
+            vector<Row> rows;
+            return database.query(record.table, record.values, rows);
+        }
+        case TraceOp::RemoveMany: {
+            vector<int> ids;
+            for (size_t index = 0; index < record.values.size(); ++index){
+                ids.push_back(id(index));
+            }
+            return database.removeMany(record.table, ids, record.cascade);
+        }
+        default:
+            return true;
+    }
+}
+
+size_t WorkloadReplayer::replay(const vector<TraceRecord> &records, size_t index, const vector<size_t> &ends){
+    const TraceRecord &record = records[index];
+    const auto started = chrono::steady_clock::now();
+    bool ok;
+    size_t next;
+
+    if (record.op == TraceOp::Begin){
+        const size_t end = ends[index];
+        ok = database.transaction([&]{
+            for (size_t inner = index + 1; inner < end;){
+                inner = replay(records, inner, ends);
+            }
+            return records[end].ok;
+        }) == records[end].ok;
+        next = end + 1;
+
+        Latencies &measured = latencies[traceOpName(TraceOp::End)];
+        measured.original.push_back(records[end].duration / 1000.0);
+        measured.replayed.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - started).count());
+        measured.diverged += ok ? 0 : 1;
+        // The operations inside were counted as they were replayed.
+        replayedRecords += 2;
+        return next;
+    }
+
+    ok = execute(record) == record.ok;
+    Latencies &measured = latencies[traceOpName(record.op)];
+    measured.original.push_back(record.duration / 1000.0);
+    measured.replayed.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - started).count());
+    measured.diverged += ok ? 0 : 1;
+    ++replayedRecords;
+    return index + 1;
+}
+
+bool WorkloadReplayer::run(const vector<TraceRecord> &records){
+    latencies.clear();
+    replayedRecords = 0;
+
+    // Match every Begin with its End before running anything.
+    vector<size_t> ends(records.size(), 0);
+    vector<size_t> open;
+    for (size_t index = 0; index < records.size(); ++index){
+        if (records[index].op == TraceOp::Begin){
+            open.push_back(index);
+        }else if (records[index].op == TraceOp::End){
+            if (open.empty()){
+                LOG_ERROR("Trace record %zu ends a transaction that never began", index);
+                return false;
+            }
+            ends[open.back()] = index;
+            open.pop_back();
+        }
+    }
+    if (!open.empty()){
+        LOG_ERROR("Trace ends inside a transaction");
+        return false;
+    }
+
+    const auto started = chrono::steady_clock::now();
+    const int64_t firstTimestamp = records.empty() ? 0 : records.front().timestamp;
+    for (size_t index = 0; index < records.size();){
+        if (options.speed > 0){
+            const double offset = static_cast<double>(records[index].timestamp - firstTimestamp) / options.speed;
+            this_thread::sleep_until(started + chrono::microseconds(static_cast<int64_t>(offset)));
+        }
+        index = replay(records, index, ends);
+    }
+    elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+    return true;
+}
+
+double percentile(vector<double> &values, double fraction){
+    if (values.empty()){
+        return 0;
+    }
+    const size_t index = min(values.size() - 1, static_cast<size_t>(fraction * static_cast<double>(values.size())));
+    nth_element(values.begin(), values.begin() + static_cast<long>(index), values.end());
+    return values[index];
+}
+
+void WorkloadReplayer::printSummary(FILE *out) const{
+    fprintf(out, "replayed %zu records in %.1f ms\n", replayedRecords, elapsedMs);
+    fprintf(out, "%-12s %8s  %9s %9s %9s  %9s %9s  %8s\n", "operation", "count", "p50 ms", "p99 ms", "max ms", "orig p50", "orig p99", "diverged");
+    for (const auto &[name, measured] : latencies){
+        vector<double> replayed = measured.replayed;
+        vector<double> original = measured.original;
+        fprintf(out, "%-12s %8zu  %9.3f %9.3f %9.3f  %9.3f %9.3f  %8zu\n", name.c_str(), replayed.size(), percentile(replayed, 0.5),
+                percentile(replayed, 0.99), percentile(replayed, 1.0), percentile(original, 0.5), percentile(original, 0.99), measured.diverged);
+    }
+}